@@ -4,26 +4,96 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <arpa/inet.h>
 
 #include <rte_eal.h>
 #include <rte_log.h>
 #include <rte_debug.h>
+#include <rte_lcore.h>
+#include <rte_cycles.h>
+#include <rte_malloc.h>
+#include <rte_random.h>
+#include <rte_vect.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_mbuf.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
 #include <rte_acl.h>
 #include <rte_ip.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
 
 /* 常量定义 / Constants */
-#define ACL_DENY 0
-#define ACL_ALLOW 1
 #define NUM_FIELDS_IPV4 5
-#define MAX_ACL_RULES 10
+#define NUM_FIELDS_IPV6 11
+#define MAX_ACL_RULES 10        // 内置规则编号上限 / Highest built-in rule id
 #define NUM_TEST_PACKETS 5
 
+/* 规则文件参数 / Rule file parameters */
+#define MAX_FILE_RULES (1U << 20)   // 单个规则文件的规则数上限 / Rules per file
+#define ACL_LOAD_CHUNK 1024         // 每次 rte_acl_add_rules() 的规则数 / Rules per add call
+#define MAX_REPORTED_ERRORS 5       // 打印的无效行数 / Invalid lines printed
+#define PRINT_RULE_LIMIT 32         // 命中表最多打印的规则数 / Rows in the hit table
+
+/* 数据面参数 / Datapath parameters */
+#define MAX_PKT_BURST 64        // 一次分类的最大包数 / Max packets per classify call
+#define NUM_MBUFS 8191
+#define MBUF_CACHE_SIZE 256
+#define RX_RING_SIZE 1024
+#define TX_RING_SIZE 1024
+#define STATS_INTERVAL 1        // 统计打印间隔(秒) / Stats print interval (s)
+#define NUM_BASE_RULES 7        // 基础规则集的规则数 / Rules in the base ruleset
+#define BLOCK_RULE_ID 8         // 推送的封禁规则编号 / Id of the pushed block rule
+
+/* 连接跟踪参数 / Connection tracking parameters */
+#define CT_ENTRIES (1U << 16)       // 每个 lcore 的连接数 / Connections per lcore
+#define CT_IDLE_TIMEOUT_S 30        // 空闲连接超时(秒) / Idle timeout (s)
+#define CT_CLOSE_TIMEOUT_S 5        // 见过 FIN/RST 后的超时(秒) / Timeout after FIN/RST (s)
+#define CT_SCAN_BATCH 256           // 每次老化扫描的表项数 / Entries per aging scan
+#define CT_SCAN_INTERVAL_US 1000    // 老化扫描间隔(微秒) / Aging scan interval (us)
+
+/* 分类基准参数 / Classify benchmark parameters */
+#define BENCH_TUPLES (1U << 21)     // 每轮分类的五元组数 / Tuples per run
+#define BENCH_HIT_PCT 75            // 落在某条规则内的五元组比例 / Share of tuples inside a rule
+#define DEFAULT_BENCH_RULE_LIMIT 100000
+
 /* IPv4协议号已在 netinet/in.h 中定义 / IPv4 Protocol Numbers defined in netinet/in.h */
 /* IPPROTO_TCP = 6, IPPROTO_UDP = 17 */
 
+/* 规则动作 / Rule actions */
+enum acl_action {
+	ACL_DENY = 0,       // 拒绝 / Deny
+	ACL_ALLOW,          // 允许 / Allow
+	ACL_COUNT,          // 只计数，不影响放行 / Count only, verdict unaffected
+};
+
+/**
+ * 分类类别 (category) / Categories
+ *
+ * 类别0决定放行或拒绝，类别1只做计数；每个包在两个类别中各得到一个最高优先级的匹配
+ * Category 0 decides allow/deny, category 1 only counts; each packet gets
+ * one highest-priority match per category
+ *
+ * rte_acl_classify() 的 categories 参数必须是 1 或 RTE_ACL_RESULTS_MULTIPLIER 的倍数，
+ * 所以结果数组按 4 个类别布局，类别2、3空置
+ * rte_acl_classify() requires categories to be 1 or a multiple of
+ * RTE_ACL_RESULTS_MULTIPLIER, so results are laid out for 4 (2 and 3 unused)
+ */
+enum {
+	ACL_CAT_FILTER,     // 过滤类别 / Filter category
+	ACL_CAT_COUNT,      // 计数类别 / Accounting category
+};
+#define ACL_NUM_CATEGORIES RTE_ACL_RESULTS_MULTIPLIER
+
 /* 字段索引枚举 (field_index) / Field index enumeration */
 enum {
 	PROTO_FIELD_IPV4,   // 协议字段 / Protocol field
@@ -51,20 +121,136 @@ enum {
 	RTE_ACL_IPV4VLAN_NUM = 5
 };
 
-/* IPv4五元组结构体 / IPv4 5-tuple structure */
+/* IPv6 字段索引：地址拆成 4 个 32 位字段 / IPv6 field index: addresses split into 4 x 32 bits */
+enum {
+	PROTO_FIELD_IPV6,
+	SRC1_FIELD_IPV6,
+	SRC2_FIELD_IPV6,
+	SRC3_FIELD_IPV6,
+	SRC4_FIELD_IPV6,
+	DST1_FIELD_IPV6,
+	DST2_FIELD_IPV6,
+	DST3_FIELD_IPV6,
+	DST4_FIELD_IPV6,
+	SRCP_FIELD_IPV6,
+	DSTP_FIELD_IPV6
+};
+
+/* IPv6 input_index：每个 32 位地址字一组，端口共享一组 / One group per address word, ports share one */
+enum {
+	ACL_IPV6_PROTO = 0,
+	ACL_IPV6_SRC1,
+	ACL_IPV6_SRC2,
+	ACL_IPV6_SRC3,
+	ACL_IPV6_SRC4,
+	ACL_IPV6_DST1,
+	ACL_IPV6_DST2,
+	ACL_IPV6_DST3,
+	ACL_IPV6_DST4,
+	ACL_IPV6_PORTS,
+};
+
+/**
+ * IPv4五元组结构体 / IPv4 5-tuple structure
+ *
+ * 布局与 IPv4 头从 next_proto_id 开始的部分相同（无选项时端口紧跟在头后面），
+ * 同一套字段定义既能分类这个结构体，也能直接分类报文头而不拷贝
+ * Layout mirrors the IPv4 header from next_proto_id on (ports follow an
+ * option-less header), so the same field defs classify packet headers in place
+ */
 struct ipv4_5tuple {
-	uint8_t  proto;      // 协议 / Protocol
-	uint32_t ip_src;     // 源IP / Source IP
-	uint32_t ip_dst;     // 目的IP / Destination IP
-	uint16_t port_src;   // 源端口 / Source port
-	uint16_t port_dst;   // 目的端口 / Destination port
+	uint8_t  proto;         // 协议 / Protocol
+	uint16_t hdr_checksum;  // 对应IP头校验和，不参与匹配 / IP checksum slot, not matched
+	uint32_t ip_src;        // 源IP / Source IP
+	uint32_t ip_dst;        // 目的IP / Destination IP
+	uint16_t port_src;      // 源端口 / Source port
+	uint16_t port_dst;      // 目的端口 / Destination port
+} __rte_packed;
+
+/* ACL输入在报文中的起始偏移 / Offset of the ACL input inside a packet */
+#define ACL_INPUT_OFFSET \
+	(sizeof(struct rte_ether_hdr) + offsetof(struct rte_ipv4_hdr, next_proto_id))
+
+/**
+ * IPv6五元组结构体 / IPv6 5-tuple structure
+ *
+ * 与 IPv4 相同的做法：布局与 IPv6 头从 proto 开始的部分一致，端口紧跟在固定头后面
+ * Same idea as IPv4: mirrors the IPv6 header from proto on, ports follow the fixed header
+ */
+struct ipv6_5tuple {
+	uint8_t  proto;         // 下一个头 / Next header
+	uint8_t  hop_limits;    // 不参与匹配 / Not matched
+	uint8_t  ip_src[16];
+	uint8_t  ip_dst[16];
+	uint16_t port_src;
+	uint16_t port_dst;
 } __rte_packed;
 
+#define ACL6_INPUT_OFFSET \
+	(sizeof(struct rte_ether_hdr) + offsetof(struct rte_ipv6_hdr, proto))
+
 /* ACL规则结构体 / ACL rule structure */
 RTE_ACL_RULE_DEF(acl_ipv4_rule, NUM_FIELDS_IPV4);
+RTE_ACL_RULE_DEF(acl_ipv6_rule, NUM_FIELDS_IPV6);
+
+/**
+ * 内置规则表：userdata 即规则编号（从1开始），分类结果 0 表示没有匹配；
+ * 规则文件中的规则按文件顺序编号，动作只记在 acl_policy 里
+ * Built-in rule table: userdata is the rule id (1-based), a result of 0 means
+ * no match; file rules are numbered in file order, actions live in acl_policy
+ */
+static struct {
+	enum acl_action action;
+	const char *desc;
+} rule_info[MAX_ACL_RULES + 1];
+
+/* 基础规则集和封禁规则，由 add_acl_rules() 生成 / Base ruleset and block rule */
+static struct acl_ipv4_rule base_rules[NUM_BASE_RULES];
+static struct acl_ipv4_rule block_rule;
+
+/**
+ * 一个已构建的规则集：ACL上下文 + 按规则编号的动作表
+ * A built ruleset: ACL context plus the per-rule-id action table
+ *
+ * 动作表和上下文一起切换，数据面不会用旧上下文的结果去查新动作表
+ * Actions swap together with the context, so the datapath never pairs a
+ * result from one ruleset with the actions of another
+ */
+struct acl_policy {
+	struct rte_acl_ctx *ctx;                // IPv4 规则 / IPv4 rules
+	struct rte_acl_ctx *ctx6;               // IPv6 规则 / IPv6 rules
+	uint32_t capacity;                      // 每个上下文的规则容量 / Rule capacity per context
+	uint32_t nb_rules;                      // 最大规则编号 / Highest rule id
+	uint32_t nb_v4_rules;                   // 0 时 IPv4 全部拒绝 / IPv4 denied when 0
+	uint32_t nb_v6_rules;                   // 0 时 IPv6 全部拒绝 / IPv6 denied when 0
+	uint64_t generation;                    // 每次发布加一，连接跟踪据此作废旧判决 / Bumped on publish, invalidates cached verdicts
+	uint8_t *actions;                       // 按规则编号，capacity + 1 项 / By rule id
+};
+
+/**
+ * 双缓冲：数据面只读 active_policy 指向的槽位，控制面在另一个槽位上构建，
+ * 构建完成后原子切换指针，等所有 worker 经过静止状态再回收旧槽位
+ * Double buffer: the datapath reads the slot active_policy points to, the
+ * control plane builds in the other slot, swaps the pointer atomically and
+ * reclaims the old slot once every worker has passed a quiescent state
+ */
+static struct acl_policy acl_policies[2];
+static struct acl_policy *active_policy = NULL;
+static struct rte_rcu_qsbr *acl_qsv = NULL;
+static uint64_t policy_generation = 0;
 
-/* 全局ACL上下文 / Global ACL context */
-static struct rte_acl_ctx *acl_ctx = NULL;
+/* 规则重载统计，只由控制面写 / Reload stats, written by the control plane only */
+static struct {
+	uint64_t reloads;
+	uint64_t failures;
+	uint64_t build_cycles;          // reset + add + build
+	uint64_t max_build_cycles;
+	uint64_t publish_cycles;        // 指针切换 / Pointer store
+	uint64_t grace_cycles;          // 等待宽限期 / Waiting for the grace period
+	uint64_t max_grace_cycles;
+	uint64_t last_build_cycles;     // 最近一次 rte_acl_build() / Last rte_acl_build() only
+	size_t last_build_bytes;        // 最近一次构建的运行时内存 / Run-time memory of the last build
+} reload_stats;
 
 /* 统计信息 / Statistics */
 static struct {
@@ -73,6 +259,92 @@ static struct {
 	uint32_t denied;
 } stats = {0};
 
+/**
+ * 每个 lcore 的防火墙统计，只由所属 lcore 写，读时汇总
+ * Per-lcore firewall stats, written only by the owning lcore, summed on read
+ */
+struct fw_lcore_stats {
+	uint64_t rx;
+	uint64_t allowed;
+	uint64_t denied;
+	uint64_t slow_path;                     // 带选项或分片，需拷贝五元组 / Options or fragments, tuple copied
+	uint64_t tx_drop;
+	uint64_t ct_hit;                        // 由连接表判决，未走 ACL / Decided by the connection table
+	uint64_t ct_reply;                      // 其中回程方向的包 / Of which reply-direction packets
+	uint64_t ct_new;                        // 新建连接 / Connections created
+	uint64_t ct_expired;                    // 老化删除的连接 / Connections aged out
+	uint64_t ct_full;                       // 表满未能记录 / Not recorded, table full
+	uint64_t *rule_hits;                    // 下标为规则编号，本 lcore 的 socket 上分配 / By rule id, on the lcore's socket
+} __rte_cache_aligned;
+
+static struct fw_lcore_stats fw_stats[RTE_MAX_LCORE];
+
+/**
+ * 连接表的键：两端按 (IP, 端口) 排序，正反两个方向查到同一项
+ * Connection key: the two ends are ordered by (IP, port), so both directions
+ * map to the same entry
+ */
+struct ct_key {
+	uint32_t ip_lo;
+	uint32_t ip_hi;
+	uint16_t port_lo;       // ip_lo 一端的端口 / Port on the ip_lo side
+	uint16_t port_hi;
+	uint8_t  proto;
+	uint8_t  pad[3];
+};
+
+/**
+ * 连接表项，下标即 rte_hash 返回的位置 / Connection entry, indexed by the rte_hash position
+ *
+ * 首包经 ACL 分类后记下判决和命中的规则，之后两个方向的包都按它处理；
+ * 规则集更新后 generation 不再匹配，下一个包重新分类
+ * The first packet is classified and its verdict and rules are kept; packets
+ * in either direction then follow it until a new ruleset bumps the generation
+ */
+struct ct_entry {
+	uint64_t last_seen;     // TSC
+	uint64_t generation;    // 做出判决的规则集 / Ruleset that gave the verdict
+	uint64_t packets;
+	uint32_t filter_rule;
+	uint32_t count_rule;
+	uint8_t  verdict;       // 1 放行 / 1 = allow
+	uint8_t  init_dir;      // 首包方向 / Direction of the first packet
+	uint8_t  closing;       // 见过 FIN/RST / FIN or RST seen
+};
+
+/* 每个 lcore 一张连接表，只由所属 lcore 读写，不需要锁 / One table per lcore, owner access only, lock free */
+struct fw_conntrack {
+	struct rte_hash *hash;
+	struct ct_entry *entries;
+	uint32_t scan_iter;     // 老化扫描的位置 / Aging scan position
+	uint64_t next_scan;
+} __rte_cache_aligned;
+
+static struct fw_conntrack fw_ct[RTE_MAX_LCORE];
+static uint64_t ct_idle_cycles, ct_close_cycles, ct_scan_cycles;
+
+/* rule_hits 的长度减一；之后加载的规则文件不能超过它 / rule_hits length minus one, caps later loads */
+static uint32_t rule_id_limit = 0;
+
+/* 命令行参数 / Command line options */
+static int port_mode = 0;               // -p: 在网口上运行防火墙 / Run firewall on ports
+static uint32_t reload_interval_ms = 0; // -r: 规则推送间隔 / Policy push interval
+static int bench_mode = 0;              // -b: 分类算法基准 / Classify benchmark
+static uint32_t bench_rule_limit = DEFAULT_BENCH_RULE_LIMIT;  // -n: 基准最大规则数 / Largest ruleset
+static const char *rule_file = NULL;    // -f: ClassBench 规则文件 / ClassBench rule file
+static int conntrack_enabled = 1;       // -s 关闭: 连接跟踪 / Connection tracking, off with -s
+
+static volatile int force_quit = 0;
+
+static void
+signal_handler(int signum)
+{
+	if (signum == SIGINT || signum == SIGTERM) {
+		printf("\n收到信号 %d，准备退出...\n", signum);
+		force_quit = 1;
+	}
+}
+
 static void
 setup_acl_config(struct rte_acl_config *cfg)
 {
@@ -119,17 +391,94 @@ setup_acl_config(struct rte_acl_config *cfg)
 		},
 	};
 
+	/* 五元组布局必须与报文头一致 / 5-tuple layout must match the packet headers */
+	RTE_BUILD_BUG_ON(offsetof(struct ipv4_5tuple, ip_src) !=
+			 offsetof(struct rte_ipv4_hdr, src_addr) -
+			 offsetof(struct rte_ipv4_hdr, next_proto_id));
+	RTE_BUILD_BUG_ON(offsetof(struct ipv4_5tuple, ip_dst) !=
+			 offsetof(struct rte_ipv4_hdr, dst_addr) -
+			 offsetof(struct rte_ipv4_hdr, next_proto_id));
+	RTE_BUILD_BUG_ON(offsetof(struct ipv4_5tuple, port_src) !=
+			 sizeof(struct rte_ipv4_hdr) -
+			 offsetof(struct rte_ipv4_hdr, next_proto_id));
+
 	memset(cfg, 0, sizeof(*cfg));
-	cfg->num_categories = 1;  // 使用单一分类器 / Single classifier
+	cfg->num_categories = ACL_NUM_CATEGORIES;
 	cfg->num_fields = NUM_FIELDS_IPV4;
 	memcpy(cfg->defs, ipv4_defs, sizeof(ipv4_defs));
 }
 
+/**
+ * IPv6 字段定义，与 setup_acl_config() 相同的类别和组织方式
+ * IPv6 field definitions, same categories and layout rules as setup_acl_config()
+ */
+static void
+setup_acl6_config(struct rte_acl_config *cfg)
+{
+	struct rte_acl_field_def *def;
+	int i;
+
+	RTE_BUILD_BUG_ON(offsetof(struct ipv6_5tuple, ip_src) !=
+			 offsetof(struct rte_ipv6_hdr, src_addr) -
+			 offsetof(struct rte_ipv6_hdr, proto));
+	RTE_BUILD_BUG_ON(offsetof(struct ipv6_5tuple, port_src) !=
+			 sizeof(struct rte_ipv6_hdr) -
+			 offsetof(struct rte_ipv6_hdr, proto));
+
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->num_categories = ACL_NUM_CATEGORIES;
+	cfg->num_fields = NUM_FIELDS_IPV6;
+
+	/* 协议字段：1字节，BITMASK类型 / Protocol field: 1 byte, BITMASK type */
+	def = &cfg->defs[PROTO_FIELD_IPV6];
+	def->type = RTE_ACL_FIELD_TYPE_BITMASK;
+	def->size = sizeof(uint8_t);
+	def->field_index = PROTO_FIELD_IPV6;
+	def->input_index = ACL_IPV6_PROTO;
+	def->offset = offsetof(struct ipv6_5tuple, proto);
+
+	/* 源/目的地址：各 4 个 4 字节 MASK 字段 / Addresses: 4 MASK fields of 4 bytes each */
+	for (i = 0; i < 4; i++) {
+		def = &cfg->defs[SRC1_FIELD_IPV6 + i];
+		def->type = RTE_ACL_FIELD_TYPE_MASK;
+		def->size = sizeof(uint32_t);
+		def->field_index = SRC1_FIELD_IPV6 + i;
+		def->input_index = ACL_IPV6_SRC1 + i;
+		def->offset = offsetof(struct ipv6_5tuple, ip_src) + i * sizeof(uint32_t);
+
+		def = &cfg->defs[DST1_FIELD_IPV6 + i];
+		def->type = RTE_ACL_FIELD_TYPE_MASK;
+		def->size = sizeof(uint32_t);
+		def->field_index = DST1_FIELD_IPV6 + i;
+		def->input_index = ACL_IPV6_DST1 + i;
+		def->offset = offsetof(struct ipv6_5tuple, ip_dst) + i * sizeof(uint32_t);
+	}
+
+	/* 端口：2字节 RANGE，共享一个 input_index / Ports: 2-byte RANGE, sharing one input_index */
+	def = &cfg->defs[SRCP_FIELD_IPV6];
+	def->type = RTE_ACL_FIELD_TYPE_RANGE;
+	def->size = sizeof(uint16_t);
+	def->field_index = SRCP_FIELD_IPV6;
+	def->input_index = ACL_IPV6_PORTS;
+	def->offset = offsetof(struct ipv6_5tuple, port_src);
+
+	def = &cfg->defs[DSTP_FIELD_IPV6];
+	def->type = RTE_ACL_FIELD_TYPE_RANGE;
+	def->size = sizeof(uint16_t);
+	def->field_index = DSTP_FIELD_IPV6;
+	def->input_index = ACL_IPV6_PORTS;
+	def->offset = offsetof(struct ipv6_5tuple, port_dst);
+}
+
 /**
  * 辅助函数：构造ACL规则 / Helper: construct ACL rule
+ *
+ * 计数规则放进计数类别，其余放进过滤类别
+ * Count rules go to the accounting category, the rest to the filter category
  */
 static void
-make_rule(struct acl_ipv4_rule *rule, uint32_t priority, uint32_t userdata,
+make_rule(struct acl_ipv4_rule *rule, uint32_t priority, uint32_t rule_id,
+          enum acl_action action,
           uint8_t proto, uint8_t proto_mask,
           uint32_t src_ip, uint32_t src_mask_len,
           uint32_t dst_ip, uint32_t dst_mask_len,
@@ -139,9 +488,10 @@ make_rule(struct acl_ipv4_rule *rule, uint32_t priority, uint32_t userdata,
 	memset(rule, 0, sizeof(*rule));
 
 	/* 设置规则元数据 / Set rule metadata */
-	rule->data.category_mask = 1;  // 分类器0 / Category 0
+	rule->data.category_mask = action == ACL_COUNT ?
+				   RTE_BIT32(ACL_CAT_COUNT) : RTE_BIT32(ACL_CAT_FILTER);
 	rule->data.priority = priority;
-	rule->data.userdata = userdata;  // ACL_ALLOW or ACL_DENY
+	rule->data.userdata = rule_id;  // 规则编号，动作查 rule_info / Rule id, action in rule_info
 
 	/* 字段0：协议 / Field 0: Protocol */
 	rule->field[PROTO_FIELD_IPV4].value.u8 = proto;
@@ -164,281 +514,2251 @@ make_rule(struct acl_ipv4_rule *rule, uint32_t priority, uint32_t userdata,
 	rule->field[DSTP_FIELD_IPV4].mask_range.u16 = dst_port_high;
 }
 
+/**
+ * 辅助函数：构造IPv6 ACL规则，地址为网络字节序 / Helper: construct an IPv6 ACL rule, addresses in network order
+ */
+static void
+make_rule6(struct acl_ipv6_rule *rule, uint32_t priority, uint32_t rule_id,
+           enum acl_action action,
+           uint8_t proto, uint8_t proto_mask,
+           const uint8_t *src_ip, uint32_t src_mask_len,
+           const uint8_t *dst_ip, uint32_t dst_mask_len,
+           uint16_t src_port_low, uint16_t src_port_high,
+           uint16_t dst_port_low, uint16_t dst_port_high)
+{
+	int i;
+
+	memset(rule, 0, sizeof(*rule));
+
+	rule->data.category_mask = action == ACL_COUNT ?
+				   RTE_BIT32(ACL_CAT_COUNT) : RTE_BIT32(ACL_CAT_FILTER);
+	rule->data.priority = priority;
+	rule->data.userdata = rule_id;
+
+	rule->field[PROTO_FIELD_IPV6].value.u8 = proto;
+	rule->field[PROTO_FIELD_IPV6].mask_range.u8 = proto_mask;
+
+	/* 前缀长度拆到 4 个字上：第 i 个字取 [32i, 32i+32) 这一段 / Split the prefix over the 4 words */
+	for (i = 0; i < 4; i++) {
+		uint32_t word;
+
+		memcpy(&word, src_ip + i * 4, sizeof(word));
+		rule->field[SRC1_FIELD_IPV6 + i].value.u32 = rte_be_to_cpu_32(word);
+		rule->field[SRC1_FIELD_IPV6 + i].mask_range.u32 =
+			src_mask_len > 32U * i ? RTE_MIN(src_mask_len - 32U * i, 32U) : 0;
+
+		memcpy(&word, dst_ip + i * 4, sizeof(word));
+		rule->field[DST1_FIELD_IPV6 + i].value.u32 = rte_be_to_cpu_32(word);
+		rule->field[DST1_FIELD_IPV6 + i].mask_range.u32 =
+			dst_mask_len > 32U * i ? RTE_MIN(dst_mask_len - 32U * i, 32U) : 0;
+	}
+
+	rule->field[SRCP_FIELD_IPV6].value.u16 = src_port_low;
+	rule->field[SRCP_FIELD_IPV6].mask_range.u16 = src_port_high;
+	rule->field[DSTP_FIELD_IPV6].value.u16 = dst_port_low;
+	rule->field[DSTP_FIELD_IPV6].mask_range.u16 = dst_port_high;
+}
+
+/**
+ * 登记规则编号对应的动作和描述 / Record action and description of a rule id
+ */
+static void
+set_rule_info(uint32_t rule_id, enum acl_action action, const char *desc)
+{
+	rule_info[rule_id].action = action;
+	rule_info[rule_id].desc = desc;
+	printf("  规则%u: %s\n", rule_id, desc);
+}
+
 /**
  * 添加ACL规则 / Add ACL rules
+ * 过滤类别 / Filter category:
  * 1. 允许来自192.168.1.0/24的HTTP流量 / Allow HTTP from 192.168.1.0/24
  * 2. 拒绝所有SSH流量 / Deny all SSH
  * 3. 允许DNS查询（UDP） / Allow DNS queries (UDP)
  * 4. 允许高端口范围（1024-65535） / Allow high port range
  * 5. 默认拒绝所有 / Default deny all
+ * 计数类别 / Accounting category:
+ * 6. 统计来自10.0.0.0/8的流量 / Count traffic from 10.0.0.0/8
+ * 7. 统计所有UDP流量 / Count all UDP traffic
+ * 推送规则 / Pushed rule:
+ * 8. 封禁203.0.113.0/24 / Block 203.0.113.0/24
+ *
+ * 规则只生成到 base_rules[] 和 block_rule，由 acl_policy_reload() 构建
+ * Rules are only generated here, acl_policy_reload() builds them
  */
 static void
-add_acl_rules(struct rte_acl_ctx *ctx)
+add_acl_rules(void)
 {
-	struct acl_ipv4_rule rules[5];
-	int ret;
+	struct acl_ipv4_rule *rules = base_rules;
 
-	printf("[步骤 2] 添加防火墙规则...\n");
+	printf("[步骤 2] 生成防火墙规则...\n");
 
 	/* 规则1：允许HTTP（端口80）来自192.168.1.0/24 [优先级100] */
 	/* Rule 1: Allow HTTP (port 80) from 192.168.1.0/24 [Priority 100] */
-	make_rule(&rules[0], 100, ACL_ALLOW,
+	make_rule(&rules[0], 100, 1, ACL_ALLOW,
 	          IPPROTO_TCP, 0xFF,                    // TCP协议 / TCP protocol
 	          RTE_IPV4(192, 168, 1, 0), 24,        // 源IP: 192.168.1.0/24 / Source IP
 	          0, 0,                                 // 目的IP: 任意 / Dest IP: any
 	          0, 65535,                             // 源端口: 任意 / Source port: any
 	          80, 80);                              // 目的端口: 80 / Dest port: 80
-	printf("  规则1: 允许 HTTP (端口80) 来自 192.168.1.0/24 [优先级 100]\n");
+	set_rule_info(1, ACL_ALLOW, "允许 HTTP (端口80) 来自 192.168.1.0/24 [优先级 100]");
 
 	/* 规则2：拒绝SSH（端口22）来自任意地址 [优先级90] */
 	/* Rule 2: Deny SSH (port 22) from any [Priority 90] */
-	make_rule(&rules[1], 90, ACL_DENY,
+	make_rule(&rules[1], 90, 2, ACL_DENY,
 	          IPPROTO_TCP, 0xFF,
 	          0, 0,                                 // 源IP: 任意 / Source IP: any
 	          0, 0,                                 // 目的IP: 任意 / Dest IP: any
 	          0, 65535,
 	          22, 22);                              // 目的端口: 22 / Dest port: 22
-	printf("  规则2: 拒绝  SSH (端口22) 来自任意地址    [优先级 90]\n");
+	set_rule_info(2, ACL_DENY, "拒绝  SSH (端口22) 来自任意地址    [优先级 90]");
 
 	/* 规则3：允许DNS（UDP端口53） [优先级80] */
 	/* Rule 3: Allow DNS (UDP port 53) [Priority 80] */
-	make_rule(&rules[2], 80, ACL_ALLOW,
+	make_rule(&rules[2], 80, 3, ACL_ALLOW,
 	          IPPROTO_UDP, 0xFF,                    // UDP协议 / UDP protocol
 	          0, 0,
 	          0, 0,
 	          0, 65535,
 	          53, 53);                              // 目的端口: 53 / Dest port: 53
-	printf("  规则3: 允许  DNS (UDP端口53) 来自任意地址  [优先级 80]\n");
+	set_rule_info(3, ACL_ALLOW, "允许  DNS (UDP端口53) 来自任意地址  [优先级 80]");
 
 	/* 规则4：允许高端口范围（1024-65535） [优先级50] */
 	/* Rule 4: Allow high port range (1024-65535) [Priority 50] */
-	make_rule(&rules[3], 50, ACL_ALLOW,
+	make_rule(&rules[3], 50, 4, ACL_ALLOW,
 	          IPPROTO_TCP, 0xFF,
 	          0, 0,
 	          0, 0,
 	          0, 65535,
 	          1024, 65535);                         // 目的端口: 1024-65535 / Dest port: 1024-65535
-	printf("  规则4: 允许  高端口范围 (1024-65535)      [优先级 50]\n");
+	set_rule_info(4, ACL_ALLOW, "允许  高端口范围 (1024-65535)      [优先级 50]");
 
 	/* 规则5：默认拒绝所有 [优先级10] */
 	/* Rule 5: Default deny all [Priority 10] */
-	make_rule(&rules[4], 10, ACL_DENY,
+	make_rule(&rules[4], 10, 5, ACL_DENY,
 	          0, 0,                                 // 任意协议 / Any protocol
 	          0, 0,
 	          0, 0,
 	          0, 65535,
 	          0, 65535);
-	printf("  规则5: 拒绝  所有其他流量（默认拒绝）      [优先级 10]\n");
+	set_rule_info(5, ACL_DENY, "拒绝  所有其他流量（默认拒绝）      [优先级 10]");
 
-	/* 添加规则到ACL上下文 / Add rules to ACL context */
-	ret = rte_acl_add_rules(ctx, (struct rte_acl_rule *)rules, 5);
-	if (ret != 0) {
-		rte_exit(EXIT_FAILURE, "  错误：添加规则失败: %s\n", strerror(-ret));
-	}
-	printf("  ✓ 成功添加 5 条规则\n\n");
+	/* 规则6：统计来自10.0.0.0/8的流量 [计数类别，优先级100] */
+	/* Rule 6: Count traffic from 10.0.0.0/8 [Accounting, priority 100] */
+	make_rule(&rules[5], 100, 6, ACL_COUNT,
+	          0, 0,
+	          RTE_IPV4(10, 0, 0, 0), 8,            // 源IP: 10.0.0.0/8 / Source IP
+	          0, 0,
+	          0, 65535,
+	          0, 65535);
+	set_rule_info(6, ACL_COUNT, "计数  来自 10.0.0.0/8 的流量       [计数类别, 优先级 100]");
+
+	/* 规则7：统计所有UDP流量 [计数类别，优先级50] */
+	/* Rule 7: Count all UDP traffic [Accounting, priority 50] */
+	make_rule(&rules[6], 50, 7, ACL_COUNT,
+	          IPPROTO_UDP, 0xFF,
+	          0, 0,
+	          0, 0,
+	          0, 65535,
+	          0, 65535);
+	set_rule_info(7, ACL_COUNT, "计数  所有 UDP 流量                [计数类别, 优先级 50]");
+
+	/* 规则8：封禁203.0.113.0/24，只在推送的规则集中出现 [优先级200] */
+	/* Rule 8: Block 203.0.113.0/24, only in the pushed ruleset [Priority 200] */
+	make_rule(&block_rule, 200, BLOCK_RULE_ID, ACL_DENY,
+	          0, 0,
+	          RTE_IPV4(203, 0, 113, 0), 24,        // 源IP: 203.0.113.0/24 / Source IP
+	          0, 0,
+	          0, 65535,
+	          0, 65535);
+	set_rule_info(BLOCK_RULE_ID, ACL_DENY, "拒绝  来自 203.0.113.0/24 的流量   [推送规则, 优先级 200]");
+
+	printf("  ✓ 生成 %d 条基础规则 + 1 条推送规则\n\n", NUM_BASE_RULES);
 }
 
 /**
- * 创建测试数据包 / Create test packets
+ * 生成一次推送的规则集：基础规则，可选加上封禁规则，返回规则数
+ * Assemble a pushed ruleset: the base rules, optionally plus the block rule
+ */
+static uint32_t
+make_policy_rules(struct acl_ipv4_rule *rules, int with_block)
+{
+	uint32_t n = NUM_BASE_RULES;
+
+	memcpy(rules, base_rules, sizeof(base_rules));
+	if (with_block)
+		rules[n++] = block_rule;
+	return n;
+}
+
+/* 当前 socket 上 rte_malloc 已分配的字节数 / Bytes allocated from the rte_malloc heap */
+static size_t
+heap_alloc_bytes(void)
+{
+	struct rte_malloc_socket_stats ms;
+
+	if (rte_malloc_get_socket_stats(rte_socket_id(), &ms) != 0)
+		return 0;
+	return ms.heap_allocsz_bytes;
+}
+
+/**
+ * (重新)创建一个槽位的两个ACL上下文和动作表 / (Re)create the contexts and action table of a slot
  *
- * 创建5个测试数据包，每个数据包应匹配不同的规则
- * Create 5 test packets, each should match a different rule
+ * 调用时槽位必须不在使用中（初始化时，或已过宽限期的备用槽位）
+ * The slot must be unused: at init, or a spare slot past its grace period
  */
-static void
-create_test_packets(struct ipv4_5tuple *packets)
+static int
+acl_slot_create(struct acl_policy *slot, uint32_t capacity)
 {
-	/* 数据包1：HTTP from 192.168.1.10 → 应该允许（规则1） */
-	/* Packet 1: HTTP from 192.168.1.10 → should ALLOW (Rule 1) */
-	packets[0].proto = IPPROTO_TCP;
-	packets[0].ip_src = htonl(RTE_IPV4(192, 168, 1, 10));   // 网络字节序！/ Network byte order!
-	packets[0].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
-	packets[0].port_src = htons(12345);
-	packets[0].port_dst = htons(80);
+	int idx = slot == &acl_policies[0] ? 0 : 1;
+	char name[RTE_ACL_NAMESIZE];
+	struct rte_acl_param acl_param = {
+		.name = name,
+		.socket_id = rte_socket_id(),
+		.max_rule_num = RTE_MAX(capacity, (uint32_t)MAX_ACL_RULES),
+	};
 
-	/* 数据包2：SSH from 10.0.0.5 → 应该拒绝（规则2） */
-	/* Packet 2: SSH from 10.0.0.5 → should DENY (Rule 2) */
-	packets[1].proto = IPPROTO_TCP;
-	packets[1].ip_src = htonl(RTE_IPV4(10, 0, 0, 5));
-	packets[1].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
-	packets[1].port_src = htons(54321);
-	packets[1].port_dst = htons(22);
+	rte_acl_free(slot->ctx);
+	rte_acl_free(slot->ctx6);
+	rte_free(slot->actions);
+	memset(slot, 0, sizeof(*slot));
 
-	/* 数据包3：DNS query → 应该允许（规则3） */
-	/* Packet 3: DNS query → should ALLOW (Rule 3) */
-	packets[2].proto = IPPROTO_UDP;
-	packets[2].ip_src = htonl(RTE_IPV4(8, 8, 8, 8));
-	packets[2].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
-	packets[2].port_src = htons(33445);
-	packets[2].port_dst = htons(53);
+	/* 上下文按名字查重，两个槽位必须不同名 / Names must differ, rte_acl_create() looks them up */
+	snprintf(name, sizeof(name), "ipv4_acl_%d", idx);
+	acl_param.rule_size = RTE_ACL_RULE_SZ(NUM_FIELDS_IPV4);
+	slot->ctx = rte_acl_create(&acl_param);
 
-	/* 数据包4：高端口连接 → 应该允许（规则4） */
-	/* Packet 4: High port connection → should ALLOW (Rule 4) */
-	packets[3].proto = IPPROTO_TCP;
-	packets[3].ip_src = htonl(RTE_IPV4(172, 16, 0, 100));
-	packets[3].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
-	packets[3].port_src = htons(44556);
-	packets[3].port_dst = htons(8080);
+	snprintf(name, sizeof(name), "ipv6_acl_%d", idx);
+	acl_param.rule_size = RTE_ACL_RULE_SZ(NUM_FIELDS_IPV6);
+	slot->ctx6 = rte_acl_create(&acl_param);
 
-	/* 数据包5：低端口未知服务 → 应该拒绝（规则5） */
-	/* Packet 5: Low port unknown service → should DENY (Rule 5) */
-	packets[4].proto = IPPROTO_TCP;
-	packets[4].ip_src = htonl(RTE_IPV4(203, 0, 113, 5));
-	packets[4].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
-	packets[4].port_src = htons(11223);
-	packets[4].port_dst = htons(445);  // 低于1024的端口 / Port below 1024
+	slot->actions = rte_zmalloc("acl_actions", acl_param.max_rule_num + 1, 0);
+	if (slot->ctx == NULL || slot->ctx6 == NULL || slot->actions == NULL)
+		return -ENOMEM;
+
+	slot->capacity = acl_param.max_rule_num;
+	return 0;
 }
 
 /**
- * 分类数据包并打印结果 / Classify packets and print results
+ * 取备用槽位，容量不够时重建 / Get the spare slot, recreating it when too small
  */
-static void
-classify_and_print(struct rte_acl_ctx *ctx, struct ipv4_5tuple *packets, int num_packets)
+static struct acl_policy *
+acl_policy_spare(uint32_t capacity)
 {
-	const uint8_t *data[NUM_TEST_PACKETS];
-	uint32_t results[NUM_TEST_PACKETS] = {0};
-	int i, ret;
+	struct acl_policy *spare = active_policy == &acl_policies[0] ?
+				   &acl_policies[1] : &acl_policies[0];
 
-	printf("[步骤 4] 分类测试数据包...\n");
+	if (spare->capacity >= capacity)
+		return spare;
+	return acl_slot_create(spare, capacity) == 0 ? spare : NULL;
+}
 
-	/* 准备数据指针数组 / Prepare data pointer array */
-	for (i = 0; i < num_packets; i++) {
-		data[i] = (const uint8_t *)&packets[i];
-	}
+/**
+ * 控制面：构建备用槽位并原子切换 / Control plane: build the spare slot and swap it in
+ *
+ * 调用前规则已加入 next->ctx / next->ctx6，动作表已填好；t0 为开始准备规则的时刻
+ * Rules are already added to next and its actions filled; t0 is when preparation began
+ *
+ * 1. 在备用槽位上 build（数据面不受影响）
+ * 2. release 语义写 active_policy，worker 下一个 burst 就用新规则集
+ * 3. rte_rcu_qsbr_synchronize() 等所有 worker 报告静止状态
+ * 4. 此后没有 worker 还持有旧槽位，rte_acl_reset() 回收它的运行时内存
+ * 1. build the spare slot, off the datapath
+ * 2. store active_policy with release semantics, workers pick it up next burst
+ * 3. wait until every worker has reported a quiescent state
+ * 4. no worker can still hold the old slot, reset it to free its tries
+ *
+ * 只允许一个控制线程调用 / Single writer only
+ */
+static int
+acl_policy_commit(struct acl_policy *next, uint64_t t0)
+{
+	struct acl_policy *old = active_policy;
+	struct rte_acl_config cfg;
+	uint64_t tb, t1, t2, t3;
+	size_t before, after;
+	int ret;
 
-	/* 批量分类 / Batch classification */
-	ret = rte_acl_classify(ctx, data, results, num_packets, 1);
+	/* 没有规则的上下文不构建，数据面直接拒绝该协议族 / Empty contexts are not built, the datapath denies that family */
+	before = heap_alloc_bytes();
+	tb = rte_rdtsc();
+	ret = 0;
+	if (next->nb_v4_rules > 0) {
+		setup_acl_config(&cfg);
+		ret = rte_acl_build(next->ctx, &cfg);
+	}
+	if (ret == 0 && next->nb_v6_rules > 0) {
+		setup_acl6_config(&cfg);
+		ret = rte_acl_build(next->ctx6, &cfg);
+	}
 	if (ret != 0) {
-		rte_exit(EXIT_FAILURE, "  错误：分类失败: %s\n", strerror(-ret));
+		rte_acl_reset(next->ctx);
+		rte_acl_reset(next->ctx6);
+		reload_stats.failures++;
+		return ret;
 	}
+	t1 = rte_rdtsc();
+	after = heap_alloc_bytes();
 
-	/* 打印分类结果 / Print classification results */
-	for (i = 0; i < num_packets; i++) {
-		char src_ip[INET_ADDRSTRLEN], dst_ip[INET_ADDRSTRLEN];
-		const char *proto_str, *action_str;
-		uint32_t rule_matched;
+	next->generation = ++policy_generation;
+	__atomic_store_n(&active_policy, next, __ATOMIC_RELEASE);
+	t2 = rte_rdtsc();
 
-		/* 转换IP地址为可读格式 / Convert IP to readable format */
-		inet_ntop(AF_INET, &packets[i].ip_src, src_ip, sizeof(src_ip));
-		inet_ntop(AF_INET, &packets[i].ip_dst, dst_ip, sizeof(dst_ip));
+	rte_rcu_qsbr_synchronize(acl_qsv, RTE_QSBR_THRID_INVALID);
+	t3 = rte_rdtsc();
 
-		/* 协议字符串 / Protocol string */
-		proto_str = (packets[i].proto == IPPROTO_TCP) ? "TCP" : "UDP";
+	if (old != NULL) {
+		rte_acl_reset(old->ctx);
+		rte_acl_reset(old->ctx6);
+	}
 
-		/* 判断动作和匹配的规则 / Determine action and matched rule */
-		if (results[i] == ACL_ALLOW) {
-			action_str = "允许";
-			stats.allowed++;
+	__atomic_fetch_add(&reload_stats.reloads, 1, __ATOMIC_RELAXED);
+	reload_stats.build_cycles += t1 - t0;
+	reload_stats.max_build_cycles = RTE_MAX(reload_stats.max_build_cycles, t1 - t0);
+	reload_stats.publish_cycles += t2 - t1;
+	reload_stats.grace_cycles += t3 - t2;
+	reload_stats.max_grace_cycles = RTE_MAX(reload_stats.max_grace_cycles, t3 - t2);
+	reload_stats.last_build_cycles = t1 - tb;
+	reload_stats.last_build_bytes = after > before ? after - before : 0;
+	return 0;
+}
 
-			/* 根据端口判断具体规则 / Determine specific rule based on port */
-			if (ntohs(packets[i].port_dst) == 80 &&
-			    (ntohl(packets[i].ip_src) & 0xFFFFFF00) == RTE_IPV4(192, 168, 1, 0)) {
-				rule_matched = 1;
-			} else if (ntohs(packets[i].port_dst) == 53 && packets[i].proto == IPPROTO_UDP) {
-				rule_matched = 3;
-			} else if (ntohs(packets[i].port_dst) >= 1024) {
-				rule_matched = 4;
-			} else {
-				rule_matched = 0;  // 未知 / Unknown
-			}
-		} else {
-			action_str = "拒绝 ";
-			stats.denied++;
+/**
+ * 发布一组内置规则 / Publish a set of built-in rules
+ */
+static int
+acl_policy_reload(const struct acl_ipv4_rule *rules, uint32_t nb_rules)
+{
+	struct acl_policy *next = acl_policy_spare(MAX_ACL_RULES);
+	uint64_t t0 = rte_rdtsc();
+	uint32_t i;
+	int ret;
 
-			/* 判断是SSH拒绝还是默认拒绝 / Determine if SSH deny or default deny */
-			if (ntohs(packets[i].port_dst) == 22) {
-				rule_matched = 2;
-			} else {
-				rule_matched = 5;
-			}
-		}
+	if (next == NULL)
+		return -ENOMEM;
 
-		printf("  数据包%d: %s:%-5d → %s:%-5d (%s)  → %s (规则%d)\n",
-		       i + 1,
-		       src_ip, ntohs(packets[i].port_src),
-		       dst_ip, ntohs(packets[i].port_dst),
-		       proto_str,
-		       action_str,
-		       rule_matched);
+	ret = rte_acl_add_rules(next->ctx, (const struct rte_acl_rule *)rules, nb_rules);
+	if (ret != 0) {
+		rte_acl_reset(next->ctx);
+		reload_stats.failures++;
+		return ret;
+	}
 
-		stats.total_packets++;
+	/* 动作表随规则集一起发布 / Actions are published with the ruleset */
+	memset(next->actions, ACL_DENY, next->capacity + 1);
+	next->nb_rules = 0;
+	next->nb_v4_rules = nb_rules;
+	next->nb_v6_rules = 0;
+	for (i = 0; i < nb_rules; i++) {
+		uint32_t id = rules[i].data.userdata;
+
+		next->actions[id] = rule_info[id].action;
+		next->nb_rules = RTE_MAX(next->nb_rules, id);
 	}
-	printf("\n");
+
+	return acl_policy_commit(next, t0);
 }
 
 /**
- * 打印统计信息 / Print statistics
+ * 打印重载耗时 / Print reload timings
  */
 static void
-print_statistics(void)
+print_reload_stats(void)
 {
-	printf("[统计信息]\n");
-	printf("  总数据包: %u\n", stats.total_packets);
-	printf("  允许: %u\n", stats.allowed);
-	printf("  拒绝: %u\n\n", stats.denied);
+	double us = 1e6 / rte_get_tsc_hz();
+	uint64_t n = reload_stats.reloads;
+
+	if (n == 0) {
+		printf("  重载 0 次 (失败 %" PRIu64 ")\n", reload_stats.failures);
+		return;
+	}
+	printf("  重载 %" PRIu64 " 次 (失败 %" PRIu64 ")\n", n, reload_stats.failures);
+	printf("  构建:   平均 %.1f us, 最大 %.1f us\n",
+	       reload_stats.build_cycles * us / n, reload_stats.max_build_cycles * us);
+	printf("  切换:   平均 %.3f us\n", reload_stats.publish_cycles * us / n);
+	printf("  宽限期: 平均 %.1f us, 最大 %.1f us\n",
+	       reload_stats.grace_cycles * us / n, reload_stats.max_grace_cycles * us);
 }
 
 /**
- * 主函数 / Main function
+ * 创建两个槽位的ACL上下文和 RCU 变量 / Create both ACL slots and the RCU variable
  */
-int
-main(int argc, char **argv)
+static void
+acl_policy_init(void)
 {
-	int ret;
-	struct ipv4_5tuple test_packets[NUM_TEST_PACKETS];
+	size_t qsv_size = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+	int i;
 
-	/* 初始化EAL / Initialize EAL */
-	ret = rte_eal_init(argc, argv);
-	if (ret < 0) {
-		rte_panic("无法初始化EAL: %s\n", rte_strerror(rte_errno));
+	for (i = 0; i < 2; i++) {
+		if (acl_slot_create(&acl_policies[i], MAX_ACL_RULES) != 0) {
+			rte_exit(EXIT_FAILURE, "  错误：无法创建ACL上下文 (槽位 %d)\n", i);
+		}
+		printf("  ✓ 成功创建ACL上下文: ipv4_acl_%d / ipv6_acl_%d\n", i, i);
 	}
 
-	printf("=== DPDK ACL 演示：IPv4防火墙 ===\n\n");
+	acl_qsv = rte_zmalloc("acl_qsv", qsv_size, RTE_CACHE_LINE_SIZE);
+	if (acl_qsv == NULL || rte_rcu_qsbr_init(acl_qsv, RTE_MAX_LCORE) != 0) {
+		rte_exit(EXIT_FAILURE, "  错误：无法创建RCU变量\n");
+	}
+	printf("  ✓ RCU QSBR 变量就绪 (最多 %d 个读者)\n\n", RTE_MAX_LCORE);
+}
 
-	/* 1. 创建ACL上下文 / Create ACL context */
-	struct rte_acl_param acl_param = {
-		.name = "ipv4_acl",
-		.socket_id = rte_socket_id(),
-		.rule_size = RTE_ACL_RULE_SZ(NUM_FIELDS_IPV4),
-		.max_rule_num = MAX_ACL_RULES,
+/**
+ * ============================================================================
+ * ClassBench 规则文件 / ClassBench rule files (-f)
+ * ============================================================================
+ *
+ * 每行一条规则，与 DPDK test-acl / l3fwd-acl 的 ClassBench 格式相同:
+ * One rule per line, the ClassBench format used by DPDK test-acl / l3fwd-acl:
+ *
+ *   @<源前缀> <目的前缀> <源端口低> : <源端口高> <目的端口低> : <目的端口高> <协议>/<掩码> [标志] [动作]
+ *   @192.168.1.0/24  0.0.0.0/0  0 : 65535  80 : 80  0x06/0xFF
+ *   @2001:db8::/32   ::/0       0 : 65535  53 : 53  0x11/0xFF  allow
+ *
+ * 地址含 ':' 的行是 IPv6 规则。ClassBench 生成器附加的 0x..../0x.... 标志字段被忽略。
+ * 动作为 allow / deny / count，缺省为 deny（与 l3fwd-acl 中 ACL 规则即丢弃一致）。
+ * 文件中靠前的规则优先级更高（ClassBench 按首条匹配定义）。
+ * 不以 '@' 开头的行（空行、'#' 注释）被跳过。
+ * Lines with ':' in the address are IPv6. Trailing ClassBench flag fields
+ * are ignored. The action is allow / deny / count, deny by default. Earlier
+ * rules win (ClassBench is first-match). Lines not starting with '@' are skipped.
+ */
+
+static const char *
+skip_ws(const char *p)
+{
+	while (*p == ' ' || *p == '\t')
+		p++;
+	return p;
+}
+
+/* 解析一个不超过 max 的十进制数或 0x 十六进制数 / Parse a decimal or 0x number <= max */
+static int
+parse_uint(const char **pp, uint32_t max, uint32_t *out)
+{
+	const char *p = skip_ws(*pp);
+	int base = p[0] == '0' && (p[1] == 'x' || p[1] == 'X') ? 16 : 10;
+	unsigned long v;
+	char *end;
+
+	if (*p < '0' || *p > '9')
+		return -EINVAL;
+	errno = 0;
+	v = strtoul(p, &end, base);
+	if (errno != 0 || v > max)
+		return -EINVAL;
+	*out = (uint32_t)v;
+	*pp = end;
+	return 0;
+}
+
+/**
+ * 解析 "<地址>/<长度>"，返回 AF_INET 或 AF_INET6 / Parse "<addr>/<len>", return the family
+ *
+ * 地址按网络字节序写入 addr（IPv4 占前 4 字节），主机位清零
+ * The address goes to addr in network order (IPv4 uses 4 bytes), host bits cleared
+ */
+static int
+parse_prefix(const char **pp, uint8_t *addr, uint32_t *depth)
+{
+	const char *p = skip_ws(*pp);
+	const char *slash = p;
+	char buf[INET6_ADDRSTRLEN];
+	int family;
+	uint32_t max_depth, i;
+
+	while (*slash != '\0' && *slash != '/' && *slash != ' ' && *slash != '\t')
+		slash++;
+	if (*slash != '/' || slash == p || (size_t)(slash - p) >= sizeof(buf))
+		return -EINVAL;
+
+	memcpy(buf, p, slash - p);
+	buf[slash - p] = '\0';
+	family = memchr(buf, ':', slash - p) != NULL ? AF_INET6 : AF_INET;
+	max_depth = family == AF_INET6 ? 128 : 32;
+	if (inet_pton(family, buf, addr) != 1)
+		return -EINVAL;
+
+	p = slash + 1;
+	if (parse_uint(&p, max_depth, depth) < 0)
+		return -EINVAL;
+
+	for (i = 0; i < max_depth / 8; i++) {
+		uint32_t bits = *depth > i * 8 ? RTE_MIN(*depth - i * 8, 8U) : 0;
+
+		addr[i] &= (uint8_t)(0xFF00 >> bits);
+	}
+
+	*pp = p;
+	return family;
+}
+
+/* 解析 "<低> : <高>" 端口范围 / Parse a "<lo> : <hi>" port range */
+static int
+parse_port_range(const char **pp, uint16_t *lo, uint16_t *hi)
+{
+	const char *p = *pp;
+	uint32_t l, h;
+
+	if (parse_uint(&p, UINT16_MAX, &l) < 0)
+		return -EINVAL;
+	p = skip_ws(p);
+	if (*p++ != ':')
+		return -EINVAL;
+	if (parse_uint(&p, UINT16_MAX, &h) < 0 || l > h)
+		return -EINVAL;
+
+	*lo = (uint16_t)l;
+	*hi = (uint16_t)h;
+	*pp = p;
+	return 0;
+}
+
+/**
+ * 解析一行规则（已去掉 '@'），按协议族写入 r4 或 r6
+ * Parse one rule line (after '@') into r4 or r6 depending on the family
+ *
+ * 返回 AF_INET / AF_INET6，格式错误返回 -EINVAL
+ * Returns AF_INET / AF_INET6, or -EINVAL on malformed input
+ */
+static int
+parse_rule_line(const char *p, uint32_t priority, uint32_t rule_id,
+		struct acl_ipv4_rule *r4, struct acl_ipv6_rule *r6,
+		enum acl_action *action)
+{
+	uint8_t src[16], dst[16];
+	uint32_t src_len, dst_len, proto, proto_mask;
+	uint16_t sp_lo, sp_hi, dp_lo, dp_hi;
+	int family;
+
+	family = parse_prefix(&p, src, &src_len);
+	if (family < 0 || parse_prefix(&p, dst, &dst_len) != family)
+		return -EINVAL;
+	if (parse_port_range(&p, &sp_lo, &sp_hi) < 0 ||
+	    parse_port_range(&p, &dp_lo, &dp_hi) < 0)
+		return -EINVAL;
+	if (parse_uint(&p, UINT8_MAX, &proto) < 0 || *p++ != '/' ||
+	    parse_uint(&p, UINT8_MAX, &proto_mask) < 0)
+		return -EINVAL;
+
+	/* 可选的 ClassBench 标志字段和动作 / Optional ClassBench flags and action */
+	*action = ACL_DENY;
+	p = skip_ws(p);
+	if (strncmp(p, "0x", 2) == 0) {
+		while (*p != '\0' && *p != ' ' && *p != '\t')
+			p++;
+		p = skip_ws(p);
+	}
+	if (strncmp(p, "allow", 5) == 0) {
+		*action = ACL_ALLOW;
+		p += 5;
+	} else if (strncmp(p, "deny", 4) == 0) {
+		p += 4;
+	} else if (strncmp(p, "count", 5) == 0) {
+		*action = ACL_COUNT;
+		p += 5;
+	}
+	p = skip_ws(p);
+	if (*p != '\0' && *p != '#')
+		return -EINVAL;
+
+	if (family == AF_INET) {
+		uint32_t s4, d4;
+
+		memcpy(&s4, src, sizeof(s4));
+		memcpy(&d4, dst, sizeof(d4));
+		make_rule(r4, priority, rule_id, *action,
+		          (uint8_t)(proto & proto_mask), (uint8_t)proto_mask,
+		          ntohl(s4), src_len, ntohl(d4), dst_len,
+		          sp_lo, sp_hi, dp_lo, dp_hi);
+	} else {
+		make_rule6(r6, priority, rule_id, *action,
+		           (uint8_t)(proto & proto_mask), (uint8_t)proto_mask,
+		           src, src_len, dst, dst_len,
+		           sp_lo, sp_hi, dp_lo, dp_hi);
+	}
+	return family;
+}
+
+/* 统计文件中的规则行数，用于确定上下文容量 / Count rule lines to size the contexts */
+static int64_t
+count_rule_lines(FILE *fp)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	int64_t n = 0;
+
+	while (getline(&line, &cap, fp) > 0) {
+		if (*skip_ws(line) == '@')
+			n++;
+	}
+	free(line);
+	rewind(fp);
+	return n;
+}
+
+/**
+ * 流式加载规则文件并发布 / Stream a rule file in and publish it
+ *
+ * 文件逐行读取，不整体读入内存；解析出的规则攒满 ACL_LOAD_CHUNK 条就
+ * rte_acl_add_rules() 一次，内存中只有一个块的临时规则。无效行计数并跳过。
+ * 规则加入备用槽位后走 acl_policy_commit() 构建和切换。
+ * The file is read line by line; parsed rules are added ACL_LOAD_CHUNK at a
+ * time, so only one chunk is held in memory. Invalid lines are counted and
+ * skipped. The spare slot is then built and swapped by acl_policy_commit().
+ */
+static int
+acl_policy_load_file(const char *path, int verbose)
+{
+	struct acl_ipv4_rule *chunk4 = NULL;
+	struct acl_ipv6_rule *chunk6 = NULL;
+	struct acl_policy *next;
+	uint32_t n4 = 0, n6 = 0, nb_v4 = 0, nb_v6 = 0, nb_invalid = 0;
+	uint32_t rule_id = 0, line_no = 0;
+	uint64_t t0, t_parsed;
+	double ms = 1e3 / rte_get_tsc_hz();
+	char *line = NULL;
+	size_t cap = 0;
+	int64_t nb_lines;
+	FILE *fp;
+	int ret = 0;
+
+	fp = fopen(path, "r");
+	if (fp == NULL) {
+		ret = -errno;
+		printf("  错误：无法打开规则文件 %s: %s\n", path, strerror(-ret));
+		return ret;
+	}
+
+	nb_lines = count_rule_lines(fp);
+	if (nb_lines == 0 || nb_lines > MAX_FILE_RULES ||
+	    (rule_id_limit != 0 && nb_lines > rule_id_limit)) {
+		printf("  错误：规则文件 %s 有 %" PRId64 " 条规则 (上限 %u)\n", path, nb_lines,
+		       rule_id_limit != 0 ? rule_id_limit : MAX_FILE_RULES);
+		fclose(fp);
+		return nb_lines == 0 ? -ENOENT : -E2BIG;
+	}
+
+	next = acl_policy_spare((uint32_t)nb_lines);
+	chunk4 = malloc(sizeof(*chunk4) * ACL_LOAD_CHUNK);
+	chunk6 = malloc(sizeof(*chunk6) * ACL_LOAD_CHUNK);
+	if (next == NULL || chunk4 == NULL || chunk6 == NULL) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	t0 = rte_rdtsc();
+	memset(next->actions, ACL_DENY, next->capacity + 1);
+
+	while (getline(&line, &cap, fp) > 0) {
+		const char *p = skip_ws(line);
+		enum acl_action action;
+		int family;
+
+		line_no++;
+		if (*p != '@')
+			continue;
+		line[strcspn(line, "\r\n")] = '\0';
+
+		/* 计数之后文件被追加 (-r 定时重载时可能发生)：超出容量就放弃本次加载 */
+		if (rule_id == next->capacity) {
+			printf("  错误：规则文件在加载过程中变长，超过 %u 条\n", next->capacity);
+			ret = -E2BIG;
+			break;
+		}
+
+		family = parse_rule_line(p + 1, RTE_ACL_MAX_PRIORITY - rule_id, rule_id + 1,
+					 &chunk4[n4], &chunk6[n6], &action);
+		if (family < 0) {
+			if (++nb_invalid <= MAX_REPORTED_ERRORS)
+				printf("  第 %u 行无效: %s\n", line_no, line);
+			continue;
+		}
+
+		next->actions[++rule_id] = action;
+		if (family == AF_INET) {
+			nb_v4++;
+			if (++n4 == ACL_LOAD_CHUNK) {
+				ret = rte_acl_add_rules(next->ctx, (const struct rte_acl_rule *)chunk4, n4);
+				n4 = 0;
+			}
+		} else {
+			nb_v6++;
+			if (++n6 == ACL_LOAD_CHUNK) {
+				ret = rte_acl_add_rules(next->ctx6, (const struct rte_acl_rule *)chunk6, n6);
+				n6 = 0;
+			}
+		}
+		if (ret != 0)
+			break;
+	}
+
+	if (ret == 0 && n4 > 0)
+		ret = rte_acl_add_rules(next->ctx, (const struct rte_acl_rule *)chunk4, n4);
+	if (ret == 0 && n6 > 0)
+		ret = rte_acl_add_rules(next->ctx6, (const struct rte_acl_rule *)chunk6, n6);
+	if (ret == 0 && rule_id == 0)
+		ret = -ENOENT;
+	if (ret != 0) {
+		printf("  错误：加入规则失败: %s\n", strerror(-ret));
+		rte_acl_reset(next->ctx);
+		rte_acl_reset(next->ctx6);
+		reload_stats.failures++;
+		goto out;
+	}
+	t_parsed = rte_rdtsc();
+
+	next->nb_rules = rule_id;
+	next->nb_v4_rules = nb_v4;
+	next->nb_v6_rules = nb_v6;
+	ret = acl_policy_commit(next, t0);
+	if (ret != 0) {
+		printf("  错误：构建ACL失败: %s\n", strerror(-ret));
+		goto out;
+	}
+
+	if (verbose) {
+		printf("  %s: %u 条 IPv4 + %u 条 IPv6 规则, %u 行无效\n",
+		       path, nb_v4, nb_v6, nb_invalid);
+		printf("  解析+加入: %.1f ms, 构建: %.1f ms (%.0f 条/秒)\n",
+		       (t_parsed - t0) * ms, reload_stats.last_build_cycles * ms,
+		       rule_id / ((rte_rdtsc() - t0) * ms / 1e3));
+		printf("  内存: 规则存储 %zu KB, 运行时结构 %zu KB\n",
+		       ((size_t)next->capacity * (RTE_ACL_RULE_SZ(NUM_FIELDS_IPV4) +
+						  RTE_ACL_RULE_SZ(NUM_FIELDS_IPV6))) >> 10,
+		       reload_stats.last_build_bytes >> 10);
+	}
+
+out:
+	free(line);
+	free(chunk6);
+	free(chunk4);
+	fclose(fp);
+	return ret;
+}
+
+/**
+ * 创建测试数据包 / Create test packets
+ *
+ * 创建5个测试数据包，每个数据包应匹配不同的规则
+ * Create 5 test packets, each should match a different rule
+ */
+static void
+create_test_packets(struct ipv4_5tuple *packets)
+{
+	memset(packets, 0, sizeof(*packets) * NUM_TEST_PACKETS);
+
+	/* 数据包1：HTTP from 192.168.1.10 → 应该允许（规则1） */
+	/* Packet 1: HTTP from 192.168.1.10 → should ALLOW (Rule 1) */
+	packets[0].proto = IPPROTO_TCP;
+	packets[0].ip_src = htonl(RTE_IPV4(192, 168, 1, 10));   // 网络字节序！/ Network byte order!
+	packets[0].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
+	packets[0].port_src = htons(12345);
+	packets[0].port_dst = htons(80);
+
+	/* 数据包2：SSH from 10.0.0.5 → 应该拒绝（规则2），计数（规则6） */
+	/* Packet 2: SSH from 10.0.0.5 → should DENY (Rule 2), counted (Rule 6) */
+	packets[1].proto = IPPROTO_TCP;
+	packets[1].ip_src = htonl(RTE_IPV4(10, 0, 0, 5));
+	packets[1].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
+	packets[1].port_src = htons(54321);
+	packets[1].port_dst = htons(22);
+
+	/* 数据包3：DNS query → 应该允许（规则3），计数（规则7） */
+	/* Packet 3: DNS query → should ALLOW (Rule 3), counted (Rule 7) */
+	packets[2].proto = IPPROTO_UDP;
+	packets[2].ip_src = htonl(RTE_IPV4(8, 8, 8, 8));
+	packets[2].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
+	packets[2].port_src = htons(33445);
+	packets[2].port_dst = htons(53);
+
+	/* 数据包4：高端口连接 → 应该允许（规则4） */
+	/* Packet 4: High port connection → should ALLOW (Rule 4) */
+	packets[3].proto = IPPROTO_TCP;
+	packets[3].ip_src = htonl(RTE_IPV4(172, 16, 0, 100));
+	packets[3].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
+	packets[3].port_src = htons(44556);
+	packets[3].port_dst = htons(8080);
+
+	/* 数据包5：低端口未知服务 → 应该拒绝（规则5） */
+	/* Packet 5: Low port unknown service → should DENY (Rule 5) */
+	packets[4].proto = IPPROTO_TCP;
+	packets[4].ip_src = htonl(RTE_IPV4(203, 0, 113, 5));
+	packets[4].ip_dst = htonl(RTE_IPV4(10, 0, 0, 1));
+	packets[4].port_src = htons(11223);
+	packets[4].port_dst = htons(445);  // 低于1024的端口 / Port below 1024
+}
+
+/**
+ * 分类数据包并打印结果 / Classify packets and print results
+ */
+static void
+classify_and_print(const struct acl_policy *pol, struct ipv4_5tuple *packets, int num_packets)
+{
+	const uint8_t *data[NUM_TEST_PACKETS];
+	uint32_t results[NUM_TEST_PACKETS * ACL_NUM_CATEGORIES] = {0};
+	int i, ret;
+
+	printf("[步骤 4] 分类测试数据包...\n");
+
+	/* 准备数据指针数组 / Prepare data pointer array */
+	for (i = 0; i < num_packets; i++) {
+		data[i] = (const uint8_t *)&packets[i];
+	}
+
+	/* 批量分类，每个包 ACL_NUM_CATEGORIES 个结果 / Batch classification, ACL_NUM_CATEGORIES results per packet */
+	ret = pol->nb_v4_rules == 0 ? 0 :
+	      rte_acl_classify(pol->ctx, data, results, num_packets, ACL_NUM_CATEGORIES);
+	if (ret != 0) {
+		rte_exit(EXIT_FAILURE, "  错误：分类失败: %s\n", strerror(-ret));
+	}
+
+	/* 打印分类结果 / Print classification results */
+	for (i = 0; i < num_packets; i++) {
+		char src_ip[INET_ADDRSTRLEN], dst_ip[INET_ADDRSTRLEN];
+		const char *proto_str, *action_str;
+		uint32_t filter = results[i * ACL_NUM_CATEGORIES + ACL_CAT_FILTER];
+		uint32_t count = results[i * ACL_NUM_CATEGORIES + ACL_CAT_COUNT];
+
+		/* 转换IP地址为可读格式 / Convert IP to readable format */
+		inet_ntop(AF_INET, &packets[i].ip_src, src_ip, sizeof(src_ip));
+		inet_ntop(AF_INET, &packets[i].ip_dst, dst_ip, sizeof(dst_ip));
+
+		/* 协议字符串 / Protocol string */
+		proto_str = (packets[i].proto == IPPROTO_TCP) ? "TCP" : "UDP";
+
+		/* 结果就是规则编号，0 表示未匹配（按拒绝处理） / Result is the rule id, 0 = no match (denied) */
+		if (filter != 0 && pol->actions[filter] == ACL_ALLOW) {
+			action_str = "允许";
+			stats.allowed++;
+		} else {
+			action_str = "拒绝 ";
+			stats.denied++;
+		}
+
+		printf("  数据包%d: %s:%-5d → %s:%-5d (%s)  → %s (规则%u)",
+		       i + 1,
+		       src_ip, ntohs(packets[i].port_src),
+		       dst_ip, ntohs(packets[i].port_dst),
+		       proto_str,
+		       action_str,
+		       filter);
+		if (count != 0)
+			printf("  [计数: 规则%u]", count);
+		printf("\n");
+
+		stats.total_packets++;
+	}
+	printf("\n");
+}
+
+/**
+ * 为非首片分片或带选项的包拷贝五元组 / Copy the 5-tuple of a fragment or a packet with options
+ *
+ * 非首片分片没有 L4 头，端口按 0 匹配；带选项的包端口在 IHL 指示的位置
+ * Non-first fragments carry no L4 header, ports match as 0; with options the
+ * ports sit where IHL says
+ */
+static const uint8_t *
+fw_copy_tuple(const struct rte_mbuf *m, const struct rte_ipv4_hdr *ip,
+	      struct ipv4_5tuple *t)
+{
+	uint32_t l3_len = rte_ipv4_hdr_len(ip);
+
+	memset(t, 0, sizeof(*t));
+	t->proto = ip->next_proto_id;
+	t->ip_src = ip->src_addr;
+	t->ip_dst = ip->dst_addr;
+
+	if ((ip->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0 &&
+	    rte_pktmbuf_data_len(m) >= sizeof(struct rte_ether_hdr) + l3_len + 2 * sizeof(uint16_t)) {
+		const uint16_t *ports = rte_pktmbuf_mtod_offset(m, const uint16_t *,
+				sizeof(struct rte_ether_hdr) + l3_len);
+
+		t->port_src = ports[0];
+		t->port_dst = ports[1];
+	}
+
+	return (const uint8_t *)t;
+}
+
+/**
+ * 为带扩展头的 IPv6 包拷贝五元组 / Copy the 5-tuple of an IPv6 packet with extension headers
+ *
+ * 不解析扩展头链，协议取第一个下一个头，端口按 0 匹配
+ * The extension header chain is not walked: proto is the first next header, ports match as 0
+ */
+static const uint8_t *
+fw_copy_tuple6(const struct rte_ipv6_hdr *ip6, struct ipv6_5tuple *t)
+{
+	memset(t, 0, sizeof(*t));
+	t->proto = ip6->proto;
+	memcpy(t->ip_src, &ip6->src_addr, sizeof(t->ip_src));
+	memcpy(t->ip_dst, &ip6->dst_addr, sizeof(t->ip_dst));
+	return (const uint8_t *)t;
+}
+
+/* 按一个类别的分类结果记命中并给出放行与否 / Count hits and decide from one result row */
+static inline uint8_t
+fw_apply_result(const struct acl_policy *pol, const uint32_t *res,
+		struct fw_lcore_stats *st)
+{
+	uint32_t filter = res[ACL_CAT_FILTER];
+	uint32_t count = res[ACL_CAT_COUNT];
+
+	st->rule_hits[filter]++;        // 下标0记录未匹配 / Index 0 counts misses
+	if (count != 0)
+		st->rule_hits[count]++;
+	return filter != 0 && pol->actions[filter] == ACL_ALLOW;
+}
+
+/**
+ * 填连接表的键，返回包的方向：0 = 从 lo 端发出，1 = 从 hi 端发出
+ * Fill the connection key, return the direction: 0 = sent by the lo end, 1 = by the hi end
+ */
+static inline uint8_t
+ct_make_key(const struct rte_ipv4_hdr *ip, const uint16_t *ports, struct ct_key *key)
+{
+	uint32_t src = rte_be_to_cpu_32(ip->src_addr);
+	uint32_t dst = rte_be_to_cpu_32(ip->dst_addr);
+	uint16_t sport = rte_be_to_cpu_16(ports[0]);
+	uint16_t dport = rte_be_to_cpu_16(ports[1]);
+	uint8_t dir = src > dst || (src == dst && sport > dport);
+
+	key->ip_lo = dir ? dst : src;
+	key->ip_hi = dir ? src : dst;
+	key->port_lo = dir ? dport : sport;
+	key->port_hi = dir ? sport : dport;
+	key->proto = ip->next_proto_id;
+	memset(key->pad, 0, sizeof(key->pad));
+	return dir;
+}
+
+/* 表项是否仍可用：同一规则集，且未超时 / Entry usable: same ruleset and not timed out */
+static inline int
+ct_entry_live(const struct ct_entry *e, uint64_t generation, uint64_t now)
+{
+	return e->generation == generation &&
+	       now - e->last_seen < (e->closing ? ct_close_cycles : ct_idle_cycles);
+}
+
+/* 已建立连接的包：按表项判决，不走 ACL / Packet of a known connection: use the cached verdict */
+static inline uint8_t
+ct_hit(struct ct_entry *e, uint8_t dir, uint8_t tcp_flags, uint64_t now,
+       struct fw_lcore_stats *st)
+{
+	e->last_seen = now;
+	e->packets++;
+	if (tcp_flags & (RTE_TCP_FIN_FLAG | RTE_TCP_RST_FLAG))
+		e->closing = 1;
+
+	st->ct_hit++;
+	st->ct_reply += dir != e->init_dir;
+	st->rule_hits[e->filter_rule]++;
+	if (e->count_rule != 0)
+		st->rule_hits[e->count_rule]++;
+	return e->verdict;
+}
+
+/**
+ * 新连接首包分类后记下判决，返回表项位置，表满返回 -1
+ * Record the verdict after classifying a new connection's first packet,
+ * return the entry position or -1 when the table is full
+ *
+ * pos 为查找时得到的位置（过期或旧规则集的表项），< 0 表示表中没有这个键
+ * pos is the lookup position of a stale entry, < 0 when the key is not in the table
+ */
+static int32_t
+ct_learn(struct fw_conntrack *ct, const struct ct_key *key, int32_t pos,
+	 uint64_t generation, const uint32_t *res, uint8_t verdict,
+	 uint8_t dir, uint8_t tcp_flags, uint64_t now, struct fw_lcore_stats *st)
+{
+	struct ct_entry *e;
+
+	if (pos < 0) {
+		pos = rte_hash_add_key(ct->hash, key);
+		if (pos < 0) {
+			st->ct_full++;
+			return -1;
+		}
+	}
+
+	e = &ct->entries[pos];
+	e->last_seen = now;
+	e->generation = generation;
+	e->packets = 1;
+	e->filter_rule = res[ACL_CAT_FILTER];
+	e->count_rule = res[ACL_CAT_COUNT];
+	e->verdict = verdict;
+	e->init_dir = dir;
+	e->closing = (tcp_flags & (RTE_TCP_FIN_FLAG | RTE_TCP_RST_FLAG)) != 0;
+	st->ct_new++;
+	return pos;
+}
+
+/**
+ * 老化：每 CT_SCAN_INTERVAL_US 扫描 CT_SCAN_BATCH 项，删除超时的连接
+ * Aging: every CT_SCAN_INTERVAL_US scan CT_SCAN_BATCH entries and delete timed-out ones
+ *
+ * 旧规则集的表项不删，下一个包会重新分类并覆盖它
+ * Entries from an older ruleset are kept, the next packet reclassifies them
+ */
+static void
+ct_expire(struct fw_conntrack *ct, uint64_t now, struct fw_lcore_stats *st)
+{
+	struct ct_key expired[CT_SCAN_BATCH];
+	uint32_t i, nb_expired = 0;
+	const void *key;
+	void *data;
+
+	if (now < ct->next_scan)
+		return;
+	ct->next_scan = now + ct_scan_cycles;
+
+	for (i = 0; i < CT_SCAN_BATCH; i++) {
+		int32_t pos = rte_hash_iterate(ct->hash, &key, &data, &ct->scan_iter);
+		const struct ct_entry *e;
+
+		if (pos < 0) {
+			ct->scan_iter = 0;
+			break;
+		}
+		e = &ct->entries[pos];
+		if (now - e->last_seen >= (e->closing ? ct_close_cycles : ct_idle_cycles))
+			expired[nb_expired++] = *(const struct ct_key *)key;
+	}
+
+	/* 扫描结束后再删，不在迭代中改表 / Delete after the scan, not while iterating */
+	for (i = 0; i < nb_expired; i++)
+		rte_hash_del_key(ct->hash, &expired[i]);
+	st->ct_expired += nb_expired;
+}
+
+/**
+ * 防火墙阶段：分类一个 burst 并执行动作，返回放行的包数
+ * Firewall stage: classify a burst, apply actions, return number of packets kept
+ *
+ * 给了连接表时，无选项、非分片的 IPv4 TCP/UDP 包先批量查表：已建立连接
+ * 直接按缓存的判决处理（回程方向同样放行），只有新连接的首包才进 ACL，
+ * 分类后把判决记进表里。其余包每个都分类。
+ * With a connection table, option-less unfragmented IPv4 TCP/UDP packets are
+ * looked up first in bulk: known connections use the cached verdict (reply
+ * traffic included) and only the first packet of a new connection reaches the
+ * ACL, whose verdict is then recorded. Everything else is classified per packet.
+ *
+ * ACL 输入指针直接指向每个包 IPv4 头中的 next_proto_id，不拷贝五元组；
+ * 只有带 IP 选项、非首片分片或过短的包才拷贝到栈上再分类。IPv6 同理，
+ * 指向 proto，带扩展头的包拷贝。放行的包按原顺序压缩到 pkts[] 前部，
+ * 拒绝的包被释放。ARP 直接放行，其他非 IP 流量拒绝。
+ * The ACL input points straight at next_proto_id in each IPv4 header (proto
+ * for IPv6); only packets with options, extension headers, non-first
+ * fragments or short packets are copied. Kept packets are compacted to the
+ * front of pkts[] in order, the rest freed.
+ */
+static uint16_t
+fw_filter_burst(const struct acl_policy *pol, struct rte_mbuf **pkts,
+		uint16_t nb_pkts, struct fw_lcore_stats *st, struct fw_conntrack *ct)
+{
+	const uint8_t *data[MAX_PKT_BURST], *data6[MAX_PKT_BURST];
+	uint32_t results[MAX_PKT_BURST * ACL_NUM_CATEGORIES];
+	uint32_t results6[MAX_PKT_BURST * ACL_NUM_CATEGORIES];
+	struct ipv4_5tuple copies[MAX_PKT_BURST];
+	struct ipv6_5tuple copies6[MAX_PKT_BURST];
+	uint16_t idx[MAX_PKT_BURST];    // ACL输入对应的包下标 / Packet index of each ACL input
+	uint16_t idx6[MAX_PKT_BURST];
+	int16_t acl_ct[MAX_PKT_BURST];  // ACL输入对应的连接键，-1 表示不跟踪 / Connection key of each ACL input, -1 if untracked
+	struct ct_key keys[MAX_PKT_BURST];
+	const void *key_ptrs[MAX_PKT_BURST];
+	int32_t ct_pos[MAX_PKT_BURST];
+	uint16_t ct_pkt[MAX_PKT_BURST]; // 连接键对应的包下标 / Packet index of each key
+	int16_t ct_lead[MAX_PKT_BURST]; // 同一 burst 中同一新连接的首个键 / First key of the same new connection in this burst
+	uint16_t ct_miss[MAX_PKT_BURST];
+	uint8_t ct_dir[MAX_PKT_BURST];
+	uint8_t ct_flags[MAX_PKT_BURST];
+	uint8_t keep[MAX_PKT_BURST];
+	uint16_t nb_acl = 0, nb_acl6 = 0, nb_ct = 0, nb_miss = 0, nb_keep = 0;
+	uint64_t now = rte_rdtsc();
+	uint16_t i;
+
+	RTE_ASSERT(nb_pkts <= MAX_PKT_BURST);
+	st->rx += nb_pkts;
+
+	/* 1. 准备ACL输入或连接键，IPv4 和 IPv6 分开 / Prepare ACL inputs or connection keys, IPv4 and IPv6 apart */
+	for (i = 0; i < nb_pkts; i++) {
+		struct rte_mbuf *m = pkts[i];
+		const struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+		const struct rte_ipv4_hdr *ip = (const struct rte_ipv4_hdr *)(eth + 1);
+		const struct rte_ipv6_hdr *ip6 = (const struct rte_ipv6_hdr *)(eth + 1);
+
+		keep[i] = 0;
+		if (eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6)) {
+			if (rte_pktmbuf_data_len(m) < sizeof(*eth) + sizeof(*ip6))
+				continue;
+			if ((ip6->proto == IPPROTO_TCP || ip6->proto == IPPROTO_UDP ||
+			     ip6->proto == IPPROTO_SCTP) &&
+			    rte_pktmbuf_data_len(m) >= sizeof(*eth) + sizeof(*ip6) + 2 * sizeof(uint16_t)) {
+				data6[nb_acl6] = rte_pktmbuf_mtod_offset(m, const uint8_t *, ACL6_INPUT_OFFSET);
+			} else {
+				data6[nb_acl6] = fw_copy_tuple6(ip6, &copies6[nb_acl6]);
+				st->slow_path++;
+			}
+			idx6[nb_acl6++] = i;
+			continue;
+		}
+		if (eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+			keep[i] = eth->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_ARP);
+			continue;
+		}
+		if (rte_pktmbuf_data_len(m) < sizeof(*eth) + sizeof(*ip))
+			continue;
+
+		if ((ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) == RTE_IPV4_MIN_IHL &&
+		    (ip->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK)) == 0 &&
+		    rte_pktmbuf_data_len(m) >= sizeof(*eth) + sizeof(*ip) + 2 * sizeof(uint16_t)) {
+			if (ct != NULL &&
+			    (ip->next_proto_id == IPPROTO_TCP || ip->next_proto_id == IPPROTO_UDP)) {
+				const struct rte_tcp_hdr *tcp = (const struct rte_tcp_hdr *)(ip + 1);
+
+				ct_dir[nb_ct] = ct_make_key(ip, (const uint16_t *)(ip + 1), &keys[nb_ct]);
+				ct_flags[nb_ct] = ip->next_proto_id == IPPROTO_TCP &&
+						  rte_pktmbuf_data_len(m) >= sizeof(*eth) + sizeof(*ip) + sizeof(*tcp) ?
+						  tcp->tcp_flags : 0;
+				key_ptrs[nb_ct] = &keys[nb_ct];
+				ct_pkt[nb_ct++] = i;
+				continue;
+			}
+			data[nb_acl] = rte_pktmbuf_mtod_offset(m, const uint8_t *, ACL_INPUT_OFFSET);
+		} else {
+			data[nb_acl] = fw_copy_tuple(m, ip, &copies[nb_acl]);
+			st->slow_path++;
+		}
+		acl_ct[nb_acl] = -1;
+		idx[nb_acl++] = i;
+	}
+
+	/* 2. 批量查连接表，未命中的转去分类；同一新连接在本 burst 里只分类第一个包 */
+	/* 2. Bulk lookup, misses go to the ACL; a new connection is classified once per burst */
+	if (nb_ct > 0) {
+		rte_hash_lookup_bulk(ct->hash, key_ptrs, nb_ct, ct_pos);
+		for (i = 0; i < nb_ct; i++) {
+			struct ct_entry *e = ct_pos[i] >= 0 ? &ct->entries[ct_pos[i]] : NULL;
+			uint16_t j;
+
+			ct_lead[i] = -1;
+			if (e != NULL && ct_entry_live(e, pol->generation, now)) {
+				keep[ct_pkt[i]] = ct_hit(e, ct_dir[i], ct_flags[i], now, st);
+				continue;
+			}
+			for (j = 0; j < nb_miss; j++) {
+				if (memcmp(&keys[ct_miss[j]], &keys[i], sizeof(keys[i])) == 0) {
+					ct_lead[i] = ct_miss[j];
+					break;
+				}
+			}
+			if (ct_lead[i] >= 0)
+				continue;
+
+			ct_miss[nb_miss++] = i;
+			data[nb_acl] = rte_pktmbuf_mtod_offset(pkts[ct_pkt[i]], const uint8_t *,
+							       ACL_INPUT_OFFSET);
+			acl_ct[nb_acl] = i;
+			idx[nb_acl++] = ct_pkt[i];
+		}
+	}
+
+	/* 3. 每个协议族一次分类整批；没有规则或分类失败按拒绝处理 */
+	/* 3. One classify call per family; no rules or a failure denies */
+	if (nb_acl > 0 && (pol->nb_v4_rules == 0 ||
+	    rte_acl_classify(pol->ctx, data, results, nb_acl, ACL_NUM_CATEGORIES) != 0))
+		nb_acl = 0;
+	if (nb_acl6 > 0 && (pol->nb_v6_rules == 0 ||
+	    rte_acl_classify(pol->ctx6, data6, results6, nb_acl6, ACL_NUM_CATEGORIES) != 0))
+		nb_acl6 = 0;
+
+	/* 4. 执行动作，新连接记下判决 / Apply actions, record verdicts of new connections */
+	for (i = 0; i < nb_acl; i++) {
+		const uint32_t *res = &results[i * ACL_NUM_CATEGORIES];
+		int16_t k = acl_ct[i];
+
+		keep[idx[i]] = fw_apply_result(pol, res, st);
+		if (k >= 0)
+			ct_pos[k] = ct_learn(ct, &keys[k], ct_pos[k], pol->generation, res,
+					     keep[idx[i]], ct_dir[k], ct_flags[k], now, st);
+	}
+	for (i = 0; i < nb_acl6; i++)
+		keep[idx6[i]] = fw_apply_result(pol, &results6[i * ACL_NUM_CATEGORIES], st);
+
+	/* 本 burst 中新连接的后续包跟随首包的判决；分类失败时 nb_acl 为 0，全部拒绝 */
+	/* Later packets of a new connection follow its first one; nb_acl is 0 after a failure, all denied */
+	for (i = 0; i < nb_ct && nb_acl > 0; i++) {
+		int16_t lead = ct_lead[i];
+
+		if (lead < 0)
+			continue;
+		if (ct_pos[lead] >= 0)
+			keep[ct_pkt[i]] = ct_hit(&ct->entries[ct_pos[lead]], ct_dir[i],
+						 ct_flags[i], now, st);
+		else
+			keep[ct_pkt[i]] = keep[ct_pkt[lead]];
+	}
+
+	/* 5. 压缩放行的包，释放拒绝的包 / Compact kept packets, free denied ones */
+	for (i = 0; i < nb_pkts; i++) {
+		if (keep[i])
+			pkts[nb_keep++] = pkts[i];
+		else
+			rte_pktmbuf_free(pkts[i]);
+	}
+
+	st->allowed += nb_keep;
+	st->denied += nb_pkts - nb_keep;
+	return nb_keep;
+}
+
+/**
+ * 按五元组构造一个 Ethernet/IPv4/TCP|UDP 报文 / Build an Ethernet/IPv4/TCP|UDP packet from a 5-tuple
+ */
+static struct rte_mbuf *
+build_test_mbuf(struct rte_mempool *pool, const struct ipv4_5tuple *t)
+{
+	struct rte_mbuf *m = rte_pktmbuf_alloc(pool);
+	uint16_t l4_len = t->proto == IPPROTO_UDP ?
+			  sizeof(struct rte_udp_hdr) : sizeof(struct rte_tcp_hdr);
+	uint16_t len = sizeof(struct rte_ether_hdr) + sizeof(struct rte_ipv4_hdr) + l4_len;
+	struct rte_ether_hdr *eth;
+	struct rte_ipv4_hdr *ip;
+	uint16_t *ports;
+
+	if (m == NULL)
+		return NULL;
+
+	eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, len);
+	memset(eth, 0, len);
+	eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+	ip = (struct rte_ipv4_hdr *)(eth + 1);
+	ip->version_ihl = RTE_IPV4_VHL_DEF;
+	ip->total_length = rte_cpu_to_be_16(sizeof(*ip) + l4_len);
+	ip->time_to_live = 64;
+	ip->next_proto_id = t->proto;
+	ip->src_addr = t->ip_src;
+	ip->dst_addr = t->ip_dst;
+	ip->hdr_checksum = rte_ipv4_cksum(ip);
+
+	/* TCP 和 UDP 头都以源/目的端口开头 / TCP and UDP headers both start with the ports */
+	ports = (uint16_t *)(ip + 1);
+	ports[0] = t->port_src;
+	ports[1] = t->port_dst;
+
+	return m;
+}
+
+/**
+ * 为每个 lcore 在其 socket 上分配规则命中表 / Allocate each lcore's rule hit table on its socket
+ *
+ * 长度按当前规则集的容量定，之后的重载不能超过 rule_id_limit
+ * Sized by the current ruleset's capacity; later reloads must fit rule_id_limit
+ */
+static void
+fw_stats_init(void)
+{
+	unsigned int lcore_id;
+
+	rule_id_limit = RTE_MAX((uint32_t)MAX_ACL_RULES, active_policy->capacity);
+	RTE_LCORE_FOREACH(lcore_id) {
+		fw_stats[lcore_id].rule_hits = rte_zmalloc_socket("acl_rule_hits",
+				sizeof(uint64_t) * (rule_id_limit + 1), RTE_CACHE_LINE_SIZE,
+				rte_lcore_to_socket_id(lcore_id));
+		if (fw_stats[lcore_id].rule_hits == NULL)
+			rte_exit(EXIT_FAILURE, "  错误：无法分配规则命中表\n");
+	}
+}
+
+/**
+ * 为每个 lcore 在其 socket 上创建连接表 / Create each lcore's connection table on its socket
+ *
+ * 每张表只有所属 lcore 访问，rte_hash 不带多写者/读写并发标志，查找和插入都不加锁
+ * Only the owning lcore touches a table, so the hash is created without
+ * multi-writer or RW concurrency flags and nothing takes a lock
+ */
+static void
+fw_conntrack_init(void)
+{
+	uint64_t hz = rte_get_tsc_hz();
+	unsigned int lcore_id;
+
+	ct_idle_cycles = hz * CT_IDLE_TIMEOUT_S;
+	ct_close_cycles = hz * CT_CLOSE_TIMEOUT_S;
+	ct_scan_cycles = hz * CT_SCAN_INTERVAL_US / US_PER_S;
+
+	RTE_LCORE_FOREACH(lcore_id) {
+		struct fw_conntrack *ct = &fw_ct[lcore_id];
+		char name[RTE_HASH_NAMESIZE];
+		struct rte_hash_parameters params = {
+			.name = name,
+			.entries = CT_ENTRIES,
+			.key_len = sizeof(struct ct_key),
+			.hash_func = rte_hash_crc,
+			.hash_func_init_val = 0,
+			.socket_id = rte_lcore_to_socket_id(lcore_id),
+		};
+
+		snprintf(name, sizeof(name), "fw_ct_%u", lcore_id);
+		ct->hash = rte_hash_create(&params);
+		ct->entries = rte_zmalloc_socket("fw_ct_entries", sizeof(struct ct_entry) * CT_ENTRIES,
+						 RTE_CACHE_LINE_SIZE, params.socket_id);
+		if (ct->hash == NULL || ct->entries == NULL)
+			rte_exit(EXIT_FAILURE, "  错误：无法创建连接表 (lcore %u)\n", lcore_id);
+	}
+	printf("  ✓ 连接跟踪: 每个 lcore %u 条连接, 空闲超时 %d 秒\n\n",
+	       CT_ENTRIES, CT_IDLE_TIMEOUT_S);
+}
+
+/* 当前 lcore 的连接表，关闭连接跟踪时为 NULL / This lcore's table, NULL without tracking */
+static struct fw_conntrack *
+fw_conntrack_get(void)
+{
+	return conntrack_enabled ? &fw_ct[rte_lcore_id()] : NULL;
+}
+
+/* 清零一个 lcore 的统计，保留命中表 / Zero one lcore's stats, keeping its hit table */
+static void
+fw_stats_reset(struct fw_lcore_stats *st)
+{
+	uint64_t *hits = st->rule_hits;
+
+	memset(st, 0, sizeof(*st));
+	memset(hits, 0, sizeof(uint64_t) * (rule_id_limit + 1));
+	st->rule_hits = hits;
+}
+
+/**
+ * 打印每条规则的命中数，按 lcore 分列 / Print per-rule hits, one column per lcore
+ *
+ * 只打印有命中的规则，最多 PRINT_RULE_LIMIT 行，动作取当前规则集
+ * Only rules with hits are printed, up to PRINT_RULE_LIMIT rows, actions from the current ruleset
+ */
+static void
+print_rule_hits(void)
+{
+	static const char *action_names[] = { "拒绝", "允许", "计数" };
+	const struct acl_policy *pol = active_policy;
+	unsigned int lcore_id, rows = 0;
+	uint32_t r;
+
+	printf("  %-6s %-6s", "规则", "动作");
+	RTE_LCORE_FOREACH(lcore_id) {
+		if (fw_stats[lcore_id].rx > 0)
+			printf("  lcore%-6u", lcore_id);
+	}
+	printf("  %-12s\n", "合计");
+
+	for (r = 0; r <= rule_id_limit && rows < PRINT_RULE_LIMIT; r++) {
+		uint64_t total = 0;
+
+		RTE_LCORE_FOREACH(lcore_id) {
+			total += fw_stats[lcore_id].rule_hits[r];
+		}
+		if (r != 0 && total == 0)
+			continue;
+		rows++;
+
+		if (r == 0)
+			printf("  %-6s %-6s", "未匹配", "拒绝");
+		else
+			printf("  %-6u %-6s", r, action_names[r <= pol->capacity ?
+							       pol->actions[r] : ACL_DENY]);
+		RTE_LCORE_FOREACH(lcore_id) {
+			if (fw_stats[lcore_id].rx == 0)
+				continue;
+			printf("  %-11" PRIu64, fw_stats[lcore_id].rule_hits[r]);
+		}
+		printf("  %-12" PRIu64 "\n", total);
+	}
+	if (r <= rule_id_limit)
+		printf("  ... (只显示前 %d 条有命中的规则)\n", PRINT_RULE_LIMIT);
+}
+
+/**
+ * 内联防火墙演示：把测试五元组做成真实报文，按 MAX_PKT_BURST 一批过防火墙；
+ * 后半个 burst 是这些连接的回程包，无状态时它们各自按规则判决
+ * Inline firewall demo: turn the test tuples into real packets and run one
+ * MAX_PKT_BURST burst through the firewall stage; the second half carries the
+ * replies, which a stateless firewall judges on their own
+ */
+static void
+run_inline_demo(struct rte_mempool *pool, const struct ipv4_5tuple *packets,
+		const char *title)
+{
+	struct rte_mbuf *burst[MAX_PKT_BURST];
+	struct fw_lcore_stats *st = &fw_stats[rte_lcore_id()];
+	struct fw_conntrack *ct = fw_conntrack_get();
+	uint16_t nb_keep;
+	int i;
+
+	printf("%s\n", title);
+	fw_stats_reset(st);
+
+	for (i = 0; i < MAX_PKT_BURST; i++) {
+		struct ipv4_5tuple t = packets[i % NUM_TEST_PACKETS];
+
+		if (i >= MAX_PKT_BURST / 2) {
+			t.ip_src = packets[i % NUM_TEST_PACKETS].ip_dst;
+			t.ip_dst = packets[i % NUM_TEST_PACKETS].ip_src;
+			t.port_src = packets[i % NUM_TEST_PACKETS].port_dst;
+			t.port_dst = packets[i % NUM_TEST_PACKETS].port_src;
+		}
+		burst[i] = build_test_mbuf(pool, &t);
+		if (burst[i] == NULL) {
+			rte_pktmbuf_free_bulk(burst, i);
+			rte_exit(EXIT_FAILURE, "  错误：分配mbuf失败\n");
+		}
+	}
+
+	nb_keep = fw_filter_burst(active_policy, burst, MAX_PKT_BURST, st, ct);
+	printf("  一个 burst %d 个包: 放行 %u, 拒绝 %u, 拷贝五元组 %" PRIu64 "\n",
+	       MAX_PKT_BURST, nb_keep, MAX_PKT_BURST - nb_keep, st->slow_path);
+	if (ct != NULL)
+		printf("  连接跟踪: 新建 %" PRIu64 ", 命中 %" PRIu64 " (其中回程 %" PRIu64
+		       "), 只有新建的包走了 ACL\n", st->ct_new, st->ct_hit, st->ct_reply);
+	rte_pktmbuf_free_bulk(burst, nb_keep);
+
+	print_rule_hits();
+	printf("\n");
+}
+
+/**
+ * 打印统计信息 / Print statistics
+ */
+static void
+print_statistics(void)
+{
+	printf("[统计信息]\n");
+	printf("  总数据包: %u\n", stats.total_packets);
+	printf("  允许: %u\n", stats.allowed);
+	printf("  拒绝: %u\n\n", stats.denied);
+}
+
+/* 0x6d5a 重复的 Toeplitz 密钥，交换源/目的后哈希不变 / Repeated 0x6d5a Toeplitz key, hash is direction independent */
+static uint8_t sym_rss_key[52] = {
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+	0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+	0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d,
+	0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a, 0x6d, 0x5a,
+};
+
+/**
+ * 初始化网口：每个 worker 一个 RX/TX 队列，多队列时用 RSS 分流
+ * Init a port: one RX/TX queue per worker, RSS across queues
+ */
+static int
+port_init(uint16_t port, struct rte_mempool *pool, uint16_t nb_queues)
+{
+	struct rte_eth_conf port_conf;
+	struct rte_eth_dev_info dev_info;
+	uint16_t nb_rxd = RX_RING_SIZE, nb_txd = TX_RING_SIZE;
+	uint16_t q;
+	int ret;
+
+	ret = rte_eth_dev_info_get(port, &dev_info);
+	if (ret != 0)
+		return ret;
+
+	memset(&port_conf, 0, sizeof(port_conf));
+	if (nb_queues > 1) {
+		port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+		port_conf.rx_adv_conf.rss_conf.rss_hf =
+			(RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) & dev_info.flow_type_rss_offloads;
+		/* 对称密钥：连接两个方向落到同一队列，连接表才能按 lcore 划分 */
+		/* Symmetric key: both directions land on one queue, so tables can be per lcore */
+		if (dev_info.hash_key_size > 0 && dev_info.hash_key_size <= sizeof(sym_rss_key)) {
+			port_conf.rx_adv_conf.rss_conf.rss_key = sym_rss_key;
+			port_conf.rx_adv_conf.rss_conf.rss_key_len = dev_info.hash_key_size;
+		}
+	}
+
+	ret = rte_eth_dev_configure(port, nb_queues, nb_queues, &port_conf);
+	if (ret != 0)
+		return ret;
+
+	ret = rte_eth_dev_adjust_nb_rx_tx_desc(port, &nb_rxd, &nb_txd);
+	if (ret != 0)
+		return ret;
+
+	for (q = 0; q < nb_queues; q++) {
+		ret = rte_eth_rx_queue_setup(port, q, nb_rxd,
+					     rte_eth_dev_socket_id(port), NULL, pool);
+		if (ret < 0)
+			return ret;
+		ret = rte_eth_tx_queue_setup(port, q, nb_txd,
+					     rte_eth_dev_socket_id(port), NULL);
+		if (ret < 0)
+			return ret;
+	}
+
+	ret = rte_eth_dev_start(port);
+	if (ret < 0)
+		return ret;
+
+	return rte_eth_promiscuous_enable(port);
+}
+
+/* 端口两两配对转发：0↔1, 2↔3；落单的端口发回自身 / Ports forward in pairs, a lone port loops back */
+static uint16_t
+fw_dst_port(uint16_t port, uint16_t nb_ports)
+{
+	uint16_t peer = port ^ 1;
+
+	return peer < nb_ports ? peer : port;
+}
+
+/**
+ * 防火墙 worker：每个 worker 轮询所有端口上自己的队列
+ * Firewall worker: each worker polls its own queue on every port
+ *
+ * 每轮开始读一次 active_policy，轮询完所有端口后报告静止状态；
+ * 报告之后本 lcore 不再持有旧规则集，控制面可以回收它
+ * active_policy is read once per round and a quiescent state is reported
+ * after all ports are polled, after which this lcore holds no old ruleset
+ */
+static int
+fw_worker_main(void *arg)
+{
+	uint16_t queue_id = (uint16_t)(uintptr_t)arg;
+	uint16_t nb_ports = rte_eth_dev_count_avail();
+	unsigned int lcore_id = rte_lcore_id();
+	struct fw_lcore_stats *st = &fw_stats[lcore_id];
+	struct fw_conntrack *ct = fw_conntrack_get();
+	struct rte_mbuf *pkts[MAX_PKT_BURST];
+	uint16_t port;
+
+	printf("  lcore %u: 队列 %u\n", lcore_id, queue_id);
+
+	rte_rcu_qsbr_thread_register(acl_qsv, lcore_id);
+	rte_rcu_qsbr_thread_online(acl_qsv, lcore_id);
+
+	while (!force_quit) {
+		const struct acl_policy *pol = __atomic_load_n(&active_policy, __ATOMIC_ACQUIRE);
+
+		RTE_ETH_FOREACH_DEV(port) {
+			uint16_t nb_rx, nb_keep, nb_tx;
+
+			nb_rx = rte_eth_rx_burst(port, queue_id, pkts, MAX_PKT_BURST);
+			if (nb_rx == 0)
+				continue;
+
+			nb_keep = fw_filter_burst(pol, pkts, nb_rx, st, ct);
+			if (nb_keep == 0)
+				continue;
+
+			nb_tx = rte_eth_tx_burst(fw_dst_port(port, nb_ports), queue_id,
+						 pkts, nb_keep);
+			if (nb_tx < nb_keep) {
+				st->tx_drop += nb_keep - nb_tx;
+				rte_pktmbuf_free_bulk(&pkts[nb_tx], nb_keep - nb_tx);
+			}
+		}
+
+		if (ct != NULL)
+			ct_expire(ct, rte_rdtsc(), st);
+		rte_rcu_qsbr_quiescent(acl_qsv, lcore_id);
+	}
+
+	rte_rcu_qsbr_thread_offline(acl_qsv, lcore_id);
+	rte_rcu_qsbr_thread_unregister(acl_qsv, lcore_id);
+	return 0;
+}
+
+/**
+ * 规则推送控制线程：每 reload_interval_ms 推送一次，交替加入和撤下封禁规则
+ * Policy push thread: push every reload_interval_ms, alternately adding and
+ * removing the block rule
+ *
+ * 控制线程不占用数据面 lcore，构建期间 worker 照常用旧规则集转发
+ * Runs off the datapath lcores, workers keep using the old ruleset meanwhile
+ */
+static uint32_t
+acl_reload_thread_main(__rte_unused void *arg)
+{
+	struct acl_ipv4_rule rules[MAX_ACL_RULES];
+	uint64_t period = rte_get_timer_hz() * reload_interval_ms / 1000;
+	uint64_t next = rte_get_timer_cycles() + period;
+	int with_block = active_policy->nb_rules >= BLOCK_RULE_ID;
+
+	while (!force_quit) {
+		uint32_t n;
+
+		if (rte_get_timer_cycles() < next) {
+			rte_delay_us_sleep(1000);
+			continue;
+		}
+		next += period;
+
+		/* 有规则文件时重新加载文件，否则交替推送封禁规则 / Reload the file if given, else toggle the block rule */
+		if (rule_file != NULL) {
+			if (acl_policy_load_file(rule_file, 0) != 0)
+				printf("  规则文件重载失败\n");
+			continue;
+		}
+
+		with_block = !with_block;
+		n = make_policy_rules(rules, with_block);
+		if (acl_policy_reload(rules, n) != 0)
+			printf("  规则推送失败\n");
+	}
+
+	return 0;
+}
+
+/**
+ * 在网口上运行防火墙，主 lcore 每秒汇总一次统计
+ * Run the firewall on ports, the main lcore sums stats every second
+ */
+static void
+run_port_firewall(struct rte_mempool *pool)
+{
+	uint16_t nb_ports = rte_eth_dev_count_avail();
+	uint16_t nb_queues = rte_lcore_count() - 1;
+	uint64_t last_rx = 0;
+	unsigned int lcore_id;
+	uint16_t port, q = 0;
+	rte_thread_t reload_thread;
+	int reload_started = 0;
+
+	printf("[步骤 7] 在网口上运行防火墙 (Ctrl+C 退出)...\n");
+
+	if (nb_ports == 0)
+		rte_exit(EXIT_FAILURE, "  错误：没有可用网口\n");
+	if (nb_queues == 0)
+		rte_exit(EXIT_FAILURE, "  错误：至少需要 2 个 lcore (-l 0-1)\n");
+
+	/* 清掉演示在主 lcore 上的计数 / Drop the demo counts on the main lcore */
+	fw_stats_reset(&fw_stats[rte_lcore_id()]);
+
+	RTE_ETH_FOREACH_DEV(port) {
+		if (port_init(port, pool, nb_queues) != 0)
+			rte_exit(EXIT_FAILURE, "  错误：初始化端口 %u 失败\n", port);
+		printf("  端口 %u → 端口 %u, %u 个队列\n", port,
+		       fw_dst_port(port, nb_ports), nb_queues);
+	}
+
+	RTE_LCORE_FOREACH_WORKER(lcore_id) {
+		rte_eal_remote_launch(fw_worker_main, (void *)(uintptr_t)q, lcore_id);
+		q++;
+	}
+
+	memset(&reload_stats, 0, sizeof(reload_stats));
+	if (reload_interval_ms > 0) {
+		if (rte_thread_create_control(&reload_thread, "acl-reload",
+					      acl_reload_thread_main, NULL) == 0) {
+			reload_started = 1;
+			printf("  规则推送：每 %u ms 一次\n", reload_interval_ms);
+		} else {
+			printf("  无法创建规则推送线程\n");
+		}
+	}
+
+	while (!force_quit) {
+		uint64_t rx = 0, allowed = 0, denied = 0, slow = 0, tx_drop = 0;
+		uint64_t ct_hit = 0, ct_reply = 0, ct_new = 0, ct_expired = 0, ct_full = 0;
+
+		sleep(STATS_INTERVAL);
+		RTE_LCORE_FOREACH_WORKER(lcore_id) {
+			const struct fw_lcore_stats *st = &fw_stats[lcore_id];
+
+			rx += st->rx;
+			allowed += st->allowed;
+			denied += st->denied;
+			slow += st->slow_path;
+			tx_drop += st->tx_drop;
+			ct_hit += st->ct_hit;
+			ct_reply += st->ct_reply;
+			ct_new += st->ct_new;
+			ct_expired += st->ct_expired;
+			ct_full += st->ct_full;
+		}
+		printf("  RX %" PRIu64 " pps | 累计 允许 %" PRIu64 " 拒绝 %" PRIu64
+		       " 拷贝 %" PRIu64 " 发送丢弃 %" PRIu64 " | 规则推送 %" PRIu64 "\n",
+		       (rx - last_rx) / STATS_INTERVAL, allowed, denied, slow, tx_drop,
+		       __atomic_load_n(&reload_stats.reloads, __ATOMIC_RELAXED));
+		if (conntrack_enabled)
+			printf("    连接跟踪: 命中 %.1f%% (回程 %" PRIu64 ") | 新建 %" PRIu64
+			       " 老化 %" PRIu64 " 表满 %" PRIu64 "\n",
+			       rx > 0 ? 100.0 * ct_hit / rx : 0.0, ct_reply, ct_new,
+			       ct_expired, ct_full);
+		last_rx = rx;
+	}
+
+	/* 先停控制线程：它可能在等宽限期，worker 退出前会下线，不会卡住 */
+	/* Stop the push thread first; workers go offline on exit, so a pending grace period completes */
+	if (reload_started)
+		rte_thread_join(reload_thread, NULL);
+	rte_eal_mp_wait_lcore();
+
+	printf("\n[规则命中]\n");
+	print_rule_hits();
+	printf("\n[规则推送]\n");
+	print_reload_stats();
+	printf("\n");
+
+	RTE_ETH_FOREACH_DEV(port) {
+		rte_eth_dev_stop(port);
+		rte_eth_dev_close(port);
+	}
+}
+
+/**
+ * ============================================================================
+ * 分类算法基准 / Classify algorithm benchmark (-b)
+ * ============================================================================
+ */
+
+/* 各架构的分类算法；当前 CPU 或 EAL SIMD 位宽不支持的会被跳过 */
+/* Classify algorithms; those the CPU or EAL SIMD width cannot run are skipped */
+static const struct {
+	enum rte_acl_classify_alg alg;
+	const char *name;
+} bench_algs[] = {
+	{ RTE_ACL_CLASSIFY_SCALAR,    "scalar" },
+	{ RTE_ACL_CLASSIFY_SSE,       "sse" },
+	{ RTE_ACL_CLASSIFY_AVX2,      "avx2" },
+	{ RTE_ACL_CLASSIFY_AVX512X16, "avx512x16" },
+	{ RTE_ACL_CLASSIFY_AVX512X32, "avx512x32" },
+	{ RTE_ACL_CLASSIFY_NEON,      "neon" },
+	{ RTE_ACL_CLASSIFY_ALTIVEC,   "altivec" },
+};
+
+static const uint32_t bench_sizes[] = { 10, 1000, 10000, 100000 };
+static const uint32_t bench_categories[] = { 1, 4, 16 };
+static const uint32_t bench_max_size_mb[] = { 0, 256, 64, 16 };  // 0 = 不限 / unlimited
+
+/* 前缀长度对应的掩码（主机字节序）/ Netmask of a prefix length, host byte order */
+static uint32_t
+prefix_mask(uint32_t depth)
+{
+	return depth == 0 ? 0 : ~0U << (32 - depth);
+}
+
+/**
+ * 生成一条随机规则：源/目的前缀长度偏向 /24-/32，目的端口取常见服务或范围
+ * Generate a random rule: prefixes biased to /24-/32, common service ports or ranges
+ */
+static void
+gen_bench_rule(struct acl_ipv4_rule *rule, uint32_t rule_id)
+{
+	static const uint8_t src_depths[] = { 0, 8, 16, 24, 24, 32, 32, 32 };
+	static const uint8_t dst_depths[] = { 0, 16, 24, 24, 32, 32 };
+	static const struct { uint16_t lo, hi; } dst_ports[] = {
+		{ 80, 80 }, { 443, 443 }, { 53, 53 }, { 22, 22 },
+		{ 8000, 8999 }, { 1024, 65535 }, { 0, 1023 }, { 0, 65535 },
 	};
+	uint32_t sd = src_depths[rte_rand_max(RTE_DIM(src_depths))];
+	uint32_t dd = dst_depths[rte_rand_max(RTE_DIM(dst_depths))];
+	uint32_t dp = rte_rand_max(RTE_DIM(dst_ports));
+	uint8_t proto = rte_rand_max(4) == 0 ? IPPROTO_UDP : IPPROTO_TCP;
+	uint8_t proto_mask = rte_rand_max(8) == 0 ? 0 : 0xFF;   // 1/8 任意协议 / 1/8 any protocol
 
-	printf("[步骤 1] 创建ACL上下文...\n");
-	acl_ctx = rte_acl_create(&acl_param);
-	
-	if (acl_ctx == NULL) {
-		rte_exit(EXIT_FAILURE, "  错误：无法创建ACL上下文\n");
+	make_rule(rule, 1 + rte_rand_max(RTE_ACL_MAX_PRIORITY - 1), rule_id, ACL_ALLOW,
+	          proto, proto_mask,
+	          (uint32_t)rte_rand() & prefix_mask(sd), sd,
+	          (uint32_t)rte_rand() & prefix_mask(dd), dd,
+	          0, 65535,
+	          dst_ports[dp].lo, dst_ports[dp].hi);
+}
+
+/* 在 [lo, hi] 中取随机值 / Random value in [lo, hi] */
+static uint32_t
+rand_in_range(uint32_t lo, uint32_t hi)
+{
+	return lo + (uint32_t)rte_rand_max((uint64_t)hi - lo + 1);
+}
+
+/**
+ * 生成查找五元组：rule 非空时落在该规则内，否则完全随机
+ * Generate a lookup tuple: inside the given rule, or fully random when NULL
+ */
+static void
+gen_bench_tuple(struct ipv4_5tuple *t, const struct acl_ipv4_rule *rule)
+{
+	int f;
+
+	memset(t, 0, sizeof(*t));
+
+	if (rule == NULL) {
+		t->proto = rte_rand_max(4) == 0 ? IPPROTO_UDP : IPPROTO_TCP;
+		t->ip_src = (uint32_t)rte_rand();
+		t->ip_dst = (uint32_t)rte_rand();
+		t->port_src = (uint16_t)rte_rand();
+		t->port_dst = (uint16_t)rte_rand();
+		return;
 	}
-	printf("  ✓ 成功创建ACL上下文: %s\n\n", acl_param.name);
 
-	/* 2. 添加规则 / Add rules */
-	add_acl_rules(acl_ctx);
+	for (f = SRC_FIELD_IPV4; f <= DST_FIELD_IPV4; f++) {
+		uint32_t depth = rule->field[f].mask_range.u32;
+		uint32_t mask = prefix_mask(depth);
+		uint32_t ip = (rule->field[f].value.u32 & mask) | ((uint32_t)rte_rand() & ~mask);
 
-	/* 3. 构建ACL / Build ACL */
-	printf("[步骤 3] 构建ACL...\n");
+		if (f == SRC_FIELD_IPV4)
+			t->ip_src = htonl(ip);
+		else
+			t->ip_dst = htonl(ip);
+	}
+
+	t->proto = rule->field[PROTO_FIELD_IPV4].mask_range.u8 != 0 ?
+		   rule->field[PROTO_FIELD_IPV4].value.u8 :
+		   (rte_rand_max(4) == 0 ? IPPROTO_UDP : IPPROTO_TCP);
+	t->port_src = htons(rand_in_range(rule->field[SRCP_FIELD_IPV4].value.u16,
+					  rule->field[SRCP_FIELD_IPV4].mask_range.u16));
+	t->port_dst = htons(rand_in_range(rule->field[DSTP_FIELD_IPV4].value.u16,
+					  rule->field[DSTP_FIELD_IPV4].mask_range.u16));
+}
+
+/**
+ * 从 rte_acl_dump() 的输出中取 num_tries / Read num_tries from rte_acl_dump()
+ *
+ * rte_acl_dump() 只打印到 stdout，临时把 stdout 重定向到文件再解析
+ * rte_acl_dump() only prints to stdout, so stdout is redirected to a temp file
+ */
+static uint32_t
+acl_dump_num_tries(const struct rte_acl_ctx *ctx)
+{
+	FILE *tmp = tmpfile();
+	uint32_t tries = 0;
+	char line[128];
+	int saved;
+
+	if (tmp == NULL)
+		return 0;
+
+	fflush(stdout);
+	saved = dup(STDOUT_FILENO);
+	if (saved < 0) {
+		fclose(tmp);
+		return 0;
+	}
+	dup2(fileno(tmp), STDOUT_FILENO);
+	rte_acl_dump(ctx);
+	fflush(stdout);
+	dup2(saved, STDOUT_FILENO);
+	close(saved);
+
+	rewind(tmp);
+	while (fgets(line, sizeof(line), tmp) != NULL) {
+		if (sscanf(line, " num_tries=%u", &tries) == 1)
+			break;
+	}
+	fclose(tmp);
+	return tries;
+}
+
+/**
+ * 创建并构建一个基准用ACL上下文 / Create and build a benchmark ACL context
+ *
+ * 输出构建耗时、运行时内存（构建前后堆占用之差）和 trie 数
+ * Reports build time, run-time memory (heap delta across the build) and tries
+ */
+static struct rte_acl_ctx *
+build_bench_ctx(const struct acl_ipv4_rule *rules, uint32_t nb_rules,
+		uint32_t nb_categories, uint32_t max_size_mb,
+		double *build_ms, size_t *mem_bytes, uint32_t *tries)
+{
+	struct rte_acl_param acl_param = {
+		.name = "acl_bench",
+		.socket_id = rte_socket_id(),
+		.rule_size = RTE_ACL_RULE_SZ(NUM_FIELDS_IPV4),
+		.max_rule_num = nb_rules,
+	};
 	struct rte_acl_config cfg;
+	struct rte_acl_ctx *ctx;
+	uint64_t start;
+	size_t before, after;
+	int ret;
+
+	ctx = rte_acl_create(&acl_param);
+	if (ctx == NULL)
+		return NULL;
+
+	ret = rte_acl_add_rules(ctx, (const struct rte_acl_rule *)rules, nb_rules);
+	if (ret != 0) {
+		rte_acl_free(ctx);
+		return NULL;
+	}
 
 	setup_acl_config(&cfg);
-	ret = rte_acl_build(acl_ctx, &cfg);
+	cfg.num_categories = nb_categories;
+	cfg.max_size = (size_t)max_size_mb << 20;
+
+	before = heap_alloc_bytes();
+	start = rte_rdtsc_precise();
+	ret = rte_acl_build(ctx, &cfg);
+	*build_ms = (double)(rte_rdtsc_precise() - start) * 1e3 / rte_get_tsc_hz();
+	if (ret != 0) {
+		printf("  构建失败: %s\n", strerror(-ret));
+		rte_acl_free(ctx);
+		return NULL;
+	}
+	after = heap_alloc_bytes();
+	*mem_bytes = after > before ? after - before : 0;
+	*tries = acl_dump_num_tries(ctx);
+	return ctx;
+}
+
+/**
+ * 用当前算法分类整个五元组数组，返回总周期数
+ * Classify the whole tuple array with the current algorithm, return cycles
+ *
+ * 每个包只把第一个类别的结果累加进 sum，用于核对各算法结果一致，
+ * 同时让编译器不能省掉分类
+ * Only the first category of each packet goes into sum, to cross-check
+ * algorithms and keep the classification observable
+ */
+static uint64_t
+bench_classify(const struct rte_acl_ctx *ctx, const uint8_t **data, uint32_t nb,
+	       uint32_t nb_categories, uint64_t *sum)
+{
+	uint32_t results[MAX_PKT_BURST * RTE_ACL_MAX_CATEGORIES];
+	uint64_t s = 0, start;
+	uint32_t i, j;
+
+	start = rte_rdtsc_precise();
+	for (i = 0; i + MAX_PKT_BURST <= nb; i += MAX_PKT_BURST) {
+		rte_acl_classify(ctx, &data[i], results, MAX_PKT_BURST, nb_categories);
+		for (j = 0; j < MAX_PKT_BURST; j++)
+			s += results[j * nb_categories];
+	}
+	*sum = s;
+	return rte_rdtsc_precise() - start;
+}
+
+/**
+ * 对一个已构建的上下文跑所有算法并打印一组结果行
+ * Run every algorithm against a built context and print one group of rows
+ */
+static void
+bench_algorithms(struct rte_acl_ctx *ctx, const uint8_t **data, uint32_t nb_tuples,
+		 uint32_t nb_categories, const char *prefix)
+{
+	uint64_t ref_sum = 0;
+	int have_ref = 0;
+	unsigned int a;
+
+	for (a = 0; a < RTE_DIM(bench_algs); a++) {
+		uint64_t sum, cycles;
+		double cpp;
+
+		/* rte_acl_set_ctx_classify() 会检查 CPU 和最大 SIMD 位宽 / Checks CPU flags and max SIMD width */
+		if (rte_acl_set_ctx_classify(ctx, bench_algs[a].alg) != 0)
+			continue;
+
+		bench_classify(ctx, data, RTE_MIN(nb_tuples, 1U << 16), nb_categories, &sum);  // 预热 / Warm-up
+		cycles = bench_classify(ctx, data, nb_tuples, nb_categories, &sum);
+		cpp = (double)cycles / (nb_tuples - nb_tuples % MAX_PKT_BURST);
+
+		if (!have_ref) {
+			ref_sum = sum;
+			have_ref = 1;
+		}
+		printf("%s  %-10s  %8.1f  %7.2f  %s\n", prefix, bench_algs[a].name, cpp,
+		       rte_get_tsc_hz() / cpp / 1e6, sum == ref_sum ? "一致" : "不一致!");
+	}
+}
+
+/**
+ * 分类算法基准 / Classify algorithm benchmark
+ *
+ * 1. 规则数 × 类别数：每种组合构建一次，对所有可用算法分类同一组五元组
+ * 2. max_size：最大规则集、单类别，逐步收紧 trie 内存上限，观察 trie 拆分的代价
+ * 1. rule count x categories: one build per pair, every available algorithm
+ *    classifies the same tuples
+ * 2. max_size: the largest ruleset with one category under shrinking memory
+ *    limits, showing the cost of trie splitting
+ */
+static void
+run_acl_benchmark(void)
+{
+	uint32_t max_rules = 0, nb_sizes = 0;
+	struct acl_ipv4_rule *rules;
+	struct ipv4_5tuple *tuples;
+	const uint8_t **data;
+	unsigned int s, c, m;
+	uint32_t i;
+
+	for (s = 0; s < RTE_DIM(bench_sizes) && bench_sizes[s] <= bench_rule_limit; s++) {
+		max_rules = bench_sizes[s];
+		nb_sizes++;
+	}
+	if (nb_sizes == 0) {
+		printf("规则数上限 %u 小于最小规则集 %u\n", bench_rule_limit, bench_sizes[0]);
+		return;
+	}
+
+	rules = malloc(sizeof(*rules) * max_rules);
+	tuples = malloc(sizeof(*tuples) * BENCH_TUPLES);
+	data = malloc(sizeof(*data) * BENCH_TUPLES);
+	if (rules == NULL || tuples == NULL || data == NULL) {
+		printf("内存不足\n");
+		goto out;
+	}
+
+	printf("=== DPDK ACL 分类算法基准 ===\n\n");
+	printf("五元组: %u 个 (%u%% 落在规则内), burst %d, 最大 SIMD 位宽 %u\n",
+	       BENCH_TUPLES, BENCH_HIT_PCT, MAX_PKT_BURST, rte_vect_get_max_simd_bitwidth());
+	printf("(AVX-512 需要 EAL 参数 --force-max-simd-bitwidth=512)\n\n");
+
+	printf("规则数   类别  构建(ms)  内存(KB)  tries  算法        周期/包    Mpps  结果\n");
+	printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+	for (i = 0; i < BENCH_TUPLES; i++)
+		data[i] = (const uint8_t *)&tuples[i];
+
+	for (s = 0; s < nb_sizes; s++) {
+		uint32_t nb_rules = bench_sizes[s];
+
+		/* 固定种子，每次运行的规则和五元组相同 / Fixed seed, same rules and tuples every run */
+		rte_srand(2024 + nb_rules);
+		for (i = 0; i < nb_rules; i++)
+			gen_bench_rule(&rules[i], i + 1);
+		for (i = 0; i < BENCH_TUPLES; i++)
+			gen_bench_tuple(&tuples[i], rte_rand_max(100) < BENCH_HIT_PCT ?
+					&rules[rte_rand_max(nb_rules)] : NULL);
+
+		for (c = 0; c < RTE_DIM(bench_categories); c++) {
+			uint32_t nb_categories = bench_categories[c];
+			struct rte_acl_ctx *ctx;
+			double build_ms;
+			size_t mem;
+			uint32_t tries;
+			char prefix[64];
+
+			/* 同一组规则轮流分到各类别 / The same rules, spread round-robin over categories */
+			for (i = 0; i < nb_rules; i++)
+				rules[i].data.category_mask = RTE_BIT32(i % nb_categories);
+
+			ctx = build_bench_ctx(rules, nb_rules, nb_categories, 0,
+					      &build_ms, &mem, &tries);
+			if (ctx == NULL) {
+				printf("%-7u  %4u  (构建失败)\n", nb_rules, nb_categories);
+				continue;
+			}
+
+			snprintf(prefix, sizeof(prefix), "%-7u  %4u  %8.1f  %8zu  %5u",
+				 nb_rules, nb_categories, build_ms, mem >> 10, tries);
+			bench_algorithms(ctx, data, BENCH_TUPLES, nb_categories, prefix);
+			rte_acl_free(ctx);
+		}
+	}
+
+	/* max_size 扫描沿用最后一个规则集的五元组 / The max_size sweep reuses the last tuples */
+	printf("\n[max_size 对 trie 拆分的影响] %u 条规则, 1 个类别\n\n", max_rules);
+	printf("max_size   构建(ms)  内存(KB)  tries  算法        周期/包    Mpps  结果\n");
+	printf("───────────────────────────────────────────────────────────────────────────\n");
+
+	for (i = 0; i < max_rules; i++)
+		rules[i].data.category_mask = RTE_BIT32(0);
+
+	for (m = 0; m < RTE_DIM(bench_max_size_mb); m++) {
+		struct rte_acl_ctx *ctx;
+		double build_ms;
+		size_t mem;
+		uint32_t tries;
+		char prefix[64];
+		char limit[16];
+
+		if (bench_max_size_mb[m] == 0)
+			snprintf(limit, sizeof(limit), "不限");
+		else
+			snprintf(limit, sizeof(limit), "%uMB", bench_max_size_mb[m]);
+
+		ctx = build_bench_ctx(rules, max_rules, 1, bench_max_size_mb[m],
+				      &build_ms, &mem, &tries);
+		if (ctx == NULL) {
+			printf("%-8s   (构建失败)\n", limit);
+			continue;
+		}
+
+		snprintf(prefix, sizeof(prefix), "%-8s  %8.1f  %8zu  %5u",
+			 limit, build_ms, mem >> 10, tries);
+		bench_algorithms(ctx, data, BENCH_TUPLES, 1, prefix);
+		rte_acl_free(ctx);
+	}
+	printf("\n");
+
+out:
+	free(data);
+	free(tuples);
+	free(rules);
+}
+
+static void
+print_usage(const char *prgname)
+{
+	printf("Usage: %s [EAL options] -- [-f FILE] [-s] [-p] [-r MS] [-b [-n RULES]]\n", prgname);
+	printf("  -f F  : 从 ClassBench 格式的规则文件加载规则集 / Load the ruleset from a ClassBench rule file\n");
+	printf("  -s    : 关闭连接跟踪，每个包都走 ACL / Stateless, classify every packet\n");
+	printf("  -p    : 演示后在所有网口上运行防火墙 / Run the firewall on all ports after the demo\n");
+	printf("  -r MS : 运行时每 MS 毫秒推送一次规则集 / Push a ruleset every MS ms while running\n");
+	printf("  -b    : 只运行分类算法基准 / Run the classify algorithm benchmark only\n");
+	printf("  -n N  : 基准中最大的规则集 (默认 %u) / Largest benchmark ruleset\n",
+	       DEFAULT_BENCH_RULE_LIMIT);
+}
+
+static int
+parse_args(int argc, char **argv)
+{
+	int opt;
+
+	while ((opt = getopt(argc, argv, "pr:bn:f:sh")) != -1) {
+		switch (opt) {
+		case 's':
+			conntrack_enabled = 0;
+			break;
+		case 'f':
+			rule_file = optarg;
+			break;
+		case 'p':
+			port_mode = 1;
+			break;
+		case 'r':
+			reload_interval_ms = (uint32_t)atoi(optarg);
+			if (reload_interval_ms == 0) {
+				printf("无效的推送间隔: %s\n", optarg);
+				return -1;
+			}
+			break;
+		case 'b':
+			bench_mode = 1;
+			break;
+		case 'n':
+			bench_rule_limit = (uint32_t)atoi(optarg);
+			break;
+		case 'h':
+		default:
+			print_usage(argv[0]);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * 主函数 / Main function
+ */
+int
+main(int argc, char **argv)
+{
+	int ret;
+	struct ipv4_5tuple test_packets[NUM_TEST_PACKETS];
+	struct rte_mempool *pool;
+	unsigned int lcore_id;
+
+	/* 初始化EAL / Initialize EAL */
+	ret = rte_eal_init(argc, argv);
+	if (ret < 0) {
+		rte_panic("无法初始化EAL: %s\n", rte_strerror(rte_errno));
+	}
+	argc -= ret;
+	argv += ret;
+
+	if (parse_args(argc, argv) < 0)
+		rte_exit(EXIT_FAILURE, "参数错误\n");
+
+	signal(SIGINT, signal_handler);
+	signal(SIGTERM, signal_handler);
+
+	if (bench_mode) {
+		run_acl_benchmark();
+		rte_eal_cleanup();
+		return 0;
+	}
+
+	printf("=== DPDK ACL 演示：IPv4防火墙 ===\n\n");
+
+	/* 1. 创建双缓冲ACL上下文 / Create double-buffered ACL contexts */
+	printf("[步骤 1] 创建ACL上下文...\n");
+	acl_policy_init();
+
+	/* 2. 生成规则 / Generate rules */
+	add_acl_rules();
+
+	/* 3. 构建并发布基础规则集或规则文件 / Build and publish the base ruleset or the rule file */
+	printf("[步骤 3] 构建ACL...\n");
+	if (rule_file != NULL)
+		ret = acl_policy_load_file(rule_file, 1);
+	else
+		ret = acl_policy_reload(base_rules, NUM_BASE_RULES);
 	if (ret != 0) {
 		rte_exit(EXIT_FAILURE, "  错误：构建ACL失败: %s\n", strerror(-ret));
 	}
-	printf("  ✓ ACL构建成功\n\n");
+	printf("  ✓ ACL构建成功 (%.1f us)\n\n",
+	       reload_stats.build_cycles * 1e6 / rte_get_tsc_hz());
+	fw_stats_init();
+	if (conntrack_enabled)
+		fw_conntrack_init();
 
 	/* 4. 创建测试数据包 / Create test packets */
 	create_test_packets(test_packets);
 
 	/* 5. 分类并打印结果 / Classify and print results */
-	classify_and_print(acl_ctx, test_packets, NUM_TEST_PACKETS);
+	classify_and_print(active_policy, test_packets, NUM_TEST_PACKETS);
 
 	/* 6. 打印统计信息 / Print statistics */
 	print_statistics();
 
-	/* 7. 清理资源 / Cleanup */
+	/* 7. 报文路径上的防火墙 / Firewall on the packet path */
+	pool = rte_pktmbuf_pool_create("acl_mbuf_pool",
+				       NUM_MBUFS * RTE_MAX(rte_eth_dev_count_avail(), 1),
+				       MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE,
+				       rte_socket_id());
+	if (pool == NULL) {
+		rte_exit(EXIT_FAILURE, "  错误：无法创建mbuf池\n");
+	}
+
+	run_inline_demo(pool, test_packets, "[步骤 5] 内联防火墙：直接分类报文头...");
+
+	/* 8. 推送封禁规则（或重新加载规则文件），原子切换后再跑一遍 */
+	/* 8. Push the block rule (or reload the rule file), swap, run again */
+	{
+		struct acl_ipv4_rule rules[MAX_ACL_RULES];
+		uint32_t n = make_policy_rules(rules, 1);
+
+		memset(&reload_stats, 0, sizeof(reload_stats));
+		if (rule_file != NULL) {
+			printf("[步骤 6] 重新加载规则文件，双缓冲原子切换...\n");
+			ret = acl_policy_load_file(rule_file, 0);
+		} else {
+			printf("[步骤 6] 推送规则集 (+规则%d)，双缓冲原子切换...\n", BLOCK_RULE_ID);
+			ret = acl_policy_reload(rules, n);
+		}
+		if (ret != 0) {
+			rte_exit(EXIT_FAILURE, "  错误：推送规则失败: %s\n", strerror(-ret));
+		}
+		print_reload_stats();
+		printf("\n");
+		run_inline_demo(pool, test_packets, "[步骤 6] 新规则集下的内联防火墙...");
+	}
+
+	if (port_mode)
+		run_port_firewall(pool);
+
+	/* 9. 清理资源 / Cleanup */
 	printf("[清理]\n");
-	if (acl_ctx != NULL) {
-		rte_acl_free(acl_ctx);
-		printf("  ✓ ACL上下文已释放\n");
+	for (ret = 0; ret < 2; ret++) {
+		rte_acl_free(acl_policies[ret].ctx);
+		rte_acl_free(acl_policies[ret].ctx6);
+		rte_free(acl_policies[ret].actions);
+	}
+	RTE_LCORE_FOREACH(lcore_id) {
+		rte_free(fw_stats[lcore_id].rule_hits);
+		rte_hash_free(fw_ct[lcore_id].hash);
+		rte_free(fw_ct[lcore_id].entries);
 	}
+	printf("  ✓ ACL上下文已释放\n");
+	rte_free(acl_qsv);
+	rte_mempool_free(pool);
 
 	rte_eal_cleanup();
 	printf("  ✓ EAL已清理\n\n");
@@ -9,6 +9,7 @@
  * 4. Burst processing with prefetch optimization
  * 5. Per-core statistics and monitoring
  * 6. Load balancing analysis
+ * 7. Per-queue latency histograms (p50/p99/p999)
  */
 
 #include <stdio.h>
@@ -16,6 +17,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <errno.h>
 #include <signal.h>
 #include <unistd.h>
 #include <getopt.h>
@@ -25,6 +27,7 @@
 #include <rte_cycles.h>
 #include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_mbuf_dyn.h>
 #include <rte_ether.h>
 #include <rte_ip.h>
 #include <rte_tcp.h>
@@ -45,11 +48,31 @@
 /* 统计更新间隔 */
 #define STATS_INTERVAL_MS 1000
 
+/*
+ * 延迟直方图 (HDR 风格的 log-linear 分桶)
+ * 每个 2 的幂区间再线性切分为 LAT_HIST_SUB 个子桶, 相对误差 < 1/16
+ * 数值单位为 TSC 周期, LAT_HIST_MAX_EXP = 36 可覆盖 ~2^36 周期 (数十秒)
+ */
+#define LAT_HIST_SUB_BITS 4
+#define LAT_HIST_SUB (1U << LAT_HIST_SUB_BITS)
+#define LAT_HIST_MAX_EXP 36
+#define LAT_HIST_BUCKETS ((LAT_HIST_MAX_EXP - LAT_HIST_SUB_BITS + 2) * LAT_HIST_SUB)
+
+/* 网卡时钟频率估算时长 */
+#define NIC_CLOCK_CALIB_MS 100
+
 /* 全局变量 */
 static volatile int force_quit = 0;
 static uint16_t nb_rxd = RX_RING_SIZE;
 static uint16_t nb_txd = TX_RING_SIZE;
 
+/* 延迟时间戳来源: 0 = TSC (rx_burst 返回时), 1 = 网卡硬件时间戳 */
+static int use_hw_timestamp = 0;
+static int ts_dynfield_offset = -1;
+static uint64_t ts_dynflag;
+/* 网卡时钟 tick → TSC 周期的定点换算系数 (Q16) */
+static uint64_t nic_to_tsc_mult;
+
 /* 每个 worker 的统计信息 */
 struct worker_stats {
     uint64_t rx_packets;
@@ -64,6 +87,21 @@ struct worker_stats {
 
 static struct worker_stats worker_stats[RTE_MAX_LCORE];
 
+/*
+ * 每个 lcore 一份延迟直方图
+ * 只有对应 worker 写入 (单写者), 统计线程用原子读取做无锁快照,
+ * 每个桶单调递增, 快照间做差即得到区间直方图
+ */
+struct latency_hist {
+    uint64_t buckets[LAT_HIST_BUCKETS];
+    uint16_t queue_id;
+} __rte_cache_aligned;
+
+static struct latency_hist latency_hist[RTE_MAX_LCORE];
+
+/* 统计线程私有: 上一次快照, 用于计算区间分位数 */
+static uint64_t latency_last[RTE_MAX_LCORE][LAT_HIST_BUCKETS];
+
 /* Worker 参数 */
 struct worker_params {
     uint16_t port_id;
@@ -103,6 +141,52 @@ static void signal_handler(int signum)
     }
 }
 
+/*
+ * 数值 → 桶下标
+ * 小于 LAT_HIST_SUB 的值一一对应, 之后每个 2 的幂区间占 LAT_HIST_SUB 个桶
+ */
+static inline uint32_t lat_hist_index(uint64_t v)
+{
+    uint32_t exp;
+
+    if (v < LAT_HIST_SUB)
+        return (uint32_t)v;
+
+    exp = 63 - __builtin_clzll(v);
+    if (unlikely(exp > LAT_HIST_MAX_EXP))
+        return LAT_HIST_BUCKETS - 1;
+
+    return (exp - LAT_HIST_SUB_BITS + 1) * LAT_HIST_SUB +
+           (uint32_t)(v >> (exp - LAT_HIST_SUB_BITS)) - LAT_HIST_SUB;
+}
+
+/*
+ * 桶下标 → 该桶能表示的最大值 (与 HDR Histogram 一致, 分位数取桶上界)
+ */
+static inline uint64_t lat_hist_value(uint32_t idx)
+{
+    uint32_t group, sub;
+
+    if (idx < LAT_HIST_SUB)
+        return idx;
+
+    group = idx / LAT_HIST_SUB;
+    sub = idx % LAT_HIST_SUB;
+
+    return ((uint64_t)(LAT_HIST_SUB + sub + 1) << (group - 1)) - 1;
+}
+
+/*
+ * 记录一个延迟样本 (仅由所属 worker 调用)
+ * 单写者无需原子加, 用 relaxed store 保证统计线程读到完整的 64 位值
+ */
+static inline void lat_hist_record(struct latency_hist *h, uint64_t cycles)
+{
+    uint32_t idx = lat_hist_index(cycles);
+
+    __atomic_store_n(&h->buckets[idx], h->buckets[idx] + 1, __ATOMIC_RELAXED);
+}
+
 /*
  * 解析包并更新统计
  */
@@ -149,14 +233,18 @@ static int worker_main(void *arg)
     unsigned lcore_id = rte_lcore_id();
 
     struct rte_mbuf *bufs[BURST_SIZE];
+    uint64_t hw_ts[BURST_SIZE];
     uint16_t nb_rx;
     struct worker_stats *stats = &worker_stats[lcore_id];
+    struct latency_hist *hist = &latency_hist[lcore_id];
+    uint64_t rx_tsc;
 
     printf("Worker core %u started: Port %u Queue %u (Socket %u)\n",
            lcore_id, port_id, queue_id, rte_lcore_to_socket_id(lcore_id));
 
     /* 初始化时间戳 */
     stats->last_timestamp = rte_get_timer_cycles();
+    hist->queue_id = queue_id;
 
     while (!force_quit) {
         /* Burst 收包 */
@@ -166,6 +254,8 @@ static int worker_main(void *arg)
             continue;
         }
 
+        rx_tsc = rte_rdtsc();
+
         /* 更新统计 */
         stats->rx_packets += nb_rx;
 
@@ -180,9 +270,36 @@ static int worker_main(void *arg)
             /* 解析包 */
             parse_packet(bufs[i], stats);
 
+            if (use_hw_timestamp) {
+                /* 网卡时间戳: 先保存, burst 结束后统一读一次网卡时钟 */
+                hw_ts[i] = (bufs[i]->ol_flags & ts_dynflag) ?
+                    *RTE_MBUF_DYNFIELD(bufs[i], ts_dynfield_offset,
+                                       rte_mbuf_timestamp_t *) : 0;
+            } else {
+                /* TSC: rx_burst 返回 → 本包处理完成 */
+                lat_hist_record(hist, rte_rdtsc() - rx_tsc);
+            }
+
             /* 释放包 */
             rte_pktmbuf_free(bufs[i]);
         }
+
+        /*
+         * 网卡时间戳包含了包在 RX 描述符环中排队的时间,
+         * 这正是 TSC 方式看不到的部分
+         */
+        if (use_hw_timestamp) {
+            uint64_t nic_now;
+
+            if (rte_eth_read_clock(port_id, &nic_now) == 0) {
+                for (uint16_t i = 0; i < nb_rx; i++) {
+                    if (hw_ts[i] == 0 || hw_ts[i] > nic_now)
+                        continue;
+                    lat_hist_record(hist,
+                                    ((nic_now - hw_ts[i]) * nic_to_tsc_mult) >> 16);
+                }
+            }
+        }
     }
 
     printf("Worker core %u stopped\n", lcore_id);
@@ -372,6 +489,101 @@ static void print_load_balance_analysis(void)
     }
 }
 
+/*
+ * 从直方图计算分位数 (q 取 0.0 - 1.0)
+ */
+static uint64_t lat_hist_percentile(const uint64_t *buckets, uint64_t total,
+                                    double q)
+{
+    uint64_t target = (uint64_t)(q * total);
+    uint64_t seen = 0;
+
+    if (target >= total)
+        target = total - 1;
+
+    for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+        seen += buckets[i];
+        if (seen > target)
+            return lat_hist_value(i);
+    }
+
+    return lat_hist_value(LAT_HIST_BUCKETS - 1);
+}
+
+/*
+ * 区间直方图中最高的非空桶的上界, 即本区间的最大值 (精度与分位数相同)
+ */
+static uint64_t lat_hist_max(const uint64_t *buckets)
+{
+    for (uint32_t i = LAT_HIST_BUCKETS; i > 0; i--) {
+        if (buckets[i - 1] != 0)
+            return lat_hist_value(i - 1);
+    }
+
+    return 0;
+}
+
+/*
+ * 打印每个队列的延迟分位数
+ * 无锁快照: 逐桶原子读取当前值, 与上次快照做差得到本区间的直方图,
+ * 同时合并出所有队列的总体直方图; max 也取自区间直方图, 与表头一致
+ */
+static void print_latency_stats(void)
+{
+    static uint64_t merged[LAT_HIST_BUCKETS];
+    uint64_t delta[LAT_HIST_BUCKETS];
+    uint64_t merged_total = 0;
+    double ns_per_cycle = 1E9 / rte_get_tsc_hz();
+    unsigned lcore_id;
+
+    memset(merged, 0, sizeof(merged));
+
+    printf("\n=== Per-Queue Latency (%s, interval) ===\n",
+           use_hw_timestamp ? "NIC timestamp" : "TSC");
+    printf("┌───────┬──────────────┬──────────┬──────────┬──────────┬──────────┐\n");
+    printf("│ Queue │ Samples      │ p50(ns)  │ p99(ns)  │ p999(ns) │ max(ns)  │\n");
+    printf("├───────┼──────────────┼──────────┼──────────┼──────────┼──────────┤\n");
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        struct latency_hist *h = &latency_hist[lcore_id];
+        uint64_t *last = latency_last[lcore_id];
+        uint64_t total = 0;
+
+        for (uint32_t i = 0; i < LAT_HIST_BUCKETS; i++) {
+            uint64_t cur = __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+
+            delta[i] = cur - last[i];
+            last[i] = cur;
+            total += delta[i];
+            merged[i] += delta[i];
+        }
+
+        if (total == 0)
+            continue;
+
+        merged_total += total;
+
+        printf("│ %5u │ %12"PRIu64" │ %8.0f │ %8.0f │ %8.0f │ %8.0f │\n",
+               h->queue_id, total,
+               lat_hist_percentile(delta, total, 0.50) * ns_per_cycle,
+               lat_hist_percentile(delta, total, 0.99) * ns_per_cycle,
+               lat_hist_percentile(delta, total, 0.999) * ns_per_cycle,
+               lat_hist_max(delta) * ns_per_cycle);
+    }
+
+    if (merged_total > 0) {
+        printf("├───────┼──────────────┼──────────┼──────────┼──────────┼──────────┤\n");
+        printf("│ All   │ %12"PRIu64" │ %8.0f │ %8.0f │ %8.0f │ %8.0f │\n",
+               merged_total,
+               lat_hist_percentile(merged, merged_total, 0.50) * ns_per_cycle,
+               lat_hist_percentile(merged, merged_total, 0.99) * ns_per_cycle,
+               lat_hist_percentile(merged, merged_total, 0.999) * ns_per_cycle,
+               lat_hist_max(merged) * ns_per_cycle);
+    }
+
+    printf("└───────┴──────────────┴──────────┴──────────┴──────────┴──────────┘\n");
+}
+
 /*
  * 统计线程 - 定期打印统计信息
  */
@@ -395,6 +607,7 @@ static int stats_thread(void *arg)
         print_port_stats(port_id, nb_queues);
         print_worker_stats();
         print_load_balance_analysis();
+        print_latency_stats();
 
         printf("\nPress Ctrl+C to quit\n");
     }
@@ -402,6 +615,43 @@ static int stats_thread(void *arg)
     return 0;
 }
 
+/*
+ * 注册时间戳动态字段并估算网卡时钟频率
+ * 网卡时钟与 TSC 频率不同, 用一段固定延时同时读两者求出换算系数
+ */
+static int init_hw_timestamp(uint16_t port)
+{
+    uint64_t nic_start, nic_end, tsc_start, tsc_end;
+    int ret;
+
+    ret = rte_mbuf_dyn_rx_timestamp_register(&ts_dynfield_offset, &ts_dynflag);
+    if (ret != 0)
+        return ret;
+
+    ret = rte_eth_read_clock(port, &nic_start);
+    if (ret != 0)
+        return ret;
+    tsc_start = rte_rdtsc();
+
+    rte_delay_ms(NIC_CLOCK_CALIB_MS);
+
+    ret = rte_eth_read_clock(port, &nic_end);
+    if (ret != 0)
+        return ret;
+    tsc_end = rte_rdtsc();
+
+    if (nic_end <= nic_start)
+        return -EINVAL;
+
+    nic_to_tsc_mult = ((tsc_end - tsc_start) << 16) / (nic_end - nic_start);
+
+    printf("NIC clock: %"PRIu64" Hz (%.3f TSC cycles/tick)\n",
+           (nic_end - nic_start) * 1000 / NIC_CLOCK_CALIB_MS,
+           nic_to_tsc_mult / 65536.0);
+
+    return 0;
+}
+
 /*
  * 初始化端口
  */
@@ -442,6 +692,16 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
     printf("Configuring with %u RX queues and %u TX queues\n",
            nb_rx_queues, nb_tx_queues);
 
+    /* 网卡硬件时间戳 */
+    if (use_hw_timestamp) {
+        if (!(dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_TIMESTAMP)) {
+            printf("RX timestamp offload not supported, falling back to TSC\n");
+            use_hw_timestamp = 0;
+        } else {
+            local_port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_TIMESTAMP;
+        }
+    }
+
     /* 配置端口 */
     ret = rte_eth_dev_configure(port, nb_rx_queues, nb_tx_queues,
                                 &local_port_conf);
@@ -498,6 +758,14 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
     /* 打印 RSS 配置 */
     print_rss_config(port);
 
+    if (use_hw_timestamp) {
+        ret = init_hw_timestamp(port);
+        if (ret != 0) {
+            printf("Failed to init NIC timestamp, falling back to TSC\n");
+            use_hw_timestamp = 0;
+        }
+    }
+
     printf("Port %u initialized successfully\n", port);
 
     return 0;
@@ -508,12 +776,38 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
  */
 static void print_usage(const char *prgname)
 {
-    printf("\nUsage: %s [EAL options]\n\n", prgname);
-    printf("Example:\n");
+    printf("\nUsage: %s [EAL options] -- [options]\n\n", prgname);
+    printf("Options:\n");
+    printf("  -t         Use NIC RX timestamps for latency (default: TSC)\n");
+    printf("\nExample:\n");
     printf("  sudo %s -l 0-4 -- \n", prgname);
     printf("    (Use 1 main core + 4 worker cores for 4 RX queues)\n\n");
 }
 
+/*
+ * 解析命令行参数
+ */
+static int parse_args(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "th")) != -1) {
+        switch (opt) {
+        case 't':
+            use_hw_timestamp = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            exit(0);
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * 主函数
  */
@@ -540,6 +834,9 @@ int main(int argc, char *argv[])
     argc -= ret;
     argv += ret;
 
+    if (parse_args(argc, argv) < 0)
+        rte_exit(EXIT_FAILURE, "Invalid arguments\n");
+
     /* 打印欢迎信息 */
     printf("\n");
     printf("╔════════════════════════════════════════════════════════╗\n");
@@ -608,6 +905,7 @@ int main(int argc, char *argv[])
     print_port_stats(port_id, nb_workers);
     print_worker_stats();
     print_load_balance_analysis();
+    print_latency_stats();
 
     /* 停止端口 */
     printf("\nStopping port %u...\n", port_id);
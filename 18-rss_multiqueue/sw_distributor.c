@@ -0,0 +1,645 @@
+/*
+ * DPDK Software RSS Distributor
+ * Lesson 18 扩展: 单队列网卡上的多核扩展
+ *
+ * virtio、net_af_packet 等 PMD 只有一个 RX 队列, 硬件 RSS 无法使用.
+ * 本示例用一个 RX 核心在软件中完成 RSS:
+ * 1. 计算与硬件一致的 Toeplitz 哈希 (rte_softrss_be)
+ * 2. 通过软件 RETA (重定向表) 选择 worker, 保证流亲和性
+ * 3. 按 worker 分组后批量写入各自的 SPSC ring
+ * 4. 统计分发核心的忙碌率, 判断它是否已成为瓶颈
+ *
+ * 架构:
+ *   NIC(单队列) → 分发核心(Toeplitz + RETA) → SPSC Ring × N → Worker × N
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_cycles.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_ring.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_tcp.h>
+#include <rte_udp.h>
+#include <rte_thash.h>
+
+/* 配置参数 */
+#define RX_RING_SIZE 1024
+#define TX_RING_SIZE 1024
+#define NUM_MBUFS 8191
+#define MBUF_CACHE_SIZE 250
+#define BURST_SIZE 32
+#define PREFETCH_OFFSET 3
+
+/* 分发配置 */
+#define MAX_WORKERS 16
+#define WORKER_RING_SIZE 4096
+#define RETA_SIZE 128               /* 与常见网卡 RETA 大小一致, 必须是 2 的幂 */
+#define RSS_KEY_LEN 40
+
+/* 忙碌率超过该值即认为分发核心饱和 */
+#define SATURATION_BUSY_PCT 90.0
+/* 满 burst 比例超过该值说明 RX 队列持续积压 */
+#define SATURATION_FULL_BURST_PCT 50.0
+
+/* 统计更新间隔 */
+#define STATS_INTERVAL_MS 1000
+
+/* 全局变量 */
+static volatile int force_quit = 0;
+static uint16_t nb_rxd = RX_RING_SIZE;
+static uint16_t nb_txd = TX_RING_SIZE;
+static uint16_t nb_workers;
+
+/*
+ * 默认 Toeplitz key (与 testpmd / 大多数 Intel 网卡默认值相同),
+ * 因此软件哈希结果与硬件 RSS 结果一致
+ */
+static uint8_t rss_key[RSS_KEY_LEN] = {
+    0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+    0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+    0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+    0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+    0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+/* rte_softrss_be 需要预先转换字节序的 key */
+static uint8_t rss_key_be[RSS_KEY_LEN];
+
+/* 软件 RETA: 哈希低位 → worker 索引 */
+static uint8_t reta[RETA_SIZE];
+
+/* 每个 worker 一个 SPSC ring */
+static struct rte_ring *worker_rings[MAX_WORKERS];
+
+/* 分发核心统计 */
+struct dist_stats {
+    uint64_t rx_packets;
+    uint64_t sw_hashed;         /* 软件计算哈希的包数 */
+    uint64_t hw_hashed;         /* 直接使用网卡哈希的包数 */
+    uint64_t ring_drops;        /* worker ring 满导致的丢包 */
+    uint64_t polls;             /* rx_burst 调用次数 */
+    uint64_t full_bursts;       /* 收满 BURST_SIZE 的次数 */
+    uint64_t busy_cycles;       /* 收到包的循环所花的周期 */
+    uint64_t total_cycles;      /* 分发循环总周期 */
+    uint64_t worker_drops[MAX_WORKERS]; /* 按 worker 统计的 ring 丢包 */
+} __rte_cache_aligned;
+
+/* 每个 worker 的统计信息 */
+struct worker_stats {
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    uint64_t tcp_packets;
+    uint64_t udp_packets;
+    uint64_t other_packets;
+} __rte_cache_aligned;
+
+static struct dist_stats dist_stats;
+static struct worker_stats worker_stats[MAX_WORKERS];
+
+/* 用于计算速率的上一次快照 (仅统计线程访问) */
+static struct dist_stats last_dist_stats;
+
+/* 端口配置: 单队列, 不依赖硬件 RSS */
+static struct rte_eth_conf port_conf = {
+    .rxmode = {
+        .mq_mode = RTE_ETH_MQ_RX_NONE,
+        .mtu = RTE_ETHER_MAX_LEN,
+    },
+    .txmode = {
+        .mq_mode = RTE_ETH_MQ_TX_NONE,
+    },
+};
+
+/*
+ * 信号处理函数
+ */
+static void signal_handler(int signum)
+{
+    if (signum == SIGINT || signum == SIGTERM) {
+        printf("\n\nSignal %d received, preparing to exit...\n", signum);
+        force_quit = 1;
+    }
+}
+
+/*
+ * 初始化 RSS key 和 RETA
+ * RETA 按轮询方式填充, 与网卡默认 RETA 行为一致
+ */
+static void init_soft_rss(void)
+{
+    rte_convert_rss_key((uint32_t *)rss_key, (uint32_t *)rss_key_be,
+                        RSS_KEY_LEN);
+
+    for (uint32_t i = 0; i < RETA_SIZE; i++)
+        reta[i] = i % nb_workers;
+}
+
+/*
+ * 软件 Toeplitz 哈希
+ * TCP/UDP 使用 4 元组, 其他 IP 协议使用 2 元组, 与硬件 RSS 规则一致
+ * 非 IP 包返回 0 (全部落到同一个 worker)
+ */
+static inline uint32_t soft_rss_hash(struct rte_mbuf *m)
+{
+    struct rte_ether_hdr *eth_hdr;
+    union rte_thash_tuple tuple;
+    uint16_t ether_type;
+    uint32_t len;
+
+    eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
+
+    if (ether_type == RTE_ETHER_TYPE_IPV4) {
+        struct rte_ipv4_hdr *ipv4_hdr;
+        uint8_t proto;
+
+        ipv4_hdr = (struct rte_ipv4_hdr *)(eth_hdr + 1);
+        tuple.v4.src_addr = rte_be_to_cpu_32(ipv4_hdr->src_addr);
+        tuple.v4.dst_addr = rte_be_to_cpu_32(ipv4_hdr->dst_addr);
+        len = RTE_THASH_V4_L3_LEN;
+
+        proto = ipv4_hdr->next_proto_id;
+        /* 分片包没有可靠的 L4 端口, 只用 L3 哈希 */
+        if ((proto == IPPROTO_TCP || proto == IPPROTO_UDP) &&
+            !rte_ipv4_frag_pkt_is_fragmented(ipv4_hdr)) {
+            struct rte_udp_hdr *l4 = (struct rte_udp_hdr *)
+                ((uint8_t *)ipv4_hdr + rte_ipv4_hdr_len(ipv4_hdr));
+            tuple.v4.sport = rte_be_to_cpu_16(l4->src_port);
+            tuple.v4.dport = rte_be_to_cpu_16(l4->dst_port);
+            len = RTE_THASH_V4_L4_LEN;
+        }
+    } else if (ether_type == RTE_ETHER_TYPE_IPV6) {
+        struct rte_ipv6_hdr *ipv6_hdr;
+
+        ipv6_hdr = (struct rte_ipv6_hdr *)(eth_hdr + 1);
+        rte_thash_load_v6_addrs(ipv6_hdr, &tuple);
+        len = RTE_THASH_V6_L3_LEN;
+
+        if (ipv6_hdr->proto == IPPROTO_TCP || ipv6_hdr->proto == IPPROTO_UDP) {
+            struct rte_udp_hdr *l4 = (struct rte_udp_hdr *)(ipv6_hdr + 1);
+            tuple.v6.sport = rte_be_to_cpu_16(l4->src_port);
+            tuple.v6.dport = rte_be_to_cpu_16(l4->dst_port);
+            len = RTE_THASH_V6_L4_LEN;
+        }
+    } else {
+        return 0;
+    }
+
+    return rte_softrss_be((uint32_t *)&tuple, len, rss_key_be);
+}
+
+/*
+ * 分发核心主函数
+ * 收包 → 计算哈希 → 按 worker 分组 → 批量入队
+ */
+static int distributor_main(void *arg)
+{
+    uint16_t port_id = *(uint16_t *)arg;
+    unsigned lcore_id = rte_lcore_id();
+    struct rte_mbuf *bufs[BURST_SIZE];
+    struct rte_mbuf *per_worker[MAX_WORKERS][BURST_SIZE];
+    uint16_t per_worker_cnt[MAX_WORKERS];
+    struct dist_stats *stats = &dist_stats;
+    uint64_t loop_start, now;
+    uint16_t nb_rx;
+
+    printf("Distributor core %u started: Port %u Queue 0 (Socket %u)\n",
+           lcore_id, port_id, rte_lcore_to_socket_id(lcore_id));
+
+    loop_start = rte_rdtsc();
+
+    while (!force_quit) {
+        nb_rx = rte_eth_rx_burst(port_id, 0, bufs, BURST_SIZE);
+        stats->polls++;
+
+        if (unlikely(nb_rx == 0)) {
+            now = rte_rdtsc();
+            stats->total_cycles += now - loop_start;
+            loop_start = now;
+            continue;
+        }
+
+        stats->rx_packets += nb_rx;
+        if (nb_rx == BURST_SIZE)
+            stats->full_bursts++;
+
+        memset(per_worker_cnt, 0, sizeof(uint16_t) * nb_workers);
+
+        for (uint16_t i = 0; i < nb_rx; i++) {
+            struct rte_mbuf *m = bufs[i];
+            uint32_t hash;
+            uint8_t w;
+
+            if (i + PREFETCH_OFFSET < nb_rx) {
+                rte_prefetch0(rte_pktmbuf_mtod(bufs[i + PREFETCH_OFFSET],
+                                               void *));
+            }
+
+            /* 网卡已提供 RSS 哈希时直接复用, 否则软件计算 */
+            if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH) {
+                hash = m->hash.rss;
+                stats->hw_hashed++;
+            } else {
+                hash = soft_rss_hash(m);
+                m->hash.rss = hash;
+                m->ol_flags |= RTE_MBUF_F_RX_RSS_HASH;
+                stats->sw_hashed++;
+            }
+
+            w = reta[hash & (RETA_SIZE - 1)];
+            per_worker[w][per_worker_cnt[w]++] = m;
+        }
+
+        /* 每个 worker 一次批量入队, 摊薄 ring 操作开销 */
+        for (uint16_t w = 0; w < nb_workers; w++) {
+            uint16_t cnt = per_worker_cnt[w];
+            unsigned int sent;
+
+            if (cnt == 0)
+                continue;
+
+            sent = rte_ring_sp_enqueue_burst(worker_rings[w],
+                                             (void **)per_worker[w],
+                                             cnt, NULL);
+            if (unlikely(sent < cnt)) {
+                rte_pktmbuf_free_bulk(&per_worker[w][sent], cnt - sent);
+                stats->ring_drops += cnt - sent;
+                stats->worker_drops[w] += cnt - sent;
+            }
+        }
+
+        now = rte_rdtsc();
+        stats->busy_cycles += now - loop_start;
+        stats->total_cycles += now - loop_start;
+        loop_start = now;
+    }
+
+    printf("Distributor core %u stopped\n", lcore_id);
+    return 0;
+}
+
+/*
+ * 解析包并更新统计
+ */
+static inline void parse_packet(struct rte_mbuf *m, struct worker_stats *stats)
+{
+    struct rte_ether_hdr *eth_hdr;
+    struct rte_ipv4_hdr *ipv4_hdr;
+    uint16_t ether_type;
+
+    eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
+
+    stats->rx_bytes += rte_pktmbuf_pkt_len(m);
+
+    if (ether_type == RTE_ETHER_TYPE_IPV4) {
+        ipv4_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+                                           sizeof(struct rte_ether_hdr));
+
+        switch (ipv4_hdr->next_proto_id) {
+        case IPPROTO_TCP:
+            stats->tcp_packets++;
+            break;
+        case IPPROTO_UDP:
+            stats->udp_packets++;
+            break;
+        default:
+            stats->other_packets++;
+            break;
+        }
+    } else {
+        stats->other_packets++;
+    }
+}
+
+/*
+ * Worker 核心主函数
+ * 每个 worker 只消费自己的 ring (单消费者)
+ */
+static int worker_main(void *arg)
+{
+    uint16_t worker_id = *(uint16_t *)arg;
+    unsigned lcore_id = rte_lcore_id();
+    struct rte_ring *ring = worker_rings[worker_id];
+    struct worker_stats *stats = &worker_stats[worker_id];
+    struct rte_mbuf *bufs[BURST_SIZE];
+    unsigned int nb_deq;
+
+    printf("Worker core %u started: Ring %s\n", lcore_id, ring->name);
+
+    while (!force_quit) {
+        nb_deq = rte_ring_sc_dequeue_burst(ring, (void **)bufs,
+                                           BURST_SIZE, NULL);
+        if (unlikely(nb_deq == 0))
+            continue;
+
+        stats->rx_packets += nb_deq;
+
+        for (unsigned int i = 0; i < nb_deq; i++) {
+            if (i + PREFETCH_OFFSET < nb_deq) {
+                rte_prefetch0(rte_pktmbuf_mtod(bufs[i + PREFETCH_OFFSET],
+                                               void *));
+            }
+            parse_packet(bufs[i], stats);
+        }
+
+        rte_pktmbuf_free_bulk(bufs, nb_deq);
+    }
+
+    /* 退出前清空 ring, 归还 mbuf */
+    while ((nb_deq = rte_ring_sc_dequeue_burst(ring, (void **)bufs,
+                                               BURST_SIZE, NULL)) > 0)
+        rte_pktmbuf_free_bulk(bufs, nb_deq);
+
+    printf("Worker core %u stopped\n", lcore_id);
+    return 0;
+}
+
+/*
+ * 打印分发核心统计及饱和度分析
+ */
+static void print_distributor_stats(uint16_t port_id)
+{
+    struct dist_stats cur = dist_stats;
+    struct dist_stats *last = &last_dist_stats;
+    struct rte_eth_stats eth_stats;
+    uint64_t hz = rte_get_tsc_hz();
+    uint64_t d_total = cur.total_cycles - last->total_cycles;
+    uint64_t d_busy = cur.busy_cycles - last->busy_cycles;
+    uint64_t d_polls = cur.polls - last->polls;
+    uint64_t d_full = cur.full_bursts - last->full_bursts;
+    uint64_t d_rx = cur.rx_packets - last->rx_packets;
+    double busy_pct = d_total ? d_busy * 100.0 / d_total : 0.0;
+    double full_pct = d_polls ? d_full * 100.0 / d_polls : 0.0;
+    double pps = d_total ? (double)d_rx * hz / d_total : 0.0;
+    double cycles_per_pkt = d_rx ? (double)d_busy / d_rx : 0.0;
+    uint64_t imissed = 0;
+
+    if (rte_eth_stats_get(port_id, &eth_stats) == 0)
+        imissed = eth_stats.imissed;
+
+    printf("\n=== Distributor Statistics ===\n");
+    printf("RX Packets:      %"PRIu64"  (%.0f pps)\n", cur.rx_packets, pps);
+    printf("Hash Source:     SW %"PRIu64"  HW %"PRIu64"\n",
+           cur.sw_hashed, cur.hw_hashed);
+    printf("Ring Drops:      %"PRIu64"\n", cur.ring_drops);
+    printf("NIC Missed:      %"PRIu64"\n", imissed);
+    printf("Busy:            %.1f%%\n", busy_pct);
+    printf("Full Bursts:     %.1f%%\n", full_pct);
+    printf("Cycles/Packet:   %.1f\n", cycles_per_pkt);
+
+    if (busy_pct > SATURATION_BUSY_PCT || full_pct > SATURATION_FULL_BURST_PCT)
+        printf("✗ Distributor core is saturated (consider fewer cycles/packet "
+               "or a second RX queue)\n");
+    else
+        printf("✓ Distributor core has headroom\n");
+
+    *last = cur;
+}
+
+/*
+ * 打印 Worker 统计信息
+ */
+static void print_worker_stats(void)
+{
+    uint64_t total_packets = 0;
+
+    printf("\n=== Worker Statistics ===\n");
+    printf("┌────────┬──────────────┬──────────────┬──────────┬──────────┬──────────┬──────────┬──────────┐\n");
+    printf("│ Worker │ RX Packets   │ RX Bytes     │ TCP      │ UDP      │ Other    │ Drops    │ Ring Use │\n");
+    printf("├────────┼──────────────┼──────────────┼──────────┼──────────┼──────────┼──────────┼──────────┤\n");
+
+    for (uint16_t w = 0; w < nb_workers; w++) {
+        struct worker_stats *stats = &worker_stats[w];
+
+        printf("│ %6u │ %12"PRIu64" │ %12"PRIu64" │ %8"PRIu64" │ %8"PRIu64" │ %8"PRIu64" │ %8"PRIu64" │ %8u │\n",
+               w,
+               stats->rx_packets,
+               stats->rx_bytes,
+               stats->tcp_packets,
+               stats->udp_packets,
+               stats->other_packets,
+               dist_stats.worker_drops[w],
+               rte_ring_count(worker_rings[w]));
+
+        total_packets += stats->rx_packets;
+    }
+
+    printf("└────────┴──────────────┴──────────────┴──────────┴──────────┴──────────┴──────────┴──────────┘\n");
+    printf("Total: %"PRIu64" packets\n", total_packets);
+}
+
+/*
+ * 统计线程 - 定期打印统计信息
+ */
+static int stats_thread(void *arg)
+{
+    uint16_t port_id = *(uint16_t *)arg;
+
+    printf("Statistics thread started on lcore %u\n", rte_lcore_id());
+
+    while (!force_quit) {
+        sleep(STATS_INTERVAL_MS / 1000);
+
+        if (force_quit)
+            break;
+
+        /* 清屏 */
+        printf("\033[2J\033[H");
+
+        print_distributor_stats(port_id);
+        print_worker_stats();
+
+        printf("\nPress Ctrl+C to quit\n");
+    }
+
+    return 0;
+}
+
+/*
+ * 初始化端口 (单 RX 队列)
+ */
+static int port_init(uint16_t port, struct rte_mempool *mbuf_pool)
+{
+    struct rte_eth_conf local_port_conf = port_conf;
+    struct rte_eth_dev_info dev_info;
+    int ret;
+
+    printf("\n=== Initializing Port %u ===\n", port);
+
+    ret = rte_eth_dev_info_get(port, &dev_info);
+    if (ret != 0) {
+        printf("Error getting device info: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    printf("Device: %s\n", dev_info.driver_name);
+    printf("Max RX queues: %u\n", dev_info.max_rx_queues);
+
+    /* 网卡能提供 RSS 哈希时打开, 分发核心可省去软件计算 */
+    if (dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_RSS_HASH)
+        local_port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_RSS_HASH;
+
+    ret = rte_eth_dev_configure(port, 1, 1, &local_port_conf);
+    if (ret != 0) {
+        printf("Port configuration failed: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    ret = rte_eth_dev_adjust_nb_rx_tx_desc(port, &nb_rxd, &nb_txd);
+    if (ret != 0) {
+        printf("Failed to adjust descriptors: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    ret = rte_eth_rx_queue_setup(port, 0, nb_rxd,
+                                 rte_eth_dev_socket_id(port),
+                                 NULL, mbuf_pool);
+    if (ret < 0) {
+        printf("RX queue setup failed: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    ret = rte_eth_tx_queue_setup(port, 0, nb_txd,
+                                 rte_eth_dev_socket_id(port), NULL);
+    if (ret < 0) {
+        printf("TX queue setup failed: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    ret = rte_eth_dev_start(port);
+    if (ret < 0) {
+        printf("Port start failed: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    ret = rte_eth_promiscuous_enable(port);
+    if (ret != 0) {
+        printf("Promiscuous mode enable failed: %s\n", rte_strerror(-ret));
+        return ret;
+    }
+
+    printf("Port %u initialized successfully\n", port);
+
+    return 0;
+}
+
+/*
+ * 主函数
+ */
+int main(int argc, char *argv[])
+{
+    struct rte_mempool *mbuf_pool;
+    uint16_t port_id = 0;
+    uint16_t worker_ids[MAX_WORKERS];
+    unsigned lcore_id;
+    unsigned dist_lcore = RTE_MAX_LCORE;
+    uint16_t w = 0;
+    int ret;
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    ret = rte_eal_init(argc, argv);
+    if (ret < 0)
+        rte_panic("Cannot init EAL\n");
+
+    printf("\n");
+    printf("╔════════════════════════════════════════════════════════╗\n");
+    printf("║   DPDK Software RSS Distributor - Lesson 18            ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n");
+
+    if (rte_eth_dev_count_avail() == 0)
+        rte_exit(EXIT_FAILURE, "No Ethernet ports available\n");
+
+    /* 主核心: 统计; 第一个 worker 核心: 分发; 其余: worker */
+    if (rte_lcore_count() < 3)
+        rte_exit(EXIT_FAILURE,
+                 "Need at least 3 lcores (1 main + 1 distributor + 1 worker)\n");
+
+    nb_workers = rte_lcore_count() - 2;
+    if (nb_workers > MAX_WORKERS)
+        nb_workers = MAX_WORKERS;
+
+    printf("\nDistributor: 1 core, Workers: %u\n", nb_workers);
+
+    mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL",
+                                        NUM_MBUFS + WORKER_RING_SIZE * nb_workers,
+                                        MBUF_CACHE_SIZE, 0,
+                                        RTE_MBUF_DEFAULT_BUF_SIZE,
+                                        rte_socket_id());
+    if (mbuf_pool == NULL)
+        rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
+
+    /* 创建 SPSC ring: 分发核心是唯一生产者, 对应 worker 是唯一消费者 */
+    for (uint16_t i = 0; i < nb_workers; i++) {
+        char name[RTE_RING_NAMESIZE];
+
+        snprintf(name, sizeof(name), "dist_ring_%u", i);
+        worker_rings[i] = rte_ring_create(name, WORKER_RING_SIZE,
+                                          rte_socket_id(),
+                                          RING_F_SP_ENQ | RING_F_SC_DEQ);
+        if (worker_rings[i] == NULL)
+            rte_exit(EXIT_FAILURE, "Cannot create ring %s\n", name);
+    }
+
+    init_soft_rss();
+
+    ret = port_init(port_id, mbuf_pool);
+    if (ret != 0)
+        rte_exit(EXIT_FAILURE, "Cannot init port %u\n", port_id);
+
+    printf("\n=== Starting Cores ===\n");
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        if (dist_lcore == RTE_MAX_LCORE) {
+            dist_lcore = lcore_id;
+            printf("Launching distributor on lcore %u\n", lcore_id);
+            rte_eal_remote_launch(distributor_main, &port_id, lcore_id);
+            continue;
+        }
+
+        if (w >= nb_workers)
+            break;
+
+        worker_ids[w] = w;
+        printf("Launching worker %u on lcore %u\n", w, lcore_id);
+        rte_eal_remote_launch(worker_main, &worker_ids[w], lcore_id);
+        w++;
+    }
+
+    stats_thread(&port_id);
+
+    printf("\nWaiting for cores to stop...\n");
+    rte_eal_mp_wait_lcore();
+
+    printf("\n=== Final Statistics ===\n");
+    print_distributor_stats(port_id);
+    print_worker_stats();
+
+    printf("\nStopping port %u...\n", port_id);
+    ret = rte_eth_dev_stop(port_id);
+    if (ret != 0)
+        printf("Port stop failed: %s\n", rte_strerror(-ret));
+
+    rte_eth_dev_close(port_id);
+
+    for (uint16_t i = 0; i < nb_workers; i++)
+        rte_ring_free(worker_rings[i]);
+
+    rte_eal_cleanup();
+
+    printf("\nProgram exited cleanly.\n");
+    return 0;
+}
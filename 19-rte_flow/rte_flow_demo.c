@@ -9,6 +9,12 @@
  * 4. Actions (queue, drop, mark, count)
  * 5. Dynamic rule management
  * 6. Flow statistics and monitoring
+ * 7. Template/async API: batched insertion of thousands of rules
+ * 8. Elephant-flow offload: heavy flows found in software get hardware rules,
+ *    which are aged out when idle
+ * 9. Software rte_flow engine (sw_flow.c) for PMDs without flow offload
+ * 10. Per-packet service pipelines (DNS parsing, count-only bulk) selected by
+ *     the MARK of the rule that steered the packet, with per-lcore statistics
  */
 
 #include <stdio.h>
@@ -18,6 +24,7 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <arpa/inet.h>
 
 #include <rte_eal.h>
@@ -25,40 +32,279 @@
 #include <rte_cycles.h>
 #include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_ip_frag.h>
+#include <rte_udp.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+#include <rte_random.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
 #include <rte_flow.h>
 
+#include "sw_flow.h"
+
 /* 配置参数 */
 #define RX_RING_SIZE 1024
 #define TX_RING_SIZE 1024
 #define NUM_MBUFS 8191
 #define MBUF_CACHE_SIZE 250
 #define BURST_SIZE 32
-#define MAX_FLOWS 128
+
+/* Flow 规则管理器参数 */
+#define MAX_FLOWS 65536            /* 管理器容纳的规则数 */
+#define FLOW_OP_QUEUE 0            /* 控制线程使用的 flow 操作队列 */
+#define FLOW_OP_QUEUE_SIZE 1024    /* 期望的操作队列深度, PMD 上限更小时以 PMD 为准 */
+#define FLOW_PUSH_BATCH 64         /* 攒够这么多操作 push 一次, 不超过队列深度的一半 */
+#define FLOW_RULE_GROUP 1          /* 模板表所在的 group, group 0 只放一条跳转 */
+#define FLOW_PRINT_LIMIT 16        /* 统计表最多打印的规则数 */
+#define FLOW_PULL_TIMEOUT_MS 1000  /* 等待异步操作完成的最长时间 */
+
+/* 大流卸载参数 */
+#define ELEPHANT_TRACK_SIZE 16384  /* 每个 worker 软件统计的流数 */
+#define ELEPHANT_SCAN_MS 500       /* worker 计算流速率的周期 */
+#define ELEPHANT_RING_SIZE 1024    /* worker → 主核的大流上报队列 */
+#define ELEPHANT_REPORT_BURST 256  /* 主核一次处理的上报数 */
+#define ELEPHANT_MAX_RULES 1024    /* 最多卸载的大流数 */
+#define ELEPHANT_IDLE_SEC 5        /* 硬件计数器这么久不变就删除规则 */
+#define ELEPHANT_MAX_FAILED 16     /* 一条都没装上就失败这么多次, 停止卸载 */
+#define ELEPHANT_MARK 0xE1E        /* 大流规则打的标记 */
+#define MONITOR_POLL_US 100000     /* 主核处理上报的间隔 */
+#define MONITOR_PRINT_SEC 2        /* 统计打印间隔 */
+
+/* 业务流水线参数 */
+#define SERVICE_MARK_DNS 0xD45     /* DNS 规则打的标记 */
+#define SERVICE_MARK_BULK 0xB01    /* 大批量数据规则打的标记 */
+#define DNS_PORT 53
+#define BULK_PORT 873              /* rsync */
 
 /* 全局变量 */
 static volatile int force_quit = 0;
 static uint16_t nb_rxd = RX_RING_SIZE;
 static uint16_t nb_txd = TX_RING_SIZE;
 
-/* Flow 规则管理器 */
+/* 命令行参数 */
+static uint32_t ddos_rules = 0;    /* -d: 批量下发的 DDoS 黑名单规则数 */
+static uint64_t elephant_rate = 0; /* -e: 大流阈值, 字节/秒, 0 表示不卸载 */
+static int force_sw_flow = 0;      /* -S: 不用网卡, 规则全部由软件引擎执行 */
+
+/*
+ * 规则匹配方式, 每种对应一个 pattern 模板
+ */
+enum flow_match {
+    MATCH_IPV4_DST,     /* ETH / IPV4(dst) */
+    MATCH_TCP_DPORT,    /* ETH / IPV4 / TCP(dst_port) */
+    MATCH_IPV4_SRC,     /* ETH / IPV4(src) */
+    MATCH_UDP_DPORT,    /* ETH / IPV4 / UDP(dst_port) */
+    MATCH_UDP_SPORT,    /* ETH / IPV4 / UDP(src_port) */
+    MATCH_TCP_FLOW,     /* ETH / IPV4(src, dst) / TCP(src_port, dst_port) */
+    MATCH_UDP_FLOW,     /* ETH / IPV4(src, dst) / UDP(src_port, dst_port) */
+    MATCH_MAX,
+};
+
+/*
+ * 规则动作, 每种对应一个 actions 模板, 都带 COUNT
+ */
+enum flow_fate {
+    FATE_QUEUE,         /* COUNT / QUEUE */
+    FATE_DROP,          /* COUNT / DROP */
+    FATE_MARK,          /* COUNT / MARK / QUEUE */
+    FATE_MAX,
+};
+
+/*
+ * 规则下发方式
+ * 网卡支持模板 API 时用异步队列, 否则逐条同步下发;
+ * 网卡连同步 rte_flow 都不支持 (net_null, net_ring, af_packet 等) 时由软件引擎执行
+ */
+enum flow_backend {
+    BACKEND_SYNC,       /* rte_flow_validate + rte_flow_create */
+    BACKEND_ASYNC,      /* 模板/异步 API */
+    BACKEND_SW,         /* sw_flow.c, RX 回调里分类 */
+};
+
+static const char *const backend_names[] = {
+    [BACKEND_SYNC] = "synchronous API",
+    [BACKEND_ASYNC] = "template/async API",
+    [BACKEND_SW] = "software flow engine",
+};
+
+/*
+ * 模板表: 五元组规则比其他规则更具体, 放在优先级更高 (数值更小) 的表里,
+ * 大流同时命中端口规则时以五元组规则为准
+ */
+enum flow_table_id {
+    TABLE_FIVE_TUPLE,   /* MATCH_TCP_FLOW, MATCH_UDP_FLOW */
+    TABLE_BASE,         /* 其余匹配方式 */
+    TABLE_MAX,
+};
+
+static const char *const fate_names[FATE_MAX] = {
+    [FATE_QUEUE] = "queue",
+    [FATE_DROP] = "drop",
+    [FATE_MARK] = "mark",
+};
+
+/* -o: 大流规则的动作 */
+static enum flow_fate elephant_fate = FATE_MARK;
+
+/*
+ * 规则键: 管理器按它去重和查找, 地址和端口为主机字节序, 匹配方式用不到的字段为 0
+ * worker 的软件流表也用它做键, 上报的大流可以直接下发
+ */
+struct flow_key {
+    uint32_t src_ip;
+    uint32_t dst_ip;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t match;      /* enum flow_match */
+    uint8_t pad[3];
+};
+
+enum flow_state {
+    FLOW_FREE = 0,
+    FLOW_CREATING,      /* 已入队, 等待完成 */
+    FLOW_ACTIVE,
+    FLOW_DESTROYING,    /* 已入队, 等待完成 */
+};
+
+/* Flow 规则, 下标就是 rte_hash 返回的位置 */
 struct flow_entry {
     struct rte_flow *flow;
-    char description[128];
+    struct sw_flow *sw_flow;    /* BACKEND_SW */
+    struct flow_key key;
+    uint8_t fate;
+    uint8_t state;
+    uint16_t queue;
+    uint8_t elephant;       /* 自动卸载的大流规则, 空闲时老化 */
+    char description[48];
     uint64_t hits;
     uint64_t bytes;
-    int active;
+    uint64_t last_hits;     /* 上次老化检查时的命中数 */
+    uint64_t last_active;   /* 命中数最后一次变化的 TSC */
+};
+
+/*
+ * Flow 规则管理器
+ * 规则按键存进 rte_hash, 增删查都是 O(1); 三种下发方式见 enum flow_backend,
+ * 调用者不感知
+ */
+static struct {
+    uint16_t port_id;
+    enum flow_backend backend;
+    struct rte_hash *index;
+    struct flow_entry *rules;
+    uint32_t num_flows;             /* 已占用的规则数, 含未完成的 */
+    uint32_t queue_size;            /* 与 PMD 协商后的操作队列深度 */
+    uint32_t push_batch;            /* 由 queue_size 得出的 push 批量 */
+    uint32_t inflight;              /* 已入队未完成的操作 */
+    uint32_t unpushed;              /* 已入队未 push 的操作 */
+    struct rte_flow_pattern_template *pattern_tmpl[MATCH_MAX];
+    struct rte_flow_actions_template *actions_tmpl[FATE_MAX];
+    struct rte_flow_template_table *tables[TABLE_MAX];
+    struct rte_flow_pattern_template *jump_pattern;
+    struct rte_flow_actions_template *jump_actions;
+    struct rte_flow_template_table *jump_table;
+    struct rte_flow *jump_flow;
+    uint64_t created;
+    uint64_t destroyed;
+    uint64_t failed;
+} flow_mgr;
+
+/*
+ * 业务流水线: 把包送进来的规则决定这个包要做多少软件处理
+ * 规则带 MARK, worker 按 mbuf->hash.fdir.hi 分派, 不用再自己解析包头分类
+ */
+enum service_id {
+    SERVICE_DEFAULT,    /* 没有标记: 计数, 开启大流卸载时做软件流统计 */
+    SERVICE_DNS,        /* SERVICE_MARK_DNS: 解析 DNS 报文头和问题 */
+    SERVICE_BULK,       /* SERVICE_MARK_BULK: 只计数, 不读包内容 */
+    SERVICE_ELEPHANT,   /* ELEPHANT_MARK: 已卸载的大流, 只计数 */
+    SERVICE_MAX,
 };
 
-static struct flow_entry flow_table[MAX_FLOWS];
-static uint32_t num_flows = 0;
+static const char *const service_names[SERVICE_MAX] = {
+    [SERVICE_DEFAULT] = "default",
+    [SERVICE_DNS] = "dns",
+    [SERVICE_BULK] = "bulk",
+    [SERVICE_ELEPHANT] = "elephant",
+};
 
 /* 统计信息 */
-struct queue_stats {
+struct service_stats {
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+struct dns_stats {
+    uint64_t queries;
+    uint64_t responses;
+    uint64_t nxdomain;
+    uint64_t qtype_a;
+    uint64_t qtype_aaaa;
+    uint64_t qtype_other;
+    uint64_t malformed;
+};
+
+/*
+ * 每个 worker 的队列和统计, 按 lcore 分开
+ * 只有所属的 worker 写, 主核只读, 不需要原子操作
+ */
+struct worker_ctx {
+    uint16_t port_id;
+    uint16_t queue_id;
+    int active;
     uint64_t rx_packets;
     uint64_t rx_bytes;
+    uint64_t unknown_marks;
+    struct service_stats service[SERVICE_MAX];
+    struct dns_stats dns;
+} __rte_cache_aligned;
+
+static struct worker_ctx workers[RTE_MAX_LCORE];
+
+/* worker 软件流表的表项: 本周期的字节数和包数 */
+struct track_entry {
+    uint64_t bytes;
+    uint64_t packets;
+};
+
+/*
+ * 每个 worker 的软件流表, 只有所属的 worker 读写, 不需要锁
+ * 与 6-flow_manager 的会话表一样按五元组统计, 定期换算成速率
+ */
+struct elephant_tracker {
+    struct rte_hash *index;
+    struct track_entry *entries;    /* 下标是 rte_hash 返回的位置 */
+    uint64_t last_scan;
+    uint64_t next_scan;
+    uint64_t tracked;               /* 软件统计的包数 */
+    uint64_t offloaded;             /* 带大流标记、跳过统计的包数 */
+    uint64_t table_full;
+    uint64_t report_drops;          /* 上报队列满 */
 } __rte_cache_aligned;
 
-static struct queue_stats queue_stats[16];
+static struct elephant_tracker trackers[RTE_MAX_LCORE];
+
+/* worker 上报给主核的大流 */
+struct elephant_report {
+    struct flow_key key;
+    uint64_t rate;                  /* 字节/秒 */
+};
+
+/* 主核的大流卸载状态 */
+static struct {
+    struct rte_ring *reports;
+    uint16_t queue;                 /* 大流的专用队列, 没有专用队列时为 UINT16_MAX */
+    uint32_t nb_rules;
+    uint64_t reported;
+    uint64_t offloaded;
+    uint64_t aged;
+    uint64_t failed;
+    uint64_t over_budget;           /* 规则数到上限而没有卸载的上报 */
+    int disabled;                   /* 网卡不接受大流规则 */
+} elephant = { .queue = UINT16_MAX };
 
 /*
  * 信号处理函数
@@ -71,230 +317,754 @@ static void signal_handler(int signum)
     }
 }
 
+static const char *flow_error_msg(const struct rte_flow_error *error)
+{
+    return error->message != NULL ? error->message : "(no message)";
+}
+
 /*
- * 添加 flow 到管理器
+ * 在 rte_eth_dev_start() 之前为模板 API 预留资源
+ * 不支持的 PMD 返回错误, 管理器之后走同步路径
  */
-static int add_flow_entry(struct rte_flow *flow, const char *desc)
+static int flow_mgr_configure(uint16_t port_id)
 {
-    if (num_flows >= MAX_FLOWS) {
-        printf("Flow table full\n");
-        return -1;
+    struct rte_flow_port_info port_info;
+    struct rte_flow_queue_info queue_info;
+    struct rte_flow_port_attr port_attr;
+    struct rte_flow_queue_attr queue_attr = { .size = FLOW_OP_QUEUE_SIZE };
+    const struct rte_flow_queue_attr *queue_attrs[] = { &queue_attr };
+    struct rte_flow_error error;
+    int ret;
+
+    memset(&port_info, 0, sizeof(port_info));
+    memset(&queue_info, 0, sizeof(queue_info));
+    ret = rte_flow_info_get(port_id, &port_info, &queue_info, &error);
+    if (ret != 0 || port_info.max_nb_queues == 0) {
+        printf("Flow template API not supported on port %u, using synchronous rte_flow_create\n",
+               port_id);
+        return ret != 0 ? ret : -ENOTSUP;
     }
 
-    flow_table[num_flows].flow = flow;
-    snprintf(flow_table[num_flows].description,
-             sizeof(flow_table[num_flows].description),
-             "%s", desc);
-    flow_table[num_flows].active = 1;
-    flow_table[num_flows].hits = 0;
-    flow_table[num_flows].bytes = 0;
+    memset(&port_attr, 0, sizeof(port_attr));
+    port_attr.nb_counters = port_info.max_nb_counters != 0 ?
+                            RTE_MIN(port_info.max_nb_counters, (uint32_t)MAX_FLOWS) : MAX_FLOWS;
+    if (queue_info.max_size != 0)
+        queue_attr.size = RTE_MIN(queue_info.max_size, (uint32_t)FLOW_OP_QUEUE_SIZE);
 
-    num_flows++;
+    ret = rte_flow_configure(port_id, &port_attr, 1, queue_attrs, &error);
+    if (ret != 0) {
+        printf("rte_flow_configure failed: %s, using synchronous rte_flow_create\n",
+               flow_error_msg(&error));
+        return ret;
+    }
+
+    /* 入队和收取的阈值都按实际深度算, 否则深度小的 PMD 上入队会失败 */
+    flow_mgr.queue_size = queue_attr.size;
+    flow_mgr.push_batch = RTE_MAX(RTE_MIN((uint32_t)FLOW_PUSH_BATCH, queue_attr.size / 2), 1U);
+    flow_mgr.backend = BACKEND_ASYNC;
     return 0;
 }
 
-/*
- * 创建 IPv4 规则: 匹配目的 IP,发送到指定队列
- */
-static struct rte_flow *
-create_ipv4_flow(uint16_t port_id, uint16_t queue_id,
-                 uint32_t dest_ip, const char *desc)
-{
-    struct rte_flow_attr attr;
-    struct rte_flow_item pattern[4];
-    struct rte_flow_action action[4];
-    struct rte_flow *flow = NULL;
-    struct rte_flow_error error;
-    struct rte_flow_action_queue queue_action = { .index = queue_id };
-    struct rte_flow_action_count count_action = { .id = num_flows };
-    struct rte_flow_item_ipv4 ipv4_spec;
-    struct rte_flow_item_ipv4 ipv4_mask;
+/* 各匹配方式的 mask: 模板里定义匹配哪些字段, 同步规则也用它们 */
+static const struct rte_flow_item_ipv4 ipv4_dst_mask = {
+    .hdr.dst_addr = RTE_BE32(0xFFFFFFFF),
+};
+static const struct rte_flow_item_ipv4 ipv4_src_mask = {
+    .hdr.src_addr = RTE_BE32(0xFFFFFFFF),
+};
+static const struct rte_flow_item_tcp tcp_dport_mask = {
+    .hdr.dst_port = RTE_BE16(0xFFFF),
+};
+static const struct rte_flow_item_udp udp_dport_mask = {
+    .hdr.dst_port = RTE_BE16(0xFFFF),
+};
+static const struct rte_flow_item_udp udp_sport_mask = {
+    .hdr.src_port = RTE_BE16(0xFFFF),
+};
+static const struct rte_flow_item_ipv4 ipv4_flow_mask = {
+    .hdr.src_addr = RTE_BE32(0xFFFFFFFF),
+    .hdr.dst_addr = RTE_BE32(0xFFFFFFFF),
+};
+static const struct rte_flow_item_tcp tcp_flow_mask = {
+    .hdr.src_port = RTE_BE16(0xFFFF),
+    .hdr.dst_port = RTE_BE16(0xFFFF),
+};
+static const struct rte_flow_item_udp udp_flow_mask = {
+    .hdr.src_port = RTE_BE16(0xFFFF),
+    .hdr.dst_port = RTE_BE16(0xFFFF),
+};
 
-    memset(&attr, 0, sizeof(struct rte_flow_attr));
-    memset(pattern, 0, sizeof(pattern));
-    memset(action, 0, sizeof(action));
-    memset(&ipv4_spec, 0, sizeof(struct rte_flow_item_ipv4));
-    memset(&ipv4_mask, 0, sizeof(struct rte_flow_item_ipv4));
+/* 一条规则的 pattern spec, 按匹配方式只用到其中一部分 */
+struct flow_specs {
+    struct rte_flow_item_ipv4 ipv4;
+    struct rte_flow_item_tcp tcp;
+    struct rte_flow_item_udp udp;
+};
 
-    /* 属性: ingress 方向 */
-    attr.ingress = 1;
-    attr.priority = 0;
+static void flow_fill_specs(struct flow_specs *spec, const struct flow_key *key)
+{
+    memset(spec, 0, sizeof(*spec));
+    spec->ipv4.hdr.src_addr = rte_cpu_to_be_32(key->src_ip);
+    spec->ipv4.hdr.dst_addr = rte_cpu_to_be_32(key->dst_ip);
+    spec->tcp.hdr.src_port = rte_cpu_to_be_16(key->src_port);
+    spec->tcp.hdr.dst_port = rte_cpu_to_be_16(key->dst_port);
+    spec->udp.hdr.src_port = rte_cpu_to_be_16(key->src_port);
+    spec->udp.hdr.dst_port = rte_cpu_to_be_16(key->dst_port);
+}
 
-    /* Pattern: ETH / IPv4(dest=X) / END */
+/*
+ * 按匹配方式填 pattern
+ * 模板: spec 为 NULL, 带 mask; 异步规则: 只带 spec; 同步规则: spec 和 mask 都带
+ */
+static void flow_fill_pattern(struct rte_flow_item *pattern, enum flow_match match,
+                              const struct flow_specs *spec, int with_mask)
+{
+    memset(pattern, 0, sizeof(*pattern) * 4);
     pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
+    pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+    pattern[2].type = RTE_FLOW_ITEM_TYPE_END;
+    pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
 
-    ipv4_spec.hdr.dst_addr = rte_cpu_to_be_32(dest_ip);
-    ipv4_mask.hdr.dst_addr = RTE_BE32(0xFFFFFFFF);
+    switch (match) {
+    case MATCH_IPV4_DST:
+    case MATCH_IPV4_SRC:
+        pattern[1].spec = spec != NULL ? &spec->ipv4 : NULL;
+        if (with_mask)
+            pattern[1].mask = match == MATCH_IPV4_DST ? &ipv4_dst_mask : &ipv4_src_mask;
+        break;
+    case MATCH_TCP_FLOW:
+        pattern[1].spec = spec != NULL ? &spec->ipv4 : NULL;
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
+        pattern[2].spec = spec != NULL ? &spec->tcp : NULL;
+        if (with_mask) {
+            pattern[1].mask = &ipv4_flow_mask;
+            pattern[2].mask = &tcp_flow_mask;
+        }
+        break;
+    case MATCH_UDP_FLOW:
+        pattern[1].spec = spec != NULL ? &spec->ipv4 : NULL;
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+        pattern[2].spec = spec != NULL ? &spec->udp : NULL;
+        if (with_mask) {
+            pattern[1].mask = &ipv4_flow_mask;
+            pattern[2].mask = &udp_flow_mask;
+        }
+        break;
+    case MATCH_UDP_DPORT:
+    case MATCH_UDP_SPORT:
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_UDP;
+        pattern[2].spec = spec != NULL ? &spec->udp : NULL;
+        if (with_mask)
+            pattern[2].mask = match == MATCH_UDP_DPORT ? &udp_dport_mask : &udp_sport_mask;
+        break;
+    case MATCH_TCP_DPORT:
+    default:
+        /* IPV4 不带 spec: 只要求是 IPv4, 不匹配地址 */
+        pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
+        pattern[2].spec = spec != NULL ? &spec->tcp : NULL;
+        if (with_mask)
+            pattern[2].mask = &tcp_dport_mask;
+        break;
+    }
+}
 
-    pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
-    pattern[1].spec = &ipv4_spec;
-    pattern[1].mask = &ipv4_mask;
+/*
+ * 等待一个非批量 (postpone = 0) 的异步操作完成
+ * PMD 一直不返回结果时最多等 FLOW_PULL_TIMEOUT_MS, 不让启动和退出卡住
+ */
+static int flow_pull_one(uint16_t port_id, struct rte_flow_error *error)
+{
+    uint64_t deadline = rte_rdtsc() + rte_get_tsc_hz() * FLOW_PULL_TIMEOUT_MS / 1000;
+    struct rte_flow_op_result result;
+    int n;
+
+    do {
+        n = rte_flow_pull(port_id, FLOW_OP_QUEUE, &result, 1, error);
+        if (n < 0)
+            return n;
+        if (n > 0)
+            return result.status == RTE_FLOW_OP_SUCCESS ? 0 : -EIO;
+    } while (rte_rdtsc() < deadline);
+
+    return -ETIMEDOUT;
+}
 
-    pattern[2].type = RTE_FLOW_ITEM_TYPE_END;
+/*
+ * 创建模板和模板表
+ * 规则表放在 group FLOW_RULE_GROUP: 模板表在非 0 group 才走硬件快速插入路径,
+ * group 0 只有一条把所有流量跳过去的规则
+ */
+static int flow_mgr_create_templates(uint16_t port_id)
+{
+    const struct rte_flow_pattern_template_attr pt_attr = { .relaxed_matching = 0, .ingress = 1 };
+    const struct rte_flow_actions_template_attr at_attr = { .ingress = 1 };
+    struct rte_flow_template_table_attr table_attr;
+    struct rte_flow_item pattern[4];
+    struct rte_flow_action_queue queue_mask = { .index = 0 };
+    struct rte_flow_action_mark mark_mask = { .id = 0 };
+    struct rte_flow_action_jump jump = { .group = FLOW_RULE_GROUP };
+    struct rte_flow_action actions[FATE_MAX][4] = {
+        [FATE_QUEUE] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_QUEUE },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+        [FATE_DROP] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_DROP },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+        [FATE_MARK] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_MARK },
+            { .type = RTE_FLOW_ACTION_TYPE_QUEUE },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+    };
+    /* 队列号和标记的 mask 为 0: 每条规则自己带 */
+    struct rte_flow_action masks[FATE_MAX][4] = {
+        [FATE_QUEUE] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue_mask },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+        [FATE_DROP] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_DROP },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+        [FATE_MARK] = {
+            { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+            { .type = RTE_FLOW_ACTION_TYPE_MARK, .conf = &mark_mask },
+            { .type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue_mask },
+            { .type = RTE_FLOW_ACTION_TYPE_END },
+        },
+    };
+    struct rte_flow_action jump_actions[] = {
+        { .type = RTE_FLOW_ACTION_TYPE_JUMP, .conf = &jump },
+        { .type = RTE_FLOW_ACTION_TYPE_END },
+    };
+    struct rte_flow_item jump_pattern[] = {
+        { .type = RTE_FLOW_ITEM_TYPE_ETH },
+        { .type = RTE_FLOW_ITEM_TYPE_END },
+    };
+    const struct rte_flow_op_attr op_attr = { .postpone = 0 };
+    struct rte_flow_error error;
+    int i;
+
+    memset(&error, 0, sizeof(error));
+    for (i = 0; i < MATCH_MAX; i++) {
+        flow_fill_pattern(pattern, i, NULL, 1);
+        flow_mgr.pattern_tmpl[i] = rte_flow_pattern_template_create(port_id, &pt_attr,
+                                                                   pattern, &error);
+        if (flow_mgr.pattern_tmpl[i] == NULL)
+            goto fail;
+    }
+    for (i = 0; i < FATE_MAX; i++) {
+        flow_mgr.actions_tmpl[i] = rte_flow_actions_template_create(port_id, &at_attr,
+                                                                   actions[i], masks[i], &error);
+        if (flow_mgr.actions_tmpl[i] == NULL)
+            goto fail;
+    }
 
-    /* Actions: COUNT / QUEUE / END */
-    action[0].type = RTE_FLOW_ACTION_TYPE_COUNT;
-    action[0].conf = &count_action;
+    memset(&table_attr, 0, sizeof(table_attr));
+    table_attr.flow_attr.group = FLOW_RULE_GROUP;
+    table_attr.flow_attr.priority = TABLE_FIVE_TUPLE;
+    table_attr.flow_attr.ingress = 1;
+    table_attr.nb_flows = ELEPHANT_MAX_RULES;
+    flow_mgr.tables[TABLE_FIVE_TUPLE] = rte_flow_template_table_create(port_id, &table_attr,
+            &flow_mgr.pattern_tmpl[MATCH_TCP_FLOW], MATCH_MAX - MATCH_TCP_FLOW,
+            flow_mgr.actions_tmpl, FATE_MAX, &error);
+    if (flow_mgr.tables[TABLE_FIVE_TUPLE] == NULL)
+        goto fail;
+
+    table_attr.flow_attr.priority = TABLE_BASE;
+    table_attr.nb_flows = MAX_FLOWS;
+    flow_mgr.tables[TABLE_BASE] = rte_flow_template_table_create(port_id, &table_attr,
+            flow_mgr.pattern_tmpl, MATCH_TCP_FLOW,
+            flow_mgr.actions_tmpl, FATE_MAX, &error);
+    if (flow_mgr.tables[TABLE_BASE] == NULL)
+        goto fail;
+
+    /* group 0: ETH → JUMP group 1 */
+    flow_mgr.jump_pattern = rte_flow_pattern_template_create(port_id, &pt_attr,
+                                                             jump_pattern, &error);
+    if (flow_mgr.jump_pattern == NULL)
+        goto fail;
+    flow_mgr.jump_actions = rte_flow_actions_template_create(port_id, &at_attr,
+                                                             jump_actions, jump_actions, &error);
+    if (flow_mgr.jump_actions == NULL)
+        goto fail;
+    memset(&table_attr, 0, sizeof(table_attr));
+    table_attr.flow_attr.group = 0;
+    table_attr.flow_attr.ingress = 1;
+    table_attr.nb_flows = 1;
+    flow_mgr.jump_table = rte_flow_template_table_create(port_id, &table_attr,
+                                                         &flow_mgr.jump_pattern, 1,
+                                                         &flow_mgr.jump_actions, 1, &error);
+    if (flow_mgr.jump_table == NULL)
+        goto fail;
+
+    flow_mgr.jump_flow = rte_flow_async_create(port_id, FLOW_OP_QUEUE, &op_attr,
+                                               flow_mgr.jump_table, jump_pattern, 0,
+                                               jump_actions, 0, NULL, &error);
+    if (flow_mgr.jump_flow == NULL)
+        goto fail;
+    if (flow_pull_one(port_id, &error) != 0) {
+        /* 没有确认创建成功的规则不再保留, 退出时也不再删除它 */
+        flow_mgr.jump_flow = NULL;
+        goto fail;
+    }
 
-    action[1].type = RTE_FLOW_ACTION_TYPE_QUEUE;
-    action[1].conf = &queue_action;
+    return 0;
 
-    action[2].type = RTE_FLOW_ACTION_TYPE_END;
+fail:
+    printf("Flow template setup failed: %s\n", flow_error_msg(&error));
+    return -1;
+}
 
-    /* 验证规则 */
-    int res = rte_flow_validate(port_id, &attr, pattern, action, &error);
-    if (res != 0) {
-        printf("Flow validation failed: %s\n", error.message);
-        return NULL;
+/*
+ * 用一条 ETH / IPV4(dst) → COUNT / QUEUE 规则试探网卡能否同步下发规则
+ * 示例规则都带 COUNT, 不支持计数的网卡同样交给软件引擎
+ */
+static int flow_mgr_probe_sync(uint16_t port_id)
+{
+    const struct flow_key key = { .dst_ip = RTE_IPV4(192, 0, 2, 1), .match = MATCH_IPV4_DST };
+    struct rte_flow_attr attr = { .ingress = 1 };
+    struct rte_flow_action_queue queue = { .index = 0 };
+    struct rte_flow_action actions[] = {
+        { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+        { .type = RTE_FLOW_ACTION_TYPE_QUEUE, .conf = &queue },
+        { .type = RTE_FLOW_ACTION_TYPE_END },
+    };
+    struct rte_flow_item pattern[4];
+    struct flow_specs spec;
+    struct rte_flow_error error;
+
+    flow_fill_specs(&spec, &key);
+    flow_fill_pattern(pattern, MATCH_IPV4_DST, &spec, 1);
+    if (rte_flow_validate(port_id, &attr, pattern, actions, &error) != 0) {
+        printf("rte_flow not usable on port %u: %s\n", port_id, flow_error_msg(&error));
+        return -ENOTSUP;
     }
+    return 0;
+}
 
-    /* 创建规则 */
-    flow = rte_flow_create(port_id, &attr, pattern, action, &error);
-    if (flow == NULL) {
-        printf("Flow creation failed: %s\n", error.message);
-        return NULL;
+/*
+ * 初始化规则管理器 (端口已启动)
+ */
+static int flow_mgr_init(uint16_t port_id, uint16_t nb_queues)
+{
+    struct rte_hash_parameters params = {
+        .name = "flow_mgr_index",
+        .entries = MAX_FLOWS,
+        .key_len = sizeof(struct flow_key),
+        .hash_func = rte_hash_crc,
+        .hash_func_init_val = 0,
+        .socket_id = rte_socket_id(),
+    };
+
+    flow_mgr.port_id = port_id;
+    flow_mgr.index = rte_hash_create(&params);
+    flow_mgr.rules = rte_zmalloc("flow_mgr_rules", sizeof(struct flow_entry) * MAX_FLOWS, 0);
+    if (flow_mgr.index == NULL || flow_mgr.rules == NULL)
+        return -ENOMEM;
+
+    if (flow_mgr.backend == BACKEND_ASYNC && flow_mgr_create_templates(port_id) != 0) {
+        printf("Falling back to synchronous rte_flow_create\n");
+        flow_mgr.backend = BACKEND_SYNC;
     }
+    if (flow_mgr.backend == BACKEND_SYNC &&
+        (force_sw_flow || flow_mgr_probe_sync(port_id) != 0)) {
+        int ret = sw_flow_init(port_id, nb_queues, MAX_FLOWS);
 
-    printf("✓ Created flow: %s (Queue %u)\n", desc, queue_id);
+        if (ret != 0) {
+            printf("Cannot init software flow engine: %s\n", rte_strerror(-ret));
+            return ret;
+        }
+        /* 范围规则走 ACL 层, 字段布局错了只会静默误分类, 启动时先验证一遍 */
+        if (sw_flow_selftest() != 0) {
+            printf("Software flow engine selftest failed\n");
+            sw_flow_fini();
+            return -EINVAL;
+        }
+        flow_mgr.backend = BACKEND_SW;
+    }
 
-    /* 添加到管理器 */
-    add_flow_entry(flow, desc);
+    printf("Flow manager: %s, up to %u rules\n", backend_names[flow_mgr.backend], MAX_FLOWS);
+    return 0;
+}
 
-    return flow;
+/* 释放一条规则占用的表项 */
+static void flow_mgr_release(struct flow_entry *e)
+{
+    rte_hash_del_key(flow_mgr.index, &e->key);
+    memset(e, 0, sizeof(*e));
+    flow_mgr.num_flows--;
 }
 
 /*
- * 创建 TCP 端口规则
+ * 收取已完成的异步操作, 返回收取的个数
  */
-static struct rte_flow *
-create_tcp_port_flow(uint16_t port_id, uint16_t queue_id,
-                     uint16_t tcp_port, const char *desc)
+static int flow_mgr_pull(void)
 {
-    struct rte_flow_attr attr;
-    struct rte_flow_item pattern[5];
-    struct rte_flow_action action[4];
-    struct rte_flow *flow = NULL;
+    struct rte_flow_op_result results[FLOW_PUSH_BATCH];
     struct rte_flow_error error;
-    struct rte_flow_action_queue queue_action = { .index = queue_id };
-    struct rte_flow_action_count count_action = { .id = num_flows };
-    struct rte_flow_item_tcp tcp_spec;
-    struct rte_flow_item_tcp tcp_mask;
+    int n, i;
 
-    memset(&attr, 0, sizeof(struct rte_flow_attr));
-    memset(pattern, 0, sizeof(pattern));
-    memset(action, 0, sizeof(action));
-    memset(&tcp_spec, 0, sizeof(struct rte_flow_item_tcp));
-    memset(&tcp_mask, 0, sizeof(struct rte_flow_item_tcp));
+    n = rte_flow_pull(flow_mgr.port_id, FLOW_OP_QUEUE, results, FLOW_PUSH_BATCH, &error);
+    if (n <= 0)
+        return n;
 
-    /* 属性 */
-    attr.ingress = 1;
-    attr.priority = 0;
+    for (i = 0; i < n; i++) {
+        struct flow_entry *e = results[i].user_data;
 
-    /* Pattern: ETH / IPv4 / TCP(dst_port=X) / END */
-    pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
-    pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
+        if (e->state == FLOW_CREATING) {
+            if (results[i].status == RTE_FLOW_OP_SUCCESS) {
+                e->state = FLOW_ACTIVE;
+                flow_mgr.created++;
+            } else {
+                flow_mgr.failed++;
+                flow_mgr_release(e);
+            }
+        } else if (e->state == FLOW_DESTROYING) {
+            if (results[i].status == RTE_FLOW_OP_SUCCESS) {
+                flow_mgr.destroyed++;
+                flow_mgr_release(e);
+            } else {
+                flow_mgr.failed++;
+                e->state = FLOW_ACTIVE;
+            }
+        }
+    }
+    flow_mgr.inflight -= n;
+    return n;
+}
 
-    tcp_spec.hdr.dst_port = rte_cpu_to_be_16(tcp_port);
-    tcp_mask.hdr.dst_port = RTE_BE16(0xFFFF);
+/*
+ * 收取完成的操作, 直到未完成的操作不超过 limit
+ * 每收到一批结果就重新计时, PMD 超过 FLOW_PULL_TIMEOUT_MS 没有结果时放弃
+ */
+static void flow_mgr_drain(uint32_t limit)
+{
+    uint64_t timeout = rte_get_tsc_hz() * FLOW_PULL_TIMEOUT_MS / 1000;
+    uint64_t deadline = rte_rdtsc() + timeout;
 
-    pattern[2].type = RTE_FLOW_ITEM_TYPE_TCP;
-    pattern[2].spec = &tcp_spec;
-    pattern[2].mask = &tcp_mask;
+    while (flow_mgr.inflight > limit) {
+        int n = flow_mgr_pull();
 
-    pattern[3].type = RTE_FLOW_ITEM_TYPE_END;
+        if (n < 0)
+            break;
+        if (n > 0) {
+            deadline = rte_rdtsc() + timeout;
+        } else if (rte_rdtsc() >= deadline) {
+            printf("Flow queue: %u operations not completed after %d ms\n",
+                   flow_mgr.inflight, FLOW_PULL_TIMEOUT_MS);
+            break;
+        }
+    }
+}
 
-    /* Actions: COUNT / QUEUE / END */
-    action[0].type = RTE_FLOW_ACTION_TYPE_COUNT;
-    action[0].conf = &count_action;
+/* 把已入队未 push 的操作提交给硬件 */
+static int flow_mgr_push(void)
+{
+    struct rte_flow_error error;
+    int ret;
 
-    action[1].type = RTE_FLOW_ACTION_TYPE_QUEUE;
-    action[1].conf = &queue_action;
+    if (flow_mgr.unpushed == 0)
+        return 0;
 
-    action[2].type = RTE_FLOW_ACTION_TYPE_END;
+    ret = rte_flow_push(flow_mgr.port_id, FLOW_OP_QUEUE, &error);
+    if (ret != 0) {
+        printf("rte_flow_push failed: %s\n", flow_error_msg(&error));
+        return ret;
+    }
+    flow_mgr.unpushed = 0;
+    return 0;
+}
 
-    /* 验证并创建 */
-    int res = rte_flow_validate(port_id, &attr, pattern, action, &error);
-    if (res != 0) {
-        printf("Flow validation failed: %s\n", error.message);
-        return NULL;
+/*
+ * 异步: push 已入队的操作并等待全部完成; 软件引擎: 把改动发布给数据面
+ */
+static void flow_mgr_flush(void)
+{
+    if (flow_mgr.backend == BACKEND_SW) {
+        if (sw_flow_commit() != 0)
+            printf("Software flow commit failed\n");
+        return;
     }
+    if (flow_mgr.backend != BACKEND_ASYNC)
+        return;
 
-    flow = rte_flow_create(port_id, &attr, pattern, action, &error);
-    if (flow == NULL) {
-        printf("Flow creation failed: %s\n", error.message);
-        return NULL;
+    flow_mgr_push();
+    flow_mgr_drain(0);
+}
+
+/*
+ * 入队一个操作之后调用: 攒够一批就 push, 队列快满时收取完成的操作
+ */
+static void flow_mgr_enqueued(void)
+{
+    /* 入队前未完成的操作不超过 limit, 入队后就不会超过队列深度 */
+    uint32_t limit = flow_mgr.queue_size - flow_mgr.push_batch;
+
+    flow_mgr.inflight++;
+    if (++flow_mgr.unpushed >= flow_mgr.push_batch) {
+        if (flow_mgr_push() == 0)
+            flow_mgr_pull();
     }
+    if (flow_mgr.inflight > limit) {
+        /* 未 push 的操作不会完成, 先提交再收取 */
+        flow_mgr_push();
+        flow_mgr_drain(limit);
+    }
+}
 
-    printf("✓ Created flow: %s (Queue %u)\n", desc, queue_id);
+/* 同步路径: validate + create, 与原来的逐条下发相同 */
+static struct rte_flow *flow_create_sync(const struct rte_flow_item *pattern,
+                                         const struct rte_flow_action *actions)
+{
+    struct rte_flow_attr attr;
+    struct rte_flow_error error;
+    struct rte_flow *flow;
 
-    add_flow_entry(flow, desc);
+    memset(&attr, 0, sizeof(attr));
+    attr.ingress = 1;
+    /* 不少 PMD (如 i40e) 只接受 priority 0, 同步路径不区分五元组规则的优先级 */
+    attr.priority = 0;
 
+    if (rte_flow_validate(flow_mgr.port_id, &attr, pattern, actions, &error) != 0) {
+        printf("Flow validation failed: %s\n", flow_error_msg(&error));
+        return NULL;
+    }
+
+    flow = rte_flow_create(flow_mgr.port_id, &attr, pattern, actions, &error);
+    if (flow == NULL)
+        printf("Flow creation failed: %s\n", flow_error_msg(&error));
     return flow;
 }
 
 /*
- * 创建 DROP 规则 (用于阻止特定流量)
+ * 添加一条规则, key 的 match 决定匹配方式, mark 只用于 FATE_MARK
+ * 异步模式下只是入队, 结果在 flow_mgr_flush() 之后才确定
+ * 返回规则在表中的位置, -EEXIST 规则已存在, 其他负值为错误
  */
-static struct rte_flow *
-create_drop_flow(uint16_t port_id, uint32_t src_ip, const char *desc)
+static int flow_mgr_add(const struct flow_key *key, enum flow_fate fate,
+                        uint16_t queue_id, uint32_t mark, const char *desc)
 {
-    struct rte_flow_attr attr;
+    enum flow_match match = key->match;
     struct rte_flow_item pattern[4];
-    struct rte_flow_action action[3];
-    struct rte_flow *flow = NULL;
-    struct rte_flow_error error;
-    struct rte_flow_action_count count_action = { .id = num_flows };
-    struct rte_flow_item_ipv4 ipv4_spec;
-    struct rte_flow_item_ipv4 ipv4_mask;
-
-    memset(&attr, 0, sizeof(struct rte_flow_attr));
-    memset(pattern, 0, sizeof(pattern));
-    memset(action, 0, sizeof(action));
-    memset(&ipv4_spec, 0, sizeof(struct rte_flow_item_ipv4));
-    memset(&ipv4_mask, 0, sizeof(struct rte_flow_item_ipv4));
+    struct flow_specs spec;
+    struct rte_flow_action_queue queue_action = { .index = queue_id };
+    struct rte_flow_action_mark mark_action = { .id = mark };
+    struct rte_flow_action_count count_action = { .id = 0 };
+    struct rte_flow_action actions[4];
+    struct flow_entry *e;
+    int32_t pos;
+
+    if (rte_hash_lookup(flow_mgr.index, key) >= 0)
+        return -EEXIST;
+    pos = rte_hash_add_key(flow_mgr.index, key);
+    if (pos < 0) {
+        printf("Flow table full\n");
+        return pos;
+    }
 
-    /* 属性: 高优先级 */
-    attr.ingress = 1;
-    attr.priority = 0;  /* 最高优先级 */
+    e = &flow_mgr.rules[pos];
+    memset(e, 0, sizeof(*e));
+    e->key = *key;
+    e->fate = fate;
+    e->queue = queue_id;
+    snprintf(e->description, sizeof(e->description), "%s", desc);
+    flow_mgr.num_flows++;
+
+    flow_fill_specs(&spec, key);
+    flow_fill_pattern(pattern, match, &spec, flow_mgr.backend != BACKEND_ASYNC);
+
+    memset(actions, 0, sizeof(actions));
+    actions[0].type = RTE_FLOW_ACTION_TYPE_COUNT;
+    actions[0].conf = &count_action;
+    switch (fate) {
+    case FATE_QUEUE:
+        actions[1].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+        actions[1].conf = &queue_action;
+        actions[2].type = RTE_FLOW_ACTION_TYPE_END;
+        break;
+    case FATE_MARK:
+        actions[1].type = RTE_FLOW_ACTION_TYPE_MARK;
+        actions[1].conf = &mark_action;
+        actions[2].type = RTE_FLOW_ACTION_TYPE_QUEUE;
+        actions[2].conf = &queue_action;
+        actions[3].type = RTE_FLOW_ACTION_TYPE_END;
+        break;
+    case FATE_DROP:
+    default:
+        actions[1].type = RTE_FLOW_ACTION_TYPE_DROP;
+        actions[2].type = RTE_FLOW_ACTION_TYPE_END;
+        break;
+    }
 
-    /* Pattern: ETH / IPv4(src=X) / END */
-    pattern[0].type = RTE_FLOW_ITEM_TYPE_ETH;
+    if (flow_mgr.backend == BACKEND_SW) {
+        const struct rte_flow_attr attr = { .ingress = 1 };
+        struct rte_flow_error error;
+
+        /* 与同步路径相同的 pattern / actions, flush 时才对数据面生效 */
+        e->sw_flow = sw_flow_create(&attr, pattern, actions, &error);
+        if (e->sw_flow == NULL) {
+            printf("Software flow creation failed: %s\n", flow_error_msg(&error));
+            flow_mgr.failed++;
+            flow_mgr_release(e);
+            return -EIO;
+        }
+        e->state = FLOW_ACTIVE;
+        flow_mgr.created++;
+        return pos;
+    }
 
-    ipv4_spec.hdr.src_addr = rte_cpu_to_be_32(src_ip);
-    ipv4_mask.hdr.src_addr = RTE_BE32(0xFFFFFFFF);
+    if (flow_mgr.backend == BACKEND_ASYNC) {
+        const struct rte_flow_op_attr op_attr = { .postpone = 1 };
+        struct rte_flow_error error;
+
+        /* mask 来自模板, 规则只带 spec; pattern 模板下标是在所属表内的下标 */
+        e->state = FLOW_CREATING;
+        if (match >= MATCH_TCP_FLOW)
+            e->flow = rte_flow_async_create(flow_mgr.port_id, FLOW_OP_QUEUE, &op_attr,
+                                            flow_mgr.tables[TABLE_FIVE_TUPLE], pattern,
+                                            match - MATCH_TCP_FLOW, actions, fate, e, &error);
+        else
+            e->flow = rte_flow_async_create(flow_mgr.port_id, FLOW_OP_QUEUE, &op_attr,
+                                            flow_mgr.tables[TABLE_BASE], pattern,
+                                            match, actions, fate, e, &error);
+        if (e->flow == NULL) {
+            printf("Flow enqueue failed: %s\n", flow_error_msg(&error));
+            flow_mgr.failed++;
+            flow_mgr_release(e);
+            return -EIO;
+        }
+        flow_mgr_enqueued();
+        return pos;
+    }
 
-    pattern[1].type = RTE_FLOW_ITEM_TYPE_IPV4;
-    pattern[1].spec = &ipv4_spec;
-    pattern[1].mask = &ipv4_mask;
+    e->flow = flow_create_sync(pattern, actions);
+    if (e->flow == NULL) {
+        flow_mgr.failed++;
+        flow_mgr_release(e);
+        return -EIO;
+    }
+    e->state = FLOW_ACTIVE;
+    flow_mgr.created++;
+    return pos;
+}
 
-    pattern[2].type = RTE_FLOW_ITEM_TYPE_END;
+/*
+ * 删除一条规则, 异步模式下只是入队
+ */
+static int flow_mgr_del(struct flow_entry *e)
+{
+    struct rte_flow_error error;
 
-    /* Actions: COUNT / DROP / END */
-    action[0].type = RTE_FLOW_ACTION_TYPE_COUNT;
-    action[0].conf = &count_action;
+    if (e->state == FLOW_CREATING)
+        flow_mgr_flush();
+    if (e->state != FLOW_ACTIVE)
+        return -ENOENT;
 
-    action[1].type = RTE_FLOW_ACTION_TYPE_DROP;
+    if (flow_mgr.backend == BACKEND_SW) {
+        if (sw_flow_destroy(e->sw_flow, &error) != 0) {
+            flow_mgr.failed++;
+            return -EIO;
+        }
+        flow_mgr.destroyed++;
+        flow_mgr_release(e);
+        return 0;
+    }
 
-    action[2].type = RTE_FLOW_ACTION_TYPE_END;
+    if (flow_mgr.backend == BACKEND_ASYNC) {
+        const struct rte_flow_op_attr op_attr = { .postpone = 1 };
 
-    /* 验证并创建 */
-    int res = rte_flow_validate(port_id, &attr, pattern, action, &error);
-    if (res != 0) {
-        printf("Flow validation failed: %s\n", error.message);
-        return NULL;
+        if (rte_flow_async_destroy(flow_mgr.port_id, FLOW_OP_QUEUE, &op_attr,
+                                   e->flow, e, &error) != 0) {
+            flow_mgr.failed++;
+            return -EIO;
+        }
+        e->state = FLOW_DESTROYING;
+        flow_mgr_enqueued();
+        return 0;
     }
 
-    flow = rte_flow_create(port_id, &attr, pattern, action, &error);
-    if (flow == NULL) {
-        printf("Flow creation failed: %s\n", error.message);
-        return NULL;
+    if (rte_flow_destroy(flow_mgr.port_id, e->flow, &error) != 0) {
+        printf("Failed to destroy flow %s: %s\n", e->description, flow_error_msg(&error));
+        flow_mgr.failed++;
+        return -EIO;
     }
+    flow_mgr.destroyed++;
+    flow_mgr_release(e);
+    return 0;
+}
 
-    printf("✓ Created drop flow: %s\n", desc);
+/*
+ * 创建 IPv4 规则: 匹配目的 IP,发送到指定队列
+ */
+static int create_ipv4_flow(uint16_t port_id, uint16_t queue_id,
+                            uint32_t dest_ip, const char *desc)
+{
+    struct flow_key key = { .dst_ip = dest_ip, .match = MATCH_IPV4_DST };
+    int ret = flow_mgr_add(&key, FATE_QUEUE, queue_id, 0, desc);
 
-    add_flow_entry(flow, desc);
+    RTE_SET_USED(port_id);
+    if (ret >= 0)
+        printf("✓ Created flow: %s (Queue %u)\n", desc, queue_id);
+    return ret;
+}
 
-    return flow;
+/*
+ * 创建 TCP 端口规则
+ */
+static int create_tcp_port_flow(uint16_t port_id, uint16_t queue_id,
+                                uint16_t tcp_port, const char *desc)
+{
+    struct flow_key key = { .dst_port = tcp_port, .match = MATCH_TCP_DPORT };
+    int ret = flow_mgr_add(&key, FATE_QUEUE, queue_id, 0, desc);
+
+    RTE_SET_USED(port_id);
+    if (ret >= 0)
+        printf("✓ Created flow: %s (Queue %u)\n", desc, queue_id);
+    return ret;
+}
+
+/*
+ * 创建业务规则: 匹配端口, 打上业务标记送到指定队列, worker 按标记选择流水线
+ * MATCH_UDP_SPORT 匹配源端口, 其余匹配目的端口
+ */
+static int create_service_flow(uint16_t port_id, uint16_t queue_id, enum flow_match match,
+                               uint16_t l4_port, uint32_t mark, const char *desc)
+{
+    struct flow_key key = { .match = match };
+    int ret;
+
+    if (match == MATCH_UDP_SPORT)
+        key.src_port = l4_port;
+    else
+        key.dst_port = l4_port;
+    ret = flow_mgr_add(&key, FATE_MARK, queue_id, mark, desc);
+
+    RTE_SET_USED(port_id);
+    if (ret >= 0)
+        printf("✓ Created flow: %s (Queue %u, mark 0x%X)\n", desc, queue_id, mark);
+    return ret;
+}
+
+/*
+ * 创建 DROP 规则 (用于阻止特定流量)
+ */
+static int create_drop_flow(uint16_t port_id, uint32_t src_ip, const char *desc)
+{
+    struct flow_key key = { .src_ip = src_ip, .match = MATCH_IPV4_SRC };
+    int ret = flow_mgr_add(&key, FATE_DROP, 0, 0, desc);
+
+    RTE_SET_USED(port_id);
+    if (ret >= 0)
+        printf("✓ Created drop flow: %s\n", desc);
+    return ret;
 }
 
 /*
@@ -327,70 +1097,539 @@ static int query_flow_stats(uint16_t port_id, struct rte_flow *flow,
     return 0;
 }
 
+/* 读一条规则的计数器, 软件引擎的规则读软件计数器 */
+static int flow_mgr_query(struct flow_entry *e)
+{
+    struct rte_flow_query_count count;
+    struct rte_flow_error error;
+
+    if (flow_mgr.backend != BACKEND_SW)
+        return query_flow_stats(flow_mgr.port_id, e->flow, &e->hits, &e->bytes);
+
+    memset(&count, 0, sizeof(count));
+    if (sw_flow_query(e->sw_flow, &count, &error) != 0)
+        return -1;
+    e->hits = count.hits;
+    e->bytes = count.bytes;
+    return 0;
+}
+
+/*
+ * 一遍读出所有生效规则的计数器, 结果存回规则表, 返回读成功的规则数
+ * rte_flow 只有间接动作才有异步查询, 规则里直接带的 COUNT 只能逐条同步读,
+ * 这里集中在一处读完, 打印和排序都用缓存的值
+ */
+static uint32_t flow_mgr_query_all(uint64_t *cycles)
+{
+    uint64_t start = rte_rdtsc();
+    const void *key;
+    void *data;
+    uint32_t iter = 0, nb = 0;
+    int32_t pos;
+
+    while ((pos = rte_hash_iterate(flow_mgr.index, &key, &data, &iter)) >= 0) {
+        struct flow_entry *e = &flow_mgr.rules[pos];
+
+        if (e->state == FLOW_ACTIVE && flow_mgr_query(e) == 0)
+            nb++;
+    }
+
+    if (cycles != NULL)
+        *cycles = rte_rdtsc() - start;
+    return nb;
+}
+
 /*
  * 打印所有 flow 统计
+ * 规则多时只打印前 FLOW_PRINT_LIMIT 条有命中的
  */
 static void print_flow_stats(uint16_t port_id)
 {
+    const void *key;
+    void *data;
+    uint32_t iter = 0, printed = 0, queried;
+    uint64_t cycles;
+    int32_t pos;
+
+    RTE_SET_USED(port_id);
+    queried = flow_mgr_query_all(&cycles);
+
     printf("\n=== Flow Rules Statistics ===\n");
-    printf("┌────┬─────────────────────────────────────────────┬──────────────┬──────────────┐\n");
-    printf("│ ID │ Description                                 │ Packets      │ Bytes        │\n");
-    printf("├────┼─────────────────────────────────────────────┼──────────────┼──────────────┤\n");
+    printf("┌──────┬─────────────────────────────────────────────┬──────────────┬──────────────┐\n");
+    printf("│ ID   │ Description                                 │ Packets      │ Bytes        │\n");
+    printf("├──────┼─────────────────────────────────────────────┼──────────────┼──────────────┤\n");
+
+    while ((pos = rte_hash_iterate(flow_mgr.index, &key, &data, &iter)) >= 0) {
+        const struct flow_entry *e = &flow_mgr.rules[pos];
+
+        if (e->state != FLOW_ACTIVE)
+            continue;
+        if (flow_mgr.num_flows > FLOW_PRINT_LIMIT && e->hits == 0)
+            continue;
+        if (printed++ == FLOW_PRINT_LIMIT)
+            break;
+
+        printf("│ %4d │ %-43s │ %12"PRIu64" │ %12"PRIu64" │\n",
+               pos, e->description, e->hits, e->bytes);
+    }
+
+    printf("└──────┴─────────────────────────────────────────────┴──────────────┴──────────────┘\n");
+    printf("%u rules, counters of %u read in %.1f us\n", flow_mgr.num_flows, queried,
+           (double)cycles * 1e6 / rte_get_tsc_hz());
+}
+
+/*
+ * 从包头取出五元组, 只处理 IPv4 TCP/UDP 的非分片包
+ */
+static int flow_key_from_mbuf(const struct rte_mbuf *m, struct flow_key *key)
+{
+    const struct rte_ether_hdr *eth;
+    const struct rte_ipv4_hdr *ip;
+    const rte_be16_t *ports;
+    uint32_t l3_len;
+
+    if (rte_pktmbuf_data_len(m) < sizeof(*eth) + sizeof(*ip))
+        return -1;
+    eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+    if (eth->ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4))
+        return -1;
+
+    ip = (const struct rte_ipv4_hdr *)(eth + 1);
+    if (rte_ipv4_frag_pkt_is_fragmented(ip))
+        return -1;
+    l3_len = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+    if (rte_pktmbuf_data_len(m) < sizeof(*eth) + l3_len + 2 * sizeof(*ports))
+        return -1;
+
+    memset(key, 0, sizeof(*key));
+    if (ip->next_proto_id == IPPROTO_TCP)
+        key->match = MATCH_TCP_FLOW;
+    else if (ip->next_proto_id == IPPROTO_UDP)
+        key->match = MATCH_UDP_FLOW;
+    else
+        return -1;
+
+    /* TCP 和 UDP 头的前 4 字节都是源端口和目的端口 */
+    ports = (const rte_be16_t *)((const uint8_t *)ip + l3_len);
+    key->src_ip = rte_be_to_cpu_32(ip->src_addr);
+    key->dst_ip = rte_be_to_cpu_32(ip->dst_addr);
+    key->src_port = rte_be_to_cpu_16(ports[0]);
+    key->dst_port = rte_be_to_cpu_16(ports[1]);
+    return 0;
+}
+
+/*
+ * worker: 把包计入软件流表
+ */
+static void elephant_track(struct elephant_tracker *trk, const struct rte_mbuf *m)
+{
+    struct flow_key key;
+    int32_t pos;
+
+    if (flow_key_from_mbuf(m, &key) != 0)
+        return;
+
+    pos = rte_hash_lookup(trk->index, &key);
+    if (pos < 0) {
+        pos = rte_hash_add_key(trk->index, &key);
+        if (pos < 0) {
+            trk->table_full++;
+            return;
+        }
+        memset(&trk->entries[pos], 0, sizeof(trk->entries[pos]));
+    }
+
+    trk->entries[pos].bytes += rte_pktmbuf_pkt_len(m);
+    trk->entries[pos].packets++;
+    trk->tracked++;
+}
 
-    for (uint32_t i = 0; i < num_flows; i++) {
-        if (!flow_table[i].active)
+/*
+ * worker: 每 ELEPHANT_SCAN_MS 计算一次各流速率, 超过阈值的上报给主核
+ * 一个周期没有包的流直接删除: 已卸载的流不再经过软件统计, 也在这里退出流表
+ * 上报不去重, 规则已存在时管理器返回 -EEXIST
+ */
+static void elephant_scan(struct elephant_tracker *trk, uint64_t now)
+{
+    double secs = (double)(now - trk->last_scan) / rte_get_tsc_hz();
+    const void *key;
+    void *data;
+    uint32_t iter = 0;
+    int32_t pos;
+
+    while ((pos = rte_hash_iterate(trk->index, &key, &data, &iter)) >= 0) {
+        struct track_entry *e = &trk->entries[pos];
+        struct elephant_report report;
+
+        report.key = *(const struct flow_key *)key;
+        if (e->bytes == 0) {
+            rte_hash_del_key(trk->index, &report.key);
             continue;
+        }
+
+        report.rate = (uint64_t)(e->bytes / secs);
+        if (report.rate >= elephant_rate &&
+            rte_ring_enqueue_elem(elephant.reports, &report, sizeof(report)) != 0)
+            trk->report_drops++;
+
+        e->bytes = 0;
+        e->packets = 0;
+    }
 
-        uint64_t hits = 0, bytes = 0;
-        query_flow_stats(port_id, flow_table[i].flow, &hits, &bytes);
+    trk->last_scan = now;
+    trk->next_scan = now + rte_get_tsc_hz() * ELEPHANT_SCAN_MS / 1000;
+}
 
-        flow_table[i].hits = hits;
-        flow_table[i].bytes = bytes;
+/*
+ * 创建上报队列和每个 worker 的软件流表
+ * FATE_QUEUE / FATE_MARK 时大流送到最后一个队列, 该队列的 worker 不做软件统计
+ */
+static int elephant_init(uint16_t nb_queues)
+{
+    char name[RTE_HASH_NAMESIZE];
+    unsigned int lcore_id;
+
+    elephant.reports = rte_ring_create_elem("elephant_reports", sizeof(struct elephant_report),
+                                            ELEPHANT_RING_SIZE, rte_socket_id(), RING_F_SC_DEQ);
+    if (elephant.reports == NULL)
+        return -ENOMEM;
+    if (elephant_fate != FATE_DROP)
+        elephant.queue = nb_queues - 1;
 
-        printf("│ %2u │ %-43s │ %12"PRIu64" │ %12"PRIu64" │\n",
-               i, flow_table[i].description, hits, bytes);
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        struct elephant_tracker *trk = &trackers[lcore_id];
+        struct rte_hash_parameters params = {
+            .name = name,
+            .entries = ELEPHANT_TRACK_SIZE,
+            .key_len = sizeof(struct flow_key),
+            .hash_func = rte_hash_crc,
+            .hash_func_init_val = 0,
+            .socket_id = rte_lcore_to_socket_id(lcore_id),
+        };
+
+        snprintf(name, sizeof(name), "elephant_%u", lcore_id);
+        trk->index = rte_hash_create(&params);
+        trk->entries = rte_zmalloc_socket("elephant_entries",
+                                          sizeof(struct track_entry) * ELEPHANT_TRACK_SIZE,
+                                          0, params.socket_id);
+        if (trk->index == NULL || trk->entries == NULL)
+            return -ENOMEM;
+        trk->last_scan = rte_rdtsc();
+        trk->next_scan = trk->last_scan + rte_get_tsc_hz() * ELEPHANT_SCAN_MS / 1000;
     }
 
-    printf("└────┴─────────────────────────────────────────────┴──────────────┴──────────────┘\n");
+    printf("Elephant offload: flows above %.1f Mbit/s get a %s rule",
+           elephant_rate * 8 / 1e6, fate_names[elephant_fate]);
+    if (elephant.queue != UINT16_MAX)
+        printf(" to queue %u", elephant.queue);
+    printf(", idle rules aged after %d s\n", ELEPHANT_IDLE_SEC);
+    return 0;
+}
+
+static void elephant_free(void)
+{
+    unsigned int lcore_id;
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        rte_hash_free(trackers[lcore_id].index);
+        rte_free(trackers[lcore_id].entries);
+    }
+    rte_ring_free(elephant.reports);
+}
+
+/* 按速率从高到低排序 */
+static int cmp_report_rate(const void *a, const void *b)
+{
+    const struct elephant_report *ra = a;
+    const struct elephant_report *rb = b;
+
+    return (ra->rate < rb->rate) - (ra->rate > rb->rate);
+}
+
+/*
+ * 主核: 为上报的大流下发硬件规则
+ * 一批上报按速率排序后再下发, 规则数到上限时先卸载最重的流
+ */
+static void elephant_offload(uint64_t now)
+{
+    struct elephant_report reports[ELEPHANT_REPORT_BURST];
+    char desc[48];
+    unsigned int n, i;
+
+    n = rte_ring_dequeue_burst_elem(elephant.reports, reports, sizeof(reports[0]),
+                                    RTE_DIM(reports), NULL);
+    if (n == 0)
+        return;
+    elephant.reported += n;
+    if (elephant.disabled)
+        return;
+
+    qsort(reports, n, sizeof(reports[0]), cmp_report_rate);
+    for (i = 0; i < n; i++) {
+        const struct flow_key *k = &reports[i].key;
+        int pos;
+
+        if (elephant.nb_rules >= ELEPHANT_MAX_RULES) {
+            elephant.over_budget += n - i;
+            break;
+        }
+
+        snprintf(desc, sizeof(desc), "%s %u.%u.%u.%u:%u>%u.%u.%u.%u:%u",
+                 k->match == MATCH_TCP_FLOW ? "TCP" : "UDP",
+                 k->src_ip >> 24, (k->src_ip >> 16) & 0xFF,
+                 (k->src_ip >> 8) & 0xFF, k->src_ip & 0xFF, k->src_port,
+                 k->dst_ip >> 24, (k->dst_ip >> 16) & 0xFF,
+                 (k->dst_ip >> 8) & 0xFF, k->dst_ip & 0xFF, k->dst_port);
+        pos = flow_mgr_add(k, elephant_fate, elephant.queue, ELEPHANT_MARK, desc);
+        if (pos >= 0) {
+            flow_mgr.rules[pos].elephant = 1;
+            flow_mgr.rules[pos].last_active = now;
+            elephant.nb_rules++;
+            elephant.offloaded++;
+        } else if (pos != -EEXIST) {
+            if (++elephant.failed >= ELEPHANT_MAX_FAILED && elephant.offloaded == 0) {
+                printf("Port rejects elephant flow rules, offload disabled\n");
+                elephant.disabled = 1;
+                break;
+            }
+        }
+    }
+    flow_mgr_flush();
+}
+
+/*
+ * 主核: 每秒读一遍大流规则的计数器 (硬件规则用 query_flow_stats()),
+ * 命中数 ELEPHANT_IDLE_SEC 秒不变的规则删除, 流量回到软件统计
+ * 读不到计数器的规则同样按空闲处理: 流还大的话会被重新上报
+ */
+static void elephant_age(uint64_t now)
+{
+    uint64_t idle = rte_get_tsc_hz() * ELEPHANT_IDLE_SEC;
+    const void *key;
+    void *data;
+    uint32_t iter = 0, nb = 0;
+    int32_t pos;
+
+    while ((pos = rte_hash_iterate(flow_mgr.index, &key, &data, &iter)) >= 0) {
+        struct flow_entry *e = &flow_mgr.rules[pos];
+
+        if (!e->elephant)
+            continue;
+        if (e->state == FLOW_ACTIVE) {
+            flow_mgr_query(e);
+            if (e->hits != e->last_hits) {
+                e->last_hits = e->hits;
+                e->last_active = now;
+            } else if (now - e->last_active >= idle && flow_mgr_del(e) == 0) {
+                elephant.aged++;
+                continue;
+            }
+        }
+        nb++;
+    }
+    flow_mgr_flush();
+    elephant.nb_rules = nb;
+}
+
+static void print_elephant_stats(void)
+{
+    uint64_t tracked = 0, offloaded = 0, full = 0, drops = 0;
+    unsigned int lcore_id;
+
+    if (elephant_rate == 0)
+        return;
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        tracked += trackers[lcore_id].tracked;
+        offloaded += trackers[lcore_id].offloaded;
+        full += trackers[lcore_id].table_full;
+        drops += trackers[lcore_id].report_drops;
+    }
+
+    printf("\n=== Elephant Flow Offload (> %.1f Mbit/s, %s%s) ===\n",
+           elephant_rate * 8 / 1e6, fate_names[elephant_fate],
+           elephant.disabled ? ", disabled" : "");
+    printf("Hardware: %u rules, %"PRIu64" offloaded, %"PRIu64" aged, "
+           "%"PRIu64" failed, %"PRIu64" over budget (%u)\n",
+           elephant.nb_rules, elephant.offloaded, elephant.aged,
+           elephant.failed, elephant.over_budget, ELEPHANT_MAX_RULES);
+    printf("Software: %"PRIu64" pkts tracked, %"PRIu64" marked pkts skipped, "
+           "%"PRIu64" reports, %"PRIu64" table full, %"PRIu64" report drops\n",
+           tracked, offloaded, elephant.reported, full, drops);
+}
+
+/* DNS 报文头, RFC 1035 4.1.1 */
+struct dns_hdr {
+    rte_be16_t id;
+    rte_be16_t flags;
+    rte_be16_t qdcount;
+    rte_be16_t ancount;
+    rte_be16_t nscount;
+    rte_be16_t arcount;
+} __rte_packed;
+
+#define DNS_FLAG_QR 0x8000
+#define DNS_RCODE_MASK 0x000F
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_QTYPE_A 1
+#define DNS_QTYPE_AAAA 28
+
+/*
+ * 按规则的标记选择流水线
+ * 网卡 (或软件引擎) 执行 MARK 时设置 RTE_MBUF_F_RX_FDIR_ID, 标记在 hash.fdir.hi
+ */
+static inline enum service_id service_classify(struct worker_ctx *w,
+                                               const struct rte_mbuf *m)
+{
+    if (!(m->ol_flags & RTE_MBUF_F_RX_FDIR_ID))
+        return SERVICE_DEFAULT;
+
+    switch (m->hash.fdir.hi) {
+    case SERVICE_MARK_DNS:
+        return SERVICE_DNS;
+    case SERVICE_MARK_BULK:
+        return SERVICE_BULK;
+    case ELEPHANT_MARK:
+        return SERVICE_ELEPHANT;
+    default:
+        w->unknown_marks++;
+        return SERVICE_DEFAULT;
+    }
+}
+
+/*
+ * DNS 流水线: 解析报文头和第一个问题的 QTYPE
+ * 只看第一个 mbuf 段; 问题部分的 QNAME 是报文里第一个名字, 不应出现压缩指针
+ */
+static void service_dns(struct worker_ctx *w, const struct rte_mbuf *m)
+{
+    const uint8_t *start = rte_pktmbuf_mtod(m, const uint8_t *);
+    const uint8_t *end = start + rte_pktmbuf_data_len(m);
+    const struct rte_ether_hdr *eth = (const struct rte_ether_hdr *)start;
+    const struct rte_ipv4_hdr *ip = (const struct rte_ipv4_hdr *)(eth + 1);
+    const struct dns_hdr *dns;
+    const uint8_t *p;
+    uint16_t flags, qtype;
+    uint32_t l3_len;
+
+    if ((const uint8_t *)(ip + 1) > end ||
+        eth->ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4) ||
+        ip->next_proto_id != IPPROTO_UDP || rte_ipv4_frag_pkt_is_fragmented(ip))
+        goto malformed;
+
+    l3_len = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+    dns = (const struct dns_hdr *)((const uint8_t *)ip + l3_len + sizeof(struct rte_udp_hdr));
+    if ((const uint8_t *)(dns + 1) > end)
+        goto malformed;
+
+    flags = rte_be_to_cpu_16(dns->flags);
+    if (flags & DNS_FLAG_QR) {
+        w->dns.responses++;
+        if ((flags & DNS_RCODE_MASK) == DNS_RCODE_NXDOMAIN)
+            w->dns.nxdomain++;
+    } else {
+        w->dns.queries++;
+    }
+    if (dns->qdcount == 0)
+        return;
+
+    /* QNAME: 长度前缀的标签序列, 以长度 0 结束, 标签最长 63 字节 */
+    p = (const uint8_t *)(dns + 1);
+    while (p < end && *p != 0) {
+        if (*p > 63)
+            goto malformed;
+        p += *p + 1;
+    }
+    /* 结束的 0 字节之后是 2 字节 QTYPE */
+    if (p + 3 > end)
+        goto malformed;
+
+    qtype = (uint16_t)(p[1] << 8 | p[2]);
+    if (qtype == DNS_QTYPE_A)
+        w->dns.qtype_a++;
+    else if (qtype == DNS_QTYPE_AAAA)
+        w->dns.qtype_aaaa++;
+    else
+        w->dns.qtype_other++;
+    return;
+
+malformed:
+    w->dns.malformed++;
 }
 
 /*
  * Worker 核心处理函数
+ * 每个 worker 轮询主核分配给它的队列, 统计写在自己的 worker_ctx 里
  */
 static int worker_main(void *arg)
 {
-    uint16_t port_id = *(uint16_t *)arg;
-    uint16_t queue_id = rte_lcore_id() - 1;  /* 假设 lcore 1 → queue 0 */
+    struct worker_ctx *w = arg;
     unsigned lcore_id = rte_lcore_id();
+    /* 大流专用队列上的包已经卸载过, 不再做软件统计 */
+    struct elephant_tracker *trk = elephant_rate > 0 && w->queue_id != elephant.queue ?
+                                   &trackers[lcore_id] : NULL;
 
     struct rte_mbuf *bufs[BURST_SIZE];
     uint16_t nb_rx;
 
-    printf("Worker core %u started on queue %u\n", lcore_id, queue_id);
+    printf("Worker core %u started on queue %u\n", lcore_id, w->queue_id);
+
+    /* 软件引擎的 RX 回调在本核上执行, 更新规则集时要等本核报告静止状态 */
+    if (flow_mgr.backend == BACKEND_SW)
+        sw_flow_worker_start(lcore_id);
 
     while (!force_quit) {
-        nb_rx = rte_eth_rx_burst(port_id, queue_id, bufs, BURST_SIZE);
+        if (flow_mgr.backend == BACKEND_SW)
+            sw_flow_quiescent(lcore_id);
+
+        if (trk != NULL) {
+            uint64_t now = rte_rdtsc();
+
+            if (now >= trk->next_scan)
+                elephant_scan(trk, now);
+        }
+
+        nb_rx = rte_eth_rx_burst(w->port_id, w->queue_id, bufs, BURST_SIZE);
 
         if (unlikely(nb_rx == 0))
             continue;
 
         /* 更新统计 */
-        queue_stats[queue_id].rx_packets += nb_rx;
+        w->rx_packets += nb_rx;
 
         for (uint16_t i = 0; i < nb_rx; i++) {
-            queue_stats[queue_id].rx_bytes += rte_pktmbuf_pkt_len(bufs[i]);
-
-            /* 检查是否有标记 */
-            if (bufs[i]->ol_flags & RTE_MBUF_F_RX_FDIR_ID) {
-                uint32_t mark = bufs[i]->hash.fdir.hi;
-                printf("Lcore %u: Received marked packet (mark=%u)\n",
-                       lcore_id, mark);
+            struct rte_mbuf *m = bufs[i];
+            enum service_id svc = service_classify(w, m);
+            uint32_t len = rte_pktmbuf_pkt_len(m);
+
+            w->rx_bytes += len;
+            w->service[svc].packets++;
+            w->service[svc].bytes += len;
+
+            switch (svc) {
+            case SERVICE_DNS:
+                service_dns(w, m);
+                break;
+            case SERVICE_ELEPHANT:
+                /* 已卸载的大流: 跳过软件流表 */
+                if (trk != NULL)
+                    trk->offloaded++;
+                break;
+            case SERVICE_BULK:
+                break;
+            default:
+                if (trk != NULL)
+                    elephant_track(trk, m);
+                break;
             }
 
-            rte_pktmbuf_free(bufs[i]);
+            rte_pktmbuf_free(m);
         }
     }
 
+    if (flow_mgr.backend == BACKEND_SW)
+        sw_flow_worker_stop(lcore_id);
+
     printf("Worker core %u stopped\n", lcore_id);
     return 0;
 }
@@ -400,20 +1639,72 @@ static int worker_main(void *arg)
  */
 static void print_queue_stats(void)
 {
+    unsigned int lcore_id;
+
     printf("\n=== Queue Statistics ===\n");
-    printf("┌────────┬──────────────┬──────────────┐\n");
-    printf("│ Queue  │ RX Packets   │ RX Bytes     │\n");
-    printf("├────────┼──────────────┼──────────────┤\n");
+    printf("┌────────┬────────┬──────────────┬──────────────┐\n");
+    printf("│ Queue  │ Lcore  │ RX Packets   │ RX Bytes     │\n");
+    printf("├────────┼────────┼──────────────┼──────────────┤\n");
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const struct worker_ctx *w = &workers[lcore_id];
 
-    for (int q = 0; q < 8; q++) {
-        if (queue_stats[q].rx_packets == 0)
+        if (!w->active || w->rx_packets == 0)
             continue;
 
-        printf("│ %6d │ %12"PRIu64" │ %12"PRIu64" │\n",
-               q, queue_stats[q].rx_packets, queue_stats[q].rx_bytes);
+        printf("│ %6u │ %6u │ %12"PRIu64" │ %12"PRIu64" │\n",
+               w->queue_id, lcore_id, w->rx_packets, w->rx_bytes);
     }
 
-    printf("└────────┴──────────────┴──────────────┘\n");
+    printf("└────────┴────────┴──────────────┴──────────────┘\n");
+}
+
+/*
+ * 打印各流水线的统计, 汇总所有 worker
+ */
+static void print_service_stats(void)
+{
+    struct service_stats total[SERVICE_MAX];
+    struct dns_stats dns;
+    uint64_t unknown = 0;
+    unsigned int lcore_id;
+
+    memset(total, 0, sizeof(total));
+    memset(&dns, 0, sizeof(dns));
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const struct worker_ctx *w = &workers[lcore_id];
+
+        if (!w->active)
+            continue;
+        for (int s = 0; s < SERVICE_MAX; s++) {
+            total[s].packets += w->service[s].packets;
+            total[s].bytes += w->service[s].bytes;
+        }
+        dns.queries += w->dns.queries;
+        dns.responses += w->dns.responses;
+        dns.nxdomain += w->dns.nxdomain;
+        dns.qtype_a += w->dns.qtype_a;
+        dns.qtype_aaaa += w->dns.qtype_aaaa;
+        dns.qtype_other += w->dns.qtype_other;
+        dns.malformed += w->dns.malformed;
+        unknown += w->unknown_marks;
+    }
+
+    printf("\n=== Service Pipelines ===\n");
+    printf("┌──────────┬──────────────┬──────────────┐\n");
+    printf("│ Service  │ Packets      │ Bytes        │\n");
+    printf("├──────────┼──────────────┼──────────────┤\n");
+    for (int s = 0; s < SERVICE_MAX; s++)
+        printf("│ %-8s │ %12"PRIu64" │ %12"PRIu64" │\n",
+               service_names[s], total[s].packets, total[s].bytes);
+    printf("└──────────┴──────────────┴──────────────┘\n");
+
+    printf("DNS: %"PRIu64" queries, %"PRIu64" responses (%"PRIu64" NXDOMAIN), "
+           "QTYPE A %"PRIu64" / AAAA %"PRIu64" / other %"PRIu64", %"PRIu64" malformed\n",
+           dns.queries, dns.responses, dns.nxdomain,
+           dns.qtype_a, dns.qtype_aaaa, dns.qtype_other, dns.malformed);
+    if (unknown > 0)
+        printf("Unknown marks: %"PRIu64" pkts\n", unknown);
 }
 
 /*
@@ -423,12 +1714,18 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
                      uint16_t nb_queues)
 {
     struct rte_eth_conf port_conf;
+    uint64_t rx_metadata = RTE_ETH_RX_METADATA_USER_MARK | RTE_ETH_RX_METADATA_USER_FLAG;
     int ret;
 
     memset(&port_conf, 0, sizeof(struct rte_eth_conf));
 
     printf("\n=== Initializing Port %u ===\n", port);
 
+    /* 部分 PMD 要在 configure 之前协商, MARK 的值才会送到 mbuf; 不支持协商的忽略 */
+    ret = rte_eth_rx_metadata_negotiate(port, &rx_metadata);
+    if (ret == 0 && !(rx_metadata & RTE_ETH_RX_METADATA_USER_MARK))
+        printf("Port %u does not deliver MARK to mbufs\n", port);
+
     ret = rte_eth_dev_configure(port, nb_queues, 1, &port_conf);
     if (ret != 0)
         return ret;
@@ -452,6 +1749,10 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
     if (ret < 0)
         return ret;
 
+    /* 模板 API 的资源必须在启动前预留, 失败时管理器走同步路径 */
+    if (!force_sw_flow)
+        flow_mgr_configure(port);
+
     /* 启动设备 */
     ret = rte_eth_dev_start(port);
     if (ret < 0)
@@ -467,25 +1768,156 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
 }
 
 /*
- * 清理所有 flow 规则
+ * 批量下发 DDoS 黑名单: n 条随机源 IP 的 DROP 规则, 测量下发速率
+ */
+static void install_ddos_rules(uint32_t n)
+{
+    uint64_t hz = rte_get_tsc_hz();
+    uint64_t start, created = flow_mgr.created, failed = flow_mgr.failed;
+    uint32_t i, queued = 0;
+    char desc[48];
+
+    printf("\n=== Installing %u DDoS blacklist rules ===\n", n);
+
+    start = rte_rdtsc();
+    for (i = 0; i < n && !force_quit; i++) {
+        /* 攻击源取自 100.64.0.0/10, 与示例规则不重叠 */
+        uint32_t src_ip = RTE_IPV4(100, 64, 0, 0) | (uint32_t)rte_rand_max(1U << 22);
+        struct flow_key key = { .src_ip = src_ip, .match = MATCH_IPV4_SRC };
+
+        snprintf(desc, sizeof(desc), "DDoS drop %u.%u.%u.%u",
+                 src_ip >> 24, (src_ip >> 16) & 0xFF, (src_ip >> 8) & 0xFF, src_ip & 0xFF);
+        if (flow_mgr_add(&key, FATE_DROP, 0, 0, desc) >= 0)
+            queued++;
+    }
+    flow_mgr_flush();
+
+    printf("Queued %u rules (%u duplicates skipped), created %"PRIu64", failed %"PRIu64"\n",
+           queued, i - queued, flow_mgr.created - created, flow_mgr.failed - failed);
+    if (flow_mgr.backend == BACKEND_ASYNC)
+        printf("Insertion: %.1f ms, %.0f rules/s (async, batches of %u, queue depth %u)\n",
+               (double)(rte_rdtsc() - start) * 1e3 / hz,
+               (flow_mgr.created - created) / ((double)(rte_rdtsc() - start) / hz),
+               flow_mgr.push_batch, flow_mgr.queue_size);
+    else
+        printf("Insertion: %.1f ms, %.0f rules/s (%s)\n",
+               (double)(rte_rdtsc() - start) * 1e3 / hz,
+               (flow_mgr.created - created) / ((double)(rte_rdtsc() - start) / hz),
+               backend_names[flow_mgr.backend]);
+}
+
+/*
+ * 清理所有 flow 规则: 全部入队后一次等待完成
  */
 static void cleanup_flows(uint16_t port_id)
 {
     struct rte_flow_error error;
+    uint64_t start = rte_rdtsc();
+    uint64_t destroyed = flow_mgr.destroyed;
+    const void *key;
+    void *data;
+    uint32_t iter = 0;
+    int32_t pos;
 
     printf("\nCleaning up flow rules...\n");
 
-    for (uint32_t i = 0; i < num_flows; i++) {
-        if (flow_table[i].active && flow_table[i].flow != NULL) {
-            int ret = rte_flow_destroy(port_id, flow_table[i].flow, &error);
-            if (ret != 0) {
-                printf("Failed to destroy flow %u: %s\n", i, error.message);
-            } else {
-                printf("✓ Destroyed flow %u: %s\n", i, flow_table[i].description);
+    flow_mgr_flush();
+    while ((pos = rte_hash_iterate(flow_mgr.index, &key, &data, &iter)) >= 0) {
+        struct flow_entry *e = &flow_mgr.rules[pos];
+
+        /* 删除只清空表项所在的槽, 不影响迭代位置 */
+        if (e->state == FLOW_ACTIVE)
+            flow_mgr_del(e);
+    }
+    flow_mgr_flush();
+
+    printf("✓ Destroyed %"PRIu64" flows in %.1f ms, %u left\n",
+           flow_mgr.destroyed - destroyed,
+           (double)(rte_rdtsc() - start) * 1e3 / rte_get_tsc_hz(), flow_mgr.num_flows);
+
+    if (flow_mgr.backend == BACKEND_SW)
+        sw_flow_fini();
+
+    if (flow_mgr.backend == BACKEND_ASYNC) {
+        const struct rte_flow_op_attr op_attr = { .postpone = 0 };
+
+        if (flow_mgr.jump_flow != NULL &&
+            rte_flow_async_destroy(port_id, FLOW_OP_QUEUE, &op_attr,
+                                   flow_mgr.jump_flow, NULL, &error) == 0 &&
+            flow_pull_one(port_id, &error) != 0)
+            printf("Jump flow destroy not confirmed\n");
+        flow_mgr.jump_flow = NULL;
+        if (flow_mgr.jump_table != NULL)
+            rte_flow_template_table_destroy(port_id, flow_mgr.jump_table, &error);
+        for (int i = 0; i < TABLE_MAX; i++) {
+            if (flow_mgr.tables[i] != NULL)
+                rte_flow_template_table_destroy(port_id, flow_mgr.tables[i], &error);
+        }
+        if (flow_mgr.jump_actions != NULL)
+            rte_flow_actions_template_destroy(port_id, flow_mgr.jump_actions, &error);
+        if (flow_mgr.jump_pattern != NULL)
+            rte_flow_pattern_template_destroy(port_id, flow_mgr.jump_pattern, &error);
+        for (int i = 0; i < FATE_MAX; i++) {
+            if (flow_mgr.actions_tmpl[i] != NULL)
+                rte_flow_actions_template_destroy(port_id, flow_mgr.actions_tmpl[i], &error);
+        }
+        for (int i = 0; i < MATCH_MAX; i++) {
+            if (flow_mgr.pattern_tmpl[i] != NULL)
+                rte_flow_pattern_template_destroy(port_id, flow_mgr.pattern_tmpl[i], &error);
+        }
+    }
+
+    rte_hash_free(flow_mgr.index);
+    rte_free(flow_mgr.rules);
+}
+
+static void print_usage(const char *prgname)
+{
+    printf("Usage: %s [EAL options] -- [-d N] [-e MBPS] [-o queue|mark|drop] [-S]\n", prgname);
+    printf("  -d N    : install N DDoS blacklist drop rules in batches\n");
+    printf("  -e MBPS : offload flows above MBPS Mbit/s to hardware rules\n");
+    printf("  -o ACT  : action of offloaded flows: queue (dedicated queue),\n"
+           "            mark (mark + dedicated queue, default) or drop\n");
+    printf("  -S      : run all rules in the software flow engine\n");
+}
+
+static int parse_args(int argc, char **argv)
+{
+    int opt, i;
+
+    while ((opt = getopt(argc, argv, "d:e:o:Sh")) != -1) {
+        switch (opt) {
+        case 'd':
+            ddos_rules = (uint32_t)strtoul(optarg, NULL, 0);
+            if (ddos_rules > MAX_FLOWS - 16) {
+                printf("At most %u DDoS rules\n", MAX_FLOWS - 16);
+                return -1;
             }
-            flow_table[i].active = 0;
+            break;
+        case 'e':
+            elephant_rate = (uint64_t)(strtod(optarg, NULL) * 1e6 / 8);
+            break;
+        case 'o':
+            for (i = 0; i < FATE_MAX; i++) {
+                if (strcmp(optarg, fate_names[i]) == 0)
+                    break;
+            }
+            if (i == FATE_MAX) {
+                print_usage(argv[0]);
+                return -1;
+            }
+            elephant_fate = i;
+            break;
+        case 'S':
+            force_sw_flow = 1;
+            break;
+        case 'h':
+        default:
+            print_usage(argv[0]);
+            return -1;
         }
     }
+    return 0;
 }
 
 /*
@@ -512,6 +1944,9 @@ int main(int argc, char *argv[])
     argc -= ret;
     argv += ret;
 
+    if (parse_args(argc, argv) < 0)
+        rte_exit(EXIT_FAILURE, "Invalid arguments\n");
+
     /* 打印欢迎信息 */
     printf("\n");
     printf("╔════════════════════════════════════════════════════════╗\n");
@@ -525,6 +1960,13 @@ int main(int argc, char *argv[])
 
     printf("\nUsing port: %u\n", port_id);
 
+    /* 大流送往专用队列时多开一个队列 */
+    if (elephant_rate > 0 && elephant_fate != FATE_DROP)
+        nb_queues++;
+    if (rte_lcore_count() - 1 < nb_queues)
+        printf("Warning: %u queues but only %u worker lcores, unserved queues will drop\n",
+               nb_queues, rte_lcore_count() - 1);
+
     /* 创建 mbuf pool */
     mbuf_pool = rte_pktmbuf_pool_create("MBUF_POOL", NUM_MBUFS,
                                        MBUF_CACHE_SIZE, 0,
@@ -538,6 +1980,9 @@ int main(int argc, char *argv[])
     if (ret != 0)
         rte_exit(EXIT_FAILURE, "Cannot init port %u\n", port_id);
 
+    if (flow_mgr_init(port_id, nb_queues) != 0)
+        rte_exit(EXIT_FAILURE, "Cannot init flow manager\n");
+
     /* 创建 Flow 规则 */
     printf("\n=== Creating Flow Rules ===\n");
 
@@ -556,27 +2001,67 @@ int main(int argc, char *argv[])
     /* 示例5: 阻止特定源 IP (模拟 DDoS 防护) */
     create_drop_flow(port_id, 0x0A000001, "Block IP 10.0.0.1 (attacker)");
 
-    printf("\nTotal flows created: %u\n", num_flows);
+    /* 示例6: DNS 查询和响应打标记送到队列 3, worker 走 DNS 解析流水线 */
+    create_service_flow(port_id, 3, MATCH_UDP_DPORT, DNS_PORT, SERVICE_MARK_DNS,
+                        "DNS queries (udp dst 53)");
+    create_service_flow(port_id, 3, MATCH_UDP_SPORT, DNS_PORT, SERVICE_MARK_DNS,
+                        "DNS responses (udp src 53)");
+
+    /* 示例7: rsync 大批量数据打标记送到队列 2, worker 只计数 */
+    create_service_flow(port_id, 2, MATCH_TCP_DPORT, BULK_PORT, SERVICE_MARK_BULK,
+                        "Bulk rsync (tcp 873)");
+
+    /* 异步模式下规则到这里才真正下发完成 */
+    flow_mgr_flush();
+    printf("\nTotal flows created: %u\n", flow_mgr.num_flows);
+
+    if (ddos_rules > 0)
+        install_ddos_rules(ddos_rules);
+
+    if (elephant_rate > 0 && elephant_init(nb_queues) != 0)
+        rte_exit(EXIT_FAILURE, "Cannot init elephant flow offload\n");
 
     /* 启动 worker 核心 */
     printf("\n=== Starting Workers ===\n");
+    /* 按 worker 的顺序分配队列, lcore 编号不必连续 */
     uint16_t queue = 0;
     RTE_LCORE_FOREACH_WORKER(lcore_id) {
         if (queue >= nb_queues)
             break;
-        rte_eal_remote_launch(worker_main, &port_id, lcore_id);
-        queue++;
+        workers[lcore_id].port_id = port_id;
+        workers[lcore_id].queue_id = queue++;
+        workers[lcore_id].active = 1;
+        rte_eal_remote_launch(worker_main, &workers[lcore_id], lcore_id);
     }
 
     /* 主核心监控统计 */
     printf("\n=== Monitoring (Press Ctrl+C to quit) ===\n");
 
+    uint64_t hz = rte_get_tsc_hz();
+    uint64_t next_age = rte_rdtsc() + hz;
+    uint64_t next_print = rte_rdtsc() + MONITOR_PRINT_SEC * hz;
+
     while (!force_quit) {
-        sleep(2);
+        usleep(MONITOR_POLL_US);
 
         if (force_quit)
             break;
 
+        /* 大流卸载: 每轮处理上报, 每秒老化一次 */
+        uint64_t now = rte_rdtsc();
+
+        if (elephant_rate > 0) {
+            elephant_offload(now);
+            if (now >= next_age) {
+                elephant_age(now);
+                next_age = now + hz;
+            }
+        }
+
+        if (now < next_print)
+            continue;
+        next_print = now + MONITOR_PRINT_SEC * hz;
+
         /* 清屏并打印统计 */
         printf("\033[2J\033[H");
         printf("╔════════════════════════════════════════════════════════╗\n");
@@ -585,6 +2070,10 @@ int main(int argc, char *argv[])
 
         print_flow_stats(port_id);
         print_queue_stats();
+        print_service_stats();
+        print_elephant_stats();
+        if (flow_mgr.backend == BACKEND_SW)
+            sw_flow_print_stats();
 
         printf("\nPress Ctrl+C to quit\n");
     }
@@ -597,9 +2086,15 @@ int main(int argc, char *argv[])
     printf("\n=== Final Statistics ===\n");
     print_flow_stats(port_id);
     print_queue_stats();
+    print_service_stats();
+    print_elephant_stats();
+    if (flow_mgr.backend == BACKEND_SW)
+        sw_flow_print_stats();
 
     /* 清理 flow 规则 */
     cleanup_flows(port_id);
+    if (elephant_rate > 0)
+        elephant_free();
 
     /* 停止端口 */
     printf("\nStopping port %u...\n", port_id);
@@ -0,0 +1,1242 @@
+/*
+ * 软件 rte_flow 引擎, 接口说明见 sw_flow.h
+ *
+ * 规则按匹配方式分两层:
+ * 1. 没有范围的规则按 mask 分组 (tuple space), 每组一张 rte_hash,
+ *    键是被 mask 过的五元组, 值是规则
+ * 2. 带 last 范围的规则放进一个 rte_acl 上下文
+ * 每个包对每张哈希表查一次, 再查一次 ACL, 取 priority 最小的命中规则
+ *
+ * 控制面的增删先记在各组的规则链表上, sw_flow_commit() 只重建有改动的哈希表和 ACL,
+ * 组成新的规则集原子替换, 等 RCU 宽限期结束后回收旧表和已删除的规则
+ * (与 15-acl-adv 的规则集热更新相同)
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sys/queue.h>
+#include <netinet/in.h>
+
+#include <rte_common.h>
+#include <rte_cycles.h>
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_ip.h>
+#include <rte_malloc.h>
+#include <rte_ring.h>
+#include <rte_hash.h>
+#include <rte_hash_crc.h>
+#include <rte_acl.h>
+#include <rte_rcu_qsbr.h>
+
+#include "sw_flow.h"
+
+#define SW_FLOW_MAX_QUEUES 16
+#define SW_FLOW_MAX_SUBTABLES 16     /* 不同 mask 组合的上限 */
+#define SW_FLOW_BURST 32             /* 一次分类的包数, 不超过 RTE_HASH_LOOKUP_BULK_MAX */
+#define SW_FLOW_REDIRECT_RING 1024   /* QUEUE 动作转到其他队列用的 ring */
+
+/*
+ * 分类用的五元组, 字段保持网络字节序, 可以直接与 rte_flow item 的 spec/mask 按位与
+ * 同时是 ACL 的输入, 布局与 acl_fields 对应: rte_acl 只允许第一个字段是 1 字节,
+ * 之后每个 input_index 读 4 字节, 所以 proto 放在最前, IPv4 标志单独占 4 字节
+ */
+struct sw_flow_tuple {
+    uint8_t proto;
+    uint8_t pad[3];
+    rte_be32_t ipv4;        /* RTE_BE32(1): IPv4 包; 非 IPv4 包整个五元组为 0 */
+    rte_be32_t src_ip;
+    rte_be32_t dst_ip;
+    rte_be16_t src_port;
+    rte_be16_t dst_port;
+};
+
+enum sw_flow_fate {
+    SW_FATE_PASSTHRU,       /* 没有 QUEUE/DROP: 留在收到的队列 */
+    SW_FATE_QUEUE,
+    SW_FATE_DROP,
+};
+
+/* 一条软件规则, 由 sw_flow_create() 编译 */
+struct sw_flow {
+    TAILQ_ENTRY(sw_flow) next;
+    uint64_t hits;                  /* COUNT, 多个 worker 原子累加 */
+    uint64_t bytes;
+    struct sw_flow_tuple spec;      /* 已与 mask 按位与 */
+    struct sw_flow_tuple mask;
+    struct sw_flow_tuple last;      /* 范围字段的上界, 其余字段与 spec 相同 */
+    uint32_t priority;
+    uint64_t seq;                   /* 创建顺序, 同优先级先创建的优先 */
+    int ranged;                     /* 有范围: 放进 ACL */
+    int subtable;                   /* 哈希层的组号 */
+    int dead;                       /* 已 destroy, commit 后回收 */
+    uint8_t fate;
+    uint8_t count;
+    uint8_t mark;
+    uint8_t flag;
+    uint16_t queue;
+    uint32_t mark_id;
+};
+
+TAILQ_HEAD(sw_flow_list, sw_flow);
+
+/* 发布给数据面的哈希表, 发布后只读 */
+struct sw_subtable_rt {
+    struct sw_flow_tuple mask;
+    struct rte_hash *hash;          /* 同一个键只存优先级最高的规则 */
+};
+
+/* 哈希层的一组: mask 相同的规则 */
+struct sw_subtable {
+    struct sw_flow_tuple mask;
+    struct sw_flow_list rules;
+    uint32_t nb_rules;
+    int dirty;
+    struct sw_subtable_rt *rt;      /* 已发布的表 */
+};
+
+/* ACL 层, 发布后只读 */
+struct sw_acl_rt {
+    struct rte_acl_ctx *ctx;
+    struct sw_flow **rules;         /* userdata - 1 → 规则 */
+};
+
+/* 数据面看到的规则集 */
+struct sw_ruleset {
+    uint32_t nb_subtables;
+    struct sw_subtable_rt *subtables[SW_FLOW_MAX_SUBTABLES];
+    struct sw_acl_rt *acl;
+};
+
+/* 每个 RX 队列的状态, 统计只由轮询该队列的 lcore 写 */
+struct sw_queue {
+    struct rte_ring *redirect;      /* 其他队列转来的包 */
+    const struct rte_eth_rxtx_callback *cb;
+    uint64_t classified;
+    uint64_t matched;
+    uint64_t dropped;
+    uint64_t redirected;
+    uint64_t redirect_drops;
+} __rte_cache_aligned;
+
+static struct {
+    uint16_t port_id;
+    uint16_t nb_queues;
+    uint32_t max_rules;
+    uint32_t nb_rules;
+    uint64_t seq;
+    uint32_t name_id;               /* 哈希表和 ACL 的名字不能重复 */
+    int dirty;
+    struct sw_subtable subtables[SW_FLOW_MAX_SUBTABLES];
+    struct sw_flow_list acl_rules;
+    uint32_t nb_acl_rules;
+    int acl_dirty;
+    struct sw_acl_rt *acl;          /* 已发布的 ACL */
+    struct sw_flow_list dead;       /* 已 destroy, 等宽限期结束 */
+    struct sw_ruleset *active;
+    struct rte_rcu_qsbr *qsv;
+    uint64_t commits;
+    uint64_t commit_cycles;
+    struct sw_queue queues[SW_FLOW_MAX_QUEUES];
+} sw;
+
+/* ACL 字段 */
+enum {
+    ACL_FIELD_PROTO,
+    ACL_FIELD_IPV4,
+    ACL_FIELD_SRC,
+    ACL_FIELD_DST,
+    ACL_FIELD_SPORT,
+    ACL_FIELD_DPORT,
+    ACL_NUM_FIELDS,
+};
+
+RTE_ACL_RULE_DEF(sw_flow_acl_rule, ACL_NUM_FIELDS);
+
+/*
+ * 只有第一个字段可以是 1 字节, 其余按 4 字节一组 (两个端口共用一组);
+ * 地址和端口都用 RANGE, 前缀 mask 也换算成范围
+ */
+static const struct rte_acl_field_def acl_fields[ACL_NUM_FIELDS] = {
+    {
+        .type = RTE_ACL_FIELD_TYPE_BITMASK,
+        .size = sizeof(uint8_t),
+        .field_index = ACL_FIELD_PROTO,
+        .input_index = 0,
+        .offset = offsetof(struct sw_flow_tuple, proto),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_BITMASK,
+        .size = sizeof(uint32_t),
+        .field_index = ACL_FIELD_IPV4,
+        .input_index = 1,
+        .offset = offsetof(struct sw_flow_tuple, ipv4),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_RANGE,
+        .size = sizeof(uint32_t),
+        .field_index = ACL_FIELD_SRC,
+        .input_index = 2,
+        .offset = offsetof(struct sw_flow_tuple, src_ip),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_RANGE,
+        .size = sizeof(uint32_t),
+        .field_index = ACL_FIELD_DST,
+        .input_index = 3,
+        .offset = offsetof(struct sw_flow_tuple, dst_ip),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_RANGE,
+        .size = sizeof(uint16_t),
+        .field_index = ACL_FIELD_SPORT,
+        .input_index = 4,
+        .offset = offsetof(struct sw_flow_tuple, src_port),
+    },
+    {
+        .type = RTE_ACL_FIELD_TYPE_RANGE,
+        .size = sizeof(uint16_t),
+        .field_index = ACL_FIELD_DPORT,
+        .input_index = 4,
+        .offset = offsetof(struct sw_flow_tuple, dst_port),
+    },
+};
+
+static int sw_flow_is_zero(const void *p, size_t len)
+{
+    const uint8_t *b = p;
+
+    for (size_t i = 0; i < len; i++) {
+        if (b[i] != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * 写一个字段的 spec/mask/last
+ * 按 rte_flow 的约定, last 为 0 或与 spec 相同时不构成范围
+ */
+static void sw_flow_set_field(struct sw_flow *f, size_t off, size_t len,
+                              const void *spec, const void *mask, const void *last)
+{
+    uint8_t *s = (uint8_t *)&f->spec + off;
+    uint8_t *m = (uint8_t *)&f->mask + off;
+    uint8_t *l = (uint8_t *)&f->last + off;
+    const uint8_t *sp = spec, *mp = mask, *lp = last;
+    int ranged = 0;
+    size_t i;
+
+    for (i = 0; i < len; i++) {
+        m[i] = mp[i];
+        s[i] = sp[i] & mp[i];
+    }
+    if (lp != NULL) {
+        for (i = 0; i < len; i++) {
+            l[i] = lp[i] & mp[i];
+            if (l[i] != 0)
+                ranged = 1;
+        }
+        if (ranged && memcmp(l, s, len) != 0) {
+            f->ranged = 1;
+            return;
+        }
+    }
+    memcpy(l, s, len);
+}
+
+#define SW_SET_FIELD(f, field, spec, mask, last) \
+    sw_flow_set_field(f, offsetof(struct sw_flow_tuple, field), \
+                      sizeof(((struct sw_flow_tuple *)0)->field), spec, mask, last)
+
+static void sw_flow_match_ipv4(struct sw_flow *f)
+{
+    f->mask.ipv4 = RTE_BE32(UINT32_MAX);
+    f->spec.ipv4 = RTE_BE32(1);
+    f->last.ipv4 = RTE_BE32(1);
+}
+
+static int sw_flow_parse_ipv4(struct sw_flow *f, const struct rte_flow_item *item,
+                              struct rte_flow_error *error)
+{
+    const struct rte_flow_item_ipv4 *spec = item->spec;
+    const struct rte_flow_item_ipv4 *last = item->last;
+    struct rte_flow_item_ipv4 mask, rest;
+
+    sw_flow_match_ipv4(f);
+    if (spec == NULL)
+        return 0;
+
+    mask = item->mask != NULL ? *(const struct rte_flow_item_ipv4 *)item->mask :
+                                rte_flow_item_ipv4_mask;
+    rest = mask;
+    rest.hdr.src_addr = 0;
+    rest.hdr.dst_addr = 0;
+    rest.hdr.next_proto_id = 0;
+    if (!sw_flow_is_zero(&rest, sizeof(rest)))
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM_MASK, item,
+                                  "only IPv4 addresses and protocol can be matched");
+    if (last != NULL && last->hdr.next_proto_id != 0 &&
+        last->hdr.next_proto_id != spec->hdr.next_proto_id)
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM_LAST, item,
+                                  "IPv4 protocol ranges are not supported");
+
+    SW_SET_FIELD(f, src_ip, &spec->hdr.src_addr, &mask.hdr.src_addr,
+                 last != NULL ? &last->hdr.src_addr : NULL);
+    SW_SET_FIELD(f, dst_ip, &spec->hdr.dst_addr, &mask.hdr.dst_addr,
+                 last != NULL ? &last->hdr.dst_addr : NULL);
+    SW_SET_FIELD(f, proto, &spec->hdr.next_proto_id, &mask.hdr.next_proto_id, NULL);
+    return 0;
+}
+
+/*
+ * TCP / UDP: 两种头的前 4 字节都是源端口和目的端口, 其余字段不支持匹配
+ * 没有 IPV4 item 时按 IPv4 处理, 引擎只解析 IPv4 包的端口
+ */
+static int sw_flow_parse_l4(struct sw_flow *f, const struct rte_flow_item *item,
+                            uint8_t proto, struct rte_flow_error *error)
+{
+    size_t size = proto == IPPROTO_TCP ? sizeof(struct rte_flow_item_tcp) :
+                                         sizeof(struct rte_flow_item_udp);
+    const void *default_mask = proto == IPPROTO_TCP ? (const void *)&rte_flow_item_tcp_mask :
+                                                      (const void *)&rte_flow_item_udp_mask;
+    const uint8_t *spec = item->spec;
+    const uint8_t *mask = item->mask != NULL ? item->mask : default_mask;
+    const uint8_t *last = item->last;
+    const uint8_t full = 0xFF;
+
+    if (f->mask.proto != 0 && f->spec.proto != proto)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM, item,
+                                  "L4 item conflicts with IPv4 protocol");
+    sw_flow_match_ipv4(f);
+    SW_SET_FIELD(f, proto, &proto, &full, NULL);
+    if (spec == NULL)
+        return 0;
+
+    if (!sw_flow_is_zero(mask + 2 * sizeof(rte_be16_t), size - 2 * sizeof(rte_be16_t)))
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM_MASK, item,
+                                  "only L4 ports can be matched");
+
+    SW_SET_FIELD(f, src_port, spec, mask, last);
+    SW_SET_FIELD(f, dst_port, spec + sizeof(rte_be16_t), mask + sizeof(rte_be16_t),
+                 last != NULL ? last + sizeof(rte_be16_t) : NULL);
+    return 0;
+}
+
+static int sw_flow_parse_pattern(struct sw_flow *f, const struct rte_flow_item pattern[],
+                                 struct rte_flow_error *error)
+{
+    const struct rte_flow_item *item;
+    int ret = 0;
+
+    if (pattern == NULL)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ITEM_NUM, NULL,
+                                  "NULL pattern");
+
+    for (item = pattern; item->type != RTE_FLOW_ITEM_TYPE_END && ret == 0; item++) {
+        switch (item->type) {
+        case RTE_FLOW_ITEM_TYPE_VOID:
+            break;
+        case RTE_FLOW_ITEM_TYPE_ETH:
+            /* 以太网字段不参与匹配 */
+            if (item->spec != NULL &&
+                !sw_flow_is_zero(item->mask != NULL ? item->mask : &rte_flow_item_eth_mask,
+                                 sizeof(struct rte_flow_item_eth)))
+                ret = rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM, item,
+                                         "ETH fields cannot be matched");
+            break;
+        case RTE_FLOW_ITEM_TYPE_IPV4:
+            ret = sw_flow_parse_ipv4(f, item, error);
+            break;
+        case RTE_FLOW_ITEM_TYPE_TCP:
+            ret = sw_flow_parse_l4(f, item, IPPROTO_TCP, error);
+            break;
+        case RTE_FLOW_ITEM_TYPE_UDP:
+            ret = sw_flow_parse_l4(f, item, IPPROTO_UDP, error);
+            break;
+        default:
+            ret = rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM, item,
+                                     "item not supported by software flow engine");
+            break;
+        }
+    }
+    return ret;
+}
+
+static int sw_flow_parse_actions(struct sw_flow *f, const struct rte_flow_action actions[],
+                                 struct rte_flow_error *error)
+{
+    const struct rte_flow_action *a;
+    int fates = 0;
+
+    if (actions == NULL)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION_NUM, NULL,
+                                  "NULL actions");
+
+    for (a = actions; a->type != RTE_FLOW_ACTION_TYPE_END; a++) {
+        switch (a->type) {
+        case RTE_FLOW_ACTION_TYPE_VOID:
+            break;
+        case RTE_FLOW_ACTION_TYPE_COUNT:
+            f->count = 1;
+            break;
+        case RTE_FLOW_ACTION_TYPE_FLAG:
+            f->flag = 1;
+            break;
+        case RTE_FLOW_ACTION_TYPE_MARK:
+            if (a->conf == NULL)
+                return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION_CONF, a,
+                                          "MARK without id");
+            f->mark = 1;
+            f->mark_id = ((const struct rte_flow_action_mark *)a->conf)->id;
+            break;
+        case RTE_FLOW_ACTION_TYPE_QUEUE:
+            if (a->conf == NULL ||
+                ((const struct rte_flow_action_queue *)a->conf)->index >= sw.nb_queues)
+                return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION_CONF, a,
+                                          "invalid queue index");
+            f->fate = SW_FATE_QUEUE;
+            f->queue = ((const struct rte_flow_action_queue *)a->conf)->index;
+            fates++;
+            break;
+        case RTE_FLOW_ACTION_TYPE_DROP:
+            f->fate = SW_FATE_DROP;
+            fates++;
+            break;
+        default:
+            return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, a,
+                                      "action not supported by software flow engine");
+        }
+    }
+
+    if (fates > 1)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ACTION, actions,
+                                  "more than one fate action");
+    return 0;
+}
+
+/*
+ * 字段换算成 ACL 范围 (主机字节序): 有 last 时是 [spec, last],
+ * 否则 mask 必须是前缀, 范围是 [spec, spec | ~mask]
+ */
+static int sw_flow_range32(rte_be32_t spec, rte_be32_t mask, rte_be32_t last,
+                           uint32_t *lo, uint32_t *hi)
+{
+    uint32_t s = rte_be_to_cpu_32(spec);
+    uint32_t inv = ~rte_be_to_cpu_32(mask);
+    uint32_t l = rte_be_to_cpu_32(last);
+
+    if (l != s) {
+        *lo = s;
+        *hi = l;
+        return l < s ? -1 : 0;
+    }
+    if ((inv & (inv + 1)) != 0)
+        return -1;
+    *lo = s;
+    *hi = s | inv;
+    return 0;
+}
+
+static int sw_flow_range16(rte_be16_t spec, rte_be16_t mask, rte_be16_t last,
+                           uint16_t *lo, uint16_t *hi)
+{
+    uint16_t s = rte_be_to_cpu_16(spec);
+    uint16_t inv = (uint16_t)~rte_be_to_cpu_16(mask);
+    uint16_t l = rte_be_to_cpu_16(last);
+
+    if (l != s) {
+        *lo = s;
+        *hi = l;
+        return l < s ? -1 : 0;
+    }
+    if ((inv & (uint16_t)(inv + 1)) != 0)
+        return -1;
+    *lo = s;
+    *hi = s | inv;
+    return 0;
+}
+
+/* 带范围的规则转成 ACL 规则, userdata 由调用者填 */
+static int sw_flow_acl_rule(const struct sw_flow *f, struct sw_flow_acl_rule *r)
+{
+    uint32_t lo32, hi32;
+    uint16_t lo16, hi16;
+
+    memset(r, 0, sizeof(*r));
+    r->data.category_mask = 1;
+    /* rte_flow 的 priority 越小越优先, ACL 相反 */
+    r->data.priority = RTE_ACL_MAX_PRIORITY -
+                       RTE_MIN(f->priority, (uint32_t)(RTE_ACL_MAX_PRIORITY - RTE_ACL_MIN_PRIORITY));
+
+    r->field[ACL_FIELD_PROTO].value.u8 = f->spec.proto;
+    r->field[ACL_FIELD_PROTO].mask_range.u8 = f->mask.proto;
+    /* ACL 规则的值用主机字节序 */
+    r->field[ACL_FIELD_IPV4].value.u32 = rte_be_to_cpu_32(f->spec.ipv4);
+    r->field[ACL_FIELD_IPV4].mask_range.u32 = rte_be_to_cpu_32(f->mask.ipv4);
+
+    if (sw_flow_range32(f->spec.src_ip, f->mask.src_ip, f->last.src_ip, &lo32, &hi32) != 0)
+        return -1;
+    r->field[ACL_FIELD_SRC].value.u32 = lo32;
+    r->field[ACL_FIELD_SRC].mask_range.u32 = hi32;
+    if (sw_flow_range32(f->spec.dst_ip, f->mask.dst_ip, f->last.dst_ip, &lo32, &hi32) != 0)
+        return -1;
+    r->field[ACL_FIELD_DST].value.u32 = lo32;
+    r->field[ACL_FIELD_DST].mask_range.u32 = hi32;
+    if (sw_flow_range16(f->spec.src_port, f->mask.src_port, f->last.src_port, &lo16, &hi16) != 0)
+        return -1;
+    r->field[ACL_FIELD_SPORT].value.u16 = lo16;
+    r->field[ACL_FIELD_SPORT].mask_range.u16 = hi16;
+    if (sw_flow_range16(f->spec.dst_port, f->mask.dst_port, f->last.dst_port, &lo16, &hi16) != 0)
+        return -1;
+    r->field[ACL_FIELD_DPORT].value.u16 = lo16;
+    r->field[ACL_FIELD_DPORT].mask_range.u16 = hi16;
+    return 0;
+}
+
+/* 编译 attr/pattern/actions, validate 和 create 共用 */
+static int sw_flow_compile(const struct rte_flow_attr *attr, const struct rte_flow_item pattern[],
+                           const struct rte_flow_action actions[], struct sw_flow *f,
+                           struct rte_flow_error *error)
+{
+    struct sw_flow_acl_rule acl_rule;
+    int ret;
+
+    if (attr == NULL)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_ATTR, NULL, "NULL attr");
+    if (!attr->ingress || attr->egress || attr->transfer)
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ATTR, attr,
+                                  "only ingress rules are supported");
+    if (attr->group != 0)
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ATTR_GROUP, attr,
+                                  "groups are not supported");
+
+    memset(f, 0, sizeof(*f));
+    f->priority = attr->priority;
+
+    ret = sw_flow_parse_pattern(f, pattern, error);
+    if (ret == 0)
+        ret = sw_flow_parse_actions(f, actions, error);
+    if (ret == 0 && f->ranged && sw_flow_acl_rule(f, &acl_rule) != 0)
+        ret = rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ITEM, NULL,
+                                 "ranges need prefix masks and last >= spec");
+    return ret;
+}
+
+int sw_flow_validate(const struct rte_flow_attr *attr, const struct rte_flow_item pattern[],
+                     const struct rte_flow_action actions[], struct rte_flow_error *error)
+{
+    struct sw_flow f;
+
+    return sw_flow_compile(attr, pattern, actions, &f, error);
+}
+
+/* 找 mask 相同的组, 没有就占一个空组 */
+static struct sw_subtable *sw_subtable_get(const struct sw_flow_tuple *mask)
+{
+    struct sw_subtable *free_st = NULL;
+
+    for (int i = 0; i < SW_FLOW_MAX_SUBTABLES; i++) {
+        struct sw_subtable *st = &sw.subtables[i];
+
+        if (st->nb_rules == 0 && st->rt == NULL) {
+            if (free_st == NULL)
+                free_st = st;
+            continue;
+        }
+        if (memcmp(&st->mask, mask, sizeof(*mask)) == 0)
+            return st;
+    }
+
+    if (free_st != NULL)
+        free_st->mask = *mask;
+    return free_st;
+}
+
+struct sw_flow *sw_flow_create(const struct rte_flow_attr *attr,
+                               const struct rte_flow_item pattern[],
+                               const struct rte_flow_action actions[],
+                               struct rte_flow_error *error)
+{
+    struct sw_subtable *st;
+    struct sw_flow *f;
+
+    if (sw.nb_rules >= sw.max_rules) {
+        rte_flow_error_set(error, ENOSPC, RTE_FLOW_ERROR_TYPE_HANDLE, NULL,
+                           "software flow table full");
+        return NULL;
+    }
+
+    f = rte_zmalloc("sw_flow", sizeof(*f), RTE_CACHE_LINE_SIZE);
+    if (f == NULL) {
+        rte_flow_error_set(error, ENOMEM, RTE_FLOW_ERROR_TYPE_HANDLE, NULL, "out of memory");
+        return NULL;
+    }
+    if (sw_flow_compile(attr, pattern, actions, f, error) != 0) {
+        rte_free(f);
+        return NULL;
+    }
+
+    if (f->ranged) {
+        TAILQ_INSERT_TAIL(&sw.acl_rules, f, next);
+        sw.nb_acl_rules++;
+        sw.acl_dirty = 1;
+    } else {
+        st = sw_subtable_get(&f->mask);
+        if (st == NULL) {
+            rte_flow_error_set(error, ENOSPC, RTE_FLOW_ERROR_TYPE_ITEM_MASK, NULL,
+                               "too many distinct masks");
+            rte_free(f);
+            return NULL;
+        }
+        f->subtable = st - sw.subtables;
+        TAILQ_INSERT_TAIL(&st->rules, f, next);
+        st->nb_rules++;
+        st->dirty = 1;
+    }
+
+    f->seq = sw.seq++;
+    sw.nb_rules++;
+    sw.dirty = 1;
+    return f;
+}
+
+int sw_flow_destroy(struct sw_flow *f, struct rte_flow_error *error)
+{
+    if (f == NULL || f->dead)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_HANDLE, NULL,
+                                  "invalid flow handle");
+
+    if (f->ranged) {
+        TAILQ_REMOVE(&sw.acl_rules, f, next);
+        sw.nb_acl_rules--;
+        sw.acl_dirty = 1;
+    } else {
+        struct sw_subtable *st = &sw.subtables[f->subtable];
+
+        TAILQ_REMOVE(&st->rules, f, next);
+        st->nb_rules--;
+        st->dirty = 1;
+    }
+
+    /* 已发布的规则集可能还引用它, commit 的宽限期之后再释放 */
+    f->dead = 1;
+    TAILQ_INSERT_TAIL(&sw.dead, f, next);
+    sw.nb_rules--;
+    sw.dirty = 1;
+    return 0;
+}
+
+int sw_flow_query(struct sw_flow *f, struct rte_flow_query_count *count,
+                  struct rte_flow_error *error)
+{
+    if (f == NULL || f->dead)
+        return rte_flow_error_set(error, EINVAL, RTE_FLOW_ERROR_TYPE_HANDLE, NULL,
+                                  "invalid flow handle");
+    if (!f->count)
+        return rte_flow_error_set(error, ENOTSUP, RTE_FLOW_ERROR_TYPE_ACTION, NULL,
+                                  "flow has no COUNT action");
+
+    count->hits = __atomic_load_n(&f->hits, __ATOMIC_RELAXED);
+    count->bytes = __atomic_load_n(&f->bytes, __ATOMIC_RELAXED);
+    count->hits_set = 1;
+    count->bytes_set = 1;
+    if (count->reset) {
+        __atomic_fetch_sub(&f->hits, count->hits, __ATOMIC_RELAXED);
+        __atomic_fetch_sub(&f->bytes, count->bytes, __ATOMIC_RELAXED);
+    }
+    return 0;
+}
+
+static int sw_flow_better(const struct sw_flow *a, const struct sw_flow *b)
+{
+    return b == NULL || a->priority < b->priority ||
+           (a->priority == b->priority && a->seq < b->seq);
+}
+
+static struct sw_subtable_rt *sw_subtable_build(const struct sw_subtable *st)
+{
+    char name[RTE_HASH_NAMESIZE];
+    struct rte_hash_parameters params = {
+        .name = name,
+        /* 留一倍余量, cuckoo 哈希接近满时插入可能失败 */
+        .entries = RTE_MAX(st->nb_rules * 2, 64U),
+        .key_len = sizeof(struct sw_flow_tuple),
+        .hash_func = rte_hash_crc,
+        .hash_func_init_val = 0,
+        .socket_id = rte_eth_dev_socket_id(sw.port_id),
+    };
+    struct sw_subtable_rt *rt;
+    struct sw_flow *f;
+    void *data;
+
+    rt = rte_zmalloc("sw_subtable_rt", sizeof(*rt), 0);
+    if (rt == NULL)
+        return NULL;
+    snprintf(name, sizeof(name), "sw_flow_%u", sw.name_id++);
+    rt->mask = st->mask;
+    rt->hash = rte_hash_create(&params);
+    if (rt->hash == NULL)
+        goto fail;
+
+    TAILQ_FOREACH(f, &st->rules, next) {
+        /* 匹配相同的规则只留优先级最高的 */
+        if (rte_hash_lookup_data(rt->hash, &f->spec, &data) >= 0 && !sw_flow_better(f, data))
+            continue;
+        if (rte_hash_add_key_data(rt->hash, &f->spec, f) < 0)
+            goto fail;
+    }
+    return rt;
+
+fail:
+    rte_hash_free(rt->hash);
+    rte_free(rt);
+    return NULL;
+}
+
+static void sw_subtable_rt_free(struct sw_subtable_rt *rt)
+{
+    if (rt == NULL)
+        return;
+    rte_hash_free(rt->hash);
+    rte_free(rt);
+}
+
+static void sw_acl_rt_free(struct sw_acl_rt *rt)
+{
+    if (rt == NULL)
+        return;
+    rte_acl_free(rt->ctx);
+    rte_free(rt->rules);
+    rte_free(rt);
+}
+
+static struct sw_acl_rt *sw_acl_build(void)
+{
+    char name[RTE_ACL_NAMESIZE];
+    struct rte_acl_param param = {
+        .name = name,
+        .socket_id = rte_eth_dev_socket_id(sw.port_id),
+        .rule_size = RTE_ACL_RULE_SZ(ACL_NUM_FIELDS),
+        .max_rule_num = sw.nb_acl_rules,
+    };
+    struct rte_acl_config cfg;
+    struct sw_flow_acl_rule r;
+    struct sw_acl_rt *rt;
+    struct sw_flow *f;
+    uint32_t i = 0;
+
+    rt = rte_zmalloc("sw_acl_rt", sizeof(*rt), 0);
+    if (rt == NULL)
+        return NULL;
+    snprintf(name, sizeof(name), "sw_flow_acl_%u", sw.name_id++);
+    rt->rules = rte_malloc("sw_acl_rules", sizeof(*rt->rules) * sw.nb_acl_rules, 0);
+    rt->ctx = rte_acl_create(&param);
+    if (rt->rules == NULL || rt->ctx == NULL)
+        goto fail;
+
+    TAILQ_FOREACH(f, &sw.acl_rules, next) {
+        /* 创建时已经检查过, 这里不会失败 */
+        sw_flow_acl_rule(f, &r);
+        r.data.userdata = i + 1;
+        rt->rules[i++] = f;
+        if (rte_acl_add_rules(rt->ctx, (const struct rte_acl_rule *)&r, 1) != 0)
+            goto fail;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.num_categories = 1;
+    cfg.num_fields = ACL_NUM_FIELDS;
+    memcpy(cfg.defs, acl_fields, sizeof(acl_fields));
+    if (rte_acl_build(rt->ctx, &cfg) != 0)
+        goto fail;
+    return rt;
+
+fail:
+    sw_acl_rt_free(rt);
+    return NULL;
+}
+
+/*
+ * 发布改动
+ * 1. 为有改动的组重建哈希表, ACL 规则有改动时重建 ACL (数据面不受影响)
+ * 2. 组成新规则集, release 语义替换 sw.active
+ * 3. rte_rcu_qsbr_synchronize() 等所有 worker 报告静止状态
+ * 4. 回收旧规则集、被替换的表和已删除的规则
+ */
+int sw_flow_commit(void)
+{
+    struct sw_subtable_rt *built[SW_FLOW_MAX_SUBTABLES] = { NULL };
+    struct sw_subtable_rt *retired[SW_FLOW_MAX_SUBTABLES];
+    struct sw_acl_rt *acl = sw.acl, *old_acl = NULL;
+    struct sw_ruleset *next, *old;
+    uint64_t start = rte_rdtsc();
+    uint32_t nb_retired = 0;
+    struct sw_flow *f;
+    int i;
+
+    if (!sw.dirty)
+        return 0;
+
+    next = rte_zmalloc("sw_ruleset", sizeof(*next), 0);
+    if (next == NULL)
+        return -ENOMEM;
+
+    /* 先建好所有新表, 失败时已发布的规则集不受影响 */
+    for (i = 0; i < SW_FLOW_MAX_SUBTABLES; i++) {
+        const struct sw_subtable *st = &sw.subtables[i];
+
+        if (!st->dirty || st->nb_rules == 0)
+            continue;
+        built[i] = sw_subtable_build(st);
+        if (built[i] == NULL)
+            goto fail;
+    }
+    if (sw.acl_dirty) {
+        acl = NULL;
+        if (sw.nb_acl_rules > 0) {
+            acl = sw_acl_build();
+            if (acl == NULL)
+                goto fail;
+        }
+    }
+
+    for (i = 0; i < SW_FLOW_MAX_SUBTABLES; i++) {
+        struct sw_subtable *st = &sw.subtables[i];
+
+        if (st->dirty) {
+            if (st->rt != NULL)
+                retired[nb_retired++] = st->rt;
+            st->rt = built[i];
+            st->dirty = 0;
+        }
+        if (st->rt != NULL)
+            next->subtables[next->nb_subtables++] = st->rt;
+    }
+    if (sw.acl_dirty) {
+        old_acl = sw.acl;
+        sw.acl = acl;
+        sw.acl_dirty = 0;
+    }
+    next->acl = sw.acl;
+
+    old = sw.active;
+    __atomic_store_n(&sw.active, next, __ATOMIC_RELEASE);
+    rte_rcu_qsbr_synchronize(sw.qsv, RTE_QSBR_THRID_INVALID);
+
+    /* 没有 worker 还持有旧规则集 */
+    rte_free(old);
+    for (uint32_t k = 0; k < nb_retired; k++)
+        sw_subtable_rt_free(retired[k]);
+    sw_acl_rt_free(old_acl);
+    while ((f = TAILQ_FIRST(&sw.dead)) != NULL) {
+        TAILQ_REMOVE(&sw.dead, f, next);
+        rte_free(f);
+    }
+
+    sw.dirty = 0;
+    sw.commits++;
+    sw.commit_cycles += rte_rdtsc() - start;
+    return 0;
+
+fail:
+    for (i = 0; i < SW_FLOW_MAX_SUBTABLES; i++)
+        sw_subtable_rt_free(built[i]);
+    if (acl != sw.acl)
+        sw_acl_rt_free(acl);
+    rte_free(next);
+    return -ENOMEM;
+}
+
+/* 取出五元组; 非 IPv4 包全 0, 分片包只有首片带端口 */
+static void sw_flow_parse_mbuf(const struct rte_mbuf *m, struct sw_flow_tuple *t)
+{
+    const struct rte_ether_hdr *eth;
+    const struct rte_ipv4_hdr *ip;
+    const rte_be16_t *ports;
+    uint32_t l3_len;
+
+    memset(t, 0, sizeof(*t));
+    if (rte_pktmbuf_data_len(m) < sizeof(*eth) + sizeof(*ip))
+        return;
+    eth = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+    if (eth->ether_type != RTE_BE16(RTE_ETHER_TYPE_IPV4))
+        return;
+
+    ip = (const struct rte_ipv4_hdr *)(eth + 1);
+    t->ipv4 = RTE_BE32(1);
+    t->proto = ip->next_proto_id;
+    t->src_ip = ip->src_addr;
+    t->dst_ip = ip->dst_addr;
+
+    if (t->proto != IPPROTO_TCP && t->proto != IPPROTO_UDP)
+        return;
+    if ((ip->fragment_offset & RTE_BE16(RTE_IPV4_HDR_OFFSET_MASK)) != 0)
+        return;
+    l3_len = (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) * RTE_IPV4_IHL_MULTIPLIER;
+    if (rte_pktmbuf_data_len(m) < sizeof(*eth) + l3_len + 2 * sizeof(*ports))
+        return;
+
+    ports = (const rte_be16_t *)((const uint8_t *)ip + l3_len);
+    t->src_port = ports[0];
+    t->dst_port = ports[1];
+}
+
+static inline void sw_flow_tuple_mask(struct sw_flow_tuple *dst, const struct sw_flow_tuple *t,
+                                      const struct sw_flow_tuple *m)
+{
+    dst->proto = t->proto & m->proto;
+    memset(dst->pad, 0, sizeof(dst->pad));
+    dst->ipv4 = t->ipv4 & m->ipv4;
+    dst->src_ip = t->src_ip & m->src_ip;
+    dst->dst_ip = t->dst_ip & m->dst_ip;
+    dst->src_port = t->src_port & m->src_port;
+    dst->dst_port = t->dst_port & m->dst_port;
+}
+
+/* 对 n 个五元组找优先级最高的命中规则, 没有命中为 NULL */
+static void sw_flow_classify(const struct sw_ruleset *rs, const struct sw_flow_tuple *tuples,
+                             uint16_t n, struct sw_flow **match)
+{
+    struct sw_flow_tuple keys[SW_FLOW_BURST];
+    const void *key_ptrs[SW_FLOW_BURST];
+    const uint8_t *acl_data[SW_FLOW_BURST];
+    uint32_t results[SW_FLOW_BURST];
+    void *data[SW_FLOW_BURST];
+    uint64_t hits;
+    uint16_t j;
+
+    for (j = 0; j < n; j++) {
+        match[j] = NULL;
+        key_ptrs[j] = &keys[j];
+    }
+
+    /* 哈希层: 每张表按自己的 mask 屏蔽五元组后批量查找 */
+    for (uint32_t s = 0; s < rs->nb_subtables; s++) {
+        const struct sw_subtable_rt *rt = rs->subtables[s];
+
+        for (j = 0; j < n; j++)
+            sw_flow_tuple_mask(&keys[j], &tuples[j], &rt->mask);
+        if (rte_hash_lookup_bulk_data(rt->hash, key_ptrs, n, &hits, data) <= 0)
+            continue;
+        for (j = 0; j < n; j++) {
+            if ((hits & (1ULL << j)) && sw_flow_better(data[j], match[j]))
+                match[j] = data[j];
+        }
+    }
+
+    /* ACL 层: 带范围的规则 */
+    if (rs->acl != NULL) {
+        for (j = 0; j < n; j++)
+            acl_data[j] = (const uint8_t *)&tuples[j];
+        rte_acl_classify(rs->acl->ctx, acl_data, results, n, 1);
+        for (j = 0; j < n; j++) {
+            if (results[j] != 0 && sw_flow_better(rs->acl->rules[results[j] - 1], match[j]))
+                match[j] = rs->acl->rules[results[j] - 1];
+        }
+    }
+}
+
+/* 执行命中规则的动作, 返回 1 表示包留在本队列 */
+static int sw_flow_apply(struct sw_queue *q, uint16_t queue_id, struct sw_flow *f,
+                         struct rte_mbuf *m)
+{
+    if (f == NULL)
+        return 1;
+
+    q->matched++;
+    if (f->count) {
+        __atomic_fetch_add(&f->hits, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&f->bytes, rte_pktmbuf_pkt_len(m), __ATOMIC_RELAXED);
+    }
+    if (f->flag)
+        m->ol_flags |= RTE_MBUF_F_RX_FDIR;
+    if (f->mark) {
+        m->hash.fdir.hi = f->mark_id;
+        m->ol_flags |= RTE_MBUF_F_RX_FDIR | RTE_MBUF_F_RX_FDIR_ID;
+    }
+
+    switch (f->fate) {
+    case SW_FATE_DROP:
+        rte_pktmbuf_free(m);
+        q->dropped++;
+        return 0;
+    case SW_FATE_QUEUE:
+        if (f->queue == queue_id)
+            return 1;
+        if (rte_ring_mp_enqueue(sw.queues[f->queue].redirect, m) != 0) {
+            rte_pktmbuf_free(m);
+            q->redirect_drops++;
+        } else {
+            q->redirected++;
+        }
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+/*
+ * RX 回调: 在 rte_eth_rx_burst() 返回前对收到的包分类并执行动作
+ * DROP 的包释放掉, QUEUE 到其他队列的包放进目标队列的 ring,
+ * 最后把其他队列转来的包追加到本次返回的数组里
+ */
+static uint16_t sw_flow_rx_callback(uint16_t port_id, uint16_t queue_id,
+                                    struct rte_mbuf *pkts[], uint16_t nb_pkts,
+                                    uint16_t max_pkts, void *user_param)
+{
+    struct sw_queue *q = user_param;
+    const struct sw_ruleset *rs = __atomic_load_n(&sw.active, __ATOMIC_ACQUIRE);
+    struct sw_flow_tuple tuples[SW_FLOW_BURST];
+    struct sw_flow *match[SW_FLOW_BURST];
+    uint16_t i, j, n, kept = 0;
+
+    RTE_SET_USED(port_id);
+
+    if (rs == NULL) {
+        kept = nb_pkts;
+    } else {
+        for (i = 0; i < nb_pkts; i += n) {
+            n = RTE_MIN(nb_pkts - i, SW_FLOW_BURST);
+            for (j = 0; j < n; j++)
+                sw_flow_parse_mbuf(pkts[i + j], &tuples[j]);
+            sw_flow_classify(rs, tuples, n, match);
+            /* kept 不超过 i + j, 原地压缩不会覆盖未处理的包 */
+            for (j = 0; j < n; j++) {
+                if (sw_flow_apply(q, queue_id, match[j], pkts[i + j]))
+                    pkts[kept++] = pkts[i + j];
+            }
+        }
+        q->classified += nb_pkts;
+    }
+
+    /* 其他队列按 QUEUE 规则转来的包已经分类过 */
+    if (kept < max_pkts)
+        kept += rte_ring_sc_dequeue_burst(q->redirect, (void **)&pkts[kept],
+                                          max_pkts - kept, NULL);
+    return kept;
+}
+
+int sw_flow_init(uint16_t port_id, uint16_t nb_queues, uint32_t max_rules)
+{
+    char name[RTE_RING_NAMESIZE];
+    size_t sz;
+    int ret = -ENOMEM;
+
+    if (nb_queues > SW_FLOW_MAX_QUEUES)
+        return -EINVAL;
+
+    sw.port_id = port_id;
+    sw.nb_queues = nb_queues;
+    sw.max_rules = max_rules;
+    for (int i = 0; i < SW_FLOW_MAX_SUBTABLES; i++)
+        TAILQ_INIT(&sw.subtables[i].rules);
+    TAILQ_INIT(&sw.acl_rules);
+    TAILQ_INIT(&sw.dead);
+
+    sz = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+    sw.qsv = rte_zmalloc("sw_flow_qsv", sz, RTE_CACHE_LINE_SIZE);
+    if (sw.qsv == NULL || rte_rcu_qsbr_init(sw.qsv, RTE_MAX_LCORE) != 0)
+        goto fail;
+
+    for (uint16_t q = 0; q < nb_queues; q++) {
+        snprintf(name, sizeof(name), "sw_flow_q%u", q);
+        sw.queues[q].redirect = rte_ring_create(name, SW_FLOW_REDIRECT_RING,
+                                                rte_eth_dev_socket_id(port_id), RING_F_SC_DEQ);
+        if (sw.queues[q].redirect == NULL)
+            goto fail;
+
+        sw.queues[q].cb = rte_eth_add_rx_callback(port_id, q, sw_flow_rx_callback,
+                                                  &sw.queues[q]);
+        if (sw.queues[q].cb == NULL) {
+            ret = -rte_errno;
+            goto fail;
+        }
+    }
+    return 0;
+
+fail:
+    /* 已注册的回调和 ring 都撤掉, 调用者可以当作引擎从未启用 */
+    sw_flow_fini();
+    return ret;
+}
+
+void sw_flow_fini(void)
+{
+    struct rte_mbuf *m;
+    struct sw_flow *f;
+
+    for (uint16_t q = 0; q < sw.nb_queues; q++) {
+        struct sw_queue *sq = &sw.queues[q];
+
+        /* worker 已停止, 回调不会再被调用, 可以直接释放 */
+        if (sq->cb != NULL &&
+            rte_eth_remove_rx_callback(sw.port_id, q, sq->cb) == 0)
+            rte_free((void *)(uintptr_t)sq->cb);
+        sq->cb = NULL;
+        if (sq->redirect != NULL) {
+            while (rte_ring_sc_dequeue(sq->redirect, (void **)&m) == 0)
+                rte_pktmbuf_free(m);
+            rte_ring_free(sq->redirect);
+            sq->redirect = NULL;
+        }
+    }
+    sw.nb_queues = 0;
+
+    rte_free(sw.active);
+    sw.active = NULL;
+    for (int i = 0; i < SW_FLOW_MAX_SUBTABLES; i++) {
+        struct sw_subtable *st = &sw.subtables[i];
+
+        sw_subtable_rt_free(st->rt);
+        st->rt = NULL;
+        while ((f = TAILQ_FIRST(&st->rules)) != NULL) {
+            TAILQ_REMOVE(&st->rules, f, next);
+            rte_free(f);
+        }
+        st->nb_rules = 0;
+    }
+    sw_acl_rt_free(sw.acl);
+    sw.acl = NULL;
+    while ((f = TAILQ_FIRST(&sw.acl_rules)) != NULL) {
+        TAILQ_REMOVE(&sw.acl_rules, f, next);
+        rte_free(f);
+    }
+    while ((f = TAILQ_FIRST(&sw.dead)) != NULL) {
+        TAILQ_REMOVE(&sw.dead, f, next);
+        rte_free(f);
+    }
+    sw.nb_rules = 0;
+    sw.nb_acl_rules = 0;
+
+    rte_free(sw.qsv);
+    sw.qsv = NULL;
+}
+
+void sw_flow_worker_start(unsigned int lcore_id)
+{
+    rte_rcu_qsbr_thread_register(sw.qsv, lcore_id);
+    rte_rcu_qsbr_thread_online(sw.qsv, lcore_id);
+}
+
+void sw_flow_quiescent(unsigned int lcore_id)
+{
+    rte_rcu_qsbr_quiescent(sw.qsv, lcore_id);
+}
+
+void sw_flow_worker_stop(unsigned int lcore_id)
+{
+    rte_rcu_qsbr_thread_offline(sw.qsv, lcore_id);
+    rte_rcu_qsbr_thread_unregister(sw.qsv, lcore_id);
+}
+
+/* 自检用的五元组, 主机字节序参数 */
+static void sw_flow_test_tuple(struct sw_flow_tuple *t, uint8_t proto, uint32_t src_ip,
+                               uint16_t dst_port)
+{
+    memset(t, 0, sizeof(*t));
+    t->proto = proto;
+    t->ipv4 = RTE_BE32(1);
+    t->src_ip = rte_cpu_to_be_32(src_ip);
+    t->dst_ip = RTE_BE32(RTE_IPV4(192, 0, 2, 1));
+    t->src_port = RTE_BE16(40000);
+    t->dst_port = rte_cpu_to_be_16(dst_port);
+}
+
+/*
+ * 自检: 下发一条 IPV4(src 10.0.0.0/8) / UDP(dst 1000-2000) 的范围规则 (走 ACL 层),
+ * 范围内的包必须命中, 协议、源地址、端口只差一点的包都不能命中
+ * 在 worker 启动前调用, 规则集为空时使用
+ */
+int sw_flow_selftest(void)
+{
+    const struct rte_flow_attr attr = { .ingress = 1 };
+    const struct rte_flow_item_ipv4 ip_spec = { .hdr.src_addr = RTE_BE32(RTE_IPV4(10, 0, 0, 0)) };
+    const struct rte_flow_item_ipv4 ip_mask = { .hdr.src_addr = RTE_BE32(0xFF000000) };
+    const struct rte_flow_item_udp udp_spec = { .hdr.dst_port = RTE_BE16(1000) };
+    const struct rte_flow_item_udp udp_last = { .hdr.dst_port = RTE_BE16(2000) };
+    const struct rte_flow_item_udp udp_mask = { .hdr.dst_port = RTE_BE16(0xFFFF) };
+    const struct rte_flow_item pattern[] = {
+        { .type = RTE_FLOW_ITEM_TYPE_ETH },
+        { .type = RTE_FLOW_ITEM_TYPE_IPV4, .spec = &ip_spec, .mask = &ip_mask },
+        { .type = RTE_FLOW_ITEM_TYPE_UDP, .spec = &udp_spec, .last = &udp_last,
+          .mask = &udp_mask },
+        { .type = RTE_FLOW_ITEM_TYPE_END },
+    };
+    const struct rte_flow_action actions[] = {
+        { .type = RTE_FLOW_ACTION_TYPE_COUNT },
+        { .type = RTE_FLOW_ACTION_TYPE_END },
+    };
+    static const struct {
+        uint8_t proto;
+        uint32_t src_ip;
+        uint16_t dst_port;
+        int hit;
+    } cases[] = {
+        { IPPROTO_UDP, RTE_IPV4(10, 1, 2, 3), 1000, 1 },
+        { IPPROTO_UDP, RTE_IPV4(10, 255, 255, 255), 2000, 1 },
+        { IPPROTO_UDP, RTE_IPV4(10, 1, 2, 3), 999, 0 },
+        { IPPROTO_UDP, RTE_IPV4(10, 1, 2, 3), 2001, 0 },
+        { IPPROTO_TCP, RTE_IPV4(10, 1, 2, 3), 1500, 0 },
+        { IPPROTO_UDP, RTE_IPV4(11, 1, 2, 3), 1500, 0 },
+    };
+    struct sw_flow_tuple tuples[RTE_DIM(cases)];
+    struct sw_flow *match[RTE_DIM(cases)];
+    struct rte_flow_error error;
+    struct sw_flow *f;
+    int ret = 0;
+
+    f = sw_flow_create(&attr, pattern, actions, &error);
+    if (f == NULL) {
+        printf("sw_flow selftest: cannot create ranged rule\n");
+        return -1;
+    }
+    if (!f->ranged || sw_flow_commit() != 0) {
+        ret = -1;
+        goto out;
+    }
+
+    for (unsigned int i = 0; i < RTE_DIM(cases); i++)
+        sw_flow_test_tuple(&tuples[i], cases[i].proto, cases[i].src_ip, cases[i].dst_port);
+    sw_flow_classify(sw.active, tuples, RTE_DIM(cases), match);
+    for (unsigned int i = 0; i < RTE_DIM(cases); i++) {
+        if ((match[i] == f) != cases[i].hit) {
+            printf("sw_flow selftest: case %u (proto %u, dst port %u) %s\n", i,
+                   cases[i].proto, cases[i].dst_port,
+                   cases[i].hit ? "missed" : "matched unexpectedly");
+            ret = -1;
+        }
+    }
+
+out:
+    sw_flow_destroy(f, &error);
+    if (sw_flow_commit() != 0)
+        ret = -1;
+    return ret;
+}
+
+void sw_flow_print_stats(void)
+{
+    uint64_t classified = 0, matched = 0, dropped = 0, redirected = 0, redirect_drops = 0;
+    uint32_t nb_tables = 0;
+
+    for (uint16_t q = 0; q < sw.nb_queues; q++) {
+        classified += sw.queues[q].classified;
+        matched += sw.queues[q].matched;
+        dropped += sw.queues[q].dropped;
+        redirected += sw.queues[q].redirected;
+        redirect_drops += sw.queues[q].redirect_drops;
+    }
+    for (int i = 0; i < SW_FLOW_MAX_SUBTABLES; i++)
+        nb_tables += sw.subtables[i].rt != NULL;
+
+    printf("\n=== Software Flow Engine ===\n");
+    printf("Rules: %u (%u in %u hash tables, %u in ACL), %"PRIu64" commits, avg %.1f us\n",
+           sw.nb_rules, sw.nb_rules - sw.nb_acl_rules, nb_tables, sw.nb_acl_rules, sw.commits,
+           sw.commits > 0 ? (double)sw.commit_cycles / sw.commits * 1e6 / rte_get_tsc_hz() : 0.0);
+    printf("Packets: %"PRIu64" classified, %"PRIu64" matched, %"PRIu64" dropped, "
+           "%"PRIu64" redirected, %"PRIu64" redirect drops\n",
+           classified, matched, dropped, redirected, redirect_drops);
+}
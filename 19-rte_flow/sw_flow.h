@@ -0,0 +1,61 @@
+#ifndef _SW_FLOW_H_
+#define _SW_FLOW_H_
+
+/*
+ * 软件 rte_flow 引擎
+ * 给没有 flow 卸载能力的 PMD (net_null, net_ring, af_packet 等) 用:
+ * 接受与 rte_flow_create() 相同的 pattern / actions 数组, 编译成
+ * 精确匹配的哈希表 (每种 mask 一张) 加范围匹配的 ACL,
+ * 在 rte_eth_add_rx_callback() 注册的 RX 回调里对每个包执行
+ *
+ * 支持的 item: VOID, ETH (不匹配字段), IPV4 (src/dst/proto), TCP, UDP (src/dst 端口),
+ *              IPV4/TCP/UDP 的 last 表示范围
+ * 支持的 action: VOID, COUNT, QUEUE, DROP, MARK, FLAG
+ * 只支持 ingress, group 0; priority 数值小的优先
+ *
+ * 控制面 (create/destroy/commit) 只允许一个线程调用;
+ * 规则在 sw_flow_commit() 之后才对数据面生效
+ */
+
+#include <stdint.h>
+
+#include <rte_flow.h>
+
+struct sw_flow;
+
+/* 在已配置好 RX 队列的端口上注册 RX 回调 */
+int sw_flow_init(uint16_t port_id, uint16_t nb_queues, uint32_t max_rules);
+
+/* 删除 RX 回调并释放所有规则, 调用前 worker 必须已停止 */
+void sw_flow_fini(void);
+
+int sw_flow_validate(const struct rte_flow_attr *attr,
+                     const struct rte_flow_item pattern[],
+                     const struct rte_flow_action actions[],
+                     struct rte_flow_error *error);
+
+struct sw_flow *sw_flow_create(const struct rte_flow_attr *attr,
+                               const struct rte_flow_item pattern[],
+                               const struct rte_flow_action actions[],
+                               struct rte_flow_error *error);
+
+int sw_flow_destroy(struct sw_flow *flow, struct rte_flow_error *error);
+
+/* 读 COUNT 计数器 */
+int sw_flow_query(struct sw_flow *flow, struct rte_flow_query_count *count,
+                  struct rte_flow_error *error);
+
+/* 把 create/destroy 的结果发布给数据面, 等 worker 都离开旧规则集后回收 */
+int sw_flow_commit(void);
+
+/* worker 轮询队列前后调用, 用于 RCU 回收旧规则集 */
+void sw_flow_worker_start(unsigned int lcore_id);
+void sw_flow_quiescent(unsigned int lcore_id);
+void sw_flow_worker_stop(unsigned int lcore_id);
+
+/* 用一条范围规则检查 ACL 层, 在 worker 启动前调用, 返回 0 表示通过 */
+int sw_flow_selftest(void);
+
+void sw_flow_print_stats(void);
+
+#endif
@@ -9,16 +9,26 @@
  * 4. Real-time monitoring dashboard
  * 5. Traffic analysis (packet rate, bandwidth, protocol distribution)
  * 6. Alert system for anomaly detection
+ * 7. Branchless burst-level stats kernel (SIMD protocol/size counting)
+ * 8. Prometheus /metrics endpoint and DPDK telemetry command
+ * 9. Streaming rate-of-change anomaly detection (EWMA + robust z-score)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stdarg.h>
+#include <math.h>
 #include <inttypes.h>
+#include <errno.h>
 #include <signal.h>
 #include <unistd.h>
+#include <poll.h>
+#include <getopt.h>
 #include <sys/time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #include <rte_eal.h>
 #include <rte_ethdev.h>
@@ -30,6 +40,10 @@
 #include <rte_tcp.h>
 #include <rte_udp.h>
 #include <rte_metrics.h>
+#include <rte_seqcount.h>
+#include <rte_vect.h>
+#include <rte_thread.h>
+#include <rte_telemetry.h>
 
 /* 配置参数 */
 #define RX_RING_SIZE 1024
@@ -39,10 +53,78 @@
 #define BURST_SIZE 32
 #define STATS_INTERVAL_SEC 1
 
+/* 指标导出 */
+#define METRICS_HTTP_PORT 9100      /* Prometheus node exporter 惯用端口 */
+#define METRICS_BUF_SIZE (64 * 1024)
+#define MAX_XSTATS 256
+#define HTTP_REQ_SIZE 1024
+#define HTTP_POLL_MS 500
+#define HTTP_IO_TIMEOUT_MS 1000     /* 单个连接收发的超时, 不让慢客户端卡住导出线程 */
+
+/* 异常检测 */
+#define ANOMALY_ALPHA 0.05          /* EWMA 平滑系数, 约等于最近 20 个周期 */
+#define ANOMALY_Z_THRESHOLD 6.0     /* |z| 超过该值告警 */
+#define ANOMALY_CLIP 3.0            /* 更新基线时把偏差截断在 ±3 个尺度内 */
+#define ANOMALY_WARMUP 10           /* 学习期样本数, 期间不告警 */
+#define MAD_TO_SIGMA 1.4826         /* 正态分布下 MAD → 标准差 */
+#define ANOMALY_REL_FLOOR 0.01      /* 尺度下限: 基线均值的 1% */
+
+/* 非 IPv4 包在协议数组中的占位值 (不是合法的 IPv4 协议号) */
+#define PROTO_NONE 0xFF
+
+/* count_eq_u8() 用 32 位掩码表示一个 burst, 并按 16 字节一组比较 */
+#if BURST_SIZE > 32 || BURST_SIZE % 16 != 0
+#error "BURST_SIZE must be 16 or 32"
+#endif
+
 /* 全局变量 */
 static volatile int force_quit = 0;
 
-/* 性能指标 */
+/* 协议类别 */
+enum proto_class {
+    PROTO_TCP,
+    PROTO_UDP,
+    PROTO_ICMP,
+    PROTO_OTHER,
+    NB_PROTO_CLASSES
+};
+
+/* 包大小区间 */
+enum size_bucket {
+    SIZE_64,
+    SIZE_65_127,
+    SIZE_128_255,
+    SIZE_256_511,
+    SIZE_512_1023,
+    SIZE_1024_1518,
+    SIZE_JUMBO,
+    NB_SIZE_BUCKETS
+};
+
+/*
+ * 热计数器: 只包含 worker 在快路径上累加的字段
+ * 速率、时间戳等派生字段由统计核心计算, 不放在这里
+ */
+struct hot_counters {
+    uint64_t rx_packets;
+    uint64_t rx_bytes;
+    uint64_t proto[NB_PROTO_CLASSES];
+    uint64_t size[NB_SIZE_BUCKETS];
+};
+
+/*
+ * 每个 lcore 的计数器块
+ * 单写者 (所属 worker), 用 seqcount 保护: 写端每个 burst 只做两次普通
+ * store + 内存屏障, 没有原子 RMW; 读端发现序号变化就重读, 保证快照不撕裂
+ */
+struct lcore_counters {
+    rte_seqcount_t seq;
+    struct hot_counters c;
+} __rte_cache_aligned;
+
+static struct lcore_counters lcore_counters[RTE_MAX_LCORE];
+
+/* 端口性能指标 (仅统计核心读写) */
 struct perf_metrics {
     uint64_t rx_packets;
     uint64_t rx_bytes;
@@ -52,21 +134,6 @@ struct perf_metrics {
     uint64_t tx_errors;
     uint64_t rx_dropped;
 
-    /* 协议统计 */
-    uint64_t tcp_packets;
-    uint64_t udp_packets;
-    uint64_t icmp_packets;
-    uint64_t other_packets;
-
-    /* 包大小分布 */
-    uint64_t size_64;
-    uint64_t size_65_127;
-    uint64_t size_128_255;
-    uint64_t size_256_511;
-    uint64_t size_512_1023;
-    uint64_t size_1024_1518;
-    uint64_t size_jumbo;
-
     /* 速率 */
     uint64_t pps;          /* Packets per second */
     uint64_t bps;          /* Bits per second */
@@ -75,10 +142,20 @@ struct perf_metrics {
     /* 时间戳 */
     uint64_t timestamp;
     uint64_t last_timestamp;
-} __rte_cache_aligned;
+};
 
 static struct perf_metrics port_metrics[RTE_MAX_ETHPORTS];
-static struct perf_metrics lcore_metrics[RTE_MAX_LCORE];
+
+/* lcore 速率 (统计核心根据前后两次快照计算) */
+struct lcore_rate {
+    uint64_t last_rx_packets;
+    uint64_t last_rx_bytes;
+    uint64_t last_timestamp;
+    uint64_t pps;
+    double mbps;
+};
+
+static struct lcore_rate lcore_rates[RTE_MAX_LCORE];
 
 /* 告警阈值 */
 struct alert_thresholds {
@@ -88,6 +165,71 @@ struct alert_thresholds {
     double max_drop_rate;       /* 最大丢包率 (%) */
 };
 
+/* HTTP /metrics 监听端口, 0 表示不启动 */
+static uint16_t metrics_http_port = METRICS_HTTP_PORT;
+
+/*
+ * 导出快照: 统计核心每个周期生成一次, 包括数值和渲染好的 Prometheus 文本
+ * HTTP 线程和 telemetry 回调只读取这里, 从不访问 worker 的计数器
+ */
+struct metrics_snapshot {
+    uint16_t port_id;
+    struct perf_metrics port;
+    struct hot_counters traffic;
+    uint32_t nb_xstats;
+    uint64_t xstats[MAX_XSTATS];
+};
+
+struct metrics_export {
+    rte_seqcount_t seq;
+    struct metrics_snapshot snap;
+    size_t text_len;
+    char text[METRICS_BUF_SIZE];
+};
+
+static struct metrics_export metrics_export;
+
+/* xstats 名称在初始化时取一次, 之后只读 */
+static struct rte_eth_xstat_name *xstat_names;
+static struct rte_eth_xstat *xstat_values;
+static uint32_t nb_xstats;
+
+/*
+ * 异常检测指标: 端口速率/错误率/丢包率, 以及每个协议、每个大小区间的包速率
+ */
+enum anomaly_metric {
+    AM_PORT_PPS,
+    AM_PORT_BPS,
+    AM_PORT_ERROR_RATE,
+    AM_PORT_DROP_RATE,
+    AM_PROTO_BASE,
+    AM_SIZE_BASE = AM_PROTO_BASE + NB_PROTO_CLASSES,
+    NB_ANOMALY_METRICS = AM_SIZE_BASE + NB_SIZE_BUCKETS
+};
+
+/*
+ * 单个指标的流式检测器 (常数内存)
+ * mean: 指标的 EWMA; mad: |偏差| 的 EWMA, 作为对离群值不敏感的尺度
+ */
+struct ewma_detector {
+    double mean;
+    double mad;
+    double last_value;
+    double last_z;
+    uint32_t samples;
+};
+
+struct anomaly_state {
+    struct ewma_detector det[NB_ANOMALY_METRICS];
+    struct hot_counters last_traffic;
+    uint64_t last_rx_packets;
+    uint64_t last_rx_errors;
+    uint64_t last_rx_dropped;
+    uint64_t last_timestamp;
+};
+
+static struct anomaly_state anomaly_state;
+
 static struct alert_thresholds thresholds = {
     .max_pps = 1000000,         /* 1M pps */
     .max_bps = 1000000000,      /* 1 Gbps */
@@ -108,64 +250,118 @@ static void signal_handler(int signum)
 
 /*
  * 计算包大小类别
+ * 各阈值比较结果直接相加, 没有分支, 整个 burst 的循环可被编译器向量化
  */
-static inline void update_size_stats(struct perf_metrics *stats, uint16_t pkt_len)
+static inline uint8_t size_bucket_of(uint32_t pkt_len)
 {
-    if (pkt_len <= 64)
-        stats->size_64++;
-    else if (pkt_len <= 127)
-        stats->size_65_127++;
-    else if (pkt_len <= 255)
-        stats->size_128_255++;
-    else if (pkt_len <= 511)
-        stats->size_256_511++;
-    else if (pkt_len <= 1023)
-        stats->size_512_1023++;
-    else if (pkt_len <= 1518)
-        stats->size_1024_1518++;
-    else
-        stats->size_jumbo++;
+    return (pkt_len > 64) + (pkt_len > 127) + (pkt_len > 255) +
+           (pkt_len > 511) + (pkt_len > 1023) + (pkt_len > 1518);
 }
 
 /*
- * 解析包并更新协议统计
+ * 统计 v[] 中等于 val 的元素个数, valid_mask 标记有效位置
+ * x86 上每次比较 16 字节, movemask + popcount 得到计数
  */
-static inline void parse_and_update_stats(struct rte_mbuf *m,
-                                         struct perf_metrics *stats)
+static inline uint32_t count_eq_u8(const uint8_t *v, uint8_t val,
+                                   uint32_t valid_mask)
 {
-    struct rte_ether_hdr *eth_hdr;
-    struct rte_ipv4_hdr *ipv4_hdr;
-    uint16_t ether_type;
-    uint16_t pkt_len = rte_pktmbuf_pkt_len(m);
+#if defined(RTE_ARCH_X86)
+    __m128i key = _mm_set1_epi8((char)val);
+    uint32_t mask = 0;
 
-    eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
-    ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
+    for (int i = 0; i < BURST_SIZE; i += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+        mask |= (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, key)) << i;
+    }
 
-    /* 更新包大小统计 */
-    update_size_stats(stats, pkt_len);
+    return __builtin_popcount(mask & valid_mask);
+#else
+    uint32_t cnt = 0;
 
-    /* 协议统计 */
-    if (ether_type == RTE_ETHER_TYPE_IPV4) {
-        ipv4_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
-                                           sizeof(struct rte_ether_hdr));
+    for (int i = 0; i < BURST_SIZE; i++)
+        cnt += ((valid_mask >> i) & 1) & (v[i] == val);
 
-        switch (ipv4_hdr->next_proto_id) {
-        case IPPROTO_TCP:
-            stats->tcp_packets++;
-            break;
-        case IPPROTO_UDP:
-            stats->udp_packets++;
-            break;
-        case IPPROTO_ICMP:
-            stats->icmp_packets++;
-            break;
-        default:
-            stats->other_packets++;
-            break;
-        }
-    } else {
-        stats->other_packets++;
+    return cnt;
+#endif
+}
+
+/*
+ * Burst 级统计内核
+ * 第一遍只收集每个包的长度区间和 IPv4 协议号 (非 IPv4 记为 PROTO_NONE),
+ * 第二遍用 SIMD 比较一次性数出每个类别, 计数器每个 burst 只更新一次
+ */
+static inline void stats_burst_kernel(struct rte_mbuf **bufs, uint16_t nb_rx,
+                                      struct hot_counters *burst)
+{
+    uint8_t protos[BURST_SIZE];
+    uint8_t sizes[BURST_SIZE];
+    uint32_t valid = (uint32_t)((UINT64_C(1) << nb_rx) - 1);
+    uint32_t known = 0;
+    uint64_t bytes = 0;
+
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        struct rte_mbuf *m = bufs[i];
+        const struct rte_ether_hdr *eth_hdr;
+        const struct rte_ipv4_hdr *ipv4_hdr;
+        uint32_t pkt_len = rte_pktmbuf_pkt_len(m);
+        int is_ipv4;
+
+        eth_hdr = rte_pktmbuf_mtod(m, const struct rte_ether_hdr *);
+        ipv4_hdr = (const struct rte_ipv4_hdr *)(eth_hdr + 1);
+        is_ipv4 = eth_hdr->ether_type ==
+                  rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+        /* 读取始终落在 mbuf 数据区内, 由 is_ipv4 选择结果 (cmov) */
+        protos[i] = is_ipv4 ? ipv4_hdr->next_proto_id : PROTO_NONE;
+        sizes[i] = size_bucket_of(pkt_len);
+        bytes += pkt_len;
     }
+
+    burst->rx_packets = nb_rx;
+    burst->rx_bytes = bytes;
+
+    burst->proto[PROTO_TCP] = count_eq_u8(protos, IPPROTO_TCP, valid);
+    burst->proto[PROTO_UDP] = count_eq_u8(protos, IPPROTO_UDP, valid);
+    burst->proto[PROTO_ICMP] = count_eq_u8(protos, IPPROTO_ICMP, valid);
+    for (int i = PROTO_TCP; i < PROTO_OTHER; i++)
+        known += burst->proto[i];
+    burst->proto[PROTO_OTHER] = nb_rx - known;
+
+    for (int i = 0; i < NB_SIZE_BUCKETS; i++)
+        burst->size[i] = count_eq_u8(sizes, (uint8_t)i, valid);
+}
+
+/*
+ * 把一个 burst 的增量发布到 lcore 计数器块
+ * 写临界区只包含若干加法, 读端重试窗口极短
+ */
+static inline void publish_burst(struct lcore_counters *ctr,
+                                 const struct hot_counters *burst)
+{
+    rte_seqcount_write_begin(&ctr->seq);
+
+    ctr->c.rx_packets += burst->rx_packets;
+    ctr->c.rx_bytes += burst->rx_bytes;
+    for (int i = 0; i < NB_PROTO_CLASSES; i++)
+        ctr->c.proto[i] += burst->proto[i];
+    for (int i = 0; i < NB_SIZE_BUCKETS; i++)
+        ctr->c.size[i] += burst->size[i];
+
+    rte_seqcount_write_end(&ctr->seq);
+}
+
+/*
+ * 读取 lcore 计数器的一致快照 (统计核心调用)
+ */
+static void snapshot_lcore_counters(unsigned lcore_id, struct hot_counters *snap)
+{
+    struct lcore_counters *ctr = &lcore_counters[lcore_id];
+    uint32_t sn;
+
+    do {
+        sn = rte_seqcount_read_begin(&ctr->seq);
+        *snap = ctr->c;
+    } while (rte_seqcount_read_retry(&ctr->seq, sn));
 }
 
 /*
@@ -179,27 +375,23 @@ static int worker_main(void *arg)
 
     struct rte_mbuf *bufs[BURST_SIZE];
     uint16_t nb_rx;
-    struct perf_metrics *stats = &lcore_metrics[lcore_id];
+    struct lcore_counters *ctr = &lcore_counters[lcore_id];
+    struct hot_counters burst;
 
     printf("Worker core %u started on queue %u\n", lcore_id, queue_id);
 
-    stats->last_timestamp = rte_get_timer_cycles();
-
     while (!force_quit) {
         nb_rx = rte_eth_rx_burst(port_id, queue_id, bufs, BURST_SIZE);
 
         if (unlikely(nb_rx == 0))
             continue;
 
-        stats->rx_packets += nb_rx;
+        /* 先在栈上算出本 burst 的增量, 再一次性发布 */
+        stats_burst_kernel(bufs, nb_rx, &burst);
 
-        for (uint16_t i = 0; i < nb_rx; i++) {
-            stats->rx_bytes += rte_pktmbuf_pkt_len(bufs[i]);
-            parse_and_update_stats(bufs[i], stats);
-            rte_pktmbuf_free(bufs[i]);
-        }
+        rte_pktmbuf_free_bulk(bufs, nb_rx);
 
-        stats->timestamp = rte_get_timer_cycles();
+        publish_burst(ctr, &burst);
     }
 
     printf("Worker core %u stopped\n", lcore_id);
@@ -249,30 +441,84 @@ static void collect_port_stats(uint16_t port_id)
 /*
  * 聚合所有 lcore 统计
  */
-static void aggregate_lcore_stats(struct perf_metrics *total)
+static void aggregate_lcore_stats(struct hot_counters *total)
+{
+    unsigned lcore_id;
+    struct hot_counters snap;
+
+    memset(total, 0, sizeof(struct hot_counters));
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        snapshot_lcore_counters(lcore_id, &snap);
+
+        total->rx_packets += snap.rx_packets;
+        total->rx_bytes += snap.rx_bytes;
+        for (int i = 0; i < NB_PROTO_CLASSES; i++)
+            total->proto[i] += snap.proto[i];
+        for (int i = 0; i < NB_SIZE_BUCKETS; i++)
+            total->size[i] += snap.size[i];
+    }
+}
+
+/*
+ * 计算每个 lcore 的速率 (派生字段只在统计核心计算)
+ */
+static void update_lcore_rates(void)
+{
+    unsigned lcore_id;
+    struct hot_counters snap;
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t now = rte_get_timer_cycles();
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        struct lcore_rate *rate = &lcore_rates[lcore_id];
+        double time_sec;
+
+        snapshot_lcore_counters(lcore_id, &snap);
+
+        if (rate->last_timestamp != 0) {
+            time_sec = (double)(now - rate->last_timestamp) / hz;
+            if (time_sec > 0) {
+                rate->pps = (uint64_t)((snap.rx_packets -
+                                        rate->last_rx_packets) / time_sec);
+                rate->mbps = (snap.rx_bytes - rate->last_rx_bytes) * 8 /
+                             time_sec / 1000000.0;
+            }
+        }
+
+        rate->last_rx_packets = snap.rx_packets;
+        rate->last_rx_bytes = snap.rx_bytes;
+        rate->last_timestamp = now;
+    }
+}
+
+/*
+ * 打印每个 lcore 的统计
+ */
+static void print_lcore_stats(void)
 {
     unsigned lcore_id;
+    struct hot_counters snap;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║              Per-Lcore Statistics                      ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n");
 
-    memset(total, 0, sizeof(struct perf_metrics));
+    printf("\n┌───────┬──────────────┬──────────────┬──────────────┬────────────┐\n");
+    printf("│ Lcore │ RX Packets   │ RX Bytes     │ Rate (pps)   │ Rate(Mbps) │\n");
+    printf("├───────┼──────────────┼──────────────┼──────────────┼────────────┤\n");
 
     RTE_LCORE_FOREACH_WORKER(lcore_id) {
-        struct perf_metrics *stats = &lcore_metrics[lcore_id];
-
-        total->rx_packets += stats->rx_packets;
-        total->rx_bytes += stats->rx_bytes;
-        total->tcp_packets += stats->tcp_packets;
-        total->udp_packets += stats->udp_packets;
-        total->icmp_packets += stats->icmp_packets;
-        total->other_packets += stats->other_packets;
-
-        total->size_64 += stats->size_64;
-        total->size_65_127 += stats->size_65_127;
-        total->size_128_255 += stats->size_128_255;
-        total->size_256_511 += stats->size_256_511;
-        total->size_512_1023 += stats->size_512_1023;
-        total->size_1024_1518 += stats->size_1024_1518;
-        total->size_jumbo += stats->size_jumbo;
+        snapshot_lcore_counters(lcore_id, &snap);
+        if (snap.rx_packets == 0)
+            continue;
+
+        printf("│ %5u │ %12"PRIu64" │ %12"PRIu64" │ %12"PRIu64" │ %10.2f │\n",
+               lcore_id, snap.rx_packets, snap.rx_bytes,
+               lcore_rates[lcore_id].pps, lcore_rates[lcore_id].mbps);
     }
+
+    printf("└───────┴──────────────┴──────────────┴──────────────┴────────────┘\n");
 }
 
 /*
@@ -315,7 +561,7 @@ static void print_port_stats(uint16_t port_id)
  */
 static void print_protocol_distribution(void)
 {
-    struct perf_metrics total;
+    struct hot_counters total;
     aggregate_lcore_stats(&total);
 
     if (total.rx_packets == 0)
@@ -329,15 +575,18 @@ static void print_protocol_distribution(void)
     printf("│ Protocol │ Packets      │ Percentage │\n");
     printf("├──────────┼──────────────┼────────────┤\n");
 
-    double tcp_pct = (double)total.tcp_packets * 100.0 / total.rx_packets;
-    double udp_pct = (double)total.udp_packets * 100.0 / total.rx_packets;
-    double icmp_pct = (double)total.icmp_packets * 100.0 / total.rx_packets;
-    double other_pct = (double)total.other_packets * 100.0 / total.rx_packets;
+    static const char *proto_labels[NB_PROTO_CLASSES] = {
+        [PROTO_TCP] = "TCP",
+        [PROTO_UDP] = "UDP",
+        [PROTO_ICMP] = "ICMP",
+        [PROTO_OTHER] = "Other",
+    };
 
-    printf("│ TCP      │ %12"PRIu64" │ %8.2f%% │\n", total.tcp_packets, tcp_pct);
-    printf("│ UDP      │ %12"PRIu64" │ %8.2f%% │\n", total.udp_packets, udp_pct);
-    printf("│ ICMP     │ %12"PRIu64" │ %8.2f%% │\n", total.icmp_packets, icmp_pct);
-    printf("│ Other    │ %12"PRIu64" │ %8.2f%% │\n", total.other_packets, other_pct);
+    for (int i = 0; i < NB_PROTO_CLASSES; i++) {
+        double pct = (double)total.proto[i] * 100.0 / total.rx_packets;
+        printf("│ %-8s │ %12"PRIu64" │ %8.2f%% │\n",
+               proto_labels[i], total.proto[i], pct);
+    }
     printf("└──────────┴──────────────┴────────────┘\n");
 }
 
@@ -346,7 +595,7 @@ static void print_protocol_distribution(void)
  */
 static void print_size_distribution(void)
 {
-    struct perf_metrics total;
+    struct hot_counters total;
     aggregate_lcore_stats(&total);
 
     if (total.rx_packets == 0)
@@ -360,28 +609,181 @@ static void print_size_distribution(void)
     printf("│ Size (bytes) │ Packets      │ Percentage │\n");
     printf("├──────────────┼──────────────┼────────────┤\n");
 
-    struct {
-        const char *label;
-        uint64_t count;
-    } size_stats[] = {
-        {"≤ 64",         total.size_64},
-        {"65-127",       total.size_65_127},
-        {"128-255",      total.size_128_255},
-        {"256-511",      total.size_256_511},
-        {"512-1023",     total.size_512_1023},
-        {"1024-1518",    total.size_1024_1518},
-        {"> 1518",       total.size_jumbo},
+    static const char *size_labels[NB_SIZE_BUCKETS] = {
+        [SIZE_64]        = "≤ 64",
+        [SIZE_65_127]    = "65-127",
+        [SIZE_128_255]   = "128-255",
+        [SIZE_256_511]   = "256-511",
+        [SIZE_512_1023]  = "512-1023",
+        [SIZE_1024_1518] = "1024-1518",
+        [SIZE_JUMBO]     = "> 1518",
     };
 
-    for (int i = 0; i < 7; i++) {
-        double pct = (double)size_stats[i].count * 100.0 / total.rx_packets;
+    for (int i = 0; i < NB_SIZE_BUCKETS; i++) {
+        double pct = (double)total.size[i] * 100.0 / total.rx_packets;
         printf("│ %-12s │ %12"PRIu64" │ %8.2f%% │\n",
-               size_stats[i].label, size_stats[i].count, pct);
+               size_labels[i], total.size[i], pct);
     }
 
     printf("└──────────────┴──────────────┴────────────┘\n");
 }
 
+/*
+ * 指标名称和尺度绝对下限 (避免基线为 0 时出现无穷大的 z)
+ */
+static const char *anomaly_metric_name(int m)
+{
+    static const char *names[NB_ANOMALY_METRICS] = {
+        [AM_PORT_PPS]        = "port.pps",
+        [AM_PORT_BPS]        = "port.bps",
+        [AM_PORT_ERROR_RATE] = "port.error_rate",
+        [AM_PORT_DROP_RATE]  = "port.drop_rate",
+        [AM_PROTO_BASE + PROTO_TCP]   = "proto.tcp.pps",
+        [AM_PROTO_BASE + PROTO_UDP]   = "proto.udp.pps",
+        [AM_PROTO_BASE + PROTO_ICMP]  = "proto.icmp.pps",
+        [AM_PROTO_BASE + PROTO_OTHER] = "proto.other.pps",
+        [AM_SIZE_BASE + SIZE_64]        = "size.64.pps",
+        [AM_SIZE_BASE + SIZE_65_127]    = "size.65-127.pps",
+        [AM_SIZE_BASE + SIZE_128_255]   = "size.128-255.pps",
+        [AM_SIZE_BASE + SIZE_256_511]   = "size.256-511.pps",
+        [AM_SIZE_BASE + SIZE_512_1023]  = "size.512-1023.pps",
+        [AM_SIZE_BASE + SIZE_1024_1518] = "size.1024-1518.pps",
+        [AM_SIZE_BASE + SIZE_JUMBO]     = "size.jumbo.pps",
+    };
+
+    return names[m];
+}
+
+static double anomaly_abs_floor(int m)
+{
+    switch (m) {
+    case AM_PORT_BPS:
+        return 1E5;             /* 100 Kbps */
+    case AM_PORT_ERROR_RATE:
+    case AM_PORT_DROP_RATE:
+        return 1E-4;            /* 0.01% */
+    default:
+        return 100.0;           /* 100 pps */
+    }
+}
+
+/*
+ * 用一个新样本更新检测器, 返回该样本的 robust z-score
+ * 先用旧基线打分, 再把截断后的偏差并入基线, 突发值不会把基线一下子拉走
+ */
+static double detector_update(struct ewma_detector *d, double x, double floor)
+{
+    double dev, scale, z, clip;
+
+    d->last_value = x;
+
+    if (d->samples++ == 0) {
+        d->mean = x;
+        d->mad = 0;
+        d->last_z = 0;
+        return 0;
+    }
+
+    dev = x - d->mean;
+    scale = RTE_MAX(MAD_TO_SIGMA * d->mad,
+                    RTE_MAX(fabs(d->mean) * ANOMALY_REL_FLOOR, floor));
+    z = dev / scale;
+
+    clip = ANOMALY_CLIP * scale;
+    if (dev > clip)
+        dev = clip;
+    else if (dev < -clip)
+        dev = -clip;
+
+    d->mean += ANOMALY_ALPHA * dev;
+    d->mad += ANOMALY_ALPHA * (fabs(dev) - d->mad);
+
+    d->last_z = (d->samples > ANOMALY_WARMUP) ? z : 0;
+    return d->last_z;
+}
+
+/*
+ * 每个统计周期调用一次: 由计数器差值算出各指标速率并更新检测器
+ * 只读取已有的快照, 没有任何逐包开销
+ */
+static void update_anomaly_detectors(uint16_t port_id)
+{
+    struct anomaly_state *st = &anomaly_state;
+    struct perf_metrics *pm = &port_metrics[port_id];
+    struct hot_counters traffic;
+    uint64_t now = rte_get_timer_cycles();
+    uint64_t d_pkts, d_err, d_drop;
+    double dt;
+
+    aggregate_lcore_stats(&traffic);
+
+    if (st->last_timestamp == 0)
+        goto save;
+
+    dt = (double)(now - st->last_timestamp) / rte_get_timer_hz();
+    if (dt <= 0)
+        goto save;
+
+    d_pkts = pm->rx_packets - st->last_rx_packets;
+    d_err = pm->rx_errors - st->last_rx_errors;
+    d_drop = pm->rx_dropped - st->last_rx_dropped;
+
+    detector_update(&st->det[AM_PORT_PPS], (double)pm->pps,
+                    anomaly_abs_floor(AM_PORT_PPS));
+    detector_update(&st->det[AM_PORT_BPS], (double)pm->bps,
+                    anomaly_abs_floor(AM_PORT_BPS));
+    detector_update(&st->det[AM_PORT_ERROR_RATE],
+                    d_pkts ? (double)d_err / d_pkts : 0.0,
+                    anomaly_abs_floor(AM_PORT_ERROR_RATE));
+    detector_update(&st->det[AM_PORT_DROP_RATE],
+                    (d_pkts + d_drop) ? (double)d_drop / (d_pkts + d_drop) : 0.0,
+                    anomaly_abs_floor(AM_PORT_DROP_RATE));
+
+    for (int i = 0; i < NB_PROTO_CLASSES; i++)
+        detector_update(&st->det[AM_PROTO_BASE + i],
+                        (traffic.proto[i] - st->last_traffic.proto[i]) / dt,
+                        anomaly_abs_floor(AM_PROTO_BASE + i));
+
+    for (int i = 0; i < NB_SIZE_BUCKETS; i++)
+        detector_update(&st->det[AM_SIZE_BASE + i],
+                        (traffic.size[i] - st->last_traffic.size[i]) / dt,
+                        anomaly_abs_floor(AM_SIZE_BASE + i));
+
+save:
+    st->last_traffic = traffic;
+    st->last_rx_packets = pm->rx_packets;
+    st->last_rx_errors = pm->rx_errors;
+    st->last_rx_dropped = pm->rx_dropped;
+    st->last_timestamp = now;
+}
+
+/*
+ * 打印变化率异常, 返回告警数量
+ */
+static int check_anomalies(void)
+{
+    struct anomaly_state *st = &anomaly_state;
+    int alerts = 0;
+
+    for (int m = 0; m < NB_ANOMALY_METRICS; m++) {
+        struct ewma_detector *d = &st->det[m];
+
+        if (fabs(d->last_z) <= ANOMALY_Z_THRESHOLD)
+            continue;
+
+        printf("⚠ %s %s: %.4g (baseline %.4g, z=%+.1f)\n",
+               d->last_z > 0 ? "SURGE" : "DROP",
+               anomaly_metric_name(m), d->last_value, d->mean, d->last_z);
+        alerts++;
+    }
+
+    if (st->det[AM_PORT_PPS].samples <= ANOMALY_WARMUP)
+        printf("Anomaly detector learning baseline (%u/%u samples)\n",
+               st->det[AM_PORT_PPS].samples, ANOMALY_WARMUP);
+
+    return alerts;
+}
+
 /*
  * 检查告警
  */
@@ -428,11 +830,350 @@ static void check_alerts(uint16_t port_id)
         }
     }
 
+    /* 检查变化率异常 */
+    if (check_anomalies() > 0)
+        alert = 1;
+
     if (!alert) {
         printf("✓ All metrics within normal range\n");
     }
 }
 
+/*
+ * 查询端口 xstats 数量并缓存名称
+ */
+static int metrics_init_xstats(uint16_t port_id)
+{
+    int n;
+
+    n = rte_eth_xstats_get_names(port_id, NULL, 0);
+    if (n <= 0)
+        return n;
+
+    xstat_names = calloc(n, sizeof(*xstat_names));
+    xstat_values = calloc(n, sizeof(*xstat_values));
+    if (xstat_names == NULL || xstat_values == NULL)
+        return -ENOMEM;
+
+    if (rte_eth_xstats_get_names(port_id, xstat_names, n) != n)
+        return -EINVAL;
+
+    nb_xstats = n;
+    printf("Port %u exposes %u xstats (%u exported)\n", port_id, nb_xstats,
+           RTE_MIN(nb_xstats, (uint32_t)MAX_XSTATS));
+
+    return 0;
+}
+
+/*
+ * 向文本缓冲区追加格式化内容, 超出容量时截断
+ */
+static void metrics_append(char *buf, size_t *off, const char *fmt, ...)
+{
+    va_list ap;
+    int n;
+
+    if (*off >= METRICS_BUF_SIZE)
+        return;
+
+    va_start(ap, fmt);
+    n = vsnprintf(buf + *off, METRICS_BUF_SIZE - *off, fmt, ap);
+    va_end(ap);
+
+    if (n > 0)
+        *off = RTE_MIN(*off + n, (size_t)METRICS_BUF_SIZE);
+}
+
+/*
+ * 按 Prometheus text exposition format (0.0.4) 渲染快照
+ */
+static size_t render_prometheus(const struct metrics_snapshot *snap, char *buf)
+{
+    static const char *proto_names[NB_PROTO_CLASSES] = {
+        [PROTO_TCP] = "tcp",
+        [PROTO_UDP] = "udp",
+        [PROTO_ICMP] = "icmp",
+        [PROTO_OTHER] = "other",
+    };
+    static const char *size_names[NB_SIZE_BUCKETS] = {
+        [SIZE_64]        = "0-64",
+        [SIZE_65_127]    = "65-127",
+        [SIZE_128_255]   = "128-255",
+        [SIZE_256_511]   = "256-511",
+        [SIZE_512_1023]  = "512-1023",
+        [SIZE_1024_1518] = "1024-1518",
+        [SIZE_JUMBO]     = "1519-",
+    };
+    const struct perf_metrics *pm = &snap->port;
+    uint16_t port = snap->port_id;
+    size_t off = 0;
+
+#define PORT_COUNTER(name, help, val)                                       \
+    metrics_append(buf, &off,                                               \
+                   "# HELP dpdk_port_" name " " help "\n"                   \
+                   "# TYPE dpdk_port_" name " counter\n"                    \
+                   "dpdk_port_" name "{port=\"%u\"} %" PRIu64 "\n",         \
+                   port, (uint64_t)(val))
+
+    PORT_COUNTER("rx_packets_total", "Received packets.", pm->rx_packets);
+    PORT_COUNTER("rx_bytes_total", "Received bytes.", pm->rx_bytes);
+    PORT_COUNTER("tx_packets_total", "Transmitted packets.", pm->tx_packets);
+    PORT_COUNTER("tx_bytes_total", "Transmitted bytes.", pm->tx_bytes);
+    PORT_COUNTER("rx_errors_total", "Receive errors.", pm->rx_errors);
+    PORT_COUNTER("tx_errors_total", "Transmit errors.", pm->tx_errors);
+    PORT_COUNTER("rx_dropped_total", "Missed plus no-mbuf drops.",
+                 pm->rx_dropped);
+#undef PORT_COUNTER
+
+    metrics_append(buf, &off,
+                   "# HELP dpdk_port_rx_pps Receive packet rate.\n"
+                   "# TYPE dpdk_port_rx_pps gauge\n"
+                   "dpdk_port_rx_pps{port=\"%u\"} %" PRIu64 "\n"
+                   "# HELP dpdk_port_rx_bps Receive bit rate.\n"
+                   "# TYPE dpdk_port_rx_bps gauge\n"
+                   "dpdk_port_rx_bps{port=\"%u\"} %" PRIu64 "\n",
+                   port, pm->pps, port, pm->bps);
+
+    metrics_append(buf, &off,
+                   "# HELP stats_monitor_protocol_packets_total Packets per protocol.\n"
+                   "# TYPE stats_monitor_protocol_packets_total counter\n");
+    for (int i = 0; i < NB_PROTO_CLASSES; i++)
+        metrics_append(buf, &off,
+                       "stats_monitor_protocol_packets_total{port=\"%u\",proto=\"%s\"} %" PRIu64 "\n",
+                       port, proto_names[i], snap->traffic.proto[i]);
+
+    metrics_append(buf, &off,
+                   "# HELP stats_monitor_size_packets_total Packets per size range.\n"
+                   "# TYPE stats_monitor_size_packets_total counter\n");
+    for (int i = 0; i < NB_SIZE_BUCKETS; i++)
+        metrics_append(buf, &off,
+                       "stats_monitor_size_packets_total{port=\"%u\",size=\"%s\"} %" PRIu64 "\n",
+                       port, size_names[i], snap->traffic.size[i]);
+
+    metrics_append(buf, &off,
+                   "# HELP dpdk_port_xstat PMD extended statistic.\n"
+                   "# TYPE dpdk_port_xstat untyped\n");
+    for (uint32_t i = 0; i < snap->nb_xstats; i++)
+        metrics_append(buf, &off,
+                       "dpdk_port_xstat{port=\"%u\",name=\"%s\"} %" PRIu64 "\n",
+                       port, xstat_names[i].name, snap->xstats[i]);
+
+    return off;
+}
+
+/*
+ * 生成导出快照 (统计核心每个周期调用一次)
+ * 渲染在私有缓冲区完成, 写临界区内只做 memcpy
+ */
+static void update_metrics_export(uint16_t port_id)
+{
+    static struct metrics_snapshot snap;
+    static char text[METRICS_BUF_SIZE];
+    struct metrics_export *exp = &metrics_export;
+    size_t len;
+    int n;
+
+    snap.port_id = port_id;
+    snap.port = port_metrics[port_id];
+    aggregate_lcore_stats(&snap.traffic);
+
+    snap.nb_xstats = 0;
+    if (nb_xstats > 0) {
+        n = rte_eth_xstats_get(port_id, xstat_values, nb_xstats);
+        if (n > 0 && (uint32_t)n <= nb_xstats) {
+            snap.nb_xstats = RTE_MIN((uint32_t)n, (uint32_t)MAX_XSTATS);
+            for (uint32_t i = 0; i < snap.nb_xstats; i++)
+                snap.xstats[i] = xstat_values[i].value;
+        }
+    }
+
+    len = render_prometheus(&snap, text);
+
+    rte_seqcount_write_begin(&exp->seq);
+    exp->snap = snap;
+    memcpy(exp->text, text, len);
+    exp->text_len = len;
+    rte_seqcount_write_end(&exp->seq);
+}
+
+/*
+ * telemetry 命令 /stats_monitor/metrics
+ * 在 telemetry 线程中执行, 只读取导出快照
+ */
+static int telemetry_metrics_cb(const char *cmd __rte_unused,
+                                const char *params __rte_unused,
+                                struct rte_tel_data *d)
+{
+    static const char *proto_keys[NB_PROTO_CLASSES] = {
+        [PROTO_TCP] = "tcp_packets",
+        [PROTO_UDP] = "udp_packets",
+        [PROTO_ICMP] = "icmp_packets",
+        [PROTO_OTHER] = "other_packets",
+    };
+    struct metrics_snapshot snap;
+    uint32_t sn;
+
+    do {
+        sn = rte_seqcount_read_begin(&metrics_export.seq);
+        snap = metrics_export.snap;
+    } while (rte_seqcount_read_retry(&metrics_export.seq, sn));
+
+    rte_tel_data_start_dict(d);
+    rte_tel_data_add_dict_uint(d, "port_id", snap.port_id);
+    rte_tel_data_add_dict_uint(d, "rx_packets", snap.port.rx_packets);
+    rte_tel_data_add_dict_uint(d, "rx_bytes", snap.port.rx_bytes);
+    rte_tel_data_add_dict_uint(d, "tx_packets", snap.port.tx_packets);
+    rte_tel_data_add_dict_uint(d, "tx_bytes", snap.port.tx_bytes);
+    rte_tel_data_add_dict_uint(d, "rx_errors", snap.port.rx_errors);
+    rte_tel_data_add_dict_uint(d, "tx_errors", snap.port.tx_errors);
+    rte_tel_data_add_dict_uint(d, "rx_dropped", snap.port.rx_dropped);
+    rte_tel_data_add_dict_uint(d, "rx_pps", snap.port.pps);
+    rte_tel_data_add_dict_uint(d, "rx_bps", snap.port.bps);
+    for (int i = 0; i < NB_PROTO_CLASSES; i++)
+        rte_tel_data_add_dict_uint(d, proto_keys[i], snap.traffic.proto[i]);
+
+    return 0;
+}
+
+/*
+ * 发送完整缓冲区
+ */
+static int send_all(int fd, const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        buf += n;
+        len -= n;
+    }
+
+    return 0;
+}
+
+/*
+ * 处理一个 HTTP 连接: 只支持 GET /metrics
+ */
+static void handle_http_conn(int fd)
+{
+    static char body[METRICS_BUF_SIZE];
+    const struct timeval tv = {
+        .tv_sec = HTTP_IO_TIMEOUT_MS / 1000,
+        .tv_usec = (HTTP_IO_TIMEOUT_MS % 1000) * 1000,
+    };
+    char req[HTTP_REQ_SIZE];
+    char hdr[256];
+    size_t len;
+    uint32_t sn;
+    ssize_t n;
+    int hlen;
+
+    /* 连上不发请求或不读响应的客户端: 超时后 recv/send 返回错误, 调用者关闭连接 */
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv)) < 0)
+        return;
+
+    n = recv(fd, req, sizeof(req) - 1, 0);
+    if (n <= 0)
+        return;
+    req[n] = '\0';
+
+    /* 路径必须正好是 /metrics, 后面只能跟空格或查询串 */
+    if (strncmp(req, "GET /metrics", 12) != 0 ||
+        (req[12] != ' ' && req[12] != '?')) {
+        static const char not_found[] =
+            "HTTP/1.1 404 Not Found\r\n"
+            "Content-Length: 0\r\n"
+            "Connection: close\r\n\r\n";
+        send_all(fd, not_found, sizeof(not_found) - 1);
+        return;
+    }
+
+    /* 复制预渲染文本, 发送过程中不持有任何共享状态 */
+    do {
+        sn = rte_seqcount_read_begin(&metrics_export.seq);
+        len = RTE_MIN(metrics_export.text_len, (size_t)METRICS_BUF_SIZE);
+        memcpy(body, metrics_export.text, len);
+    } while (rte_seqcount_read_retry(&metrics_export.seq, sn));
+
+    hlen = snprintf(hdr, sizeof(hdr),
+                    "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: %zu\r\n"
+                    "Connection: close\r\n\r\n", len);
+
+    if (send_all(fd, hdr, hlen) == 0)
+        send_all(fd, body, len);
+}
+
+/*
+ * HTTP /metrics 服务线程 (control thread, 不占用数据面 lcore)
+ */
+static uint32_t metrics_http_main(void *arg)
+{
+    int listen_fd = (int)(intptr_t)arg;
+    struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+
+    while (!force_quit) {
+        int fd;
+
+        /* 带超时的 poll, 保证能及时响应退出信号 */
+        if (poll(&pfd, 1, HTTP_POLL_MS) <= 0)
+            continue;
+
+        fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        handle_http_conn(fd);
+        close(fd);
+    }
+
+    close(listen_fd);
+    return 0;
+}
+
+/*
+ * 创建监听 socket 并启动 HTTP 线程
+ */
+static int metrics_http_start(uint16_t tcp_port, rte_thread_t *thread)
+{
+    struct sockaddr_in addr;
+    int fd, one = 1;
+    int ret;
+
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -errno;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(tcp_port);
+
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(fd, 16) < 0) {
+        ret = -errno;
+        close(fd);
+        return ret;
+    }
+
+    ret = rte_thread_create_control(thread, "metrics-http",
+                                    metrics_http_main, (void *)(intptr_t)fd);
+    if (ret != 0) {
+        close(fd);
+        return -ret;
+    }
+
+    return 0;
+}
+
 /*
  * 初始化端口
  */
@@ -472,6 +1213,43 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
     return ret;
 }
 
+/*
+ * 打印使用说明
+ */
+static void print_usage(const char *prgname)
+{
+    printf("\nUsage: %s [EAL options] -- [options]\n\n", prgname);
+    printf("Options:\n");
+    printf("  -p PORT    HTTP port for Prometheus /metrics (default: %u, 0 = off)\n",
+           METRICS_HTTP_PORT);
+    printf("\nTelemetry:\n");
+    printf("  dpdk-telemetry.py, then: /stats_monitor/metrics\n\n");
+}
+
+/*
+ * 解析命令行参数
+ */
+static int parse_args(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "p:h")) != -1) {
+        switch (opt) {
+        case 'p':
+            metrics_http_port = (uint16_t)atoi(optarg);
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            exit(0);
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * 主函数
  */
@@ -482,6 +1260,8 @@ int main(int argc, char *argv[])
     unsigned lcore_id;
     int ret;
     uint16_t nb_queues = 4;
+    rte_thread_t http_thread;
+    int http_started = 0;
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -490,6 +1270,12 @@ int main(int argc, char *argv[])
     if (ret < 0)
         rte_panic("Cannot init EAL\n");
 
+    argc -= ret;
+    argv += ret;
+
+    if (parse_args(argc, argv) < 0)
+        rte_exit(EXIT_FAILURE, "Invalid arguments\n");
+
     printf("\n");
     printf("╔════════════════════════════════════════════════════════╗\n");
     printf("║   DPDK Statistics and Monitoring - Lesson 20           ║\n");
@@ -512,6 +1298,35 @@ int main(int argc, char *argv[])
     /* 初始化时间戳 */
     port_metrics[port_id].last_timestamp = rte_get_timer_cycles();
 
+    RTE_LCORE_FOREACH_WORKER(lcore_id)
+        rte_seqcount_init(&lcore_counters[lcore_id].seq);
+
+    /* 指标导出: xstats 名称、telemetry 命令、HTTP 线程 */
+    rte_seqcount_init(&metrics_export.seq);
+
+    ret = metrics_init_xstats(port_id);
+    if (ret < 0)
+        printf("xstats unavailable: %s\n", rte_strerror(-ret));
+
+    ret = rte_telemetry_register_cmd("/stats_monitor/metrics",
+                                     telemetry_metrics_cb,
+                                     "Returns stats_monitor port and protocol counters. No parameters");
+    if (ret != 0)
+        printf("Telemetry command registration failed: %s\n",
+               rte_strerror(-ret));
+
+    if (metrics_http_port != 0) {
+        ret = metrics_http_start(metrics_http_port, &http_thread);
+        if (ret != 0) {
+            printf("Cannot start /metrics listener on port %u: %s\n",
+                   metrics_http_port, strerror(-ret));
+        } else {
+            http_started = 1;
+            printf("Prometheus metrics: http://0.0.0.0:%u/metrics\n",
+                   metrics_http_port);
+        }
+    }
+
     printf("\n=== Starting Workers ===\n");
     uint16_t queue = 0;
     RTE_LCORE_FOREACH_WORKER(lcore_id) {
@@ -535,7 +1350,11 @@ int main(int argc, char *argv[])
 
         /* 收集并打印统计 */
         collect_port_stats(port_id);
+        update_lcore_rates();
+        update_metrics_export(port_id);
+        update_anomaly_detectors(port_id);
         print_port_stats(port_id);
+        print_lcore_stats();
         print_protocol_distribution();
         print_size_distribution();
         check_alerts(port_id);
@@ -546,6 +1365,9 @@ int main(int argc, char *argv[])
     printf("\nWaiting for workers to stop...\n");
     rte_eal_mp_wait_lcore();
 
+    if (http_started)
+        rte_thread_join(http_thread, NULL);
+
     /* 最终统计 */
     printf("\n=== Final Statistics ===\n");
     collect_port_stats(port_id);
@@ -558,6 +1380,10 @@ int main(int argc, char *argv[])
         printf("Port stop failed: %s\n", rte_strerror(-ret));
 
     rte_eth_dev_close(port_id);
+
+    free(xstat_names);
+    free(xstat_values);
+
     rte_eal_cleanup();
 
     printf("\nProgram exited cleanly.\n");
@@ -9,6 +9,14 @@
  * 4. Fragment statistics and monitoring
  * 5. Complete packet analysis after reassembly
  * 6. Performance optimization techniques
+ *    - Burst reassembly path with header prefetch
+ *    - Per-lcore statistics (no shared writes between workers)
+ *    - Fragment table sized from the expected fragment rate
+ * 7. Fragment-aware steering: all fragments of a datagram reach one lcore
+ * 8. IPv6 fragment-header reassembly
+ * 9. Egress fragmentation to the port MTU with indirect mbufs (zero copy)
+ * 10. Offline benchmark of both directions (-b)
+ * 11. Timer-driven expiry, bounded reclaim and a cap on held mbufs
  */
 
 #include <stdio.h>
@@ -18,17 +26,24 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <errno.h>
 
 #include <rte_eal.h>
 #include <rte_ethdev.h>
 #include <rte_cycles.h>
 #include <rte_lcore.h>
 #include <rte_mbuf.h>
+#include <rte_malloc.h>
+#include <rte_memcpy.h>
+#include <rte_ring.h>
+#include <rte_jhash.h>
 #include <rte_ether.h>
 #include <rte_ip.h>
 #include <rte_tcp.h>
 #include <rte_udp.h>
 #include <rte_ip_frag.h>
+#include <rte_timer.h>
 
 /* 配置参数 */
 #define RX_RING_SIZE 1024
@@ -36,28 +51,109 @@
 #define NUM_MBUFS 8191
 #define MBUF_CACHE_SIZE 250
 #define BURST_SIZE 32
+#define PREFETCH_OFFSET 3
 
 /* 分片表参数 */
 #define MAX_FRAG_NUM 4                /* 每个数据包最多片段数 */
-#define FRAG_TBL_BUCKET_ENTRIES 16    /* 每个桶的条目数 */
-#define MAX_FLOW_NUM 1024             /* 最大流数量 */
+#define FRAG_TBL_BUCKET_ENTRIES 16    /* 每个桶的条目数 (必须是 2 的幂) */
+#define FRAG_TBL_LOAD 4               /* 每个桶平均占用条目数, 16 项桶溢出概率 < 1e-6 */
+#define FRAG_FLOW_HEADROOM 2          /* 流容量余量 (突发 / 乱序) */
+#define FRAG_MBUFS_PER_FLOW 1         /* 每个未完成流平均缓存的 mbuf 数 */
+#define HELD_MBUFS_DEFAULT_MAX 16384  /* -c 的默认值上限, 流表很大时也不按流数预留 mbuf */
+#define MAX_POOL_MBUFS (1U << 20)     /* mbuf pool 上限, 约 4.5 GB, 超过就要求调小 -c */
+#define MIN_FLOW_NUM 1024             /* 最小流数量 */
+#define MAX_FLOW_NUM (1U << 20)       /* 最大流数量上限 */
+#define DEFAULT_FRAG_RATE 1000        /* 默认每 lcore 每秒分片数据报数 */
 #define FRAG_TIMEOUT_MS 5000          /* 5秒超时 */
 
+/* 分片转交 */
+#define MAX_WORKERS 16
+#define FRAG_RING_SIZE 1024
+
+/* 过期回收 */
+#define TIMER_RESOLUTION_MS 10        /* rte_timer_manage() 调用间隔 */
+#define FRAG_EXPIRE_MS 100            /* 过期扫描周期 */
+#define RECLAIM_FREE_BURST 32         /* 每次循环最多归还的过期 mbuf */
+#define FRAG_EVICT_SLACK 64           /* 淘汰到上限以下的余量, 避免每个 burst 都触发 */
+
+/* 出方向分片 */
+#define MAX_EGRESS_FRAGS 16           /* 单个包最多切成的片段数 */
+#define DIRECT_DATA_ROOM 128          /* 片段头: IPv4 头最长 60 字节, IPv6 头 + 分片扩展头 48 字节 */
+
+/* 基准测试 */
+#define BENCH_BATCH 32                /* 每轮同时在途的数据报数 */
+#define BENCH_ITERATIONS 10000
+
 /* 全局变量 */
 static volatile int force_quit = 0;
+static int verbose = 0;
+
+/* 分片表尺寸 (由 compute_frag_table_size() 根据预期分片速率计算) */
+static uint32_t frag_rate = DEFAULT_FRAG_RATE;
+static uint32_t frag_timeout_ms = FRAG_TIMEOUT_MS;
+static uint32_t max_flow_num;
+static uint32_t frag_bucket_num;
+
+/*
+ * 每个 lcore 上等待重组的片段最多占用的 mbuf 数, mbuf pool 按它为分片表预留.
+ * 分片洪水攻击时按 LRU 淘汰, 不会挤占收包所需的 mbuf
+ */
+static uint32_t max_held_mbufs;
+
+/*
+ * 出方向: 超过 egress_mtu 的包用 rte_ipv4/ipv6_fragment_packet 切片
+ * 片段 = direct mbuf (L2/L3 头) + indirect mbuf (引用原包数据), 不复制负载
+ */
+static int forward_mode = 0;
+static int bench_mode = 0;
+static uint16_t egress_mtu;           /* 0 表示使用端口 MTU */
+static struct rte_mempool *direct_pool;
+static struct rte_mempool *indirect_pool;
+
+/*
+ * 分片转交: RSS 按 5 元组哈希, 只有第一个片段带 L4 端口, 同一数据报的
+ * 片段会落到不同队列. 每个分片按 (src, dst, id, proto) 算出属主 worker,
+ * 不是自己的就写入属主的 ring (多生产者/单消费者)
+ */
+static uint16_t nb_workers;
+static struct rte_ring *frag_rings[MAX_WORKERS];
+
+/* Worker 参数 */
+struct worker_params {
+    uint16_t port_id;
+    uint16_t queue_id;
+    uint16_t worker_id;
+} __rte_cache_aligned;
 
 /* 分片统计 */
 struct frag_statistics {
     uint64_t total_packets;           /* 总包数 */
     uint64_t total_fragments;         /* 总片段数 */
+    uint64_t ipv6_fragments;          /* 其中 IPv6 片段 */
     uint64_t first_fragments;         /* 第一个片段 */
     uint64_t middle_fragments;        /* 中间片段 */
     uint64_t last_fragments;          /* 最后片段 */
     uint64_t reassembled;             /* 重组成功 */
-    uint64_t timeouts;                /* 超时 */
+    uint64_t reassembled_ipv6;        /* 其中 IPv6 */
+    uint64_t frag_dropped;            /* 进入死亡行的 mbuf (表满/超时/非法) */
+    uint64_t timeouts;                /* 定时扫描回收的超时 mbuf */
+    uint64_t frag_evicted;            /* 超过上限被淘汰的 mbuf */
+    uint64_t held_mbufs;              /* 当前分片表占用的 mbuf (瞬时值) */
     uint64_t errors;                  /* 错误 */
     uint64_t non_fragments;           /* 非分片包 */
 
+    /* 跨核转交 */
+    uint64_t handoff_tx;              /* 转交给其他 lcore 的分片 */
+    uint64_t handoff_rx;              /* 从其他 lcore 收到的分片 */
+    uint64_t handoff_drops;           /* 属主 ring 满而丢弃的分片 */
+
+    /* 出方向 */
+    uint64_t tx_packets;              /* 发送成功 */
+    uint64_t tx_dropped;              /* TX 队列满丢弃 */
+    uint64_t egress_fragmented;       /* 超过 MTU 被切片的包 */
+    uint64_t egress_fragments;        /* 切出的片段数 */
+    uint64_t egress_errors;           /* 无法切片 (DF/非 IP/片段数超限) */
+
     /* 重组后的包统计 */
     uint64_t reassembled_tcp;
     uint64_t reassembled_udp;
@@ -70,7 +166,20 @@ struct frag_statistics {
     uint64_t size_gt_5000;
 } __rte_cache_aligned;
 
-static struct frag_statistics frag_stats;
+/* 每个 lcore 一份, worker 之间没有共享写 */
+static struct frag_statistics frag_stats[RTE_MAX_LCORE];
+
+/*
+ * 每个 worker 的回收状态
+ * row 存放定时扫描和上限淘汰从分片表里移出的 mbuf, 与重组路径的死亡行分开,
+ * 这样过期的 mbuf 可以分批归还, 不会在某一次循环里集中释放上百个
+ */
+struct frag_reclaim {
+    struct rte_ip_frag_tbl *tbl;
+    struct frag_statistics *stats;
+    struct rte_timer expire_timer;
+    struct rte_ip_frag_death_row row;
+};
 
 /*
  * 信号处理函数
@@ -115,69 +224,68 @@ static inline const char* get_frag_type(const struct rte_ipv4_hdr *ip_hdr)
 }
 
 /*
- * 更新分片统计
+ * 更新片段类型统计
  */
-static void update_frag_stats(const struct rte_ipv4_hdr *ip_hdr,
-                              int is_frag, int is_reassembled)
+static inline void update_frag_stats(struct frag_statistics *stats,
+                                     uint16_t offset, int mf)
 {
-    frag_stats.total_packets++;
-
-    if (!is_frag) {
-        frag_stats.non_fragments++;
-        return;
-    }
-
-    frag_stats.total_fragments++;
-
-    /* 判断片段类型 */
-    uint16_t frag_off = rte_be_to_cpu_16(ip_hdr->fragment_offset);
-    uint16_t offset = (frag_off & RTE_IPV4_HDR_OFFSET_MASK) * 8;
-    int mf = (frag_off & RTE_IPV4_HDR_MF_FLAG) != 0;
+    stats->total_fragments++;
 
     if (offset == 0 && mf)
-        frag_stats.first_fragments++;
+        stats->first_fragments++;
     else if (offset > 0 && mf)
-        frag_stats.middle_fragments++;
+        stats->middle_fragments++;
     else if (offset > 0 && !mf)
-        frag_stats.last_fragments++;
-
-    if (is_reassembled)
-        frag_stats.reassembled++;
+        stats->last_fragments++;
 }
 
 /*
  * 更新重组后包的统计
  */
-static void update_reassembled_stats(struct rte_mbuf *m)
+static void update_reassembled_stats(struct frag_statistics *stats,
+                                     struct rte_mbuf *m)
 {
-    struct rte_ipv4_hdr *ip_hdr;
-    uint16_t pkt_len = rte_pktmbuf_pkt_len(m);
+    uint32_t pkt_len = rte_pktmbuf_pkt_len(m);
+    uint8_t proto;
 
-    ip_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
-                                     sizeof(struct rte_ether_hdr));
+    /* 重组后 IPv6 分片扩展头已被移除, proto 即上层协议 */
+    if (RTE_ETH_IS_IPV6_HDR(m->packet_type)) {
+        struct rte_ipv6_hdr *ip6_hdr;
+
+        ip6_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv6_hdr *,
+                                          m->l2_len);
+        proto = ip6_hdr->proto;
+        stats->reassembled_ipv6++;
+    } else {
+        struct rte_ipv4_hdr *ip_hdr;
+
+        ip_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+                                         m->l2_len);
+        proto = ip_hdr->next_proto_id;
+    }
 
     /* 协议统计 */
-    switch (ip_hdr->next_proto_id) {
+    switch (proto) {
     case IPPROTO_TCP:
-        frag_stats.reassembled_tcp++;
+        stats->reassembled_tcp++;
         break;
     case IPPROTO_UDP:
-        frag_stats.reassembled_udp++;
+        stats->reassembled_udp++;
         break;
     default:
-        frag_stats.reassembled_other++;
+        stats->reassembled_other++;
         break;
     }
 
     /* 大小统计 */
     if (pkt_len < 1500)
-        frag_stats.size_lt_1500++;
+        stats->size_lt_1500++;
     else if (pkt_len < 3000)
-        frag_stats.size_1500_3000++;
+        stats->size_1500_3000++;
     else if (pkt_len < 5000)
-        frag_stats.size_3000_5000++;
+        stats->size_3000_5000++;
     else
-        frag_stats.size_gt_5000++;
+        stats->size_gt_5000++;
 }
 
 /*
@@ -238,55 +346,450 @@ static void print_packet_info(struct rte_mbuf *m, int is_reassembled)
 }
 
 /*
- * 处理 IPv4 数据包 (包括分片重组)
+ * 根据预期分片速率计算分片表尺寸
+ *
+ * 一个未完成的数据报最多在表中停留一个超时周期, 因此:
+ *   max_flow_num = 分片速率 × 超时 × 余量
+ * 桶数按平均每桶 FRAG_TBL_LOAD 项取整到 2 的幂; 桶是组相联的,
+ * 某个桶的 16 项占满时新流直接失败 (表未命中), 所以负载必须远低于 16
+ */
+static void compute_frag_table_size(void)
+{
+    uint64_t flows;
+
+    flows = (uint64_t)frag_rate * frag_timeout_ms / 1000 * FRAG_FLOW_HEADROOM;
+    flows = RTE_MAX(flows, (uint64_t)MIN_FLOW_NUM);
+    flows = RTE_MIN(flows, (uint64_t)MAX_FLOW_NUM);
+
+    max_flow_num = (uint32_t)flows;
+    frag_bucket_num = rte_align32pow2((max_flow_num + FRAG_TBL_LOAD - 1) /
+                                      FRAG_TBL_LOAD);
+}
+
+/*
+ * 计算分片的属主 worker
+ * 同一数据报的所有片段 (src, dst, id, proto) 相同, 因此属主相同
  */
-static struct rte_mbuf *
-handle_ipv4_packet(struct rte_mbuf *m,
-                   struct rte_ip_frag_tbl *frag_tbl,
-                   struct rte_ip_frag_death_row *dr,
-                   uint64_t cur_tsc,
-                   int verbose)
+static inline uint16_t hash_to_worker(uint32_t h)
 {
-    struct rte_ipv4_hdr *ip_hdr;
-    int is_frag;
+    /* 乘法取高位代替取模 */
+    return (uint16_t)(((uint64_t)h * nb_workers) >> 32);
+}
 
-    ip_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
-                                     sizeof(struct rte_ether_hdr));
+static inline uint16_t frag_owner_ipv4(const struct rte_ipv4_hdr *ip_hdr)
+{
+    return hash_to_worker(rte_jhash_3words(ip_hdr->src_addr, ip_hdr->dst_addr,
+                                           ((uint32_t)ip_hdr->packet_id << 8) |
+                                           ip_hdr->next_proto_id, 0));
+}
 
-    /* 检查是否为分片 */
-    is_frag = is_ipv4_fragment(ip_hdr);
+/* IPv6 分片的键是 (src, dst, id), src/dst 在头部中相邻 */
+static inline uint16_t
+frag_owner_ipv6(const struct rte_ipv6_hdr *ip6_hdr,
+                const struct rte_ipv6_fragment_ext *frag_hdr)
+{
+    return hash_to_worker(rte_jhash(&ip6_hdr->src_addr,
+                                    2 * sizeof(ip6_hdr->src_addr),
+                                    frag_hdr->id));
+}
 
-    if (is_frag) {
-        if (verbose) {
-            printf("\n→ Received fragment:\n");
-            print_packet_info(m, 0);
+/*
+ * Burst 分类 + 分片转交
+ *
+ * 预取后续包头, 设置 l2_len/l3_len (重组库依赖这两个字段),
+ * 非分片包直接放入 output, 属于本 worker 的分片收集到 frags[],
+ * 属于其他 worker 的分片按属主分组后批量写入对方 ring
+ */
+static uint16_t
+classify_burst(struct rte_mbuf **bufs, uint16_t nb_rx,
+               struct rte_mbuf **output,
+               struct rte_mbuf **frags, uint16_t *nb_frag,
+               uint16_t worker_id,
+               struct frag_statistics *stats)
+{
+    struct rte_mbuf *steer[MAX_WORKERS][BURST_SIZE];
+    uint16_t steer_cnt[MAX_WORKERS];
+    uint16_t nb_out = 0;
+    int steered = 0;
+
+    memset(steer_cnt, 0, sizeof(uint16_t) * nb_workers);
+    *nb_frag = 0;
+
+    for (uint16_t i = 0; i < nb_rx; i++) {
+        struct rte_mbuf *m = bufs[i];
+        struct rte_ether_hdr *eth_hdr;
+        uint16_t owner = worker_id;
+
+        if (i + PREFETCH_OFFSET < nb_rx)
+            rte_prefetch0(rte_pktmbuf_mtod(bufs[i + PREFETCH_OFFSET], void *));
+
+        eth_hdr = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+
+        if (eth_hdr->ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+            struct rte_ipv4_hdr *ip_hdr = (struct rte_ipv4_hdr *)(eth_hdr + 1);
+            uint16_t frag_off;
+
+            stats->total_packets++;
+            if (!is_ipv4_fragment(ip_hdr)) {
+                stats->non_fragments++;
+                output[nb_out++] = m;
+                continue;
+            }
+
+            frag_off = rte_be_to_cpu_16(ip_hdr->fragment_offset);
+            update_frag_stats(stats,
+                              (frag_off & RTE_IPV4_HDR_OFFSET_MASK) * 8,
+                              (frag_off & RTE_IPV4_HDR_MF_FLAG) != 0);
+
+            m->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV4;
+            m->l2_len = sizeof(struct rte_ether_hdr);
+            m->l3_len = rte_ipv4_hdr_len(ip_hdr);
+            if (nb_workers > 1)
+                owner = frag_owner_ipv4(ip_hdr);
+        } else if (eth_hdr->ether_type ==
+                   rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6)) {
+            struct rte_ipv6_hdr *ip6_hdr = (struct rte_ipv6_hdr *)(eth_hdr + 1);
+            struct rte_ipv6_fragment_ext *frag_hdr;
+            uint16_t frag_data;
+
+            stats->total_packets++;
+            /* 只识别紧跟在基本头之后的分片扩展头 */
+            frag_hdr = rte_ipv6_frag_get_ipv6_fragment_header(ip6_hdr);
+            if (frag_hdr == NULL) {
+                stats->non_fragments++;
+                output[nb_out++] = m;
+                continue;
+            }
+
+            frag_data = rte_be_to_cpu_16(frag_hdr->frag_data);
+            update_frag_stats(stats, RTE_IPV6_GET_FO(frag_data) * 8,
+                              RTE_IPV6_GET_MF(frag_data) != 0);
+            stats->ipv6_fragments++;
+
+            m->packet_type = RTE_PTYPE_L2_ETHER | RTE_PTYPE_L3_IPV6;
+            m->l2_len = sizeof(struct rte_ether_hdr);
+            m->l3_len = sizeof(*ip6_hdr) + sizeof(*frag_hdr);
+            if (nb_workers > 1)
+                owner = frag_owner_ipv6(ip6_hdr, frag_hdr);
+        } else {
+            /* 非 IP 包,直接输出 */
+            output[nb_out++] = m;
+            continue;
         }
 
-        /* 尝试重组 */
-        struct rte_mbuf *mo;
+        if (owner == worker_id) {
+            frags[(*nb_frag)++] = m;
+        } else {
+            steer[owner][steer_cnt[owner]++] = m;
+            steered = 1;
+        }
+    }
+
+    if (!steered)
+        return nb_out;
+
+    for (uint16_t w = 0; w < nb_workers; w++) {
+        uint16_t cnt = steer_cnt[w];
+        unsigned int sent;
+
+        if (cnt == 0)
+            continue;
+
+        sent = rte_ring_mp_enqueue_burst(frag_rings[w], (void **)steer[w],
+                                         cnt, NULL);
+        stats->handoff_tx += sent;
+        if (unlikely(sent < cnt)) {
+            rte_pktmbuf_free_bulk(&steer[w][sent], cnt - sent);
+            stats->handoff_drops += cnt - sent;
+        }
+    }
+
+    return nb_out;
+}
+
+/*
+ * 死亡行 [from, cnt) 中的 mbuf 段数
+ */
+static inline uint32_t
+death_row_segs(const struct rte_ip_frag_death_row *dr, uint32_t from)
+{
+    uint32_t segs = 0;
+
+    for (uint32_t i = from; i < dr->cnt; i++)
+        segs += dr->row[i]->nb_segs;
+
+    return segs;
+}
+
+/*
+ * 从回收行尾部归还最多 max 个 mbuf, 不需要移动剩余条目
+ */
+static void reclaim_free(struct frag_reclaim *rc, uint32_t max)
+{
+    struct rte_ip_frag_death_row *dr = &rc->row;
+    uint32_t n = RTE_MIN(dr->cnt, max);
+    uint32_t base;
+
+    if (n == 0)
+        return;
+
+    base = dr->cnt - n;
+    rc->stats->held_mbufs -= death_row_segs(dr, base);
+    rte_pktmbuf_free_bulk(&dr->row[base], n);
+    dr->cnt = base;
+}
+
+/*
+ * 过期扫描定时器 (在 worker 自己的 lcore 上由 rte_timer_manage() 调用)
+ *
+ * rte_ip_frag_table_del_expired_entries() 沿 LRU 从最老的条目开始删除,
+ * 死亡行放不下时停止, 所以单次扫描的工作量以死亡行容量为上限.
+ * 上一批还没归还完就跳过本周期, 不与 reclaim_free() 争用回收行
+ */
+static void
+frag_expire_cb(__rte_unused struct rte_timer *tim, void *arg)
+{
+    struct frag_reclaim *rc = arg;
+
+    if (rc->row.cnt != 0)
+        return;
+
+    rte_ip_frag_table_del_expired_entries(rc->tbl, &rc->row, rte_rdtsc());
+    rc->stats->timeouts += rc->row.cnt;
+}
+
+/*
+ * 按 LRU 淘汰最老的条目, 直到移出约 budget 个 mbuf
+ *
+ * 分片表对外不透明, 唯一能按 LRU 顺序删除条目的接口是
+ * rte_ip_frag_table_del_expired_entries(): tms 取 UINT64_MAX 使所有条目
+ * 都视为过期, 再把死亡行的剩余空间预先限制为 budget, 函数在空间不足时
+ * 停止, 从而只淘汰最老的一部分
+ */
+static void evict_oldest(struct frag_reclaim *rc, uint32_t budget)
+{
+    struct rte_ip_frag_death_row *dr = &rc->row;
+    uint32_t base, n;
+
+    budget = RTE_MIN(budget, (uint32_t)RTE_IP_FRAG_DEATH_ROW_MBUF_LEN);
+    base = RTE_IP_FRAG_DEATH_ROW_MBUF_LEN - budget;
+
+    dr->cnt = base;
+    rte_ip_frag_table_del_expired_entries(rc->tbl, dr, UINT64_MAX);
+    n = dr->cnt - base;
 
-        mo = rte_ipv4_frag_reassemble_packet(frag_tbl, dr, m,
-                                            cur_tsc, ip_hdr);
+    memmove(&dr->row[0], &dr->row[base], n * sizeof(dr->row[0]));
+    dr->cnt = n;
+    rc->stats->frag_evicted += n;
+}
+
+/*
+ * 硬上限: 占用超过 max_held_mbufs 时先归还回收行, 仍超限则按 LRU 淘汰,
+ * 淘汰出来的 mbuf 立即归还. 每次循环检查一次, 超出量不超过两个 burst
+ */
+static void enforce_held_cap(struct frag_reclaim *rc)
+{
+    struct frag_statistics *stats = rc->stats;
 
-        if (mo == NULL) {
-            /* 片段已缓存,等待其他片段 */
-            update_frag_stats(ip_hdr, 1, 0);
-            return NULL;
+    if (likely(stats->held_mbufs <= max_held_mbufs))
+        return;
+
+    reclaim_free(rc, rc->row.cnt);
+
+    if (stats->held_mbufs > max_held_mbufs) {
+        evict_oldest(rc, (uint32_t)(stats->held_mbufs - max_held_mbufs) +
+                         FRAG_EVICT_SLACK);
+        reclaim_free(rc, rc->row.cnt);
+    }
+}
+
+/*
+ * 分片重组
+ *
+ * 连续调用重组, 分片表相关的缓存行在这一段内保持热度
+ * 调用者每次调用后必须清空死亡行 (frags 最多 BURST_SIZE 个)
+ */
+static uint16_t
+reassemble_frags(struct rte_mbuf **frags, uint16_t nb_frag,
+                 struct rte_mbuf **output,
+                 struct rte_ip_frag_tbl *frag_tbl,
+                 struct rte_ip_frag_death_row *dr,
+                 struct frag_statistics *stats)
+{
+    uint16_t nb_out = 0;
+    uint64_t cur_tsc;
+
+    if (nb_frag == 0)
+        return 0;
+
+    cur_tsc = rte_rdtsc();
+
+    for (uint16_t i = 0; i < nb_frag; i++) {
+        struct rte_mbuf *m = frags[i];
+        struct rte_mbuf *mo;
+        uint32_t dr_before = dr->cnt;
+        int is_ipv6 = RTE_ETH_IS_IPV6_HDR(m->packet_type);
+
+        /* 片段交给分片表后由表持有, 直到重组完成或进入死亡行 */
+        stats->held_mbufs += m->nb_segs;
+
+        if (i + PREFETCH_OFFSET < nb_frag)
+            rte_prefetch0(rte_pktmbuf_mtod_offset(frags[i + PREFETCH_OFFSET],
+                                                  void *,
+                                                  sizeof(struct rte_ether_hdr)));
+
+        if (is_ipv6) {
+            struct rte_ipv6_hdr *ip6_hdr;
+
+            ip6_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv6_hdr *,
+                                              m->l2_len);
+            mo = rte_ipv6_frag_reassemble_packet(frag_tbl, dr, m, cur_tsc,
+                    ip6_hdr, rte_ipv6_frag_get_ipv6_fragment_header(ip6_hdr));
+        } else {
+            struct rte_ipv4_hdr *ip_hdr;
+
+            ip_hdr = rte_pktmbuf_mtod_offset(m, struct rte_ipv4_hdr *,
+                                             m->l2_len);
+            if (unlikely(verbose)) {
+                printf("\n→ Received fragment:\n");
+                print_packet_info(m, 0);
+            }
+            mo = rte_ipv4_frag_reassemble_packet(frag_tbl, dr, m, cur_tsc,
+                                                 ip_hdr);
+        }
+
+        /* 被放进死亡行的 mbuf: 表未命中、超时淘汰或非法片段 */
+        if (unlikely(dr->cnt != dr_before)) {
+            stats->frag_dropped += dr->cnt - dr_before;
+            stats->held_mbufs -= death_row_segs(dr, dr_before);
         }
 
+        if (mo == NULL)
+            continue;   /* 片段已缓存,等待其他片段 */
+
+        stats->held_mbufs -= mo->nb_segs;
+
         /* 重组成功 */
-        if (verbose) {
-            print_packet_info(mo, 1);
+        if (!is_ipv6) {
+            struct rte_ipv4_hdr *ip_hdr;
+
+            /* 重组库改写了 total_length/fragment_offset, 校验和需重算 */
+            ip_hdr = rte_pktmbuf_mtod_offset(mo, struct rte_ipv4_hdr *,
+                                             mo->l2_len);
+            ip_hdr->hdr_checksum = 0;
+            ip_hdr->hdr_checksum = rte_ipv4_cksum(ip_hdr);
+
+            if (unlikely(verbose))
+                print_packet_info(mo, 1);
         }
 
-        update_frag_stats(ip_hdr, 1, 1);
-        update_reassembled_stats(mo);
+        stats->reassembled++;
+        update_reassembled_stats(stats, mo);
+        output[nb_out++] = mo;
+    }
 
-        return mo;
-    } else {
-        /* 非分片包 */
-        update_frag_stats(ip_hdr, 0, 0);
-        return m;
+    return nb_out;
+}
+
+/*
+ * 出方向分片
+ *
+ * L3 长度不超过 mtu 的包原样放入 out[0]; 否则剥掉 L2 头后交给
+ * rte_ipv4/ipv6_fragment_packet, 每个片段是 direct mbuf (新 L3 头) 链上
+ * 引用原包数据的 indirect mbuf, 负载不复制. 原包随后释放 (片段持有引用),
+ * 再给每个片段补回 L2 头. 返回 out 中的包数, 0 表示已丢弃
+ */
+static uint16_t
+fragment_packet(struct rte_mbuf *m, struct rte_mbuf **out, uint16_t max_out,
+                uint16_t mtu, uint32_t *ipv6_frag_id,
+                struct frag_statistics *stats)
+{
+    struct rte_ether_hdr eth_hdr;
+    uint16_t ether_type;
+    int32_t n;
+
+    if (rte_pktmbuf_pkt_len(m) - sizeof(struct rte_ether_hdr) <= mtu) {
+        out[0] = m;
+        return 1;
+    }
+
+    rte_memcpy(&eth_hdr, rte_pktmbuf_mtod(m, void *), sizeof(eth_hdr));
+    ether_type = eth_hdr.ether_type;
+    rte_pktmbuf_adj(m, sizeof(struct rte_ether_hdr));
+
+    /* IPv4 DF 置位时返回 -ENOTSUP, 真实路由器应回 ICMP Frag Needed */
+    if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4))
+        n = rte_ipv4_fragment_packet(m, out, max_out, mtu,
+                                     direct_pool, indirect_pool);
+    else if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6))
+        n = rte_ipv6_fragment_packet(m, out, max_out, mtu,
+                                     direct_pool, indirect_pool);
+    else
+        n = -EINVAL;
+
+    rte_pktmbuf_free(m);
+
+    if (unlikely(n <= 0)) {
+        stats->egress_errors++;
+        return 0;
+    }
+
+    /* rte_ipv6_fragment_packet 把分片 id 填成 0, 这里按数据报重新编号 */
+    if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6))
+        (*ipv6_frag_id)++;
+
+    for (int32_t i = 0; i < n; i++) {
+        struct rte_mbuf *f = out[i];
+        struct rte_ether_hdr *eh;
+
+        eh = (struct rte_ether_hdr *)rte_pktmbuf_prepend(f, sizeof(*eh));
+        if (unlikely(eh == NULL)) {
+            /* direct mbuf 的 headroom 不够放 L2 头: 少一片整个数据报都无法重组, 全部丢弃 */
+            for (int32_t j = 0; j < n; j++)
+                rte_pktmbuf_free(out[j]);
+            stats->egress_errors++;
+            return 0;
+        }
+        rte_memcpy(eh, &eth_hdr, sizeof(*eh));
+        f->l2_len = sizeof(*eh);
+
+        if (ether_type == rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4)) {
+            struct rte_ipv4_hdr *ip_hdr = (struct rte_ipv4_hdr *)(eh + 1);
+
+            ip_hdr->hdr_checksum = 0;
+            ip_hdr->hdr_checksum = rte_ipv4_cksum(ip_hdr);
+        } else {
+            struct rte_ipv6_fragment_ext *frag_hdr;
+
+            frag_hdr = (struct rte_ipv6_fragment_ext *)
+                       ((struct rte_ipv6_hdr *)(eh + 1) + 1);
+            frag_hdr->id = rte_cpu_to_be_32(*ipv6_frag_id);
+        }
+    }
+
+    stats->egress_fragmented++;
+    stats->egress_fragments += n;
+    return (uint16_t)n;
+}
+
+/*
+ * 转发一个 burst: 按 MTU 切片后写入 TX 缓冲, 缓冲满 BURST_SIZE 自动发送
+ */
+static void
+egress_burst(struct rte_mbuf **pkts, uint16_t nb_pkts,
+             uint16_t port_id, uint16_t queue_id,
+             struct rte_eth_dev_tx_buffer *tx_buffer,
+             uint32_t *ipv6_frag_id, struct frag_statistics *stats)
+{
+    struct rte_mbuf *out[MAX_EGRESS_FRAGS];
+
+    for (uint16_t i = 0; i < nb_pkts; i++) {
+        uint16_t n = fragment_packet(pkts[i], out, MAX_EGRESS_FRAGS,
+                                     egress_mtu, ipv6_frag_id, stats);
+
+        for (uint16_t j = 0; j < n; j++)
+            stats->tx_packets += rte_eth_tx_buffer(port_id, queue_id,
+                                                   tx_buffer, out[j]);
     }
 }
 
@@ -295,29 +798,36 @@ handle_ipv4_packet(struct rte_mbuf *m,
  */
 static int worker_main(void *arg)
 {
-    uint16_t port_id = *(uint16_t *)arg;
+    struct worker_params *params = (struct worker_params *)arg;
+    uint16_t port_id = params->port_id;
+    uint16_t queue_id = params->queue_id;
+    uint16_t worker_id = params->worker_id;
     unsigned lcore_id = rte_lcore_id();
-    uint64_t cur_tsc, last_cleanup = 0;
     uint64_t hz = rte_get_timer_hz();
-    uint64_t timeout_cycles = (hz * FRAG_TIMEOUT_MS) / 1000;
+    uint64_t timeout_cycles = (hz * frag_timeout_ms) / 1000;
+    struct frag_statistics *stats = &frag_stats[lcore_id];
 
     struct rte_mbuf *bufs[BURST_SIZE];
-    struct rte_mbuf *output[BURST_SIZE];
-    uint16_t nb_rx, nb_out;
+    struct rte_mbuf *frags[BURST_SIZE];
+    struct rte_mbuf *output[2 * BURST_SIZE];
+    uint16_t nb_rx, nb_frag, nb_out;
+    struct rte_eth_dev_tx_buffer *tx_buffer = NULL;
+    uint32_t ipv6_frag_id = (uint32_t)lcore_id << 24;
+    uint64_t timer_resolution_cycles = hz * TIMER_RESOLUTION_MS / 1000;
+    uint64_t prev_tsc = 0, cur_tsc;
 
     /* 创建分片表 */
     struct rte_ip_frag_tbl *frag_tbl;
     struct rte_ip_frag_death_row death_row;
+    struct frag_reclaim reclaim;
 
-    uint32_t bucket_num = (MAX_FLOW_NUM + FRAG_TBL_BUCKET_ENTRIES - 1) /
-                         FRAG_TBL_BUCKET_ENTRIES;
-
+    /* 第 4 个参数是片段在表中的最长存活时间 (TSC 周期) */
     frag_tbl = rte_ip_frag_table_create(
-        bucket_num,
+        frag_bucket_num,
         FRAG_TBL_BUCKET_ENTRIES,
-        MAX_FLOW_NUM,
-        65535,  /* Max packet size */
-        rte_socket_id()
+        max_flow_num,
+        timeout_cycles,
+        rte_lcore_to_socket_id(lcore_id)
     );
 
     if (frag_tbl == NULL) {
@@ -325,122 +835,413 @@ static int worker_main(void *arg)
         return -1;
     }
 
-    printf("Worker core %u started (fragment table created)\n", lcore_id);
+    printf("Worker %u started on lcore %u, queue %u (fragment table created)\n",
+           worker_id, lcore_id, queue_id);
 
     /* 初始化死亡行 */
-    death_row.cnt = 0;
-
-    while (!force_quit) {
-        cur_tsc = rte_rdtsc();
-
-        /* 定期清理超时的片段 */
-        if (cur_tsc - last_cleanup > timeout_cycles) {
-            rte_ip_frag_free_death_row(&death_row, BURST_SIZE);
-            last_cleanup = cur_tsc;
+    memset(&death_row, 0, sizeof(death_row));
+
+    /*
+     * 过期扫描不依赖收包: 流量稀疏时, 分片表只在查找命中时才淘汰超时条目,
+     * 残留片段会一直占着 mbuf
+     */
+    memset(&reclaim, 0, sizeof(reclaim));
+    reclaim.tbl = frag_tbl;
+    reclaim.stats = stats;
+    rte_timer_init(&reclaim.expire_timer);
+    rte_timer_reset(&reclaim.expire_timer, hz * FRAG_EXPIRE_MS / 1000,
+                    PERIODICAL, lcore_id, frag_expire_cb, &reclaim);
+
+    /* 转发模式: 每个 worker 独占一个 TX 队列和缓冲 */
+    if (forward_mode) {
+        tx_buffer = rte_zmalloc_socket("tx_buffer",
+                                       RTE_ETH_TX_BUFFER_SIZE(BURST_SIZE), 0,
+                                       rte_lcore_to_socket_id(lcore_id));
+        if (tx_buffer == NULL) {
+            printf("Failed to allocate TX buffer on lcore %u\n", lcore_id);
+            rte_ip_frag_table_destroy(frag_tbl);
+            return -1;
         }
+        rte_eth_tx_buffer_init(tx_buffer, BURST_SIZE);
+        rte_eth_tx_buffer_set_err_callback(tx_buffer,
+                                           rte_eth_tx_buffer_count_callback,
+                                           &stats->tx_dropped);
+    }
 
-        /* 收包 */
-        nb_rx = rte_eth_rx_burst(port_id, lcore_id - 1, bufs, BURST_SIZE);
-
-        if (unlikely(nb_rx == 0))
-            continue;
-
+    while (!force_quit) {
         nb_out = 0;
 
-        /* 处理每个包 */
-        for (uint16_t i = 0; i < nb_rx; i++) {
-            struct rte_ether_hdr *eth_hdr;
-            uint16_t ether_type;
-
-            eth_hdr = rte_pktmbuf_mtod(bufs[i], struct rte_ether_hdr *);
-            ether_type = rte_be_to_cpu_16(eth_hdr->ether_type);
+        /* 定时器不需要很精确, 约每 10ms 调用一次 rte_timer_manage() */
+        cur_tsc = rte_get_timer_cycles();
+        if (cur_tsc - prev_tsc > timer_resolution_cycles) {
+            rte_timer_manage();
+            prev_tsc = cur_tsc;
+        }
 
-            if (ether_type == RTE_ETHER_TYPE_IPV4) {
-                struct rte_mbuf *m;
+        /* 过期 mbuf 分批归还, 每次循环的释放量有上限 */
+        reclaim_free(&reclaim, RECLAIM_FREE_BURST);
+        enforce_held_cap(&reclaim);
 
-                m = handle_ipv4_packet(bufs[i], frag_tbl, &death_row,
-                                      cur_tsc, 0);
+        /* 收包 */
+        nb_rx = rte_eth_rx_burst(port_id, queue_id, bufs, BURST_SIZE);
+
+        if (nb_rx > 0) {
+            nb_out = classify_burst(bufs, nb_rx, output, frags, &nb_frag,
+                                    worker_id, stats);
+            nb_out += reassemble_frags(frags, nb_frag, output + nb_out,
+                                       frag_tbl, &death_row, stats);
+
+            /*
+             * 每次重组后都清空死亡行: 一次最多会放入
+             * BURST_SIZE × (MAX_FRAG + 1) 个 mbuf, 正好等于死亡行容量
+             */
+            rte_ip_frag_free_death_row(&death_row, PREFETCH_OFFSET);
+        }
 
-                if (m != NULL) {
-                    output[nb_out++] = m;
-                }
-            } else {
-                /* 非 IPv4 包,直接输出 */
-                output[nb_out++] = bufs[i];
+        /* 其他 worker 转交过来的分片 */
+        if (nb_workers > 1) {
+            nb_frag = rte_ring_sc_dequeue_burst(frag_rings[worker_id],
+                                                (void **)frags, BURST_SIZE,
+                                                NULL);
+            if (nb_frag > 0) {
+                stats->handoff_rx += nb_frag;
+                nb_out += reassemble_frags(frags, nb_frag, output + nb_out,
+                                           frag_tbl, &death_row, stats);
+                rte_ip_frag_free_death_row(&death_row, PREFETCH_OFFSET);
             }
         }
 
-        /* 释放输出包 */
-        for (uint16_t i = 0; i < nb_out; i++) {
-            rte_pktmbuf_free(output[i]);
+        /* 转发或释放输出包 */
+        if (forward_mode) {
+            if (nb_out > 0)
+                egress_burst(output, nb_out, port_id, queue_id, tx_buffer,
+                             &ipv6_frag_id, stats);
+            stats->tx_packets += rte_eth_tx_buffer_flush(port_id, queue_id,
+                                                         tx_buffer);
+        } else if (nb_out > 0) {
+            rte_pktmbuf_free_bulk(output, nb_out);
         }
     }
 
     /* 清理 */
-    rte_ip_frag_free_death_row(&death_row, BURST_SIZE);
+    rte_timer_stop_sync(&reclaim.expire_timer);
+    reclaim_free(&reclaim, reclaim.row.cnt);
+    rte_ip_frag_free_death_row(&death_row, PREFETCH_OFFSET);
     rte_ip_frag_table_destroy(frag_tbl);
+    rte_free(tx_buffer);
 
     printf("Worker core %u stopped\n", lcore_id);
     return 0;
 }
 
+/*
+ * 聚合所有 lcore 的分片统计
+ */
+static void aggregate_frag_stats(struct frag_statistics *total)
+{
+    unsigned lcore_id;
+
+    memset(total, 0, sizeof(*total));
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const uint64_t *src = (const uint64_t *)&frag_stats[lcore_id];
+        uint64_t *dst = (uint64_t *)total;
+
+        /* frag_statistics 全部由 uint64_t 组成, 逐字段累加 */
+        for (size_t i = 0; i < sizeof(*total) / sizeof(uint64_t); i++)
+            dst[i] += src[i];
+    }
+}
+
 /*
  * 打印分片统计
  */
 static void print_frag_statistics(void)
 {
+    struct frag_statistics total;
+
+    aggregate_frag_stats(&total);
+
     printf("\n╔════════════════════════════════════════════════════════╗\n");
     printf("║         IP Fragmentation Statistics                    ║\n");
     printf("╚════════════════════════════════════════════════════════╝\n");
 
     printf("\nOverall:\n");
-    printf("  Total Packets:    %15"PRIu64"\n", frag_stats.total_packets);
+    printf("  Total Packets:    %15"PRIu64"\n", total.total_packets);
     printf("  Non-fragments:    %15"PRIu64" (%.1f%%)\n",
-           frag_stats.non_fragments,
-           frag_stats.total_packets > 0 ?
-           (double)frag_stats.non_fragments * 100.0 / frag_stats.total_packets : 0);
+           total.non_fragments,
+           total.total_packets > 0 ?
+           (double)total.non_fragments * 100.0 / total.total_packets : 0);
     printf("  Total Fragments:  %15"PRIu64" (%.1f%%)\n",
-           frag_stats.total_fragments,
-           frag_stats.total_packets > 0 ?
-           (double)frag_stats.total_fragments * 100.0 / frag_stats.total_packets : 0);
+           total.total_fragments,
+           total.total_packets > 0 ?
+           (double)total.total_fragments * 100.0 / total.total_packets : 0);
+    printf("    IPv4:           %15"PRIu64"\n",
+           total.total_fragments - total.ipv6_fragments);
+    printf("    IPv6:           %15"PRIu64"\n", total.ipv6_fragments);
 
     printf("\nFragment Types:\n");
-    printf("  First Fragments:  %15"PRIu64"\n", frag_stats.first_fragments);
-    printf("  Middle Fragments: %15"PRIu64"\n", frag_stats.middle_fragments);
-    printf("  Last Fragments:   %15"PRIu64"\n", frag_stats.last_fragments);
+    printf("  First Fragments:  %15"PRIu64"\n", total.first_fragments);
+    printf("  Middle Fragments: %15"PRIu64"\n", total.middle_fragments);
+    printf("  Last Fragments:   %15"PRIu64"\n", total.last_fragments);
 
     printf("\nReassembly:\n");
-    printf("  Reassembled:      %15"PRIu64"\n", frag_stats.reassembled);
-    printf("  Timeouts:         %15"PRIu64"\n", frag_stats.timeouts);
-    printf("  Errors:           %15"PRIu64"\n", frag_stats.errors);
+    printf("  Reassembled:      %15"PRIu64" (IPv6: %"PRIu64")\n",
+           total.reassembled, total.reassembled_ipv6);
+    printf("  Dropped mbufs:    %15"PRIu64"\n", total.frag_dropped);
+    printf("  Expired mbufs:    %15"PRIu64"\n", total.timeouts);
+    printf("  Evicted mbufs:    %15"PRIu64"\n", total.frag_evicted);
+    printf("  Held mbufs:       %15"PRIu64" (cap %u per lcore)\n",
+           total.held_mbufs, max_held_mbufs);
+    printf("  Errors:           %15"PRIu64"\n", total.errors);
+
+    if (nb_workers > 1) {
+        printf("\nCross-core Steering:\n");
+        printf("  Handed off:       %15"PRIu64" (%.1f%% of fragments)\n",
+               total.handoff_tx,
+               total.total_fragments > 0 ?
+               (double)total.handoff_tx * 100.0 / total.total_fragments : 0);
+        printf("  Received:         %15"PRIu64"\n", total.handoff_rx);
+        printf("  Ring Drops:       %15"PRIu64"\n", total.handoff_drops);
+    }
+
+    if (forward_mode) {
+        printf("\nEgress (MTU %u):\n", egress_mtu);
+        printf("  TX Packets:       %15"PRIu64"\n", total.tx_packets);
+        printf("  TX Dropped:       %15"PRIu64"\n", total.tx_dropped);
+        printf("  Fragmented:       %15"PRIu64" -> %"PRIu64" fragments\n",
+               total.egress_fragmented, total.egress_fragments);
+        printf("  Frag Errors:      %15"PRIu64"\n", total.egress_errors);
+    }
 
-    if (frag_stats.reassembled > 0) {
+    if (total.reassembled > 0) {
         printf("\nReassembled Packet Protocols:\n");
         printf("  TCP:              %15"PRIu64" (%.1f%%)\n",
-               frag_stats.reassembled_tcp,
-               (double)frag_stats.reassembled_tcp * 100.0 / frag_stats.reassembled);
+               total.reassembled_tcp,
+               (double)total.reassembled_tcp * 100.0 / total.reassembled);
         printf("  UDP:              %15"PRIu64" (%.1f%%)\n",
-               frag_stats.reassembled_udp,
-               (double)frag_stats.reassembled_udp * 100.0 / frag_stats.reassembled);
+               total.reassembled_udp,
+               (double)total.reassembled_udp * 100.0 / total.reassembled);
         printf("  Other:            %15"PRIu64" (%.1f%%)\n",
-               frag_stats.reassembled_other,
-               (double)frag_stats.reassembled_other * 100.0 / frag_stats.reassembled);
+               total.reassembled_other,
+               (double)total.reassembled_other * 100.0 / total.reassembled);
 
         printf("\nReassembled Packet Sizes:\n");
-        printf("  < 1500:           %15"PRIu64"\n", frag_stats.size_lt_1500);
-        printf("  1500-3000:        %15"PRIu64"\n", frag_stats.size_1500_3000);
-        printf("  3000-5000:        %15"PRIu64"\n", frag_stats.size_3000_5000);
-        printf("  > 5000:           %15"PRIu64"\n", frag_stats.size_gt_5000);
+        printf("  < 1500:           %15"PRIu64"\n", total.size_lt_1500);
+        printf("  1500-3000:        %15"PRIu64"\n", total.size_1500_3000);
+        printf("  3000-5000:        %15"PRIu64"\n", total.size_3000_5000);
+        printf("  > 5000:           %15"PRIu64"\n", total.size_gt_5000);
     }
 
     /* 计算重组率 */
-    if (frag_stats.first_fragments > 0) {
-        double reassembly_rate = (double)frag_stats.reassembled * 100.0 /
-                                frag_stats.first_fragments;
+    if (total.first_fragments > 0) {
+        double reassembly_rate = (double)total.reassembled * 100.0 /
+                                total.first_fragments;
         printf("\nReassembly Success Rate: %.1f%%\n", reassembly_rate);
     }
 }
 
+/*
+ * 构造基准测试用数据报: Ethernet + IPv4/IPv6 + UDP, L3 总长 l3_len
+ */
+static struct rte_mbuf *
+build_bench_datagram(int is_ipv6, uint16_t l3_len, uint16_t id)
+{
+    static const uint8_t src6[16] = {0xfd, 0, 0, 0, 0, 0, 0, 0,
+                                     0, 0, 0, 0, 0, 0, 0, 1};
+    static const uint8_t dst6[16] = {0xfd, 0, 0, 0, 0, 0, 0, 0,
+                                     0, 0, 0, 0, 0, 0, 0, 2};
+    struct rte_ether_hdr *eth_hdr;
+    struct rte_udp_hdr *udp_hdr;
+    struct rte_mbuf *m;
+    uint16_t l4_len;
+
+    m = rte_pktmbuf_alloc(direct_pool);
+    if (m == NULL)
+        return NULL;
+
+    eth_hdr = (struct rte_ether_hdr *)rte_pktmbuf_append(m,
+                  sizeof(struct rte_ether_hdr) + l3_len);
+    if (eth_hdr == NULL) {
+        rte_pktmbuf_free(m);
+        return NULL;
+    }
+    memset(eth_hdr, 0, sizeof(struct rte_ether_hdr) + l3_len);
+
+    if (is_ipv6) {
+        struct rte_ipv6_hdr *ip6_hdr = (struct rte_ipv6_hdr *)(eth_hdr + 1);
+
+        eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV6);
+        ip6_hdr->vtc_flow = rte_cpu_to_be_32(6 << 28);
+        ip6_hdr->payload_len = rte_cpu_to_be_16(l3_len - sizeof(*ip6_hdr));
+        ip6_hdr->proto = IPPROTO_UDP;
+        ip6_hdr->hop_limits = 64;
+        memcpy(&ip6_hdr->src_addr, src6, sizeof(src6));
+        memcpy(&ip6_hdr->dst_addr, dst6, sizeof(dst6));
+        l4_len = l3_len - sizeof(*ip6_hdr);
+    } else {
+        struct rte_ipv4_hdr *ip_hdr = (struct rte_ipv4_hdr *)(eth_hdr + 1);
+
+        eth_hdr->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+        ip_hdr->version_ihl = RTE_IPV4_VHL_DEF;
+        ip_hdr->total_length = rte_cpu_to_be_16(l3_len);
+        ip_hdr->packet_id = rte_cpu_to_be_16(id);
+        ip_hdr->time_to_live = 64;
+        ip_hdr->next_proto_id = IPPROTO_UDP;
+        ip_hdr->src_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 1));
+        ip_hdr->dst_addr = rte_cpu_to_be_32(RTE_IPV4(10, 0, 0, 2));
+        ip_hdr->hdr_checksum = rte_ipv4_cksum(ip_hdr);
+        l4_len = l3_len - sizeof(*ip_hdr);
+    }
+
+    udp_hdr = rte_pktmbuf_mtod_offset(m, struct rte_udp_hdr *,
+                                      sizeof(struct rte_ether_hdr) +
+                                      l3_len - l4_len);
+    udp_hdr->src_port = rte_cpu_to_be_16(1024 + id);
+    udp_hdr->dst_port = rte_cpu_to_be_16(4789);
+    udp_hdr->dgram_len = rte_cpu_to_be_16(l4_len);
+
+    return m;
+}
+
+/*
+ * 双向基准测试 (单核, 不需要网卡)
+ *
+ * 出方向: BENCH_BATCH 个模板数据报经 fragment_packet 切片, 模板靠引用计数
+ *         复用, 计时只覆盖切片本身
+ * 入方向: 切出的片段按 BURST_SIZE 分批走 classify_burst + reassemble_frags,
+ *         与 worker 收包路径完全相同; 重组结果校验长度后释放 (不计时)
+ */
+static void benchmark_fragmentation(void)
+{
+    static const struct {
+        int is_ipv6;
+        uint16_t l3_len;
+        uint16_t mtu;
+    } cases[] = {
+        {0, 2000, 1500}, {0, 4000, 1500}, {0, 4000, 1280},
+        {1, 2000, 1500}, {1, 4000, 1500}, {1, 4000, 1280},
+    };
+    struct rte_mbuf *tmpl[BENCH_BATCH];
+    struct rte_mbuf *frag_out[BENCH_BATCH * MAX_EGRESS_FRAGS];
+    struct rte_mbuf *reasm[BENCH_BATCH];
+    struct rte_mbuf *frags[BURST_SIZE];
+    struct rte_ip_frag_death_row death_row;
+    struct rte_ip_frag_tbl *frag_tbl;
+    struct frag_statistics st;
+    uint64_t hz = rte_get_timer_hz();
+    uint32_t ipv6_frag_id = 0;
+
+    frag_tbl = rte_ip_frag_table_create(frag_bucket_num,
+                                        FRAG_TBL_BUCKET_ENTRIES,
+                                        max_flow_num,
+                                        (hz * frag_timeout_ms) / 1000,
+                                        rte_socket_id());
+    if (frag_tbl == NULL) {
+        printf("Failed to create fragment table\n");
+        return;
+    }
+    memset(&death_row, 0, sizeof(death_row));
+    nb_workers = 1;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║     Fragmentation / Reassembly Benchmark               ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Proto  L3 Size  MTU   Frags   Egress cyc  Mpps    Ingress cyc  Mpps    Check\n");
+    printf("───────────────────────────────────────────────────────────────────────────────\n");
+
+    for (size_t c = 0; c < RTE_DIM(cases); c++) {
+        uint64_t egress_cycles = 0, ingress_cycles = 0;
+        uint64_t nb_frags = 0, nb_ok = 0, nb_total = 0;
+        uint32_t full_len = sizeof(struct rte_ether_hdr) + cases[c].l3_len;
+        int failed = 0;
+
+        memset(&st, 0, sizeof(st));
+
+        for (uint16_t i = 0; i < BENCH_BATCH; i++) {
+            tmpl[i] = build_bench_datagram(cases[c].is_ipv6,
+                                           cases[c].l3_len, i);
+            if (tmpl[i] == NULL) {
+                rte_pktmbuf_free_bulk(tmpl, i);
+                failed = 1;
+                break;
+            }
+        }
+        if (failed) {
+            printf("Cannot build %u-byte datagrams (mbuf data room too small)\n",
+                   cases[c].l3_len);
+            continue;
+        }
+
+        for (unsigned int iter = 0; iter < BENCH_ITERATIONS; iter++) {
+            uint32_t nb_out = 0, nb_reasm = 0;
+            uint64_t start;
+
+            /* 切片会释放输入, 先加一次引用保住模板 */
+            for (uint16_t i = 0; i < BENCH_BATCH; i++)
+                rte_mbuf_refcnt_update(tmpl[i], 1);
+
+            start = rte_rdtsc();
+            for (uint16_t i = 0; i < BENCH_BATCH; i++)
+                nb_out += fragment_packet(tmpl[i], &frag_out[nb_out],
+                                          MAX_EGRESS_FRAGS, cases[c].mtu,
+                                          &ipv6_frag_id, &st);
+            egress_cycles += rte_rdtsc() - start;
+            nb_frags += nb_out;
+
+            /* fragment_packet 剥掉了模板的 L2 头, 数据仍在缓冲区里, 复原即可 */
+            for (uint16_t i = 0; i < BENCH_BATCH; i++) {
+                if (rte_pktmbuf_pkt_len(tmpl[i]) != full_len)
+                    rte_pktmbuf_prepend(tmpl[i],
+                                        sizeof(struct rte_ether_hdr));
+            }
+
+            start = rte_rdtsc();
+            for (uint32_t off = 0; off < nb_out; off += BURST_SIZE) {
+                uint16_t cnt = (uint16_t)RTE_MIN(nb_out - off,
+                                                 (uint32_t)BURST_SIZE);
+                uint16_t nb_frag, n;
+
+                n = classify_burst(&frag_out[off], cnt, &reasm[nb_reasm],
+                                   frags, &nb_frag, 0, &st);
+                n += reassemble_frags(frags, nb_frag, &reasm[nb_reasm + n],
+                                      frag_tbl, &death_row, &st);
+                rte_ip_frag_free_death_row(&death_row, PREFETCH_OFFSET);
+                nb_reasm += n;
+            }
+            ingress_cycles += rte_rdtsc() - start;
+
+            for (uint32_t i = 0; i < nb_reasm; i++) {
+                if (rte_pktmbuf_pkt_len(reasm[i]) == full_len)
+                    nb_ok++;
+            }
+            nb_total += BENCH_BATCH;
+            rte_pktmbuf_free_bulk(reasm, nb_reasm);
+        }
+
+        rte_pktmbuf_free_bulk(tmpl, BENCH_BATCH);
+
+        double egress_cpp = (double)egress_cycles / nb_total;
+        double ingress_cpp = (double)ingress_cycles / nb_total;
+
+        printf("%-5s  %7u  %4u  %5.1f   %10.1f  %5.2f   %11.1f  %5.2f   %s\n",
+               cases[c].is_ipv6 ? "IPv6" : "IPv4",
+               cases[c].l3_len, cases[c].mtu,
+               (double)nb_frags / nb_total,
+               egress_cpp, hz / egress_cpp / 1e6,
+               ingress_cpp, hz / ingress_cpp / 1e6,
+               nb_ok == nb_total ? "OK" : "FAIL");
+        if (st.egress_errors > 0 || st.frag_dropped > 0)
+            printf("       egress errors: %"PRIu64", dropped mbufs: %"PRIu64"\n",
+                   st.egress_errors, st.frag_dropped);
+    }
+
+    printf("\n(cycles and Mpps are per datagram; Mpps = single-core rate)\n\n");
+
+    rte_ip_frag_table_destroy(frag_tbl);
+}
+
 /*
  * 初始化端口
  */
@@ -448,14 +1249,23 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
                      uint16_t nb_queues)
 {
     struct rte_eth_conf port_conf;
+    struct rte_eth_dev_info dev_info;
     int ret;
 
+    ret = rte_eth_dev_info_get(port, &dev_info);
+    if (ret != 0)
+        return ret;
+
     memset(&port_conf, 0, sizeof(struct rte_eth_conf));
     port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
     port_conf.rx_adv_conf.rss_conf.rss_hf =
         RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP;
 
-    ret = rte_eth_dev_configure(port, nb_queues, 1, &port_conf);
+    /* 重组后的包和出方向片段都是多段 mbuf */
+    if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MULTI_SEGS)
+        port_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MULTI_SEGS;
+
+    ret = rte_eth_dev_configure(port, nb_queues, nb_queues, &port_conf);
     if (ret != 0)
         return ret;
 
@@ -467,10 +1277,13 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
             return ret;
     }
 
-    ret = rte_eth_tx_queue_setup(port, 0, TX_RING_SIZE,
-                                 rte_eth_dev_socket_id(port), NULL);
-    if (ret < 0)
-        return ret;
+    /* 每个 worker 一个 TX 队列 */
+    for (uint16_t q = 0; q < nb_queues; q++) {
+        ret = rte_eth_tx_queue_setup(port, q, TX_RING_SIZE,
+                                     rte_eth_dev_socket_id(port), NULL);
+        if (ret < 0)
+            return ret;
+    }
 
     ret = rte_eth_dev_start(port);
     if (ret < 0)
@@ -480,6 +1293,89 @@ static int port_init(uint16_t port, struct rte_mempool *mbuf_pool,
     return ret;
 }
 
+/*
+ * 打印使用说明
+ */
+static void print_usage(const char *prgname)
+{
+    printf("\nUsage: %s [EAL options] -- [options]\n\n", prgname);
+    printf("Options:\n");
+    printf("  -r RATE    Expected fragmented datagrams/s per lcore (default: %u)\n",
+           DEFAULT_FRAG_RATE);
+    printf("  -t MS      Fragment timeout in ms (default: %u)\n", FRAG_TIMEOUT_MS);
+    printf("  -c MBUFS   Max mbufs held by pending fragments per lcore\n"
+           "             (default: flow table size x %u, at most %u)\n",
+           FRAG_MBUFS_PER_FLOW, HELD_MBUFS_DEFAULT_MAX);
+    printf("  -v         Print every fragment and reassembled packet\n");
+    printf("  -f         Forward: fragment to egress MTU and transmit\n");
+    printf("  -m MTU     Egress MTU (default: port MTU)\n");
+    printf("  -b         Run the offline fragment/reassemble benchmark and exit\n");
+    printf("\nExample:\n");
+    printf("  %s -l 0-4 -- -r 50000 -t 2000\n", prgname);
+    printf("  %s -l 0-4 -- -f -m 1400\n", prgname);
+    printf("  %s -l 0 --no-pci -- -b\n\n", prgname);
+}
+
+/*
+ * 解析命令行参数
+ */
+static int parse_args(int argc, char **argv)
+{
+    int opt;
+    int mtu;
+
+    while ((opt = getopt(argc, argv, "r:t:c:vfm:bh")) != -1) {
+        switch (opt) {
+        case 'r':
+            frag_rate = (uint32_t)atoi(optarg);
+            if (frag_rate == 0) {
+                printf("Invalid fragment rate\n");
+                return -1;
+            }
+            break;
+        case 't':
+            frag_timeout_ms = (uint32_t)atoi(optarg);
+            if (frag_timeout_ms == 0) {
+                printf("Invalid fragment timeout\n");
+                return -1;
+            }
+            break;
+        case 'c':
+            max_held_mbufs = (uint32_t)atoi(optarg);
+            if (max_held_mbufs == 0) {
+                printf("Invalid held mbuf cap\n");
+                return -1;
+            }
+            break;
+        case 'v':
+            verbose = 1;
+            break;
+        case 'f':
+            forward_mode = 1;
+            break;
+        case 'm':
+            mtu = atoi(optarg);
+            if (mtu < RTE_ETHER_MIN_MTU || mtu > UINT16_MAX) {
+                printf("Invalid MTU\n");
+                return -1;
+            }
+            egress_mtu = (uint16_t)mtu;
+            break;
+        case 'b':
+            bench_mode = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            exit(0);
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 /*
  * 主函数
  */
@@ -490,6 +1386,8 @@ int main(int argc, char *argv[])
     unsigned lcore_id;
     int ret;
     uint16_t nb_queues;
+    struct worker_params params[MAX_WORKERS];
+    uint16_t w = 0;
 
     signal(SIGINT, signal_handler);
     signal(SIGTERM, signal_handler);
@@ -498,28 +1396,87 @@ int main(int argc, char *argv[])
     if (ret < 0)
         rte_panic("Cannot init EAL\n");
 
+    argc -= ret;
+    argv += ret;
+
+    if (parse_args(argc, argv) < 0)
+        rte_exit(EXIT_FAILURE, "Invalid arguments\n");
+
+    compute_frag_table_size();
+    if (max_held_mbufs == 0)
+        max_held_mbufs = RTE_MIN(max_flow_num * FRAG_MBUFS_PER_FLOW,
+                                 (uint32_t)HELD_MBUFS_DEFAULT_MAX);
+
+    ret = rte_timer_subsystem_init();
+    if (ret < 0)
+        rte_exit(EXIT_FAILURE, "Cannot init timer subsystem\n");
+
     printf("\n");
     printf("╔════════════════════════════════════════════════════════╗\n");
     printf("║   DPDK IP Fragmentation & Reassembly - Lesson 21      ║\n");
     printf("╚════════════════════════════════════════════════════════╝\n");
 
+    /*
+     * 基准测试: direct pool 放模板、片段头和重组链, indirect pool
+     * 只有 mbuf 头 (data room 为 0), 用来引用原包数据
+     */
+    if (bench_mode) {
+        direct_pool = rte_pktmbuf_pool_create("MBUF_POOL", NUM_MBUFS,
+                MBUF_CACHE_SIZE, 0, RTE_MBUF_DEFAULT_BUF_SIZE + 2048,
+                rte_socket_id());
+        indirect_pool = rte_pktmbuf_pool_create("INDIRECT_POOL", NUM_MBUFS,
+                MBUF_CACHE_SIZE, 0, 0, rte_socket_id());
+        if (direct_pool == NULL || indirect_pool == NULL)
+            rte_exit(EXIT_FAILURE, "Cannot create mbuf pools\n");
+
+        benchmark_fragmentation();
+
+        rte_mempool_free(indirect_pool);
+        rte_mempool_free(direct_pool);
+        rte_timer_subsystem_finalize();
+        rte_eal_cleanup();
+        return 0;
+    }
+
     if (rte_eth_dev_count_avail() == 0)
         rte_exit(EXIT_FAILURE, "No Ethernet ports available\n");
 
     nb_queues = rte_lcore_count() - 1;
     if (nb_queues == 0)
         rte_exit(EXIT_FAILURE, "Need at least 2 lcores\n");
+    if (nb_queues > MAX_WORKERS)
+        nb_queues = MAX_WORKERS;
+    nb_workers = nb_queues;
 
     printf("\nConfiguration:\n");
     printf("  Port: %u\n", port_id);
     printf("  Queues: %u\n", nb_queues);
-    printf("  Max flows: %u\n", MAX_FLOW_NUM);
-    printf("  Fragment timeout: %u ms\n", FRAG_TIMEOUT_MS);
+    printf("  Expected fragment rate: %u datagrams/s per lcore\n", frag_rate);
+    printf("  Fragment timeout: %u ms\n", frag_timeout_ms);
+    printf("  Max flows: %u per lcore\n", max_flow_num);
+    printf("  Buckets: %u x %u entries (avg load %.1f per bucket)\n",
+           frag_bucket_num, FRAG_TBL_BUCKET_ENTRIES,
+           (double)max_flow_num / frag_bucket_num);
+    printf("  Held mbuf cap: %u per lcore (expiry scan every %u ms)\n",
+           max_held_mbufs, FRAG_EXPIRE_MS);
+
+    /*
+     * 创建 mbuf pool (需要支持大包)
+     * 除收包所需外, 还要为每个 lcore 分片表中等待重组的片段预留 mbuf;
+     * 占用超过 max_held_mbufs 就淘汰, 按这个硬上限预留就够了
+     */
+    uint64_t nb_mbufs = ((uint64_t)NUM_MBUFS + max_held_mbufs) * nb_queues;
+    uint32_t mbuf_size = sizeof(struct rte_mbuf) + RTE_MBUF_DEFAULT_BUF_SIZE + 2048;
+
+    printf("  MBUF pool: %"PRIu64" mbufs, about %"PRIu64" MB\n",
+           nb_mbufs, nb_mbufs * mbuf_size >> 20);
+    if (nb_mbufs > MAX_POOL_MBUFS)
+        rte_exit(EXIT_FAILURE, "MBUF pool too large (limit %u mbufs), lower -c\n",
+                 MAX_POOL_MBUFS);
 
-    /* 创建 mbuf pool (需要支持大包) */
     mbuf_pool = rte_pktmbuf_pool_create(
         "MBUF_POOL",
-        NUM_MBUFS * nb_queues,
+        (uint32_t)nb_mbufs,
         MBUF_CACHE_SIZE,
         0,
         RTE_MBUF_DEFAULT_BUF_SIZE + 2048,  /* 支持更大的重组包 */
@@ -529,14 +1486,59 @@ int main(int argc, char *argv[])
     if (mbuf_pool == NULL)
         rte_exit(EXIT_FAILURE, "Cannot create mbuf pool\n");
 
+    /*
+     * 片段头单独一个小 pool: 只放 L3 头 (L2 头补在 headroom 里),
+     * 转发再多也不会占用收包和重组依赖的大 mbuf;
+     * indirect mbuf 只引用原包数据, 不需要 data room
+     */
+    if (forward_mode) {
+        direct_pool = rte_pktmbuf_pool_create("DIRECT_POOL",
+                NUM_MBUFS * nb_queues, MBUF_CACHE_SIZE, 0,
+                RTE_PKTMBUF_HEADROOM + DIRECT_DATA_ROOM, rte_socket_id());
+        indirect_pool = rte_pktmbuf_pool_create("INDIRECT_POOL",
+                NUM_MBUFS * nb_queues, MBUF_CACHE_SIZE, 0, 0,
+                rte_socket_id());
+        if (direct_pool == NULL || indirect_pool == NULL)
+            rte_exit(EXIT_FAILURE, "Cannot create fragment mbuf pools\n");
+    }
+
     ret = port_init(port_id, mbuf_pool, nb_queues);
     if (ret != 0)
         rte_exit(EXIT_FAILURE, "Cannot init port %u\n", port_id);
 
+    if (forward_mode && egress_mtu == 0) {
+        ret = rte_eth_dev_get_mtu(port_id, &egress_mtu);
+        if (ret != 0)
+            rte_exit(EXIT_FAILURE, "Cannot get MTU of port %u\n", port_id);
+    }
+    if (forward_mode)
+        printf("  Forwarding: fragment to MTU %u, TX on queue = worker id\n",
+               egress_mtu);
+
+    /* 每个 worker 一个分片转交 ring: 所有 worker 都可能写入, 只有属主读取 */
+    if (nb_workers > 1) {
+        for (uint16_t i = 0; i < nb_workers; i++) {
+            char name[RTE_RING_NAMESIZE];
+
+            snprintf(name, sizeof(name), "frag_ring_%u", i);
+            frag_rings[i] = rte_ring_create(name, FRAG_RING_SIZE,
+                                            rte_socket_id(), RING_F_SC_DEQ);
+            if (frag_rings[i] == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot create ring %s\n", name);
+        }
+    }
+
     /* 启动 worker 核心 */
     printf("\n=== Starting Workers ===\n");
     RTE_LCORE_FOREACH_WORKER(lcore_id) {
-        rte_eal_remote_launch(worker_main, &port_id, lcore_id);
+        if (w >= nb_workers)
+            break;
+
+        params[w].port_id = port_id;
+        params[w].queue_id = w;
+        params[w].worker_id = w;
+        rte_eal_remote_launch(worker_main, &params[w], lcore_id);
+        w++;
     }
 
     printf("\n=== Monitoring (Press Ctrl+C to quit) ===\n");
@@ -561,6 +1563,17 @@ int main(int argc, char *argv[])
     printf("\nWaiting for workers to stop...\n");
     rte_eal_mp_wait_lcore();
 
+    /* 归还 worker 退出后仍留在转交 ring 中的分片 */
+    for (uint16_t i = 0; i < nb_workers; i++) {
+        struct rte_mbuf *m;
+
+        if (frag_rings[i] == NULL)
+            continue;
+        while (rte_ring_dequeue(frag_rings[i], (void **)&m) == 0)
+            rte_pktmbuf_free(m);
+        rte_ring_free(frag_rings[i]);
+    }
+
     /* 最终统计 */
     printf("\n=== Final Statistics ===\n");
     print_frag_statistics();
@@ -570,6 +1583,7 @@ int main(int argc, char *argv[])
         printf("Port stop failed: %s\n", rte_strerror(-ret));
 
     rte_eth_dev_close(port_id);
+    rte_timer_subsystem_finalize();
     rte_eal_cleanup();
 
     printf("\nProgram exited cleanly.\n");
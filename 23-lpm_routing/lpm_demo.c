@@ -7,32 +7,108 @@
  * 3. 单个和批量路由查找
  * 4. 模拟数据包转发
  * 5. 路由查找性能测试
+ * 6. 多核查找 + 控制线程实时增删路由 (RCU 回收 tbl8)
+ * 7. 统一路由接口: rte_lpm / rte_fib (IPv4), rte_lpm6 / rte_fib6 (IPv6),
+ *    全表规模下比较查找速度和内存占用
+ * 8. 从文本或 MRT 转储导入全表, 按前缀长度排序后批量建表, 自动估算 tbl8
+ * 9. 数百万地址上的均匀 / Zipf 流量, 冷热缓存两种模式, 结果写入 CSV
+ * 10. ECMP 下一跳组和基于 mbuf 的 L3 转发 (-F 在真实端口上转发)
+ * 11. 每 lcore 的路由缓存, 路由表版本号变化时整体失效
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <inttypes.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <signal.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
 
 #include <rte_eal.h>
 #include <rte_lcore.h>
 #include <rte_ethdev.h>
 #include <rte_mbuf.h>
+#include <rte_ether.h>
+#include <rte_udp.h>
+#include <rte_jhash.h>
+#include <rte_vect.h>
 #include <rte_lpm.h>
+#include <rte_lpm6.h>
+#include <rte_fib.h>
+#include <rte_fib6.h>
+#include <rte_rcu_qsbr.h>
+#include <rte_malloc.h>
+#include <rte_thread.h>
+#include <rte_pause.h>
 #include <rte_cycles.h>
 #include <rte_random.h>
 #include <rte_ip.h>
 
 /* 配置参数 */
-#define MAX_ROUTES          1024
-#define NUM_TBL8S           256
+#define MAX_ROUTES          4096
+#define NUM_TBL8S           1024
 #define MBUF_CACHE_SIZE     256
 #define NUM_MBUFS           8191
 #define BURST_SIZE          32
-#define TEST_ITERATIONS     1000000
+
+/* 查找基准的流量模型 */
+#define DEFAULT_NB_DESTS    (1 << 22)   /* 目的地址集合大小 */
+#define DEFAULT_ZIPF_S      1.0         /* Zipf 指数, 越大越集中 */
+#define TRACE_LEN           (1 << 23)   /* 每种分布的查找序列长度 (32MB) */
+#define MAX_LOOKUP_BATCH    64
+#define EVICT_BYTES         (64 << 20)  /* 冷缓存模式每轮写一遍, 需大于 LLC */
+#define COLD_LOOKUPS        (1 << 16)   /* 冷缓存模式每轮计时的查找数 */
+#define COLD_ROUNDS         32
+#define FORWARD_PACKETS     (1 << 20)
+#define DEFAULT_CSV_FILE    "lpm_bench.csv"
+
+/* 多核查找 + 路由抖动 */
+#define LOOKUP_SET_SIZE     (1 << 16)   /* 查找地址集合 (2 的幂, BURST_SIZE 的倍数) */
+#define CHURN_WINDOW        2048        /* 同时存在的抖动路由数 */
+#define CHURN_SLOTS         (1 << 14)   /* 100.64.0.0/10 内的 /24 个数 */
+#define DEFAULT_CHURN_RATE  10000       /* 每秒路由更新数 (add + delete) */
+#define DEFAULT_PHASE_SEC   5           /* 每个测量阶段的秒数 */
+
+/* 全表后端对比 */
+#define DEFAULT_V4_ROUTES   1000000     /* 约等于当前 IPv4 全球路由表 */
+#define DEFAULT_V6_ROUTES   200000      /* 约等于当前 IPv6 全球路由表 */
+#define ROUTE_BULK_MAX      64          /* route_table_lookup_bulk 单次上限 */
+#define ROUTE_NO_NH         UINT32_MAX  /* 未命中 */
+#define LPM_NH_MASK         0x00FFFFFF  /* 批量查找结果的高 8 位还带着 valid/depth */
+#define BACKEND_ITERATIONS  (1 << 22)
+
+/* 路由文件导入 */
+#define MRT_HDR_LEN             12      /* timestamp + type + subtype + length */
+#define MRT_TABLE_DUMP_V2       13
+#define MRT_RIB_IPV4_UNICAST    2
+#define MRT_RIB_IPV6_UNICAST    4
+#define ROUTE_NH_MAX            ((1U << 21) - 1)    /* rte_lpm6 下一跳只有 21 位 */
+#define TBL8_HEADROOM_PCT       25      /* 估算值之外为后续增删预留的 tbl8 */
+/* rte_fib/rte_fib6 4 字节下一跳最大 2^31 - 1, 默认下一跳放不下 ROUTE_NO_NH, 用超出路由范围的值代替 */
+#define FIB_DEFAULT_NH          (ROUTE_NH_MAX + 1)
+
+/* 下一跳和转发 */
+#define MAX_NEXT_HOPS       1024        /* 邻接表大小 */
+#define MAX_NH_GROUPS       (1 << 16)   /* ECMP 组数, 路由的 next_hop 是组 ID */
+#define ECMP_MAX_PATHS      8
+#define NH_GROUP_DEFAULT    11          /* 未配置的组 ID 走默认网关 */
+#define NH_GROUP_ECMP       20          /* 演示用的 4 路 ECMP 组 */
+#define RX_RING_SIZE        1024
+#define TX_RING_SIZE        1024
+#define FWD_STATS_INTERVAL  1           /* 转发模式打印间隔 (秒) */
+
+/* 路由缓存 */
+#define ROUTE_CACHE_BITS    12
+#define ROUTE_CACHE_SIZE    (1 << ROUTE_CACHE_BITS)    /* 每 lcore 的条目数 */
+#define CACHE_UPDATE_INTERVAL (1 << 16)     /* 基准中模拟路由更新的间隔 (查找数) */
 
 /* 下一跳类型 */
 #define NH_TYPE_DIRECT      0    /* 直连路由 */
@@ -56,11 +132,56 @@ struct lpm_stats {
 /* 下一跳信息 */
 struct next_hop_info {
     uint8_t type;           /* 下一跳类型 */
-    uint8_t port_id;        /* 出端口 */
+    uint16_t port_id;       /* 出端口 */
     uint32_t gateway_ip;    /* 网关 IP (如果是网关路由) */
+    struct rte_ether_addr dst_mac;  /* 下一跳 MAC */
     char description[64];   /* 描述 */
 };
 
+/* ECMP 组: LPM 的查找结果是组 ID, 组内按流哈希选一条路径 */
+struct nh_group {
+    uint16_t nb_paths;
+    uint16_t paths[ECMP_MAX_PATHS];     /* next_hop_table 下标 */
+};
+
+/* 转发统计, 每个转发 lcore 一份 */
+struct fwd_stats {
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    uint64_t tx_dropped;            /* TX 队列满 */
+    uint64_t no_route;
+    uint64_t ttl_exceeded;
+    uint64_t bad_header;            /* 非 IPv4 或头部不完整 */
+    uint64_t blackholed;            /* 黑洞 / 拒绝路由 */
+    uint64_t ecmp_packets;          /* 经 ECMP 组转发 */
+} __rte_cache_aligned;
+
+/*
+ * 路由缓存条目: 目的地址 -> 查找结果 (没有路由为 ROUTE_NO_NH).
+ * gen 与路由表版本号不同时条目无效, 路由变化时不需要逐个清空
+ */
+struct route_cache_entry {
+    uint32_t dst;
+    uint32_t next_hop;
+    uint32_t gen;
+};
+
+/* 每个 lcore 一个直接映射缓存, 只有本 lcore 访问 */
+struct route_cache {
+    uint64_t hits;
+    uint64_t misses;
+    struct route_cache_entry entries[ROUTE_CACHE_SIZE];
+} __rte_cache_aligned;
+
+/* 转发上下文 */
+struct fwd_ctx {
+    uint16_t queue_id;
+    int sink;                       /* 离线模拟: 不发包, 计数后释放 */
+    struct fwd_stats *stats;
+    struct route_cache *cache;      /* NULL 表示直接查 LPM */
+    struct rte_eth_dev_tx_buffer *tx_buf[RTE_MAX_ETHPORTS];
+};
+
 /* 路由条目 */
 struct route_entry {
     uint32_t ip;        /* 网络地址 */
@@ -69,13 +190,125 @@ struct route_entry {
     char description[64];
 };
 
+/* 每个查找 lcore 的计数, 只有本 lcore 写 */
+struct reader_stats {
+    uint64_t lookups;
+    uint64_t hits;
+} __rte_cache_aligned;
+
+/* 控制线程的路由更新统计 */
+struct churn_stats {
+    uint64_t adds;
+    uint64_t deletes;
+    uint64_t add_failures;          /* 通常是 tbl8 耗尽 */
+    uint64_t delete_failures;
+    uint64_t update_cycles;         /* add/delete 总周期数 */
+    uint64_t max_update_cycles;
+};
+
+/*
+ * 统一路由接口
+ * IPv4 前缀/地址用主机字节序 uint32_t, IPv6 用 struct rte_ipv6_addr;
+ * 查找结果统一为 uint64_t, 未命中为 ROUTE_NO_NH
+ */
+enum route_backend {
+    BACKEND_LPM,        /* rte_lpm, IPv4 DIR-24-8 */
+    BACKEND_FIB,        /* rte_fib, IPv4 DIR-24-8 + RIB */
+    BACKEND_LPM6,       /* rte_lpm6, IPv6 24 + 8×13 级 */
+    BACKEND_FIB6,       /* rte_fib6, IPv6 trie + RIB */
+};
+
+struct route_table {
+    enum route_backend backend;
+    const char *name;
+    int is_ipv6;
+    union {
+        struct rte_lpm *lpm;
+        struct rte_fib *fib;
+        struct rte_lpm6 *lpm6;
+        struct rte_fib6 *fib6;
+    };
+};
+
+/* 查找序列的目的地址分布 */
+enum traffic_dist {
+    DIST_UNIFORM,
+    DIST_ZIPF,
+    DIST_MAX
+};
+
+/* 全表前缀 (合成或从路由文件读入) */
+struct prefix4 {
+    uint32_t ip;
+    uint8_t depth;
+    uint32_t next_hop;
+};
+
+struct prefix6 {
+    struct rte_ipv6_addr ip;
+    uint8_t depth;
+    uint32_t next_hop;
+};
+
+/* 从路由文件读入的前缀, 读入后按前缀长度排序 */
+struct route_set {
+    struct prefix4 *v4;
+    uint32_t nb_v4;
+    uint32_t cap_v4;
+    struct prefix6 *v6;
+    uint32_t nb_v6;
+    uint32_t cap_v6;
+    uint32_t invalid;       /* 无法解析的行/记录 */
+};
+
 /* 全局变量 */
 static struct rte_lpm *lpm = NULL;
 static struct rte_mempool *mbuf_pool = NULL;
 static struct lpm_stats stats;
-static struct next_hop_info next_hop_table[256];
+static struct next_hop_info next_hop_table[MAX_NEXT_HOPS];
+static struct nh_group nh_groups[MAX_NH_GROUPS];
 static volatile sig_atomic_t force_quit = 0;
 
+/*
+ * 路由抖动测试
+ * 查找 lcore 每个 burst 之后报告静止状态, 控制线程删除路由时 LPM 把释放的
+ * tbl8 放进 RCU 延迟队列, 所有查找 lcore 都越过静止点后才真正回收
+ */
+static struct rte_rcu_qsbr *lpm_qsv = NULL;
+static uint32_t *lookup_set = NULL;
+static struct reader_stats reader_stats[RTE_MAX_LCORE];
+static struct churn_stats churn;
+static int readers_stop = 0;
+static int churn_stop = 0;
+static uint32_t churn_rate = DEFAULT_CHURN_RATE;
+static unsigned int phase_seconds = DEFAULT_PHASE_SEC;
+static uint32_t nb_v4_routes = DEFAULT_V4_ROUTES;
+static uint32_t nb_v6_routes = DEFAULT_V6_ROUTES;
+static const char *route_file = NULL;
+static struct route_set loaded_routes;
+
+/* 查找基准的流量和结果输出 */
+static const char *const dist_names[DIST_MAX] = {"uniform", "zipf"};
+static uint32_t nb_dests = DEFAULT_NB_DESTS;
+static double zipf_s = DEFAULT_ZIPF_S;
+static uint32_t *dest_set = NULL;
+static uint32_t *traces[DIST_MAX];
+static uint64_t *evict_buf = NULL;
+static const char *csv_path = DEFAULT_CSV_FILE;
+static FILE *csv_fp = NULL;
+
+/* 转发模式 */
+static int forward_mode = 0;
+static uint16_t fwd_ports[RTE_MAX_ETHPORTS];
+static uint16_t nb_fwd_ports = 0;
+static struct rte_ether_addr port_macs[RTE_MAX_ETHPORTS];
+static struct fwd_stats fwd_stats[RTE_MAX_LCORE];
+
+/* 路由缓存: 版本号从 1 开始, 清零的条目 (gen 0) 永远不会命中 */
+static uint32_t route_gen = 1;
+static int route_cache_enabled = 0;
+static struct route_cache *fwd_caches[RTE_MAX_LCORE];
+
 /* 信号处理 */
 static void signal_handler(int signum)
 {
@@ -105,44 +338,135 @@ static void ipv4_to_string(uint32_t ip, char *buf, size_t len)
              ip & 0xFF);
 }
 
+/* 设置一个下一跳 (邻接); MAC 是演示用的邻居地址, 真实系统由 ARP 解析 */
+static void set_next_hop(uint16_t id, uint8_t type, uint16_t port_id,
+                         uint32_t gateway_ip, const char *description)
+{
+    struct next_hop_info *nh = &next_hop_table[id];
+
+    nh->type = type;
+    nh->port_id = port_id;
+    nh->gateway_ip = gateway_ip;
+    nh->dst_mac = (struct rte_ether_addr){
+        .addr_bytes = {0x02, 0x00, 0x00, 0x00, (uint8_t)(id >> 8), (uint8_t)id}
+    };
+    snprintf(nh->description, sizeof(nh->description), "%s", description);
+}
+
+/* 设置一个 ECMP 组, 路由的 next_hop 指向组 ID */
+static void set_nh_group(uint32_t group_id, const uint16_t *paths, uint16_t nb_paths)
+{
+    struct nh_group *grp = &nh_groups[group_id];
+
+    grp->nb_paths = RTE_MIN(nb_paths, (uint16_t)ECMP_MAX_PATHS);
+    memcpy(grp->paths, paths, sizeof(paths[0]) * grp->nb_paths);
+}
+
+/*
+ * 查找组 ID 对应的 ECMP 组
+ * 路由文件只带下一跳 ID, 没有配置过的组走默认网关
+ */
+static inline const struct nh_group *nh_group_lookup(uint32_t group_id)
+{
+    if (likely(group_id < MAX_NH_GROUPS && nh_groups[group_id].nb_paths != 0))
+        return &nh_groups[group_id];
+    return &nh_groups[NH_GROUP_DEFAULT];
+}
+
 /* 初始化下一跳表 */
 static void init_next_hop_table(void)
 {
-    /* 下一跳 0: 直连网络 - 端口 0 */
-    next_hop_table[0].type = NH_TYPE_DIRECT;
-    next_hop_table[0].port_id = 0;
-    snprintf(next_hop_table[0].description, sizeof(next_hop_table[0].description),
-             "Direct - Port 0");
-
-    /* 下一跳 1: 直连网络 - 端口 1 */
-    next_hop_table[1].type = NH_TYPE_DIRECT;
-    next_hop_table[1].port_id = 1;
-    snprintf(next_hop_table[1].description, sizeof(next_hop_table[1].description),
-             "Direct - Port 1");
-
-    /* 下一跳 10: 默认网关 */
-    next_hop_table[10].type = NH_TYPE_GATEWAY;
-    next_hop_table[10].port_id = 0;
-    next_hop_table[10].gateway_ip = IPv4(10, 0, 0, 1);
-    snprintf(next_hop_table[10].description, sizeof(next_hop_table[10].description),
-             "Gateway 10.0.0.1");
-
-    /* 下一跳 11: ISP 网关 */
-    next_hop_table[11].type = NH_TYPE_GATEWAY;
-    next_hop_table[11].port_id = 1;
-    next_hop_table[11].gateway_ip = IPv4(172, 16, 0, 1);
-    snprintf(next_hop_table[11].description, sizeof(next_hop_table[11].description),
-             "ISP Gateway 172.16.0.1");
-
-    /* 下一跳 254: 黑洞路由 */
-    next_hop_table[254].type = NH_TYPE_BLACKHOLE;
-    snprintf(next_hop_table[254].description, sizeof(next_hop_table[254].description),
-             "Blackhole");
-
-    /* 下一跳 255: 拒绝路由 */
-    next_hop_table[255].type = NH_TYPE_REJECT;
-    snprintf(next_hop_table[255].description, sizeof(next_hop_table[255].description),
-             "Reject");
+    static const uint16_t ecmp_paths[] = {10, 11, 12, 13};
+
+    /* 直连网络 */
+    set_next_hop(0, NH_TYPE_DIRECT, 0, 0, "Direct - Port 0");
+    set_next_hop(1, NH_TYPE_DIRECT, 1, 0, "Direct - Port 1");
+
+    /* 网关: 默认网关, ISP 网关, 以及两个只用于 ECMP 的上游 */
+    set_next_hop(10, NH_TYPE_GATEWAY, 0, IPv4(10, 0, 0, 1), "Gateway 10.0.0.1");
+    set_next_hop(11, NH_TYPE_GATEWAY, 1, IPv4(172, 16, 0, 1), "ISP Gateway 172.16.0.1");
+    set_next_hop(12, NH_TYPE_GATEWAY, 0, IPv4(10, 0, 1, 1), "Gateway 10.0.1.1");
+    set_next_hop(13, NH_TYPE_GATEWAY, 1, IPv4(172, 16, 1, 1), "Gateway 172.16.1.1");
+
+    /* 黑洞和拒绝路由 */
+    set_next_hop(254, NH_TYPE_BLACKHOLE, 0, 0, "Blackhole");
+    set_next_hop(255, NH_TYPE_REJECT, 0, 0, "Reject");
+
+    /* 每个下一跳自成一个单路径组, 组 ID 与下一跳 ID 相同 */
+    for (uint16_t id = 0; id < MAX_NEXT_HOPS; id++) {
+        if (next_hop_table[id].description[0] != '\0')
+            set_nh_group(id, &id, 1);
+    }
+
+    /* 4 路 ECMP 组 */
+    set_nh_group(NH_GROUP_ECMP, ecmp_paths, RTE_DIM(ecmp_paths));
+}
+
+/*
+ * 路由表版本号
+ * 每次增删路由之后递增, 使所有 lcore 的路由缓存失效. 必须在修改完成之后
+ * 递增: 查找方先读版本号再查 LPM, 与更新交错时查到的结果只会带着旧版本号
+ * 写进缓存, 下次查找就不会命中
+ */
+static inline void route_table_changed(void)
+{
+    __atomic_fetch_add(&route_gen, 1, __ATOMIC_RELEASE);
+}
+
+static struct route_cache *route_cache_create(int socket_id)
+{
+    return rte_zmalloc_socket("route_cache", sizeof(struct route_cache),
+                              RTE_CACHE_LINE_SIZE, socket_id);
+}
+
+static inline uint32_t route_cache_slot(uint32_t ip)
+{
+    return (ip * 2654435761U) >> (32 - ROUTE_CACHE_BITS);
+}
+
+/*
+ * 先查缓存, 未命中的地址收集起来一次批量查 LPM 并回填.
+ * hops 的格式与 rte_lpm_lookup_x4() 相同: 下一跳或 ROUTE_NO_NH,
+ * 没有路由的结果也缓存
+ */
+static inline void route_cache_lookup_bulk(struct route_cache *c,
+                                           const uint32_t *ips, uint32_t *hops,
+                                           unsigned int n)
+{
+    uint32_t gen = __atomic_load_n(&route_gen, __ATOMIC_ACQUIRE);
+    uint32_t miss_ips[MAX_LOOKUP_BATCH];
+    uint32_t miss_hops[MAX_LOOKUP_BATCH];
+    uint16_t miss_idx[MAX_LOOKUP_BATCH];
+    unsigned int nb_miss = 0;
+
+    for (unsigned int i = 0; i < n; i++) {
+        const struct route_cache_entry *e = &c->entries[route_cache_slot(ips[i])];
+
+        if (e->gen == gen && e->dst == ips[i]) {
+            hops[i] = e->next_hop;
+        } else {
+            miss_ips[nb_miss] = ips[i];
+            miss_idx[nb_miss] = (uint16_t)i;
+            nb_miss++;
+        }
+    }
+
+    c->hits += n - nb_miss;
+    c->misses += nb_miss;
+    if (nb_miss == 0)
+        return;
+
+    rte_lpm_lookup_bulk(lpm, miss_ips, miss_hops, nb_miss);
+    for (unsigned int k = 0; k < nb_miss; k++) {
+        struct route_cache_entry *e = &c->entries[route_cache_slot(miss_ips[k])];
+        uint32_t hop = (miss_hops[k] & RTE_LPM_LOOKUP_SUCCESS) ?
+                       (miss_hops[k] & LPM_NH_MASK) : ROUTE_NO_NH;
+
+        hops[miss_idx[k]] = hop;
+        e->dst = miss_ips[k];
+        e->next_hop = hop;
+        e->gen = gen;
+    }
 }
 
 /* 添加路由到 LPM 表 */
@@ -151,14 +475,16 @@ static int add_route(uint32_t ip, uint8_t depth, uint32_t next_hop, const char *
     int ret;
     char ip_str[32];
 
+    ipv4_to_string(ip, ip_str, sizeof(ip_str));
+
     ret = rte_lpm_add(lpm, ip, depth, next_hop);
     if (ret < 0) {
         printf("Failed to add route: %s/%u -> %u\n",
                ip_str, depth, next_hop);
         return ret;
     }
+    route_table_changed();
 
-    ipv4_to_string(ip, ip_str, sizeof(ip_str));
     printf("Added route: %-18s/%2u -> NH %3u (%s)\n",
            ip_str, depth, next_hop, description);
 
@@ -191,6 +517,9 @@ static int init_routing_table(void)
     add_route(IPv4(198, 51, 100, 0), 24, 254, "TEST-NET-2 (RFC 5737)");
     add_route(IPv4(203, 0, 113, 0), 24, 254, "TEST-NET-3 (RFC 5737)");
 
+    /* 基准测试网段, 4 路 ECMP */
+    add_route(IPv4(198, 18, 0, 0), 15, NH_GROUP_ECMP, "Benchmark Net (ECMP x4)");
+
     /* 默认路由 (通过 ISP 网关) */
     add_route(IPv4(0, 0, 0, 0), 0, 11, "Default Route (Internet)");
 
@@ -219,59 +548,6 @@ static int lookup_single(uint32_t ip, uint32_t *next_hop)
     }
 }
 
-/* 批量 IP 查找 */
-static int lookup_bulk(const uint32_t *ips, uint32_t *next_hops, unsigned int num)
-{
-    uint64_t start, end;
-    int ret;
-
-    start = rte_rdtsc();
-    ret = rte_lpm_lookup_bulk(lpm, ips, next_hops, num);
-    end = rte_rdtsc();
-
-    stats.lookups += num;
-    stats.total_cycles += (end - start);
-
-    /* 统计命中和未命中 */
-    for (unsigned int i = 0; i < num; i++) {
-        if (next_hops[i] & RTE_LPM_LOOKUP_SUCCESS) {
-            stats.hits++;
-            next_hops[i] &= ~RTE_LPM_LOOKUP_SUCCESS;  /* 清除标志位 */
-        } else {
-            stats.misses++;
-        }
-    }
-
-    return ret;
-}
-
-/* 处理数据包 (模拟) */
-static void process_packet(uint32_t dst_ip)
-{
-    uint32_t next_hop;
-    char ip_str[32];
-
-    if (lookup_single(dst_ip, &next_hop) == 0) {
-        struct next_hop_info *nh = &next_hop_table[next_hop];
-
-        switch (nh->type) {
-        case NH_TYPE_DIRECT:
-        case NH_TYPE_GATEWAY:
-            stats.packets_forwarded++;
-            break;
-        case NH_TYPE_BLACKHOLE:
-        case NH_TYPE_REJECT:
-            stats.packets_dropped++;
-            break;
-        }
-    } else {
-        /* 没有匹配的路由,丢弃 */
-        ipv4_to_string(dst_ip, ip_str, sizeof(ip_str));
-        printf("No route to host: %s\n", ip_str);
-        stats.packets_dropped++;
-    }
-}
-
 /* 演示路由查找 */
 static void demo_routing_lookups(void)
 {
@@ -291,6 +567,7 @@ static void demo_routing_lookups(void)
         {"8.8.8.8", "Google DNS"},
         {"1.1.1.1", "Cloudflare DNS"},
         {"192.0.2.1", "TEST-NET (should drop)"},
+        {"198.18.7.1", "Benchmark Net (ECMP)"},
         {"93.184.216.34", "Internet (default route)"},
         {"127.0.0.1", "Localhost (no route)"},
     };
@@ -303,7 +580,19 @@ static void demo_routing_lookups(void)
         printf("%-30s %-20s", test_cases[i].description, test_cases[i].ip_str);
 
         if (lookup_single(ip, &next_hop) == 0) {
-            struct next_hop_info *nh = &next_hop_table[next_hop];
+            const struct nh_group *grp = nh_group_lookup(next_hop);
+            struct next_hop_info *nh;
+
+            /* 路由文件中的下一跳 ID 没有配置组, 转发时走默认网关 */
+            if (grp != &nh_groups[next_hop]) {
+                printf(" -> NH %u (loaded route) ✓\n", next_hop);
+                continue;
+            }
+            if (grp->nb_paths > 1) {
+                printf(" -> NH %3u: ECMP, %u paths ✓\n", next_hop, grp->nb_paths);
+                continue;
+            }
+            nh = &next_hop_table[grp->paths[0]];
 
             printf(" -> NH %3u: %-20s", next_hop, nh->description);
 
@@ -327,205 +616,2187 @@ static void demo_routing_lookups(void)
     printf("\n");
 }
 
-/* 批量查找性能测试 */
-static void benchmark_bulk_lookup(void)
+/*
+ * 创建路由表
+ * num_tbl8s: LPM/FIB 的 tbl8 组数 (每组 256 项), 决定长前缀的容量
+ */
+static int route_table_create(struct route_table *rt, enum route_backend backend,
+                              uint32_t max_routes, uint32_t num_tbl8s)
 {
-    const unsigned int batch_sizes[] = {1, 8, 16, 32, 64};
-    uint32_t test_ips[64];
-    uint32_t next_hops[64];
-    uint64_t start, end;
-    double lookups_per_sec;
+    int socket_id = (int)rte_socket_id();
+
+    memset(rt, 0, sizeof(*rt));
+    rt->backend = backend;
+
+    switch (backend) {
+    case BACKEND_LPM: {
+        struct rte_lpm_config conf = {
+            .max_rules = max_routes,
+            .number_tbl8s = num_tbl8s,
+        };
+        rt->name = "rte_lpm";
+        rt->lpm = rte_lpm_create("rt_lpm", socket_id, &conf);
+        return rt->lpm != NULL ? 0 : -rte_errno;
+    }
+    case BACKEND_FIB: {
+        struct rte_fib_conf conf = {
+            .type = RTE_FIB_DIR24_8,
+            .default_nh = FIB_DEFAULT_NH,
+            .max_routes = (int)max_routes,
+            .dir24_8 = {
+                .nh_sz = RTE_FIB_DIR24_8_4B,
+                .num_tbl8 = num_tbl8s,
+            },
+        };
+        rt->name = "rte_fib";
+        rt->fib = rte_fib_create("rt_fib", socket_id, &conf);
+        return rt->fib != NULL ? 0 : -rte_errno;
+    }
+    case BACKEND_LPM6: {
+        struct rte_lpm6_config conf = {
+            .max_rules = max_routes,
+            .number_tbl8s = num_tbl8s,
+        };
+        rt->name = "rte_lpm6";
+        rt->is_ipv6 = 1;
+        rt->lpm6 = rte_lpm6_create("rt_lpm6", socket_id, &conf);
+        return rt->lpm6 != NULL ? 0 : -rte_errno;
+    }
+    case BACKEND_FIB6: {
+        struct rte_fib6_conf conf = {
+            .type = RTE_FIB6_TRIE,
+            .default_nh = FIB_DEFAULT_NH,
+            .max_routes = (int)max_routes,
+            .trie = {
+                .nh_sz = RTE_FIB6_TRIE_4B,
+                .num_tbl8 = num_tbl8s,
+            },
+        };
+        rt->name = "rte_fib6";
+        rt->is_ipv6 = 1;
+        rt->fib6 = rte_fib6_create("rt_fib6", socket_id, &conf);
+        return rt->fib6 != NULL ? 0 : -rte_errno;
+    }
+    }
 
-    printf("\n╔════════════════════════════════════════════════════════╗\n");
-    printf("║         Bulk Lookup Performance Benchmark             ║\n");
-    printf("╚════════════════════════════════════════════════════════╝\n\n");
+    return -EINVAL;
+}
 
-    /* 生成测试 IP 地址 */
-    for (unsigned int i = 0; i < 64; i++) {
-        /* 随机生成 IP (主要在已知网段) */
-        uint32_t r = rte_rand();
-        if (r % 3 == 0) {
-            test_ips[i] = IPv4(10, 0, 0, r % 256);
-        } else if (r % 3 == 1) {
-            test_ips[i] = IPv4(172, 16, (r >> 8) % 256, r % 256);
-        } else {
-            test_ips[i] = IPv4(r >> 24, (r >> 16) & 0xFF,
-                               (r >> 8) & 0xFF, r & 0xFF);
-        }
+/* 添加路由, prefix 指向 uint32_t (IPv4) 或 struct rte_ipv6_addr (IPv6) */
+static int route_table_add(struct route_table *rt, const void *prefix,
+                           uint8_t depth, uint32_t next_hop)
+{
+    switch (rt->backend) {
+    case BACKEND_LPM:
+        return rte_lpm_add(rt->lpm, *(const uint32_t *)prefix, depth, next_hop);
+    case BACKEND_FIB:
+        return rte_fib_add(rt->fib, *(const uint32_t *)prefix, depth, next_hop);
+    case BACKEND_LPM6:
+        return rte_lpm6_add(rt->lpm6, prefix, depth, next_hop);
+    case BACKEND_FIB6:
+        return rte_fib6_add(rt->fib6, prefix, depth, next_hop);
     }
 
-    printf("Batch Size    Lookups/sec      Cycles/Lookup    Time/Lookup\n");
-    printf("──────────────────────────────────────────────────────────\n");
+    return -EINVAL;
+}
 
-    for (size_t i = 0; i < sizeof(batch_sizes) / sizeof(batch_sizes[0]); i++) {
-        unsigned int batch_size = batch_sizes[i];
-        uint64_t total_cycles = 0;
-        uint64_t total_lookups = 0;
+/*
+ * 批量查找, n 不超过 ROUTE_BULK_MAX
+ * rte_lpm/rte_lpm6/rte_fib 的未命中表示不同 (成功标志位 / -1 / 默认下一跳),
+ * 这里转换为统一格式, 转换循环约占每次查找 1 个周期
+ */
+static void route_table_lookup_bulk(struct route_table *rt, const void *keys,
+                                    uint64_t *next_hops, unsigned int n)
+{
+    switch (rt->backend) {
+    case BACKEND_LPM: {
+        uint32_t nh[ROUTE_BULK_MAX];
+
+        rte_lpm_lookup_bulk(rt->lpm, keys, nh, n);
+        for (unsigned int i = 0; i < n; i++)
+            next_hops[i] = (nh[i] & RTE_LPM_LOOKUP_SUCCESS) ?
+                           (nh[i] & LPM_NH_MASK) : ROUTE_NO_NH;
+        break;
+    }
+    case BACKEND_FIB:
+        rte_fib_lookup_bulk(rt->fib, (uint32_t *)(uintptr_t)keys, next_hops, n);
+        for (unsigned int i = 0; i < n; i++)
+            if (next_hops[i] == FIB_DEFAULT_NH)
+                next_hops[i] = ROUTE_NO_NH;
+        break;
+    case BACKEND_LPM6: {
+        int32_t nh[ROUTE_BULK_MAX];
+
+        rte_lpm6_lookup_bulk_func(rt->lpm6, (struct rte_ipv6_addr *)(uintptr_t)keys,
+                                  nh, n);
+        for (unsigned int i = 0; i < n; i++)
+            next_hops[i] = nh[i] >= 0 ? (uint64_t)nh[i] : ROUTE_NO_NH;
+        break;
+    }
+    case BACKEND_FIB6:
+        rte_fib6_lookup_bulk(rt->fib6, keys, next_hops, n);
+        for (unsigned int i = 0; i < n; i++)
+            if (next_hops[i] == FIB_DEFAULT_NH)
+                next_hops[i] = ROUTE_NO_NH;
+        break;
+    }
+}
 
-        start = rte_rdtsc();
+/*
+ * 切换 rte_fib/rte_fib6 的 AVX-512 查找实现
+ * 需要 CPU 支持且 EAL 允许 512 位 SIMD (--force-max-simd-bitwidth=512)
+ */
+static int route_table_select_avx512(struct route_table *rt)
+{
+    switch (rt->backend) {
+    case BACKEND_FIB:
+        return rte_fib_select_lookup(rt->fib, RTE_FIB_LOOKUP_DIR24_8_VECTOR_AVX512);
+    case BACKEND_FIB6:
+        return rte_fib6_select_lookup(rt->fib6, RTE_FIB6_LOOKUP_TRIE_VECTOR_AVX512);
+    default:
+        return -ENOTSUP;
+    }
+}
 
-        /* 执行多次批量查找 */
-        for (unsigned int iter = 0; iter < TEST_ITERATIONS / batch_size; iter++) {
-            uint64_t batch_start = rte_rdtsc();
-            lookup_bulk(test_ips, next_hops, batch_size);
-            uint64_t batch_end = rte_rdtsc();
+static void route_table_free(struct route_table *rt)
+{
+    switch (rt->backend) {
+    case BACKEND_LPM:
+        rte_lpm_free(rt->lpm);
+        break;
+    case BACKEND_FIB:
+        rte_fib_free(rt->fib);
+        break;
+    case BACKEND_LPM6:
+        rte_lpm6_free(rt->lpm6);
+        break;
+    case BACKEND_FIB6:
+        rte_fib6_free(rt->fib6);
+        break;
+    }
+    memset(rt, 0, sizeof(*rt));
+}
 
-            total_cycles += (batch_end - batch_start);
-            total_lookups += batch_size;
-        }
+/* 当前 socket 上 rte_malloc 堆已分配的字节数, 用于估算路由表内存 */
+static size_t heap_allocated_bytes(void)
+{
+    struct rte_malloc_socket_stats st;
 
-        end = rte_rdtsc();
+    if (rte_malloc_get_socket_stats((int)rte_socket_id(), &st) != 0)
+        return 0;
+    return st.heap_allocsz_bytes;
+}
 
-        double elapsed_sec = (double)(end - start) / rte_get_timer_hz();
-        lookups_per_sec = total_lookups / elapsed_sec;
-        double cycles_per_lookup = (double)total_cycles / total_lookups;
-        double time_per_lookup_ns = cycles_per_lookup * 1e9 / rte_get_timer_hz();
+/*
+ * 按权重 (千分比) 选择前缀长度
+ * 分布参考公开 BGP 表: IPv4 以 /24 为主, IPv6 以 /48 和 /32 为主
+ */
+struct depth_weight {
+    uint8_t depth;
+    uint16_t permille;
+};
 
-        printf("%4u          %12.2f M   %10.2f       %8.2f ns\n",
-               batch_size,
-               lookups_per_sec / 1e6,
-               cycles_per_lookup,
-               time_per_lookup_ns);
-    }
+static const struct depth_weight v4_depth_dist[] = {
+    {24, 600}, {23, 100}, {22, 120}, {21, 40}, {20, 40}, {19, 30},
+    {18, 15}, {17, 10}, {16, 25}, {28, 10}, {32, 10},
+};
 
-    printf("\n");
-}
+static const struct depth_weight v6_depth_dist[] = {
+    {48, 450}, {44, 60}, {40, 60}, {36, 40}, {32, 200}, {29, 60},
+    {28, 30}, {56, 40}, {64, 60},
+};
 
-/* 模拟数据包处理 */
-static void simulate_packet_forwarding(void)
+static uint8_t pick_depth(const struct depth_weight *dist, size_t n)
 {
-    const unsigned int num_packets = 10000;
-    uint32_t test_ips[BURST_SIZE];
-    uint32_t next_hops[BURST_SIZE];
-
-    printf("\n╔════════════════════════════════════════════════════════╗\n");
-    printf("║         Simulating Packet Forwarding                  ║\n");
-    printf("╚════════════════════════════════════════════════════════╝\n\n");
-
-    printf("Processing %u packets...\n", num_packets);
+    uint32_t r = (uint32_t)(rte_rand() % 1000);
 
-    uint64_t forwarded = 0;
-    uint64_t dropped = 0;
-    uint64_t start = rte_rdtsc();
+    for (size_t i = 0; i < n; i++) {
+        if (r < dist[i].permille)
+            return dist[i].depth;
+        r -= dist[i].permille;
+    }
+    return dist[n - 1].depth;
+}
 
-    for (unsigned int i = 0; i < num_packets; i += BURST_SIZE) {
-        unsigned int batch = RTE_MIN(BURST_SIZE, num_packets - i);
+static inline uint32_t depth_to_mask(uint8_t depth)
+{
+    return depth == 0 ? 0 : (uint32_t)(UINT32_MAX << (32 - depth));
+}
 
-        /* 生成随机目标 IP */
-        for (unsigned int j = 0; j < batch; j++) {
-            uint32_t r = rte_rand();
-            if (r % 3 == 0) {
-                test_ips[j] = IPv4(10, 0, 0, r % 256);
-            } else if (r % 3 == 1) {
-                test_ips[j] = IPv4(172, 16, (r >> 8) % 256, r % 256);
-            } else {
-                test_ips[j] = IPv4(r >> 24, (r >> 16) & 0xFF,
-                                   (r >> 8) & 0xFF, r & 0xFF);
-            }
+/* 把 IPv6 地址 depth 之后的位清零 */
+static void ipv6_mask(struct rte_ipv6_addr *ip, uint8_t depth)
+{
+    for (unsigned int i = 0; i < 16; i++) {
+        if (depth >= 8) {
+            depth -= 8;
+        } else {
+            ip->a[i] &= (uint8_t)(0xFF << (8 - depth));
+            depth = 0;
         }
+    }
+}
 
-        /* 批量查找 */
-        lookup_bulk(test_ips, next_hops, batch);
+/*
+ * 合成 IPv4 全表: 网络地址在 1.0.0.0 - 223.255.255.255 内均匀分布
+ */
+static struct prefix4 *generate_v4_table(uint32_t n)
+{
+    struct prefix4 *t = malloc(sizeof(*t) * n);
 
-        /* 处理结果 */
-        for (unsigned int j = 0; j < batch; j++) {
-            uint32_t nh = next_hops[j];
+    if (t == NULL)
+        return NULL;
 
-            if (nh < 256) {  /* 有效的下一跳 */
-                struct next_hop_info *nh_info = &next_hop_table[nh];
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t ip = (uint32_t)rte_rand();
 
-                if (nh_info->type == NH_TYPE_BLACKHOLE ||
-                    nh_info->type == NH_TYPE_REJECT) {
-                    dropped++;
-                } else {
-                    forwarded++;
-                }
-            } else {
-                dropped++;  /* 未找到路由 */
-            }
-        }
+        ip = ((1 + (ip >> 24) % 223) << 24) | (ip & 0xFFFFFF);
+        t[i].depth = pick_depth(v4_depth_dist, RTE_DIM(v4_depth_dist));
+        t[i].ip = ip & depth_to_mask(t[i].depth);
+        t[i].next_hop = i & 0xFFFF;
+    }
+    return t;
+}
+
+/*
+ * 合成 IPv6 全表
+ * 真实 IPv6 表高度聚集: 前缀集中在 RIR 分配的少数 /12 内, 更长的前缀
+ * 挂在各自的 /32 分配块下面. 均匀随机地址会让每条 /48 独占 3 个 tbl8,
+ * 内存需求远超真实情况, 所以先生成 /32 分配块, 再在块内生成更长前缀
+ */
+static struct prefix6 *generate_v6_table(uint32_t n)
+{
+    static const uint16_t regions[] = {0x2001, 0x2400, 0x2600, 0x2a00, 0x2c00};
+    uint32_t nb_allocs = RTE_MAX(n / 12, 256U);
+    struct prefix6 *t = malloc(sizeof(*t) * n);
+
+    if (t == NULL)
+        return NULL;
+
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t p = (uint32_t)(rte_rand() % nb_allocs);
+        uint64_t r = rte_rand();
+        uint16_t top = regions[p % RTE_DIM(regions)] | ((p / 5) & 0xF);
+        uint16_t second = (uint16_t)((p / 80) * 0x9E37);
+        struct rte_ipv6_addr *ip = &t[i].ip;
+
+        memset(ip, 0, sizeof(*ip));
+        ip->a[0] = top >> 8;
+        ip->a[1] = top & 0xFF;
+        ip->a[2] = second >> 8;
+        ip->a[3] = second & 0xFF;
+        /* 块内最多 4 个 /40, 每个 /40 下随机 /48, 更长的前缀继续随机 */
+        ip->a[4] = (uint8_t)(r & 3);
+        ip->a[5] = (uint8_t)(r >> 8);
+        ip->a[6] = (uint8_t)(r >> 16);
+        ip->a[7] = (uint8_t)(r >> 24);
+
+        t[i].depth = pick_depth(v6_depth_dist, RTE_DIM(v6_depth_dist));
+        t[i].next_hop = i & 0xFFFF;
+        ipv6_mask(ip, t[i].depth);
     }
+    return t;
+}
 
-    uint64_t end = rte_rdtsc();
-    double elapsed_sec = (double)(end - start) / rte_get_timer_hz();
-    double pps = num_packets / elapsed_sec;
+/*
+ * 路由文件导入
+ * 文件用 mmap 映射后顺序扫描, 不做逐行 read 和拷贝. 格式自动识别:
+ *   文本: 每行 "prefix/len nexthop", IPv4/IPv6 可混合, '#' 开头为注释
+ *   MRT:  TABLE_DUMP_V2 (RFC 6396), 例如 RouteViews / RIPE RIS 的 RIB 转储
+ */
+static int route_set_add4(struct route_set *rs, uint32_t ip, uint8_t depth,
+                          uint32_t next_hop)
+{
+    if (rs->nb_v4 == rs->cap_v4) {
+        uint32_t cap = rs->cap_v4 != 0 ? rs->cap_v4 * 2 : 4096;
+        struct prefix4 *t = realloc(rs->v4, sizeof(*t) * cap);
+
+        if (t == NULL)
+            return -ENOMEM;
+        rs->v4 = t;
+        rs->cap_v4 = cap;
+    }
 
-    printf("\nResults:\n");
-    printf("  Total Packets:        %u\n", num_packets);
-    printf("  Forwarded:            %" PRIu64 " (%.1f%%)\n",
-           forwarded, 100.0 * forwarded / num_packets);
-    printf("  Dropped:              %" PRIu64 " (%.1f%%)\n",
-           dropped, 100.0 * dropped / num_packets);
-    printf("  Processing Time:      %.3f ms\n", elapsed_sec * 1000);
-    printf("  Throughput:           %.2f Mpps\n\n", pps / 1e6);
+    rs->v4[rs->nb_v4].ip = ip & depth_to_mask(depth);
+    rs->v4[rs->nb_v4].depth = depth;
+    rs->v4[rs->nb_v4].next_hop = next_hop;
+    rs->nb_v4++;
+    return 0;
 }
 
-/* 打印统计信息 */
-static void print_statistics(void)
+static int route_set_add6(struct route_set *rs, const struct rte_ipv6_addr *ip,
+                          uint8_t depth, uint32_t next_hop)
 {
-    double avg_cycles = stats.lookups > 0 ?
-                        (double)stats.total_cycles / stats.lookups : 0;
-    double avg_time_ns = avg_cycles * 1e9 / rte_get_timer_hz();
-    double hit_rate = stats.lookups > 0 ?
-                      100.0 * stats.hits / stats.lookups : 0;
+    if (rs->nb_v6 == rs->cap_v6) {
+        uint32_t cap = rs->cap_v6 != 0 ? rs->cap_v6 * 2 : 4096;
+        struct prefix6 *t = realloc(rs->v6, sizeof(*t) * cap);
+
+        if (t == NULL)
+            return -ENOMEM;
+        rs->v6 = t;
+        rs->cap_v6 = cap;
+    }
 
-    printf("\n╔════════════════════════════════════════════════════════╗\n");
-    printf("║                LPM Statistics                          ║\n");
-    printf("╚════════════════════════════════════════════════════════╝\n\n");
+    rs->v6[rs->nb_v6].ip = *ip;
+    ipv6_mask(&rs->v6[rs->nb_v6].ip, depth);
+    rs->v6[rs->nb_v6].depth = depth;
+    rs->v6[rs->nb_v6].next_hop = next_hop;
+    rs->nb_v6++;
+    return 0;
+}
 
-    printf("Lookup Statistics:\n");
-    printf("  Total Lookups:        %" PRIu64 "\n", stats.lookups);
-    printf("  Hits:                 %" PRIu64 " (%.2f%%)\n",
-           stats.hits, hit_rate);
-    printf("  Misses:               %" PRIu64 " (%.2f%%)\n",
-           stats.misses, 100.0 - hit_rate);
+static void route_set_free(struct route_set *rs)
+{
+    free(rs->v4);
+    free(rs->v6);
+    memset(rs, 0, sizeof(*rs));
+}
 
-    printf("\nPerformance:\n");
-    printf("  Avg Cycles/Lookup:    %.2f\n", avg_cycles);
-    printf("  Avg Time/Lookup:      %.2f ns\n", avg_time_ns);
-    printf("  Estimated Throughput: %.2f Mlookups/s\n",
-           rte_get_timer_hz() / avg_cycles / 1e6);
+/* 解析 [p, end) 开头的十进制数, 超过 max 视为错误; 返回解析结束位置 */
+static const char *scan_uint(const char *p, const char *end, uint32_t max,
+                             uint32_t *val)
+{
+    const char *s = p;
+    uint64_t v = 0;
 
-    printf("\nPacket Statistics:\n");
-    printf("  Forwarded:            %" PRIu64 "\n", stats.packets_forwarded);
-    printf("  Dropped:              %" PRIu64 "\n", stats.packets_dropped);
+    while (p < end && *p >= '0' && *p <= '9') {
+        v = v * 10 + (uint64_t)(*p++ - '0');
+        if (v > max)
+            return NULL;
+    }
+    if (p == s)
+        return NULL;
 
-    printf("\n");
+    *val = (uint32_t)v;
+    return p;
 }
 
-/* 主函数 */
-int main(int argc, char *argv[])
+/* 解析 [p, end) 开头的点分十进制 IPv4 地址 (映射内存不以 NUL 结尾) */
+static const char *scan_ipv4(const char *p, const char *end, uint32_t *ip)
 {
-    int ret;
-    unsigned int socket_id;
+    uint32_t v = 0;
 
-    /* 初始化 EAL */
-    ret = rte_eal_init(argc, argv);
-    if (ret < 0)
-        rte_exit(EXIT_FAILURE, "Cannot init EAL\n");
+    for (int i = 0; i < 4; i++) {
+        uint32_t octet;
 
-    argc -= ret;
-    argv += ret;
+        p = scan_uint(p, end, 255, &octet);
+        if (p == NULL)
+            return NULL;
+        v = (v << 8) | octet;
 
-    /* 注册信号处理 */
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+        if (i < 3) {
+            if (p == end || *p != '.')
+                return NULL;
+            p++;
+        }
+    }
 
-    /* 获取 NUMA socket */
-    socket_id = rte_socket_id();
+    *ip = v;
+    return p;
+}
 
-    printf("\n╔════════════════════════════════════════════════════════╗\n");
-    printf("║   DPDK LPM (Longest Prefix Match) Routing Demo        ║\n");
-    printf("╚════════════════════════════════════════════════════════╝\n\n");
+/* 解析一行 "prefix/len nexthop", 行尾多余内容忽略 */
+static int parse_route_line(struct route_set *rs, const char *p, const char *end)
+{
+    const char *prefix = p;
+    const char *slash;
+    uint32_t depth, next_hop;
+
+    while (p < end && *p != '/' && *p != ' ' && *p != '\t')
+        p++;
+    if (p == end || *p != '/')
+        return -EINVAL;
+    slash = p;
+
+    p = scan_uint(p + 1, end, 128, &depth);
+    if (p == NULL)
+        return -EINVAL;
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    if (scan_uint(p, end, ROUTE_NH_MAX, &next_hop) == NULL)
+        return -EINVAL;
+
+    if (memchr(prefix, ':', (size_t)(slash - prefix)) != NULL) {
+        char buf[INET6_ADDRSTRLEN];
+        struct rte_ipv6_addr ip;
+        size_t len = (size_t)(slash - prefix);
+
+        /* inet_pton 需要 NUL 结尾的字符串, IPv6 地址很短, 拷贝一份 */
+        if (len >= sizeof(buf))
+            return -EINVAL;
+        memcpy(buf, prefix, len);
+        buf[len] = '\0';
+        if (inet_pton(AF_INET6, buf, &ip) != 1)
+            return -EINVAL;
+        return route_set_add6(rs, &ip, (uint8_t)depth, next_hop);
+    } else {
+        uint32_t ip;
+
+        if (depth > 32 || scan_ipv4(prefix, slash, &ip) != slash)
+            return -EINVAL;
+        return route_set_add4(rs, ip, (uint8_t)depth, next_hop);
+    }
+}
+
+static int load_text_routes(struct route_set *rs, const char *buf, size_t size)
+{
+    const char *p = buf;
+    const char *end = buf + size;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', (size_t)(end - p));
+        const char *line_end = eol != NULL ? eol : end;
+
+        while (p < line_end && (*p == ' ' || *p == '\t'))
+            p++;
+        if (p < line_end && *p != '#' && *p != '\r') {
+            int ret = parse_route_line(rs, p, line_end);
+
+            if (ret == -ENOMEM)
+                return ret;
+            if (ret < 0)
+                rs->invalid++;
+        }
+        p = line_end + 1;
+    }
+
+    return 0;
+}
+
+static inline uint16_t get_be16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | p[3];
+}
+
+/* MRT 头的 type 字段为 TABLE_DUMP_V2, 否则按文本处理 */
+static int is_mrt_dump(const uint8_t *buf, size_t size)
+{
+    return size >= MRT_HDR_LEN && get_be16(buf + 4) == MRT_TABLE_DUMP_V2;
+}
+
+/*
+ * TABLE_DUMP_V2 的 RIB_IPV4_UNICAST / RIB_IPV6_UNICAST 记录:
+ *   sequence(4) prefix_len(1) prefix(按位数截断) entry_count(2) RIB entries
+ * 每个 RIB entry 以 peer_index(2) 开头. 转储里没有本地下一跳的概念,
+ * 这里把第一条 entry 的 peer_index 当作下一跳 ID, 即"经由该邻居转发".
+ * PEER_INDEX_TABLE 和 ADD-PATH 等其他子类型跳过
+ */
+static int load_mrt_routes(struct route_set *rs, const uint8_t *buf, size_t size)
+{
+    size_t off = 0;
+
+    while (off + MRT_HDR_LEN <= size) {
+        const uint8_t *hdr = buf + off;
+        const uint8_t *rec = hdr + MRT_HDR_LEN;
+        uint16_t type = get_be16(hdr + 4);
+        uint16_t subtype = get_be16(hdr + 6);
+        uint32_t len = get_be32(hdr + 8);
+        uint32_t plen_bytes;
+        uint8_t plen;
+        int is_ipv6, ret;
+
+        if (len > size - off - MRT_HDR_LEN) {
+            rs->invalid++;          /* 文件被截断 */
+            break;
+        }
+        off += MRT_HDR_LEN + len;
+
+        if (type != MRT_TABLE_DUMP_V2 ||
+            (subtype != MRT_RIB_IPV4_UNICAST && subtype != MRT_RIB_IPV6_UNICAST))
+            continue;
+        is_ipv6 = subtype == MRT_RIB_IPV6_UNICAST;
+
+        if (len < 5) {
+            rs->invalid++;
+            continue;
+        }
+        plen = rec[4];
+        plen_bytes = (plen + 7U) / 8;
+        /* 至少要有 entry_count 和第一条 entry 的 peer_index */
+        if (plen > (is_ipv6 ? 128 : 32) || len < 5 + plen_bytes + 4 ||
+            get_be16(rec + 5 + plen_bytes) == 0) {
+            rs->invalid++;
+            continue;
+        }
+
+        if (is_ipv6) {
+            struct rte_ipv6_addr ip;
+
+            memset(&ip, 0, sizeof(ip));
+            memcpy(ip.a, rec + 5, plen_bytes);
+            ret = route_set_add6(rs, &ip, plen, get_be16(rec + 7 + plen_bytes));
+        } else {
+            uint8_t a[4] = {0};
+
+            memcpy(a, rec + 5, plen_bytes);
+            ret = route_set_add4(rs, get_be32(a), plen,
+                                 get_be16(rec + 7 + plen_bytes));
+        }
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+/*
+ * 按前缀长度稳定排序 (计数排序, O(n))
+ * 短前缀先插入, 长前缀随后只覆盖自己的范围; 反过来, 每插入一条短前缀都要
+ * 回头改写其下已展开的 tbl24 项和 tbl8 组. rte_lpm 的规则数组也按长度分组,
+ * 升序插入时不需要为新规则挪动后面的组
+ */
+static int sort_by_depth(void *base, uint32_t n, size_t size, size_t depth_off,
+                         unsigned int max_depth)
+{
+    uint32_t pos[130] = {0};
+    uint8_t *src = base;
+    uint8_t *tmp;
+
+    if (n < 2)
+        return 0;
+    tmp = malloc(size * n);
+    if (tmp == NULL)
+        return -ENOMEM;
+
+    for (uint32_t i = 0; i < n; i++)
+        pos[src[i * size + depth_off] + 1]++;
+    for (unsigned int d = 1; d <= max_depth + 1; d++)
+        pos[d] += pos[d - 1];
+    for (uint32_t i = 0; i < n; i++) {
+        uint8_t d = src[i * size + depth_off];
+
+        memcpy(tmp + (size_t)pos[d]++ * size, src + (size_t)i * size, size);
+    }
+
+    memcpy(base, tmp, size * n);
+    free(tmp);
+    return 0;
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+static int cmp_ipv6(const void *a, const void *b)
+{
+    return memcmp(a, b, sizeof(struct rte_ipv6_addr));
+}
+
+/*
+ * 估算 DIR-24-8 (rte_lpm / rte_fib) 需要的 tbl8 组数:
+ * 每个含有长于 /24 前缀的 /24 占一个组
+ */
+static int estimate_tbl8s_v4(const struct prefix4 *t, uint32_t n, uint32_t *groups)
+{
+    uint32_t *keys = malloc(sizeof(*keys) * RTE_MAX(n, 1U));
+    uint32_t nb = 0;
+
+    if (keys == NULL)
+        return -ENOMEM;
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (t[i].depth > 24)
+            keys[nb++] = t[i].ip >> 8;
+    }
+    qsort(keys, nb, sizeof(*keys), cmp_u32);
+
+    *groups = 0;
+    for (uint32_t i = 0; i < nb; i++) {
+        if (i == 0 || keys[i] != keys[i - 1])
+            (*groups)++;
+    }
+
+    free(keys);
+    return 0;
+}
+
+/*
+ * 估算 rte_lpm6 / rte_fib6 trie 需要的 tbl8 组数:
+ * 第一级 24 位, 之后每 8 位一级. 在第 L 位 (L = 24, 32, ..., 120) 上,
+ * 每个下面挂着更长前缀的不同 L 位前缀占一个组
+ */
+static int estimate_tbl8s_v6(const struct prefix6 *t, uint32_t n, uint32_t *groups)
+{
+    struct rte_ipv6_addr *keys = malloc(sizeof(*keys) * RTE_MAX(n, 1U));
+
+    if (keys == NULL)
+        return -ENOMEM;
+
+    *groups = 0;
+    for (unsigned int level = 24; level < 128; level += 8) {
+        uint32_t nb = 0;
+
+        for (uint32_t i = 0; i < n; i++) {
+            if (t[i].depth > level) {
+                keys[nb] = t[i].ip;
+                ipv6_mask(&keys[nb], (uint8_t)level);
+                nb++;
+            }
+        }
+        if (nb == 0)
+            break;
+        qsort(keys, nb, sizeof(*keys), cmp_ipv6);
+
+        for (uint32_t i = 0; i < nb; i++) {
+            if (i == 0 || cmp_ipv6(&keys[i], &keys[i - 1]) != 0)
+                (*groups)++;
+        }
+    }
+
+    free(keys);
+    return 0;
+}
+
+/* 估算值加上余量, 给之后的动态增删留空间 */
+static uint32_t tbl8s_with_headroom(uint32_t groups)
+{
+    return (uint32_t)(groups + (uint64_t)groups * TBL8_HEADROOM_PCT / 100 + 64);
+}
+
+/* 读入路由文件并按前缀长度排序 */
+static int load_route_file(const char *path, struct route_set *rs)
+{
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t start, parse_cycles, sort_cycles = 0;
+    struct stat st;
+    size_t size;
+    void *buf;
+    int fd, mrt, ret;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        ret = -errno;
+        printf("Cannot open %s: %s\n", path, strerror(-ret));
+        return ret;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        printf("Cannot read %s: empty or not a regular file\n", path);
+        close(fd);
+        return -EINVAL;
+    }
+    size = (size_t)st.st_size;
+
+    buf = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ret = -errno;
+    close(fd);
+    if (buf == MAP_FAILED) {
+        printf("Cannot mmap %s: %s\n", path, strerror(-ret));
+        return ret;
+    }
+    madvise(buf, size, MADV_SEQUENTIAL);
+
+    start = rte_rdtsc();
+    mrt = is_mrt_dump(buf, size);
+    if (mrt)
+        ret = load_mrt_routes(rs, buf, size);
+    else
+        ret = load_text_routes(rs, buf, size);
+    parse_cycles = rte_rdtsc() - start;
+    munmap(buf, size);
+
+    if (ret == 0) {
+        start = rte_rdtsc();
+        ret = sort_by_depth(rs->v4, rs->nb_v4, sizeof(*rs->v4),
+                            offsetof(struct prefix4, depth), 32);
+        if (ret == 0)
+            ret = sort_by_depth(rs->v6, rs->nb_v6, sizeof(*rs->v6),
+                                offsetof(struct prefix6, depth), 128);
+        sort_cycles = rte_rdtsc() - start;
+    }
+    if (ret < 0) {
+        printf("Out of memory while loading %s\n", path);
+        route_set_free(rs);
+        return ret;
+    }
+
+    printf("Loaded %s (%s, %.1f MB)\n", path,
+           mrt ? "MRT TABLE_DUMP_V2" : "text", (double)size / (1024 * 1024));
+    printf("  IPv4 routes: %u, IPv6 routes: %u, invalid: %u\n",
+           rs->nb_v4, rs->nb_v6, rs->invalid);
+    printf("  Parse: %.1f ms, sort by prefix length: %.1f ms\n",
+           (double)parse_cycles * 1000 / hz, (double)sort_cycles * 1000 / hz);
+
+    return 0;
+}
+
+/*
+ * 把读入的 IPv4 路由装进主 LPM 表 (已按前缀长度排序)
+ * 与演示路由前缀相同的条目会覆盖演示路由
+ */
+static void build_lpm_from_routes(const struct route_set *rs)
+{
+    uint64_t hz = rte_get_timer_hz();
+    uint32_t failed = 0;
+    uint64_t start, cycles;
+
+    printf("=== Loading Full Routing Table ===\n\n");
+
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < rs->nb_v4; i++) {
+        const struct prefix4 *r = &rs->v4[i];
+
+        if (rte_lpm_add(lpm, r->ip, r->depth, r->next_hop) < 0)
+            failed++;
+    }
+    cycles = rte_rdtsc() - start;
+    route_table_changed();
+
+    printf("  Routes:               %u (%u failed)\n", rs->nb_v4, failed);
+    printf("  Build Time:           %.1f ms (%.2f M routes/s)\n\n",
+           (double)cycles * 1000 / hz,
+           cycles != 0 ? rs->nb_v4 / ((double)cycles / hz) / 1e6 : 0.0);
+}
+
+/* 对比结果的一行 */
+static void print_backend_row(const char *name, const char *family,
+                              uint32_t routes, uint32_t failed,
+                              double build_sec, double mem_mb,
+                              uint64_t cycles, uint64_t lookups)
+{
+    double cpl = (double)cycles / lookups;
+
+    printf("%-16s %-5s %9u %7u %9.2f %10.1f %11.2f %9.2f\n",
+           name, family, routes, failed, build_sec, mem_mb,
+           rte_get_timer_hz() / cpl / 1e6, cpl);
+}
+
+/* 对一个后端做 BACKEND_ITERATIONS 次批量查找, 返回总周期数 */
+static uint64_t time_backend_lookups(struct route_table *rt, const void *keys,
+                                     size_t key_size)
+{
+    uint64_t next_hops[BURST_SIZE];
+    volatile uint64_t sink = 0;
+    uint64_t start;
+
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < BACKEND_ITERATIONS; i += BURST_SIZE) {
+        uint32_t idx = i & (LOOKUP_SET_SIZE - 1);
+
+        route_table_lookup_bulk(rt, (const uint8_t *)keys + idx * key_size,
+                                next_hops, BURST_SIZE);
+        sink += next_hops[0];
+    }
+    RTE_SET_USED(sink);
+
+    return rte_rdtsc() - start;
+}
+
+/*
+ * 在一个后端上建全表并测量
+ * 内存按建表前后 rte_malloc 堆的差值计算, 包括 tbl24/tbl8 和 RIB 节点
+ */
+static void benchmark_backend(enum route_backend backend, const void *routes,
+                              uint32_t nb_routes, uint32_t num_tbl8s,
+                              const void *keys)
+{
+    struct route_table rt;
+    uint64_t hz = rte_get_timer_hz();
+    size_t heap_before = heap_allocated_bytes();
+    size_t key_size;
+    uint32_t failed = 0;
+    uint64_t start, build_cycles, cycles;
+    double mem_mb;
+    int ret;
+
+    ret = route_table_create(&rt, backend, nb_routes, num_tbl8s);
+    if (ret != 0) {
+        printf("%-16s create failed: %s\n", rt.name, rte_strerror(-ret));
+        return;
+    }
+
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < nb_routes; i++) {
+        if (rt.is_ipv6) {
+            const struct prefix6 *r = &((const struct prefix6 *)routes)[i];
+            ret = route_table_add(&rt, &r->ip, r->depth, r->next_hop);
+        } else {
+            const struct prefix4 *r = &((const struct prefix4 *)routes)[i];
+            ret = route_table_add(&rt, &r->ip, r->depth, r->next_hop);
+        }
+        if (ret < 0)
+            failed++;
+    }
+    build_cycles = rte_rdtsc() - start;
+    mem_mb = (double)(heap_allocated_bytes() - heap_before) / (1024 * 1024);
+
+    key_size = rt.is_ipv6 ? sizeof(struct rte_ipv6_addr) : sizeof(uint32_t);
+    cycles = time_backend_lookups(&rt, keys, key_size);
+    print_backend_row(rt.name, rt.is_ipv6 ? "IPv6" : "IPv4", nb_routes, failed,
+                      (double)build_cycles / hz, mem_mb,
+                      cycles, BACKEND_ITERATIONS);
+
+    /* FIB 支持时再测 AVX-512 实现, 表不变 */
+    if (route_table_select_avx512(&rt) == 0) {
+        char name[32];
+
+        snprintf(name, sizeof(name), "%s avx512", rt.name);
+        cycles = time_backend_lookups(&rt, keys, key_size);
+        print_backend_row(name, rt.is_ipv6 ? "IPv6" : "IPv4", nb_routes, failed,
+                          (double)build_cycles / hz, mem_mb,
+                          cycles, BACKEND_ITERATIONS);
+    } else if (backend == BACKEND_FIB || backend == BACKEND_FIB6) {
+        printf("%-16s (AVX-512 lookup not available)\n", "");
+    }
+
+    route_table_free(&rt);
+}
+
+/*
+ * 全表规模的后端对比
+ * 指定了路由文件时用文件中的路由, 否则用合成全表; 两者都按前缀长度排序,
+ * tbl8 组数按表内容估算. 查找地址取自路由表本身 (随机前缀 + 随机主机位),
+ * 绝大多数命中
+ */
+static void benchmark_backends(void)
+{
+    int from_file = route_file != NULL;
+    struct prefix4 *v4 = NULL;
+    struct prefix6 *v6 = NULL;
+    uint32_t n4 = nb_v4_routes;
+    uint32_t n6 = nb_v6_routes;
+    uint32_t *keys4 = NULL;
+    struct rte_ipv6_addr *keys6 = NULL;
+    uint32_t groups;
+
+    /* 固定种子, 每次运行的路由表和查找地址相同 */
+    rte_srand(2024);
+
+    if (from_file) {
+        v4 = loaded_routes.v4;
+        n4 = loaded_routes.nb_v4;
+        v6 = loaded_routes.v6;
+        n6 = loaded_routes.nb_v6;
+    } else {
+        if (n4 > 0) {
+            v4 = generate_v4_table(n4);
+            if (v4 != NULL && sort_by_depth(v4, n4, sizeof(*v4),
+                                            offsetof(struct prefix4, depth), 32) < 0) {
+                free(v4);
+                v4 = NULL;
+            }
+        }
+        if (n6 > 0) {
+            v6 = generate_v6_table(n6);
+            if (v6 != NULL && sort_by_depth(v6, n6, sizeof(*v6),
+                                            offsetof(struct prefix6, depth), 128) < 0) {
+                free(v6);
+                v6 = NULL;
+            }
+        }
+    }
+
+    printf("Full-table backend comparison (%u IPv4 / %u IPv6 routes, %s)\n\n",
+           n4, n6, from_file ? route_file : "synthetic");
+    printf("Backend          Proto    Routes  Failed  Build(s)  Memory(MB)  Mlookups/s  Cyc/lkp\n");
+    printf("─────────────────────────────────────────────────────────────────────────────────\n");
+
+    if (n4 > 0) {
+        keys4 = malloc(sizeof(*keys4) * LOOKUP_SET_SIZE);
+        if (v4 == NULL || keys4 == NULL ||
+            estimate_tbl8s_v4(v4, n4, &groups) < 0) {
+            printf("Cannot allocate IPv4 route table\n");
+        } else {
+            for (uint32_t i = 0; i < LOOKUP_SET_SIZE; i++) {
+                const struct prefix4 *r = &v4[rte_rand() % n4];
+
+                keys4[i] = r->ip | ((uint32_t)rte_rand() & ~depth_to_mask(r->depth));
+            }
+            benchmark_backend(BACKEND_LPM, v4, n4, tbl8s_with_headroom(groups), keys4);
+            benchmark_backend(BACKEND_FIB, v4, n4, tbl8s_with_headroom(groups), keys4);
+        }
+    }
+
+    if (n6 > 0) {
+        keys6 = malloc(sizeof(*keys6) * LOOKUP_SET_SIZE);
+        if (v6 == NULL || keys6 == NULL ||
+            estimate_tbl8s_v6(v6, n6, &groups) < 0) {
+            printf("Cannot allocate IPv6 route table\n");
+        } else {
+            for (uint32_t i = 0; i < LOOKUP_SET_SIZE; i++) {
+                const struct prefix6 *r = &v6[rte_rand() % n6];
+                struct rte_ipv6_addr host;
+
+                /* 主机位随机, 再用前缀覆盖网络位 */
+                for (unsigned int b = 0; b < 16; b++)
+                    host.a[b] = (uint8_t)rte_rand();
+                for (unsigned int b = 0; b < 16; b++) {
+                    unsigned int bits = RTE_MIN(8U, r->depth > b * 8 ?
+                                                r->depth - b * 8 : 0U);
+                    uint8_t mask = bits == 0 ? 0 : (uint8_t)(0xFF << (8 - bits));
+
+                    keys6[i].a[b] = (r->ip.a[b] & mask) | (host.a[b] & ~mask);
+                }
+            }
+            benchmark_backend(BACKEND_LPM6, v6, n6, tbl8s_with_headroom(groups), keys6);
+            benchmark_backend(BACKEND_FIB6, v6, n6, tbl8s_with_headroom(groups), keys6);
+        }
+    }
+
+    if (from_file)
+        printf("\n(Duplicate prefixes in the file overwrite earlier entries)\n\n");
+    else
+        printf("\n(Routes include duplicate prefixes from the generator; "
+               "duplicates overwrite)\n\n");
+
+    free(keys6);
+    free(keys4);
+    if (!from_file) {
+        free(v6);
+        free(v4);
+    }
+}
+
+/*
+ * 查找基准的流量模型
+ * 目的地址集合有数百万个地址, 查找序列按均匀分布或 Zipf 分布从中抽取,
+ * 序列本身远大于 LLC, 不会像固定的几十个地址那样一直留在 L1 里
+ */
+static uint32_t random_dest(void)
+{
+    /* 有路由文件时地址落在文件的前缀内, 否则在 1.0.0.0 - 223.255.255.255 均匀分布 */
+    if (loaded_routes.nb_v4 > 0) {
+        const struct prefix4 *r = &loaded_routes.v4[rte_rand_max(loaded_routes.nb_v4)];
+
+        return r->ip | ((uint32_t)rte_rand() & ~depth_to_mask(r->depth));
+    } else {
+        uint32_t ip = (uint32_t)rte_rand();
+
+        return ((1 + (ip >> 24) % 223) << 24) | (ip & 0xFFFFFF);
+    }
+}
+
+/*
+ * 生成 TRACE_LEN 次查找的目的地址序列
+ * Zipf: 第 k 个地址 (k 从 1 开始) 的概率正比于 1 / k^s, 用累积分布二分查找抽样;
+ * 地址集合本身是随机的, 排名和地址之间没有关联
+ */
+static int build_trace(uint32_t *trace, enum traffic_dist dist)
+{
+    double *cdf;
+    double sum = 0;
+
+    if (dist == DIST_UNIFORM) {
+        for (uint32_t i = 0; i < TRACE_LEN; i++)
+            trace[i] = dest_set[rte_rand_max(nb_dests)];
+        return 0;
+    }
+
+    cdf = malloc(sizeof(*cdf) * nb_dests);
+    if (cdf == NULL)
+        return -ENOMEM;
+
+    for (uint32_t k = 0; k < nb_dests; k++) {
+        sum += 1.0 / pow((double)(k + 1), zipf_s);
+        cdf[k] = sum;
+    }
+
+    for (uint32_t i = 0; i < TRACE_LEN; i++) {
+        double u = rte_drand() * sum;
+        uint32_t lo = 0, hi = nb_dests - 1;
+
+        while (lo < hi) {
+            uint32_t mid = lo + (hi - lo) / 2;
+
+            if (cdf[mid] < u)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        trace[i] = dest_set[lo];
+    }
+
+    free(cdf);
+    return 0;
+}
+
+/* 生成地址集合和两种分布的查找序列 */
+static int init_traffic(void)
+{
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t start = rte_rdtsc();
+
+    dest_set = malloc(sizeof(*dest_set) * nb_dests);
+    traces[DIST_UNIFORM] = malloc(sizeof(uint32_t) * TRACE_LEN);
+    traces[DIST_ZIPF] = malloc(sizeof(uint32_t) * TRACE_LEN);
+    evict_buf = malloc(EVICT_BYTES);
+    if (dest_set == NULL || traces[DIST_UNIFORM] == NULL ||
+        traces[DIST_ZIPF] == NULL || evict_buf == NULL)
+        return -ENOMEM;
+
+    for (uint32_t i = 0; i < nb_dests; i++)
+        dest_set[i] = random_dest();
+
+    if (build_trace(traces[DIST_UNIFORM], DIST_UNIFORM) < 0 ||
+        build_trace(traces[DIST_ZIPF], DIST_ZIPF) < 0)
+        return -ENOMEM;
+
+    printf("Traffic: %u destinations (%s), %u lookups per trace, "
+           "Zipf s=%.2f, generated in %.1f s\n",
+           nb_dests, loaded_routes.nb_v4 > 0 ? "from route file" : "random unicast",
+           TRACE_LEN, zipf_s, (double)(rte_rdtsc() - start) / hz);
+    return 0;
+}
+
+static void free_traffic(void)
+{
+    free(evict_buf);
+    free(traces[DIST_ZIPF]);
+    free(traces[DIST_UNIFORM]);
+    free(dest_set);
+}
+
+/* 写一遍大于 LLC 的缓冲区, 把 LPM 表和查找序列挤出缓存 */
+static void evict_caches(void)
+{
+    for (size_t i = 0; i < EVICT_BYTES / sizeof(uint64_t); i += 8)
+        evict_buf[i]++;
+    rte_mb();
+}
+
+/*
+ * 连续查找 len 个地址, 返回总周期数
+ * 整段只读两次 TSC, 不在每个批次前后计时: rdtsc 本身几十个周期, 批次小时
+ * 会明显抬高每次查找的周期数
+ */
+static uint64_t run_lookups(const uint32_t *trace, uint32_t len,
+                            unsigned int batch, uint64_t *hits)
+{
+    uint32_t next_hops[MAX_LOOKUP_BATCH];
+    uint64_t found = 0;
+    uint64_t start;
+
+    start = rte_rdtsc_precise();
+    if (batch == 1) {
+        for (uint32_t i = 0; i < len; i++) {
+            uint32_t nh;
+
+            found += rte_lpm_lookup(lpm, trace[i], &nh) == 0;
+        }
+    } else {
+        for (uint32_t i = 0; i + batch <= len; i += batch) {
+            rte_lpm_lookup_bulk(lpm, &trace[i], next_hops, batch);
+            for (unsigned int j = 0; j < batch; j++)
+                found += (next_hops[j] & RTE_LPM_LOOKUP_SUCCESS) != 0;
+        }
+    }
+    *hits += found;
+
+    return rte_rdtsc_precise() - start;
+}
+
+/* CSV 一行, 表头见 main() */
+static void csv_row(const char *test, enum traffic_dist dist, const char *cache,
+                    unsigned int batch, uint64_t lookups, uint64_t cycles,
+                    uint64_t hits)
+{
+    double cpl = (double)cycles / lookups;
+
+    if (csv_fp == NULL)
+        return;
+
+    fprintf(csv_fp, "%s,%s,%.2f,%u,%s,%u,%" PRIu64 ",%.2f,%.2f,%.2f\n",
+            test, dist_names[dist], dist == DIST_ZIPF ? zipf_s : 0.0, nb_dests,
+            cache, batch, lookups, cpl, rte_get_timer_hz() / cpl / 1e6,
+            100.0 * hits / lookups);
+}
+
+/*
+ * 路由缓存对比: 同一条查找序列分别直接批量查 LPM 和先查缓存.
+ * "cache+upd" 每 CACHE_UPDATE_INTERVAL 次查找模拟一次路由更新
+ * (只递增版本号), 看失效对命中率的影响
+ */
+static void benchmark_route_cache(void)
+{
+    struct route_cache *cache = route_cache_create((int)rte_socket_id());
+    uint32_t hops[BURST_SIZE];
+    uint64_t hz = rte_get_timer_hz();
+
+    printf("Route cache (%u entries, direct-mapped) vs bulk LPM, batch %u\n\n",
+           ROUTE_CACHE_SIZE, BURST_SIZE);
+    printf("Distribution  Method        Lookups/sec   Cycles/Lookup   Cache Hit%%   Speedup\n");
+    printf("─────────────────────────────────────────────────────────────────────────────\n");
+
+    if (cache == NULL) {
+        printf("Cannot allocate route cache\n\n");
+        return;
+    }
+
+    for (int d = 0; d < DIST_MAX; d++) {
+        const uint32_t *trace = traces[d];
+        uint64_t lpm_cycles, hits = 0;
+        double lpm_cpl;
+
+        /* 预热后计时, 与 warm 模式一致 */
+        run_lookups(trace, TRACE_LEN, BURST_SIZE, &hits);
+        hits = 0;
+        lpm_cycles = run_lookups(trace, TRACE_LEN, BURST_SIZE, &hits);
+        lpm_cpl = (double)lpm_cycles / TRACE_LEN;
+        printf("%-12s  %-10s  %10.2f M   %10.2f   %10s   %7s\n",
+               dist_names[d], "lpm", hz / lpm_cpl / 1e6, lpm_cpl, "-", "1.00x");
+        csv_row("route_cache_lpm", d, "warm", BURST_SIZE, TRACE_LEN, lpm_cycles, hits);
+
+        for (int upd = 0; upd <= 1; upd++) {
+            uint64_t start, cycles;
+            double cpl, hit_rate;
+
+            for (uint32_t i = 0; i < TRACE_LEN; i += BURST_SIZE)
+                route_cache_lookup_bulk(cache, &trace[i], hops, BURST_SIZE);
+            cache->hits = 0;
+            cache->misses = 0;
+
+            start = rte_rdtsc_precise();
+            for (uint32_t i = 0; i < TRACE_LEN; i += BURST_SIZE) {
+                if (upd && (i & (CACHE_UPDATE_INTERVAL - 1)) == 0)
+                    route_table_changed();
+                route_cache_lookup_bulk(cache, &trace[i], hops, BURST_SIZE);
+            }
+            cycles = rte_rdtsc_precise() - start;
+
+            cpl = (double)cycles / TRACE_LEN;
+            hit_rate = 100.0 * cache->hits / (cache->hits + cache->misses);
+            printf("%-12s  %-10s  %10.2f M   %10.2f   %9.1f%%   %6.2fx\n",
+                   dist_names[d], upd ? "cache+upd" : "cache",
+                   hz / cpl / 1e6, cpl, hit_rate, lpm_cpl / cpl);
+            csv_row(upd ? "route_cache_upd" : "route_cache", d, "warm",
+                    BURST_SIZE, TRACE_LEN, cycles, cache->hits);
+        }
+    }
+
+    printf("\n(hit_pct in the CSV is the cache hit rate for cache rows)\n\n");
+    rte_free(cache);
+}
+
+/*
+ * 批量查找性能测试
+ * 两种分布各在热缓存和冷缓存下测量:
+ *   warm: 先完整跑一遍序列预热, 再计时跑一遍, 即稳态下分布所能达到的缓存命中
+ *   cold: 每轮先写一遍 EVICT_BYTES 的缓冲区清掉缓存, 再计时 COLD_LOOKUPS 次
+ *         查找, 对应流水线其他阶段把 LPM 表挤出缓存之后的首批查找
+ */
+static void benchmark_bulk_lookup(void)
+{
+    const unsigned int batch_sizes[] = {1, 8, 16, 32, 64};
+    uint64_t hz = rte_get_timer_hz();
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║         Bulk Lookup Performance Benchmark             ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Distribution  Cache  Batch    Lookups/sec   Cycles/Lookup  Time/Lookup    Hit%%\n");
+    printf("────────────────────────────────────────────────────────────────────────────────\n");
+
+    for (int d = 0; d < DIST_MAX; d++) {
+        for (int cold = 0; cold <= 1; cold++) {
+            for (size_t i = 0; i < RTE_DIM(batch_sizes); i++) {
+                unsigned int batch_size = batch_sizes[i];
+                uint64_t cycles = 0, hits = 0, lookups;
+                double cpl;
+
+                if (!cold) {
+                    run_lookups(traces[d], TRACE_LEN, batch_size, &hits);
+                    hits = 0;
+                    cycles = run_lookups(traces[d], TRACE_LEN, batch_size, &hits);
+                    lookups = TRACE_LEN;
+                } else {
+                    for (uint32_t r = 0; r < COLD_ROUNDS; r++) {
+                        evict_caches();
+                        cycles += run_lookups(traces[d] + r * COLD_LOOKUPS,
+                                              COLD_LOOKUPS, batch_size, &hits);
+                    }
+                    lookups = (uint64_t)COLD_ROUNDS * COLD_LOOKUPS;
+                }
+
+                cpl = (double)cycles / lookups;
+                printf("%-12s  %-5s  %5u   %10.2f M   %10.2f     %8.2f ns   %5.1f\n",
+                       dist_names[d], cold ? "cold" : "warm", batch_size,
+                       hz / cpl / 1e6, cpl, cpl * 1e9 / hz,
+                       100.0 * hits / lookups);
+                csv_row("bulk_lookup", d, cold ? "cold" : "warm", batch_size,
+                        lookups, cycles, hits);
+            }
+        }
+    }
+
+    printf("\n");
+
+    /* 路由缓存与直接查 LPM 对比 */
+    benchmark_route_cache();
+
+    /* 全表规模下比较各路由后端 */
+    if (route_file != NULL || nb_v4_routes > 0 || nb_v6_routes > 0)
+        benchmark_backends();
+}
+
+/*
+ * L3 转发
+ * 离线模拟和 -F 转发模式走同一条路径: 解析目的地址, 4 个一组查 LPM,
+ * 按流哈希选 ECMP 路径, 改写 MAC, TTL 减一并增量更新校验和, 按出端口缓冲发送
+ */
+static inline struct rte_ipv4_hdr *fwd_parse_ipv4(struct rte_mbuf *m)
+{
+    struct rte_ether_hdr *eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    struct rte_ipv4_hdr *ip = (struct rte_ipv4_hdr *)(eth + 1);
+
+    if (unlikely(m->data_len < sizeof(*eth) + sizeof(*ip) ||
+                 eth->ether_type != rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4) ||
+                 (ip->version_ihl >> 4) != 4 ||
+                 (ip->version_ihl & RTE_IPV4_HDR_IHL_MASK) < 5))
+        return NULL;
+    return ip;
+}
+
+/*
+ * 流哈希: 网卡给了 RSS 哈希就直接用, 否则按五元组计算.
+ * 同一条流总是走同一条路径, 避免乱序
+ */
+static inline uint32_t fwd_flow_hash(const struct rte_mbuf *m,
+                                     const struct rte_ipv4_hdr *ip)
+{
+    uint32_t ports = 0;
+
+    if (m->ol_flags & RTE_MBUF_F_RX_RSS_HASH)
+        return m->hash.rss;
+
+    if ((ip->next_proto_id == IPPROTO_TCP || ip->next_proto_id == IPPROTO_UDP) &&
+        (ip->fragment_offset & rte_cpu_to_be_16(RTE_IPV4_HDR_OFFSET_MASK |
+                                                RTE_IPV4_HDR_MF_FLAG)) == 0) {
+        const struct rte_udp_hdr *l4 = (const struct rte_udp_hdr *)
+            ((const uint8_t *)ip + rte_ipv4_hdr_len(ip));
+
+        ports = ((uint32_t)l4->src_port << 16) | l4->dst_port;
+    }
+    return rte_jhash_3words(ip->src_addr, ip->dst_addr, ports,
+                            ip->next_proto_id);
+}
+
+/*
+ * TTL 减一, 校验和增量更新 (RFC 1624): TTL 是 (TTL, protocol) 这个 16 位字的
+ * 高字节, 减一相当于该字减 0x0100, 校验和 (反码) 相应加 0x0100
+ */
+static inline void fwd_decrement_ttl(struct rte_ipv4_hdr *ip)
+{
+    uint32_t check = ip->hdr_checksum;
+
+    check += rte_cpu_to_be_16(0x0100);
+    ip->hdr_checksum = (rte_be16_t)(check + (check >= 0xFFFF));
+    ip->time_to_live--;
+}
+
+static inline void fwd_send(struct fwd_ctx *ctx, uint16_t port, struct rte_mbuf *m)
+{
+    /* 离线模拟没有端口, 计数后释放 */
+    if (ctx->sink) {
+        ctx->stats->tx_packets++;
+        rte_pktmbuf_free(m);
+        return;
+    }
+    ctx->stats->tx_packets += rte_eth_tx_buffer(port, ctx->queue_id,
+                                                ctx->tx_buf[port], m);
+}
+
+static inline void fwd_one(struct fwd_ctx *ctx, struct rte_mbuf *m,
+                           struct rte_ipv4_hdr *ip, uint32_t hop)
+{
+    struct fwd_stats *st = ctx->stats;
+    struct rte_ether_hdr *eth;
+    const struct nh_group *grp;
+    const struct next_hop_info *nh;
+    uint16_t port;
+
+    if (hop == ROUTE_NO_NH) {
+        st->no_route++;
+        rte_pktmbuf_free(m);
+        return;
+    }
+
+    grp = nh_group_lookup(hop);
+    if (grp->nb_paths > 1) {
+        uint32_t h = fwd_flow_hash(m, ip);
+
+        nh = &next_hop_table[grp->paths[((uint64_t)h * grp->nb_paths) >> 32]];
+        st->ecmp_packets++;
+    } else {
+        nh = &next_hop_table[grp->paths[0]];
+    }
+
+    if (nh->type == NH_TYPE_BLACKHOLE || nh->type == NH_TYPE_REJECT) {
+        st->blackholed++;
+        rte_pktmbuf_free(m);
+        return;
+    }
+    if (ip->time_to_live <= 1) {
+        st->ttl_exceeded++;
+        rte_pktmbuf_free(m);
+        return;
+    }
+    fwd_decrement_ttl(ip);
+
+    /* 邻接表里的端口号按实际端口数取模, 单口环回测试也能用 */
+    port = ctx->sink ? nh->port_id : fwd_ports[nh->port_id % nb_fwd_ports];
+
+    eth = rte_pktmbuf_mtod(m, struct rte_ether_hdr *);
+    rte_ether_addr_copy(&nh->dst_mac, &eth->dst_addr);
+    rte_ether_addr_copy(&port_macs[port], &eth->src_addr);
+
+    fwd_send(ctx, port, m);
+}
+
+/* 处理一个 burst 的数据包 */
+static void l3fwd_burst(struct fwd_ctx *ctx, struct rte_mbuf **pkts, uint16_t nb)
+{
+    struct rte_ipv4_hdr *ips[BURST_SIZE];
+    struct rte_mbuf *valid[BURST_SIZE];
+    uint32_t dst[BURST_SIZE];
+    uint32_t hops[BURST_SIZE];
+    uint16_t n = 0;
+    uint16_t i;
+
+    ctx->stats->rx_packets += nb;
+
+    /* 1. 取出目的地址, 丢弃非 IPv4 */
+    for (i = 0; i < nb; i++) {
+        struct rte_ipv4_hdr *ip = fwd_parse_ipv4(pkts[i]);
+
+        if (ip == NULL) {
+            ctx->stats->bad_header++;
+            rte_pktmbuf_free(pkts[i]);
+            continue;
+        }
+        valid[n] = pkts[i];
+        ips[n] = ip;
+        dst[n] = rte_be_to_cpu_32(ip->dst_addr);
+        n++;
+    }
+
+    /* 2. 查下一跳, 未命中为 ROUTE_NO_NH. 开了路由缓存先查缓存, 否则每次查 4 个 */
+    if (ctx->cache != NULL) {
+        route_cache_lookup_bulk(ctx->cache, dst, hops, n);
+    } else {
+        for (i = 0; i + 4 <= n; i += 4) {
+            xmm_t v = vect_loadu_sil128((xmm_t *)&dst[i]);
+
+            rte_lpm_lookup_x4(lpm, v, &hops[i], ROUTE_NO_NH);
+        }
+        for (; i < n; i++) {
+            if (rte_lpm_lookup(lpm, dst[i], &hops[i]) != 0)
+                hops[i] = ROUTE_NO_NH;
+        }
+    }
+
+    /* 3. 选路径, 改写, 发送 */
+    for (i = 0; i < n; i++)
+        fwd_one(ctx, valid[i], ips[i], hops[i]);
+}
+
+/* 离线模拟用的 64 字节 UDP 包, 源端口随序号变化以分散 ECMP */
+static void build_test_packet(struct rte_mbuf *m, uint32_t dst_ip, uint32_t seq)
+{
+    struct rte_ether_hdr *eth;
+    struct rte_ipv4_hdr *ip;
+    struct rte_udp_hdr *udp;
+    uint16_t pkt_len = RTE_ETHER_MIN_LEN - RTE_ETHER_CRC_LEN;
+
+    eth = (struct rte_ether_hdr *)rte_pktmbuf_append(m, pkt_len);
+    memset(eth, 0, pkt_len);
+    eth->ether_type = rte_cpu_to_be_16(RTE_ETHER_TYPE_IPV4);
+
+    ip = (struct rte_ipv4_hdr *)(eth + 1);
+    ip->version_ihl = RTE_IPV4_VHL_DEF;
+    ip->total_length = rte_cpu_to_be_16(pkt_len - sizeof(*eth));
+    ip->time_to_live = 64;
+    ip->next_proto_id = IPPROTO_UDP;
+    ip->src_addr = rte_cpu_to_be_32(IPv4(192, 168, 1, (seq & 0x7F) + 1));
+    ip->dst_addr = rte_cpu_to_be_32(dst_ip);
+    ip->hdr_checksum = rte_ipv4_cksum(ip);
+
+    udp = (struct rte_udp_hdr *)(ip + 1);
+    udp->src_port = rte_cpu_to_be_16((uint16_t)(1024 + (seq & 0x3FFF)));
+    udp->dst_port = rte_cpu_to_be_16(53);
+    udp->dgram_len = rte_cpu_to_be_16(pkt_len - sizeof(*eth) - sizeof(*ip));
+}
+
+/*
+ * 转发 lcore: 第 queue_id 个 worker 轮询所有端口的第 queue_id 个 RX 队列,
+ * 每个出端口一个 TX 缓冲
+ */
+static int fwd_worker_main(void *arg)
+{
+    unsigned int lcore_id = rte_lcore_id();
+    struct fwd_ctx ctx = {
+        .queue_id = (uint16_t)(uintptr_t)arg,
+        .stats = &fwd_stats[lcore_id],
+    };
+    struct rte_mbuf *pkts[BURST_SIZE];
+    int ret = 0;
+
+    for (uint16_t i = 0; i < nb_fwd_ports; i++) {
+        uint16_t port = fwd_ports[i];
+
+        ctx.tx_buf[port] = rte_zmalloc_socket("fwd_tx_buffer",
+                                              RTE_ETH_TX_BUFFER_SIZE(BURST_SIZE), 0,
+                                              rte_lcore_to_socket_id(lcore_id));
+        if (ctx.tx_buf[port] == NULL) {
+            printf("Failed to allocate TX buffer on lcore %u\n", lcore_id);
+            ret = -1;
+            goto out;
+        }
+        rte_eth_tx_buffer_init(ctx.tx_buf[port], BURST_SIZE);
+        rte_eth_tx_buffer_set_err_callback(ctx.tx_buf[port],
+                                           rte_eth_tx_buffer_count_callback,
+                                           &ctx.stats->tx_dropped);
+    }
+
+    /* 缓存由 run_forwarder() 在所有 worker 退出后释放, 统计要读到最后 */
+    if (route_cache_enabled) {
+        ctx.cache = route_cache_create((int)rte_lcore_to_socket_id(lcore_id));
+        if (ctx.cache == NULL) {
+            printf("Failed to allocate route cache on lcore %u\n", lcore_id);
+            ret = -1;
+            goto out;
+        }
+        fwd_caches[lcore_id] = ctx.cache;
+    }
+
+    printf("Forwarding lcore %u started, queue %u%s\n", lcore_id, ctx.queue_id,
+           ctx.cache != NULL ? ", route cache on" : "");
+
+    while (!force_quit) {
+        for (uint16_t i = 0; i < nb_fwd_ports; i++) {
+            uint16_t nb_rx = rte_eth_rx_burst(fwd_ports[i], ctx.queue_id,
+                                              pkts, BURST_SIZE);
+
+            if (nb_rx > 0)
+                l3fwd_burst(&ctx, pkts, nb_rx);
+        }
+
+        for (uint16_t i = 0; i < nb_fwd_ports; i++) {
+            uint16_t port = fwd_ports[i];
+
+            ctx.stats->tx_packets += rte_eth_tx_buffer_flush(port, ctx.queue_id,
+                                                             ctx.tx_buf[port]);
+        }
+    }
+
+out:
+    for (uint16_t i = 0; i < nb_fwd_ports; i++)
+        rte_free(ctx.tx_buf[fwd_ports[i]]);
+    return ret;
+}
+
+/* 初始化转发端口: 每个 worker 一对 RX/TX 队列, RSS 分流并把哈希带给 ECMP */
+static int fwd_port_init(uint16_t port, uint16_t nb_queues)
+{
+    struct rte_eth_conf port_conf;
+    struct rte_eth_dev_info dev_info;
+    int ret;
+
+    ret = rte_eth_dev_info_get(port, &dev_info);
+    if (ret != 0)
+        return ret;
+
+    memset(&port_conf, 0, sizeof(port_conf));
+    port_conf.rxmode.mq_mode = RTE_ETH_MQ_RX_RSS;
+    port_conf.rx_adv_conf.rss_conf.rss_hf =
+        (RTE_ETH_RSS_IP | RTE_ETH_RSS_TCP | RTE_ETH_RSS_UDP) &
+        dev_info.flow_type_rss_offloads;
+    if (dev_info.rx_offload_capa & RTE_ETH_RX_OFFLOAD_RSS_HASH)
+        port_conf.rxmode.offloads |= RTE_ETH_RX_OFFLOAD_RSS_HASH;
+    if (dev_info.tx_offload_capa & RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE)
+        port_conf.txmode.offloads |= RTE_ETH_TX_OFFLOAD_MBUF_FAST_FREE;
+
+    ret = rte_eth_dev_configure(port, nb_queues, nb_queues, &port_conf);
+    if (ret != 0)
+        return ret;
+
+    for (uint16_t q = 0; q < nb_queues; q++) {
+        ret = rte_eth_rx_queue_setup(port, q, RX_RING_SIZE,
+                                     rte_eth_dev_socket_id(port),
+                                     NULL, mbuf_pool);
+        if (ret < 0)
+            return ret;
+        ret = rte_eth_tx_queue_setup(port, q, TX_RING_SIZE,
+                                     rte_eth_dev_socket_id(port), NULL);
+        if (ret < 0)
+            return ret;
+    }
+
+    ret = rte_eth_macaddr_get(port, &port_macs[port]);
+    if (ret != 0)
+        return ret;
+
+    ret = rte_eth_dev_start(port);
+    if (ret < 0)
+        return ret;
+
+    return rte_eth_promiscuous_enable(port);
+}
+
+static void sum_fwd_stats(struct fwd_stats *total)
+{
+    unsigned int lcore_id;
+
+    memset(total, 0, sizeof(*total));
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const struct fwd_stats *s = &fwd_stats[lcore_id];
+
+        total->rx_packets += s->rx_packets;
+        total->tx_packets += s->tx_packets;
+        total->tx_dropped += s->tx_dropped;
+        total->no_route += s->no_route;
+        total->ttl_exceeded += s->ttl_exceeded;
+        total->bad_header += s->bad_header;
+        total->blackholed += s->blackholed;
+        total->ecmp_packets += s->ecmp_packets;
+    }
+}
+
+/* 所有转发 lcore 的路由缓存命中率 (%) */
+static double fwd_cache_hit_rate(void)
+{
+    uint64_t hits = 0, misses = 0;
+    unsigned int lcore_id;
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        const struct route_cache *c = fwd_caches[lcore_id];
+
+        if (c != NULL) {
+            hits += __atomic_load_n(&c->hits, __ATOMIC_RELAXED);
+            misses += __atomic_load_n(&c->misses, __ATOMIC_RELAXED);
+        }
+    }
+    return hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0;
+}
+
+/*
+ * -F 转发模式: 所有端口, 每个 worker lcore 一个队列, 每秒打印一次速率,
+ * Ctrl-C 退出
+ */
+static void run_forwarder(void)
+{
+    struct fwd_stats prev, cur;
+    uint16_t nb_queues = (uint16_t)(rte_lcore_count() - 1);
+    uint16_t port, q = 0;
+    unsigned int lcore_id;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║         L3 Forwarding (LPM + ECMP)                    ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    if (nb_queues == 0) {
+        printf("Forwarding needs at least one worker lcore (e.g. -l 0-2)\n");
+        return;
+    }
+
+    RTE_ETH_FOREACH_DEV(port) {
+        int ret = fwd_port_init(port, nb_queues);
+
+        if (ret != 0) {
+            printf("Cannot init port %u: %s\n", port, rte_strerror(-ret));
+            goto stop_ports;
+        }
+        fwd_ports[nb_fwd_ports++] = port;
+        printf("Port %u: " RTE_ETHER_ADDR_PRT_FMT ", %u queues\n", port,
+               RTE_ETHER_ADDR_BYTES(&port_macs[port]), nb_queues);
+    }
+    if (nb_fwd_ports == 0) {
+        printf("No ports available (bind a NIC or use --vdev)\n");
+        return;
+    }
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        rte_eal_remote_launch(fwd_worker_main, (void *)(uintptr_t)q, lcore_id);
+        q++;
+    }
+
+    printf("\nForwarding on %u ports with %u lcores, Ctrl-C to stop\n\n",
+           nb_fwd_ports, nb_queues);
+    printf("     RX Mpps     TX Mpps   TX drop/s   No route    TTL exp  Blackhole       ECMP%s\n",
+           route_cache_enabled ? "  Cache hit%" : "");
+
+    sum_fwd_stats(&prev);
+    while (!force_quit) {
+        sleep(FWD_STATS_INTERVAL);
+        sum_fwd_stats(&cur);
+        printf("%12.3f %11.3f %11" PRIu64 " %10" PRIu64 " %10" PRIu64
+               " %10" PRIu64 " %10" PRIu64,
+               (double)(cur.rx_packets - prev.rx_packets) / FWD_STATS_INTERVAL / 1e6,
+               (double)(cur.tx_packets - prev.tx_packets) / FWD_STATS_INTERVAL / 1e6,
+               (cur.tx_dropped - prev.tx_dropped) / FWD_STATS_INTERVAL,
+               cur.no_route, cur.ttl_exceeded, cur.blackholed, cur.ecmp_packets);
+        if (route_cache_enabled)
+            printf(" %11.1f", fwd_cache_hit_rate());
+        printf("\n");
+        prev = cur;
+    }
+
+    rte_eal_mp_wait_lcore();
+
+    sum_fwd_stats(&cur);
+    stats.packets_forwarded += cur.tx_packets;
+    stats.packets_dropped += cur.rx_packets - cur.tx_packets;
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id) {
+        rte_free(fwd_caches[lcore_id]);
+        fwd_caches[lcore_id] = NULL;
+    }
+
+stop_ports:
+    for (uint16_t i = 0; i < nb_fwd_ports; i++) {
+        rte_eth_dev_stop(fwd_ports[i]);
+        rte_eth_dev_close(fwd_ports[i]);
+    }
+}
+
+/*
+ * 模拟数据包转发
+ * 按 Zipf 序列构造 UDP 包, 走与 -F 模式相同的 l3fwd_burst(), 只是不发包.
+ * 先单独测一遍构造包 (分配 + 填头 + 释放) 的开销, 从总时间里扣掉
+ */
+static void simulate_packet_forwarding(void)
+{
+    const uint32_t num_packets = FORWARD_PACKETS;
+    const uint32_t *trace = traces[DIST_ZIPF];
+    struct fwd_stats sim;
+    struct fwd_ctx ctx = { .queue_id = 0, .sink = 1, .stats = &sim };
+    struct route_cache *cache = NULL;
+    struct rte_mbuf *pkts[BURST_SIZE];
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t start, gen_cycles, total_cycles, fwd_cycles;
+    uint64_t routed, dropped;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║         Simulating Packet Forwarding                  ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Processing %u packets (Zipf s=%.2f over %u destinations)...\n",
+           num_packets, zipf_s, nb_dests);
+
+    /* 只构造包 */
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_packets; i += BURST_SIZE) {
+        if (rte_pktmbuf_alloc_bulk(mbuf_pool, pkts, BURST_SIZE) != 0) {
+            printf("mbuf allocation failed\n");
+            return;
+        }
+        for (unsigned int j = 0; j < BURST_SIZE; j++)
+            build_test_packet(pkts[j], trace[i + j], i + j);
+        rte_pktmbuf_free_bulk(pkts, BURST_SIZE);
+    }
+    gen_cycles = rte_rdtsc() - start;
+
+    /* 构造 + 转发 */
+    if (route_cache_enabled) {
+        cache = route_cache_create((int)rte_socket_id());
+        if (cache == NULL) {
+            printf("Cannot allocate route cache\n");
+            return;
+        }
+        ctx.cache = cache;
+    }
+    memset(&sim, 0, sizeof(sim));
+    start = rte_rdtsc();
+    for (uint32_t i = 0; i < num_packets; i += BURST_SIZE) {
+        if (rte_pktmbuf_alloc_bulk(mbuf_pool, pkts, BURST_SIZE) != 0) {
+            printf("mbuf allocation failed\n");
+            rte_free(cache);
+            return;
+        }
+        for (unsigned int j = 0; j < BURST_SIZE; j++)
+            build_test_packet(pkts[j], trace[i + j], i + j);
+        l3fwd_burst(&ctx, pkts, BURST_SIZE);
+    }
+    total_cycles = rte_rdtsc() - start;
+    fwd_cycles = total_cycles > gen_cycles ? total_cycles - gen_cycles : 0;
+
+    routed = num_packets - sim.no_route - sim.bad_header;
+    dropped = num_packets - sim.tx_packets;
+
+    stats.lookups += num_packets;
+    stats.hits += routed;
+    stats.misses += num_packets - routed;
+    stats.total_cycles += fwd_cycles;
+    stats.packets_forwarded += sim.tx_packets;
+    stats.packets_dropped += dropped;
+    csv_row("forwarding", DIST_ZIPF, "warm", BURST_SIZE, num_packets,
+            fwd_cycles, routed);
+
+    printf("\nResults:\n");
+    printf("  Total Packets:        %u\n", num_packets);
+    printf("  Forwarded:            %" PRIu64 " (%.1f%%, %" PRIu64 " via ECMP)\n",
+           sim.tx_packets, 100.0 * sim.tx_packets / num_packets, sim.ecmp_packets);
+    printf("  Dropped:              %" PRIu64 " (no route %" PRIu64
+           ", blackhole %" PRIu64 ", TTL %" PRIu64 ")\n",
+           dropped, sim.no_route, sim.blackholed, sim.ttl_exceeded);
+    printf("  Processing Time:      %.3f ms (%.3f ms building packets)\n",
+           (double)total_cycles * 1000 / hz, (double)gen_cycles * 1000 / hz);
+    printf("  Forwarding Cost:      %.1f cycles/packet\n",
+           (double)fwd_cycles / num_packets);
+    printf("  Throughput:           %.2f Mpps (forwarding only, one core)\n",
+           fwd_cycles != 0 ? num_packets / ((double)fwd_cycles / hz) / 1e6 : 0.0);
+    if (cache != NULL)
+        printf("  Route Cache Hits:     %.1f%%\n",
+               100.0 * cache->hits / (cache->hits + cache->misses));
+    printf("\n");
+
+    rte_free(cache);
+}
+
+/*
+ * 第 seq 条抖动路由
+ * 全部位于 100.64.0.0/10, 不与演示路由重叠; 每 4 条中有 1 条 /28,
+ * 需要分配 tbl8. 窗口 (2048) 小于槽位数, 同时存在的抖动路由互不重复
+ */
+static void churn_route(uint64_t seq, uint32_t *ip, uint8_t *depth)
+{
+    uint32_t slot = (uint32_t)(seq % CHURN_SLOTS);
+
+    *ip = IPv4(100, 64, 0, 0) + (slot << 8);
+    if ((seq & 3) == 0) {
+        *ip += ((uint32_t)(seq >> 2) & 0xF) << 4;
+        *depth = 28;
+    } else {
+        *depth = 24;
+    }
+}
+
+/* 执行一次路由更新并记录耗时 */
+static void churn_update(uint64_t seq, int is_add)
+{
+    uint32_t ip;
+    uint8_t depth;
+    uint64_t start, cycles;
+    int ret;
+
+    churn_route(seq, &ip, &depth);
+
+    start = rte_rdtsc();
+    if (is_add)
+        ret = rte_lpm_add(lpm, ip, depth, (seq & 1) ? 10 : 11);
+    else
+        ret = rte_lpm_delete(lpm, ip, depth);
+    cycles = rte_rdtsc() - start;
+    route_table_changed();
+
+    if (is_add) {
+        __atomic_fetch_add(&churn.adds, 1, __ATOMIC_RELAXED);
+        if (ret < 0)
+            __atomic_fetch_add(&churn.add_failures, 1, __ATOMIC_RELAXED);
+    } else {
+        __atomic_fetch_add(&churn.deletes, 1, __ATOMIC_RELAXED);
+        if (ret < 0)
+            __atomic_fetch_add(&churn.delete_failures, 1, __ATOMIC_RELAXED);
+    }
+
+    churn.update_cycles += cycles;
+    if (cycles > churn.max_update_cycles)
+        churn.max_update_cycles = cycles;
+}
+
+/*
+ * 控制线程: 按 churn_rate 匀速增删路由
+ * rte_lpm 只允许单写者, 所有更新都在这个线程里完成. 先以全速填满窗口,
+ * 之后 add 与 delete 交替进行, 路由数保持在 CHURN_WINDOW
+ */
+static uint32_t churn_thread_main(__rte_unused void *arg)
+{
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t start = rte_get_timer_cycles();
+    uint64_t add_seq = 0, del_seq = 0;
+
+    while (!__atomic_load_n(&churn_stop, __ATOMIC_RELAXED)) {
+        uint64_t due = (rte_get_timer_cycles() - start) * churn_rate / hz;
+
+        if (add_seq + del_seq >= due) {
+            rte_pause();
+            continue;
+        }
+
+        if (add_seq - del_seq >= CHURN_WINDOW)
+            churn_update(del_seq++, 0);
+        else
+            churn_update(add_seq++, 1);
+    }
+
+    /* 撤销剩余的抖动路由, 路由表恢复原状 */
+    while (del_seq < add_seq)
+        churn_update(del_seq++, 0);
+
+    return 0;
+}
+
+/*
+ * 查找 lcore
+ * 每个 burst 之后不再持有任何 tbl8 引用, 在此报告静止状态
+ */
+static int lpm_reader_main(__rte_unused void *arg)
+{
+    unsigned int lcore_id = rte_lcore_id();
+    struct reader_stats *rs = &reader_stats[lcore_id];
+    uint32_t next_hops[BURST_SIZE];
+    uint32_t idx = (lcore_id * BURST_SIZE * 97) & (LOOKUP_SET_SIZE - 1);
+    uint64_t lookups = 0, hits = 0;
+
+    rte_rcu_qsbr_thread_register(lpm_qsv, lcore_id);
+    rte_rcu_qsbr_thread_online(lpm_qsv, lcore_id);
+
+    while (!__atomic_load_n(&readers_stop, __ATOMIC_RELAXED) && !force_quit) {
+        rte_lpm_lookup_bulk(lpm, &lookup_set[idx], next_hops, BURST_SIZE);
+
+        for (unsigned int i = 0; i < BURST_SIZE; i++)
+            hits += (next_hops[i] & RTE_LPM_LOOKUP_SUCCESS) != 0;
+
+        idx = (idx + BURST_SIZE) & (LOOKUP_SET_SIZE - 1);
+        lookups += BURST_SIZE;
+
+        rte_rcu_qsbr_quiescent(lpm_qsv, lcore_id);
+        __atomic_store_n(&rs->lookups, lookups, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&rs->hits, hits, __ATOMIC_RELAXED);
+
+    rte_rcu_qsbr_thread_offline(lpm_qsv, lcore_id);
+    rte_rcu_qsbr_thread_unregister(lpm_qsv, lcore_id);
+    return 0;
+}
+
+/* 所有查找 lcore 的累计查找数 */
+static uint64_t sum_reader_lookups(void)
+{
+    uint64_t total = 0;
+    unsigned int lcore_id;
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id)
+        total += __atomic_load_n(&reader_stats[lcore_id].lookups,
+                                 __ATOMIC_RELAXED);
+    return total;
+}
+
+/*
+ * 测量一个阶段, 每秒打印一行, 返回平均 Mlookups/s
+ */
+static double measure_phase(const char *name)
+{
+    uint64_t hz = rte_get_timer_hz();
+    uint64_t start_lookups = sum_reader_lookups();
+    uint64_t start_tsc = rte_get_timer_cycles();
+    uint64_t prev_lookups = start_lookups, prev_tsc = start_tsc;
+    uint64_t prev_updates = churn.adds + churn.deletes;
+
+    for (unsigned int sec = 1; sec <= phase_seconds && !force_quit; sec++) {
+        sleep(1);
+
+        uint64_t cur_lookups = sum_reader_lookups();
+        uint64_t cur_tsc = rte_get_timer_cycles();
+        uint64_t cur_updates = __atomic_load_n(&churn.adds, __ATOMIC_RELAXED) +
+                               __atomic_load_n(&churn.deletes, __ATOMIC_RELAXED);
+        double secs = (double)(cur_tsc - prev_tsc) / hz;
+
+        printf("%-10s %4u   %12.2f   %10.0f\n", name, sec,
+               (cur_lookups - prev_lookups) / secs / 1e6,
+               (cur_updates - prev_updates) / secs);
+
+        prev_lookups = cur_lookups;
+        prev_tsc = cur_tsc;
+        prev_updates = cur_updates;
+    }
+
+    return (double)(prev_lookups - start_lookups) /
+           ((double)(prev_tsc - start_tsc) / hz) / 1e6;
+}
+
+/*
+ * 多核查找 + 路由抖动测试
+ * 先测量无更新时的查找吞吐量, 再启动控制线程以 churn_rate 增删路由,
+ * 比较两者的差异
+ */
+static void benchmark_route_churn(void)
+{
+    unsigned int nb_readers = rte_lcore_count() - 1;
+    uint64_t hz = rte_get_timer_hz();
+    rte_thread_t churn_thread;
+    double base_mlps, churn_mlps;
+    uint64_t nb_updates;
+    unsigned int lcore_id;
+    int ret;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║      Multi-core Lookup under Route Churn               ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    if (nb_readers == 0) {
+        printf("Skipped: needs at least 2 lcores (e.g. -l 0-3)\n\n");
+        return;
+    }
+
+    /* 查找地址: 一半落在抖动网段 (经常变化的 tbl8), 一半按原有分布随机 */
+    lookup_set = rte_malloc("lookup_set", LOOKUP_SET_SIZE * sizeof(uint32_t),
+                            RTE_CACHE_LINE_SIZE);
+    if (lookup_set == NULL) {
+        printf("Cannot allocate lookup set\n\n");
+        return;
+    }
+    for (unsigned int i = 0; i < LOOKUP_SET_SIZE; i++) {
+        uint32_t r = rte_rand();
+
+        if (i & 1)
+            lookup_set[i] = IPv4(100, 64, 0, 0) + (r & 0x3FFFFF);
+        else if (r % 3 == 0)
+            lookup_set[i] = IPv4(10, 0, 0, r % 256);
+        else if (r % 3 == 1)
+            lookup_set[i] = IPv4(172, 16, (r >> 8) % 256, r % 256);
+        else
+            lookup_set[i] = IPv4(r >> 24, (r >> 16) & 0xFF,
+                                 (r >> 8) & 0xFF, r & 0xFF);
+    }
+
+    printf("Readers: %u lcores, churn: %u updates/s, window: %u routes\n\n",
+           nb_readers, churn_rate, CHURN_WINDOW);
+
+    memset(reader_stats, 0, sizeof(reader_stats));
+    memset(&churn, 0, sizeof(churn));
+    __atomic_store_n(&readers_stop, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&churn_stop, 0, __ATOMIC_RELAXED);
+
+    RTE_LCORE_FOREACH_WORKER(lcore_id)
+        rte_eal_remote_launch(lpm_reader_main, NULL, lcore_id);
+
+    printf("Phase       Sec    Mlookups/s    Updates/s\n");
+    printf("──────────────────────────────────────────────\n");
+
+    base_mlps = measure_phase("baseline");
+
+    ret = rte_thread_create_control(&churn_thread, "lpm-churn",
+                                    churn_thread_main, NULL);
+    if (ret != 0) {
+        printf("Cannot create churn thread: %s\n", rte_strerror(-ret));
+        churn_mlps = 0;
+    } else {
+        churn_mlps = measure_phase("churn");
+        __atomic_store_n(&churn_stop, 1, __ATOMIC_RELAXED);
+        rte_thread_join(churn_thread, NULL);
+    }
+
+    __atomic_store_n(&readers_stop, 1, __ATOMIC_RELAXED);
+    rte_eal_mp_wait_lcore();
+
+    nb_updates = churn.adds + churn.deletes;
+
+    printf("\nResults:\n");
+    printf("  Baseline:             %.2f Mlookups/s (%.2f per reader)\n",
+           base_mlps, base_mlps / nb_readers);
+    printf("  During churn:         %.2f Mlookups/s (%+.1f%%)\n",
+           churn_mlps,
+           base_mlps > 0 ? (churn_mlps - base_mlps) * 100.0 / base_mlps : 0);
+    printf("  Route adds:           %" PRIu64 " (failed %" PRIu64 ")\n",
+           churn.adds, churn.add_failures);
+    printf("  Route deletes:        %" PRIu64 " (failed %" PRIu64 ")\n",
+           churn.deletes, churn.delete_failures);
+    if (nb_updates > 0)
+        printf("  Update latency:       avg %.2f us, max %.2f us\n",
+               (double)churn.update_cycles / nb_updates * 1e6 / hz,
+               (double)churn.max_update_cycles * 1e6 / hz);
+    printf("\n");
+
+    rte_free(lookup_set);
+    lookup_set = NULL;
+}
+
+/* 打印统计信息 */
+static void print_statistics(void)
+{
+    double avg_cycles = stats.lookups > 0 ?
+                        (double)stats.total_cycles / stats.lookups : 0;
+    double avg_time_ns = avg_cycles * 1e9 / rte_get_timer_hz();
+    double hit_rate = stats.lookups > 0 ?
+                      100.0 * stats.hits / stats.lookups : 0;
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║                LPM Statistics                          ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    printf("Lookup Statistics:\n");
+    printf("  Total Lookups:        %" PRIu64 "\n", stats.lookups);
+    printf("  Hits:                 %" PRIu64 " (%.2f%%)\n",
+           stats.hits, hit_rate);
+    printf("  Misses:               %" PRIu64 " (%.2f%%)\n",
+           stats.misses, 100.0 - hit_rate);
+
+    printf("\nPerformance:\n");
+    printf("  Avg Cycles/Lookup:    %.2f\n", avg_cycles);
+    printf("  Avg Time/Lookup:      %.2f ns\n", avg_time_ns);
+    printf("  Estimated Throughput: %.2f Mlookups/s\n",
+           rte_get_timer_hz() / avg_cycles / 1e6);
+
+    printf("\nPacket Statistics:\n");
+    printf("  Forwarded:            %" PRIu64 "\n", stats.packets_forwarded);
+    printf("  Dropped:              %" PRIu64 "\n", stats.packets_dropped);
+
+    printf("\n");
+}
+
+/* 打印使用说明 */
+static void print_usage(const char *prgname)
+{
+    printf("\nUsage: %s [EAL options] -- [options]\n\n", prgname);
+    printf("Options:\n");
+    printf("  -r RATE    Route updates/s during the churn test (default: %u)\n",
+           DEFAULT_CHURN_RATE);
+    printf("  -t SEC     Seconds per churn test phase (default: %u)\n",
+           DEFAULT_PHASE_SEC);
+    printf("  -4 N       IPv4 routes in the backend comparison (default: %u, 0 skips)\n",
+           DEFAULT_V4_ROUTES);
+    printf("  -6 N       IPv6 routes in the backend comparison (default: %u, 0 skips)\n",
+           DEFAULT_V6_ROUTES);
+    printf("  -f FILE    Load routes from FILE (text \"prefix/len nexthop\" or MRT\n"
+           "             TABLE_DUMP_V2); replaces the synthetic tables above\n");
+    printf("  -d N       Destination addresses in the lookup benchmark (default: %u)\n",
+           DEFAULT_NB_DESTS);
+    printf("  -z S       Zipf exponent of the skewed traffic (default: %.2f)\n",
+           DEFAULT_ZIPF_S);
+    printf("  -o FILE    Write benchmark results as CSV (default: %s, \"\" disables)\n",
+           DEFAULT_CSV_FILE);
+    printf("  -F         Forward packets between all ports instead of running the\n"
+           "             demos and benchmarks (one queue per worker lcore)\n");
+    printf("  -C         Put a per-lcore route cache (%u entries) in front of LPM\n"
+           "             when forwarding\n", ROUTE_CACHE_SIZE);
+    printf("\nExample:\n");
+    printf("  %s -l 0-4 --no-pci -- -r 10000 -t 10\n", prgname);
+    printf("  %s -l 0-4 --no-pci -- -f rib.20241101.0000.mrt\n", prgname);
+    printf("  %s -l 0-2 -a 0000:03:00.0 -a 0000:03:00.1 -- -F\n\n", prgname);
+}
+
+/* 解析命令行参数 */
+static int parse_args(int argc, char **argv)
+{
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:t:4:6:f:d:z:o:FCh")) != -1) {
+        switch (opt) {
+        case 'r':
+            churn_rate = (uint32_t)atoi(optarg);
+            if (churn_rate == 0) {
+                printf("Invalid churn rate\n");
+                return -1;
+            }
+            break;
+        case 't':
+            phase_seconds = (unsigned int)atoi(optarg);
+            if (phase_seconds == 0) {
+                printf("Invalid phase duration\n");
+                return -1;
+            }
+            break;
+        case '4':
+            nb_v4_routes = (uint32_t)atoi(optarg);
+            break;
+        case '6':
+            nb_v6_routes = (uint32_t)atoi(optarg);
+            break;
+        case 'f':
+            route_file = optarg;
+            break;
+        case 'd':
+            nb_dests = (uint32_t)atoi(optarg);
+            if (nb_dests == 0) {
+                printf("Invalid destination count\n");
+                return -1;
+            }
+            break;
+        case 'z':
+            zipf_s = atof(optarg);
+            if (zipf_s < 0) {
+                printf("Invalid Zipf exponent\n");
+                return -1;
+            }
+            break;
+        case 'o':
+            csv_path = optarg;
+            break;
+        case 'F':
+            forward_mode = 1;
+            break;
+        case 'C':
+            route_cache_enabled = 1;
+            break;
+        case 'h':
+            print_usage(argv[0]);
+            exit(0);
+        default:
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* 主函数 */
+int main(int argc, char *argv[])
+{
+    int ret;
+    unsigned int socket_id;
+    unsigned int nb_mbufs = NUM_MBUFS;
+    uint32_t max_rules = MAX_ROUTES;
+    uint32_t num_tbl8s = NUM_TBL8S;
+
+    /* 初始化 EAL */
+    ret = rte_eal_init(argc, argv);
+    if (ret < 0)
+        rte_exit(EXIT_FAILURE, "Cannot init EAL\n");
+
+    argc -= ret;
+    argv += ret;
+
+    if (parse_args(argc, argv) < 0)
+        rte_exit(EXIT_FAILURE, "Invalid arguments\n");
+
+    /* 注册信号处理 */
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    /* 获取 NUMA socket */
+    socket_id = rte_socket_id();
+
+    printf("\n╔════════════════════════════════════════════════════════╗\n");
+    printf("║   DPDK LPM (Longest Prefix Match) Routing Demo        ║\n");
+    printf("╚════════════════════════════════════════════════════════╝\n\n");
+
+    /* 导入路由文件, LPM 的规模按文件内容确定 */
+    if (route_file != NULL) {
+        uint32_t groups;
+
+        if (load_route_file(route_file, &loaded_routes) < 0)
+            rte_exit(EXIT_FAILURE, "Cannot load routes from %s\n", route_file);
+        if (estimate_tbl8s_v4(loaded_routes.v4, loaded_routes.nb_v4, &groups) < 0)
+            rte_exit(EXIT_FAILURE, "Cannot estimate tbl8 groups\n");
+
+        max_rules += loaded_routes.nb_v4;
+        num_tbl8s += tbl8s_with_headroom(groups);
+        printf("  IPv4 tbl8 groups needed: %u\n\n", groups);
+    }
 
     printf("Configuration:\n");
     printf("  NUMA Socket:          %u\n", socket_id);
-    printf("  Max Routes:           %u\n", MAX_ROUTES);
-    printf("  Number of TBL8s:      %u\n", NUM_TBL8S);
+    printf("  Max Routes:           %u\n", max_rules);
+    printf("  Number of TBL8s:      %u\n", num_tbl8s);
     printf("\n");
 
-    /* 创建内存池 */
-    mbuf_pool = rte_pktmbuf_pool_create("mbuf_pool", NUM_MBUFS,
+    /* 创建内存池, 转发模式要填满所有 RX/TX 环 */
+    if (forward_mode)
+        nb_mbufs = RTE_MAX(nb_mbufs, rte_eth_dev_count_avail() *
+                           (rte_lcore_count() - 1) *
+                           (RX_RING_SIZE + TX_RING_SIZE + BURST_SIZE) +
+                           rte_lcore_count() * MBUF_CACHE_SIZE);
+    mbuf_pool = rte_pktmbuf_pool_create("mbuf_pool", nb_mbufs,
                                         MBUF_CACHE_SIZE, 0,
                                         RTE_MBUF_DEFAULT_BUF_SIZE,
                                         socket_id);
@@ -534,8 +2805,8 @@ int main(int argc, char *argv[])
 
     /* 创建 LPM 表 */
     struct rte_lpm_config config = {
-        .max_rules = MAX_ROUTES,
-        .number_tbl8s = NUM_TBL8S,
+        .max_rules = max_rules,
+        .number_tbl8s = num_tbl8s,
         .flags = 0
     };
 
@@ -546,20 +2817,62 @@ int main(int argc, char *argv[])
 
     printf("LPM table created successfully\n");
 
+    /*
+     * 挂接 RCU: 删除路由释放的 tbl8 先进延迟队列 (DQ 模式), 所有查找线程
+     * 越过静止点后才被重新分配, 查找路径本身无锁
+     */
+    size_t qsv_size = rte_rcu_qsbr_get_memsize(RTE_MAX_LCORE);
+    lpm_qsv = rte_zmalloc("lpm_qsv", qsv_size, RTE_CACHE_LINE_SIZE);
+    if (lpm_qsv == NULL)
+        rte_exit(EXIT_FAILURE, "Cannot allocate RCU QSBR variable\n");
+    rte_rcu_qsbr_init(lpm_qsv, RTE_MAX_LCORE);
+
+    struct rte_lpm_rcu_config rcu_cfg = {
+        .v = lpm_qsv,
+        .mode = RTE_LPM_QSBR_MODE_DQ,
+    };
+    if (rte_lpm_rcu_qsbr_add(lpm, &rcu_cfg) != 0)
+        rte_exit(EXIT_FAILURE, "Cannot attach RCU to LPM: %s\n",
+                 rte_strerror(rte_errno));
+
     /* 初始化下一跳表 */
     init_next_hop_table();
 
     /* 初始化路由表 */
     init_routing_table();
 
+    /* 装入路由文件中的 IPv4 路由 */
+    if (loaded_routes.nb_v4 > 0)
+        build_lpm_from_routes(&loaded_routes);
+
     /* 演示路由查找 */
     demo_routing_lookups();
 
-    /* 性能测试 */
-    benchmark_bulk_lookup();
+    if (forward_mode) {
+        /* 转发模式: 在真实端口上转发, 不跑演示之外的测试 */
+        run_forwarder();
+    } else {
+        /* 生成查找基准的流量, 打开 CSV 输出 */
+        if (init_traffic() < 0)
+            rte_exit(EXIT_FAILURE, "Cannot allocate lookup traffic\n");
+
+        if (csv_path[0] != '\0') {
+            csv_fp = fopen(csv_path, "w");
+            if (csv_fp == NULL)
+                rte_exit(EXIT_FAILURE, "Cannot open %s: %s\n", csv_path, strerror(errno));
+            fprintf(csv_fp, "test,distribution,zipf_s,destinations,cache,batch,"
+                    "lookups,cycles_per_lookup,mlookups_per_sec,hit_pct\n");
+        }
+
+        /* 性能测试 */
+        benchmark_bulk_lookup();
+
+        /* 模拟数据包转发 */
+        simulate_packet_forwarding();
 
-    /* 模拟数据包转发 */
-    simulate_packet_forwarding();
+        /* 多核查找 + 路由抖动 */
+        benchmark_route_churn();
+    }
 
     /* 打印统计信息 */
     print_statistics();
@@ -567,6 +2880,13 @@ int main(int argc, char *argv[])
     /* 清理资源 */
     printf("Cleaning up...\n");
     rte_lpm_free(lpm);
+    rte_free(lpm_qsv);
+    route_set_free(&loaded_routes);
+    free_traffic();
+    if (csv_fp != NULL) {
+        fclose(csv_fp);
+        printf("Benchmark results written to %s\n", csv_path);
+    }
     rte_mempool_free(mbuf_pool);
 
     /* 清理 EAL */